@@ -17,6 +17,7 @@
  */
 #include <node_config.h>
 #include <lxc_config.h>
+#include "lib/static_data.h"
 
 #define EVENT_SOURCE LXC_ID
 
@@ -55,6 +56,7 @@ struct bpf_elf_map __section_maps CT_MAP6 = {
 	.type		= BPF_MAP_TYPE_LRU_HASH,
 #else
 	.type		= BPF_MAP_TYPE_HASH,
+	.flags		= CONDITIONAL_PREALLOC,
 #endif
 	.size_key	= sizeof(struct ipv6_ct_tuple),
 	.size_value	= sizeof(struct ct_entry),
@@ -67,6 +69,7 @@ struct bpf_elf_map __section_maps CT_MAP4 = {
 	.type		= BPF_MAP_TYPE_LRU_HASH,
 #else
 	.type		= BPF_MAP_TYPE_HASH,
+	.flags		= CONDITIONAL_PREALLOC,
 #endif
 	.size_key	= sizeof(struct ipv4_ct_tuple),
 	.size_value	= sizeof(struct ct_entry),
@@ -79,6 +82,18 @@ static inline bool redirect_to_proxy(int verdict)
 	return verdict > 0;
 }
 
+/* Stores the policy verdict towards/from @remote in @state so it is cached
+ * in the conntrack entry, see policy_revision(). */
+static inline void ct_state_set_policy(struct ct_state *state, __u32 rev,
+				       __u32 remote, __be32 tunnel_endpoint,
+				       int verdict)
+{
+	state->policy_rev = rev;
+	state->remote_sec_id = remote;
+	state->tunnel_endpoint = tunnel_endpoint;
+	state->proxy_port = redirect_to_proxy(verdict) ? verdict : 0;
+}
+
 static inline int ipv6_l3_from_lxc(struct __sk_buff *skb,
 				   struct ipv6_ct_tuple *tuple, int l3_off,
 				   struct ethhdr *eth, struct ipv6hdr *ip6)
@@ -95,8 +110,8 @@ static inline int ipv6_l3_from_lxc(struct __sk_buff *skb,
 	void *data, *data_end;
 	union v6addr *daddr, orig_dip;
 	uint32_t dstID = WORLD_ID;
-	__u32 tunnel_endpoint = 0;
-	bool monitor = false;
+	__u32 tunnel_endpoint = 0, policy_rev;
+	bool monitor = false, cached;
 
 	if (unlikely(!is_valid_lxc_src_mac(eth)))
 		return DROP_INVALID_SMAC;
@@ -166,10 +181,19 @@ skip_service_lookup:
 		return DROP_INVALID;
 	daddr = (union v6addr *)&ip6->daddr;
 
+	/* Established connections reuse the destination and verdict cached
+	 * in the conntrack entry unless policy or ipcache changed since. */
+	policy_rev = policy_revision();
+	cached = ret == CT_ESTABLISHED && policy_rev &&
+		 ct_state.policy_rev == policy_rev;
+
 	/* Determine the destination category for policy fallback. */
 	BPF_V6(router_ip, ROUTER_IP);
 
-	if (1) {
+	if (cached) {
+		dstID = ct_state.remote_sec_id;
+		tunnel_endpoint = ct_state.tunnel_endpoint;
+	} else {
 		struct remote_endpoint_info *info;
 
 		info = lookup_ip6_remote_endpoint(&orig_dip);
@@ -186,8 +210,11 @@ skip_service_lookup:
 	/* If the packet is in the establishing direction and it's destined
 	 * within the cluster, it must match policy or be dropped. If it's
 	 * bound for the host/outside, perform the CIDR policy check. */
-	verdict = policy_can_egress6(skb, tuple, dstID,
-				     ipv6_ct_tuple_get_daddr(tuple));
+	if (cached)
+		verdict = ct_state.proxy_port;
+	else
+		verdict = policy_can_egress6(skb, tuple, dstID,
+					     ipv6_ct_tuple_get_daddr(tuple));
 	if (ret != CT_REPLY && ret != CT_RELATED && verdict < 0) {
 		/* If the connection was previously known and packet is now
 		 * denied, remove the connection tracking entry */
@@ -205,6 +232,8 @@ skip_service_lookup:
 		 * reverse NAT.
 		 */
 		ct_state_new.src_sec_id = SECLABEL;
+		ct_state_set_policy(&ct_state_new, policy_rev, dstID,
+				    tunnel_endpoint, verdict);
 		ret = ct_create6(&CT_MAP6, tuple, skb, CT_EGRESS, &ct_state_new);
 		if (IS_ERR(ret))
 			return ret;
@@ -212,6 +241,11 @@ skip_service_lookup:
 		break;
 
 	case CT_ESTABLISHED:
+		if (policy_rev && !cached) {
+			ct_state_set_policy(&ct_state, policy_rev, dstID,
+					    tunnel_endpoint, verdict);
+			ct_update6_policy(&CT_MAP6, tuple, &ct_state);
+		}
 		break;
 
 	case CT_RELATED:
@@ -238,6 +272,14 @@ skip_service_lookup:
 		union macaddr host_mac = HOST_IFINDEX_MAC;
 		union v6addr host_ip = {};
 
+#ifdef ENABLE_PROXY_SK_ASSIGN
+		ret = ipv6_redirect_to_proxy_sk(skb, verdict, tuple->dport,
+						&orig_dip, tuple, SECLABEL,
+						forwarding_reason, monitor);
+		if (ret != DROP_PROXY_SOCKET)
+			return ret;
+#endif
+
 		BPF_V6(host_ip, HOST_IP);
 
 		ret = ipv6_redirect_to_host_port(skb, &csum_off, l4_off,
@@ -279,6 +321,7 @@ skip_service_lookup:
 		}
 
 		policy_clear_mark(skb);
+		update_ep_metrics(skb->len, METRIC_EGRESS, REASON_FORWARDED, dstID);
 		return ipv6_local_delivery(skb, l3_off, l4_off, SECLABEL, ip6, tuple->nexthdr, ep, METRIC_EGRESS);
 	}
 
@@ -415,8 +458,8 @@ static inline int handle_ipv4_from_lxc(struct __sk_buff *skb)
 	struct ct_state ct_state = {};
 	__be32 orig_dip;
 	uint32_t dstID = WORLD_ID;
-	__u32 tunnel_endpoint = 0;
-	bool monitor = false;
+	__u32 tunnel_endpoint = 0, policy_rev;
+	bool monitor = false, cached;
 
 	if (!revalidate_data(skb, &data, &data_end, &ip4))
 		return DROP_INVALID;
@@ -476,8 +519,17 @@ skip_service_lookup:
 
 	forwarding_reason = ret;
 
+	/* Established connections reuse the destination and verdict cached
+	 * in the conntrack entry unless policy or ipcache changed since. */
+	policy_rev = policy_revision();
+	cached = ret == CT_ESTABLISHED && policy_rev &&
+		 ct_state.policy_rev == policy_rev;
+
 	/* Determine the destination category for policy fallback. */
-	if (1) {
+	if (cached) {
+		dstID = ct_state.remote_sec_id;
+		tunnel_endpoint = ct_state.tunnel_endpoint;
+	} else {
 		struct remote_endpoint_info *info;
 
 		info = lookup_ip4_remote_endpoint(orig_dip);
@@ -494,7 +546,10 @@ skip_service_lookup:
 	/* If the packet is in the establishing direction and it's destined
 	 * within the cluster, it must match policy or be dropped. If it's
 	 * bound for the host/outside, perform the CIDR policy check. */
-	verdict = policy_can_egress4(skb, &tuple, dstID, ipv4_ct_tuple_get_daddr(&tuple));
+	if (cached)
+		verdict = ct_state.proxy_port;
+	else
+		verdict = policy_can_egress4(skb, &tuple, dstID, ipv4_ct_tuple_get_daddr(&tuple));
 	if (ret != CT_REPLY && ret != CT_RELATED && verdict < 0) {
 		/* If the connection was previously known and packet is now
 		 * denied, remove the connection tracking entry */
@@ -512,12 +567,19 @@ skip_service_lookup:
 		 * reverse NAT.
 		 */
 		ct_state_new.src_sec_id = SECLABEL;
+		ct_state_set_policy(&ct_state_new, policy_rev, dstID,
+				    tunnel_endpoint, verdict);
 		ret = ct_create4(&CT_MAP4, &tuple, skb, CT_EGRESS, &ct_state_new);
 		if (IS_ERR(ret))
 			return ret;
 		break;
 
 	case CT_ESTABLISHED:
+		if (policy_rev && !cached) {
+			ct_state_set_policy(&ct_state, policy_rev, dstID,
+					    tunnel_endpoint, verdict);
+			ct_update4_policy(&CT_MAP4, &tuple, &ct_state);
+		}
 		break;
 
 	case CT_RELATED:
@@ -539,6 +601,14 @@ skip_service_lookup:
 	if (redirect_to_proxy(verdict)) {
 		union macaddr host_mac = HOST_IFINDEX_MAC;
 
+#ifdef ENABLE_PROXY_SK_ASSIGN
+		ret = ipv4_redirect_to_proxy_sk(skb, verdict, tuple.dport,
+						orig_dip, &tuple, SECLABEL,
+						forwarding_reason, monitor);
+		if (ret != DROP_PROXY_SOCKET)
+			return ret;
+#endif
+
 		ret = ipv4_redirect_to_host_port(skb, &csum_off, l4_off,
 						 verdict, tuple.dport,
 						 orig_dip, &tuple, SECLABEL,
@@ -581,6 +651,7 @@ skip_service_lookup:
 #endif
 		}
 		policy_clear_mark(skb);
+		update_ep_metrics(skb->len, METRIC_EGRESS, REASON_FORWARDED, dstID);
 		return ipv4_local_delivery(skb, l3_off, l4_off, SECLABEL, ip4, ep, METRIC_EGRESS);
 	}
 
@@ -728,8 +799,9 @@ ipv6_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 	int ret, l4_off, verdict, hdrlen;
 	struct ct_state ct_state = {};
 	struct ct_state ct_state_new = {};
-	bool skip_proxy, monitor = false;
+	bool skip_proxy, cached, monitor = false;
 	union v6addr orig_dip = {};
+	__u32 policy_rev;
 
 	if (!revalidate_data(skb, &data, &data_end, &ip6))
 		return DROP_INVALID;
@@ -787,9 +859,20 @@ ipv6_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 			return ret2;
 	}
 
-	verdict = policy_can_access_ingress(skb, src_label, tuple.dport,
-					    tuple.nexthdr, sizeof(tuple.saddr),
-					    &tuple.saddr);
+	/* Established connections reuse the verdict cached in the conntrack
+	 * entry unless policy or ipcache changed or the source identity
+	 * differs from the one the verdict was computed for. */
+	policy_rev = policy_revision();
+	cached = ret == CT_ESTABLISHED && policy_rev &&
+		 ct_state.policy_rev == policy_rev &&
+		 ct_state.remote_sec_id == src_label;
+
+	if (cached)
+		verdict = ct_state.proxy_port;
+	else
+		verdict = policy_can_access_ingress(skb, src_label, tuple.dport,
+						    tuple.nexthdr, sizeof(tuple.saddr),
+						    &tuple.saddr);
 
 	/* Reply packets and related packets are allowed, all others must be
 	 * permitted by policy */
@@ -802,6 +885,16 @@ ipv6_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 		return DROP_POLICY;
 	}
 
+	/* The verdict is cached before it is overridden for proxy traffic */
+	if (ret == CT_NEW) {
+		ct_state_set_policy(&ct_state_new, policy_rev, src_label, 0,
+				    verdict);
+	} else if (ret == CT_ESTABLISHED && policy_rev && !cached) {
+		ct_state_set_policy(&ct_state, policy_rev, src_label, 0,
+				    verdict);
+		ct_update6_policy(&CT_MAP6, &tuple, &ct_state);
+	}
+
 	if (skip_proxy)
 		verdict = 0;
 
@@ -820,6 +913,14 @@ ipv6_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 		union macaddr router_mac = NODE_MAC;
 		union v6addr host_ip = {};
 
+#ifdef ENABLE_PROXY_SK_ASSIGN
+		ret = ipv6_redirect_to_proxy_sk(skb, verdict, tuple.dport,
+						&orig_dip, &tuple, src_label,
+						*forwarding_reason, monitor);
+		if (ret != DROP_PROXY_SOCKET)
+			return ret;
+#endif
+
 		BPF_V6(host_ip, HOST_IP);
 
 		ret = ipv6_redirect_to_host_port(skb, &csum_off, l4_off,
@@ -872,8 +973,9 @@ ipv4_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 	int ret, verdict, l4_off;
 	struct ct_state ct_state = {};
 	struct ct_state ct_state_new = {};
-	bool skip_proxy, monitor = false;
+	bool skip_proxy, cached, monitor = false;
 	__be32 orig_dip, orig_sip;
+	__u32 policy_rev;
 
 	if (!revalidate_data(skb, &data, &data_end, &ip4))
 		return DROP_INVALID;
@@ -918,9 +1020,20 @@ ipv4_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 			return ret2;
 	}
 
-	verdict = policy_can_access_ingress(skb, src_label, tuple.dport,
-					    tuple.nexthdr, sizeof(orig_sip),
-					    &orig_sip);
+	/* Established connections reuse the verdict cached in the conntrack
+	 * entry unless policy or ipcache changed or the source identity
+	 * differs from the one the verdict was computed for. */
+	policy_rev = policy_revision();
+	cached = ret == CT_ESTABLISHED && policy_rev &&
+		 ct_state.policy_rev == policy_rev &&
+		 ct_state.remote_sec_id == src_label;
+
+	if (cached)
+		verdict = ct_state.proxy_port;
+	else
+		verdict = policy_can_access_ingress(skb, src_label, tuple.dport,
+						    tuple.nexthdr, sizeof(orig_sip),
+						    &orig_sip);
 
 	/* Reply packets and related packets are allowed, all others must be
 	 * permitted by policy */
@@ -933,6 +1046,16 @@ ipv4_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 		return DROP_POLICY;
 	}
 
+	/* The verdict is cached before it is overridden for proxy traffic */
+	if (ret == CT_NEW) {
+		ct_state_set_policy(&ct_state_new, policy_rev, src_label, 0,
+				    verdict);
+	} else if (ret == CT_ESTABLISHED && policy_rev && !cached) {
+		ct_state_set_policy(&ct_state, policy_rev, src_label, 0,
+				    verdict);
+		ct_update4_policy(&CT_MAP4, &tuple, &ct_state);
+	}
+
 	if (skip_proxy)
 		verdict = 0;
 
@@ -950,6 +1073,14 @@ ipv4_policy(struct __sk_buff *skb, int ifindex, __u32 src_label, int *forwarding
 		union macaddr host_mac = HOST_IFINDEX_MAC;
 		union macaddr router_mac = NODE_MAC;
 
+#ifdef ENABLE_PROXY_SK_ASSIGN
+		ret = ipv4_redirect_to_proxy_sk(skb, verdict, tuple.dport,
+						orig_dip, &tuple, src_label,
+						*forwarding_reason, monitor);
+		if (ret != DROP_PROXY_SOCKET)
+			return ret;
+#endif
+
 		ret = ipv4_redirect_to_host_port(skb, &csum_off, l4_off,
 						 verdict, tuple.dport,
 						 orig_dip, &tuple, src_label,
@@ -1000,7 +1131,7 @@ __section_tail(CILIUM_MAP_CALLS, CILIUM_CALL_IPV4_TO_LXC) int tail_ipv4_policy(s
  * passed into the endpoint or if it needs further inspection by a userspace
  * proxy.
  */
-__section_tail(CILIUM_MAP_POLICY, LXC_ID) int handle_policy(struct __sk_buff *skb)
+__section_tail(CILIUM_MAP_POLICY, TEMPLATE_LXC_ID) int handle_policy(struct __sk_buff *skb)
 {
 	int ret, ifindex = skb->cb[CB_IFINDEX];
 	__u32 src_label = skb->cb[CB_SRC_LABEL];
@@ -27,6 +27,11 @@
 /* Include policy_can_access_ingress() */
 #define REQUIRES_CAN_ACCESS
 
+/* Masquerading only happens on the native device */
+#ifdef FROM_HOST
+# undef ENABLE_MASQUERADE
+#endif
+
 #include <bpf/api.h>
 
 #include <stdint.h>
@@ -46,6 +51,7 @@
 #include "lib/policy.h"
 #include "lib/drop.h"
 #include "lib/encap.h"
+#include "lib/nat.h"
 
 static inline __u32 derive_sec_ctx(struct __sk_buff *skb, const union v6addr *node_ip,
 				   struct ipv6hdr *ip6)
@@ -361,9 +367,16 @@ static inline int handle_ipv4(struct __sk_buff *skb, __u32 src_identity)
 	struct endpoint_info *ep;
 	void *data, *data_end;
 	struct iphdr *ip4;
-	int l4_off;
+	int l4_off, ret;
 	__u32 secctx;
 
+	/* Replies of masqueraded flows are translated back to the endpoint
+	 * and delivered below without passing the stack.
+	 */
+	ret = snat_v4_ingress(skb);
+	if (IS_ERR(ret))
+		return ret;
+
 	if (!revalidate_data(skb, &data, &data_end, &ip4))
 		return DROP_INVALID;
 
@@ -399,8 +412,6 @@ static inline int handle_ipv4(struct __sk_buff *skb, __u32 src_identity)
 
 #ifdef FROM_HOST
 	if (1) {
-		int ret;
-
 		secctx = src_identity;
 		ret = reverse_proxy(skb, l4_off, ip4, tuple.nexthdr);
 		/* DIRECT PACKET READ INVALID */
@@ -437,7 +448,6 @@ static inline int handle_ipv4(struct __sk_buff *skb, __u32 src_identity)
 	} else if ((ip4->daddr & IPV4_CLUSTER_MASK) == IPV4_CLUSTER_RANGE) {
 		/* IPv4 lookup key: daddr & IPV4_MASK */
 		struct endpoint_key key = {};
-		int ret;
 
 		key.ip4 = ip4->daddr & IPV4_MASK;
 		key.family = ENDPOINT_KEY_IPV4;
@@ -523,4 +533,63 @@ int from_netdev(struct __sk_buff *skb)
 	return ret;
 }
 
+#if defined(ENABLE_BANDWIDTH_MANAGER) && defined(HAVE_SKB_TSTAMP)
+/* Packets of local endpoints routed by the stack have lost the departure
+ * time set by the endpoint when they were forwarded. The limit of the
+ * endpoint is enforced here instead, found by the source address. */
+static inline int edt_sched_netdev(struct __sk_buff *skb)
+{
+	struct endpoint_info *ep = NULL;
+	void *data, *data_end;
+	struct ipv6hdr *ip6;
+#ifdef ENABLE_IPV4
+	struct iphdr *ip4;
+#endif
+
+	switch (skb->protocol) {
+	case bpf_htons(ETH_P_IPV6):
+		if (!revalidate_data(skb, &data, &data_end, &ip6))
+			return DROP_INVALID;
+		ep = __lookup_ip6_endpoint((union v6addr *) &ip6->saddr);
+		break;
+#ifdef ENABLE_IPV4
+	case bpf_htons(ETH_P_IP):
+		if (!revalidate_data(skb, &data, &data_end, &ip4))
+			return DROP_INVALID;
+		ep = __lookup_ip4_endpoint(ip4->saddr);
+		break;
+#endif
+	}
+
+	if (!ep || ep->flags & ENDPOINT_F_HOST)
+		return TC_ACT_OK;
+
+	return edt_sched_departure_ep(skb, ep->lxc_id);
+}
+#endif
+
+#if (defined(ENABLE_MASQUERADE) && defined(ENABLE_IPV4)) || \
+    (defined(ENABLE_BANDWIDTH_MANAGER) && defined(HAVE_SKB_TSTAMP))
+__section("to-netdev")
+int to_netdev(struct __sk_buff *skb)
+{
+	int ret = TC_ACT_OK;
+
+#if defined(ENABLE_BANDWIDTH_MANAGER) && defined(HAVE_SKB_TSTAMP)
+	/* Before masquerading, which hides the endpoint */
+	ret = edt_sched_netdev(skb);
+#endif
+
+#if defined(ENABLE_MASQUERADE) && defined(ENABLE_IPV4)
+	if (!IS_ERR(ret) && skb->protocol == bpf_htons(ETH_P_IP))
+		ret = snat_v4_egress(skb);
+#endif
+
+	if (IS_ERR(ret))
+		return send_drop_notify_error(skb, ret, TC_ACT_SHOT, METRIC_EGRESS);
+
+	return ret;
+}
+#endif
+
 BPF_LICENSE("GPL");
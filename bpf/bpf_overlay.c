@@ -33,22 +33,63 @@
 #include "lib/l3.h"
 #include "lib/drop.h"
 #include "lib/policy.h"
+#ifdef XDP_DECAP
+#include "lib/xdp.h"
+
+/* Returns the metadata of a frame decapsulated by bpf_xdp.o or NULL. */
+static __always_inline struct xdp_decap_meta *
+get_decap_meta(struct __sk_buff *skb)
+{
+	struct xdp_decap_meta *meta = (void *)(long)skb->data_meta;
+
+	if ((void *)(meta + 1) > (void *)(long)skb->data ||
+	    meta->magic != XDP_DECAP_MAGIC)
+		return NULL;
+
+	return meta;
+}
+#endif
+
+/* Fetches the security identity of the source from the tunnel key, or
+ * with XDP_DECAP from the metadata of a frame decapsulated by bpf_xdp.o.
+ */
+static __always_inline int get_tunnel_identity(struct __sk_buff *skb,
+					       __u32 *identity)
+{
+#ifdef XDP_DECAP
+	struct xdp_decap_meta *meta = get_decap_meta(skb);
+
+	if (unlikely(!meta))
+		return DROP_NO_TUNNEL_KEY;
+
+	*identity = meta->identity;
+#else
+	struct bpf_tunnel_key key = {};
+
+	if (unlikely(skb_get_tunnel_key(skb, &key, sizeof(key), 0) < 0))
+		return DROP_NO_TUNNEL_KEY;
+
+	*identity = key.tunnel_id;
+#endif
+	return 0;
+}
 
 static inline int handle_ipv6(struct __sk_buff *skb)
 {
 	void *data_end, *data;
 	struct ipv6hdr *ip6;
-	struct bpf_tunnel_key key = {};
 	struct endpoint_info *ep;
-	int l4_off, l3_off = ETH_HLEN, hdrlen;
+	int l4_off, l3_off = ETH_HLEN, hdrlen, ret;
+	__u32 identity;
 
 	if (!revalidate_data(skb, &data, &data_end, &ip6))
 		return DROP_INVALID;
 
-	if (unlikely(skb_get_tunnel_key(skb, &key, sizeof(key), 0) < 0))
-		return DROP_NO_TUNNEL_KEY;
+	ret = get_tunnel_identity(skb, &identity);
+	if (ret < 0)
+		return ret;
 
-	cilium_dbg(skb, DBG_DECAP, key.tunnel_id, key.tunnel_label);
+	cilium_dbg(skb, DBG_DECAP, identity, 0);
 
 	/* Lookup IPv6 address in list of local endpoints */
 	if ((ep = lookup_ip6_endpoint(ip6)) != NULL) {
@@ -63,7 +104,7 @@ static inline int handle_ipv6(struct __sk_buff *skb)
 			return hdrlen;
 
 		l4_off = l3_off + hdrlen;
-		return ipv6_local_delivery(skb, l3_off, l4_off, key.tunnel_id, ip6, nexthdr, ep, METRIC_INGRESS);
+		return ipv6_local_delivery(skb, l3_off, l4_off, identity, ip6, nexthdr, ep, METRIC_INGRESS);
 	}
 
 to_host:
@@ -94,14 +135,15 @@ static inline int handle_ipv4(struct __sk_buff *skb)
 	void *data_end, *data;
 	struct iphdr *ip4;
 	struct endpoint_info *ep;
-	struct bpf_tunnel_key key = {};
-	int l4_off;
+	int l4_off, ret;
+	__u32 identity;
 
 	if (!revalidate_data(skb, &data, &data_end, &ip4))
 		return DROP_INVALID;
 
-	if (unlikely(skb_get_tunnel_key(skb, &key, sizeof(key), 0) < 0))
-		return DROP_NO_TUNNEL_KEY;
+	ret = get_tunnel_identity(skb, &identity);
+	if (ret < 0)
+		return ret;
 
 	l4_off = ETH_HLEN + ipv4_hdrlen(ip4);
 
@@ -112,7 +154,7 @@ static inline int handle_ipv4(struct __sk_buff *skb)
 		if (ep->flags & ENDPOINT_F_HOST)
 			goto to_host;
 
-		return ipv4_local_delivery(skb, ETH_HLEN, l4_off, key.tunnel_id, ip4, ep, METRIC_INGRESS);
+		return ipv4_local_delivery(skb, ETH_HLEN, l4_off, identity, ip4, ep, METRIC_INGRESS);
 	}
 
 to_host:
@@ -153,6 +195,14 @@ int from_overlay(struct __sk_buff *skb)
 {
 	int ret;
 
+#ifdef XDP_DECAP
+	/* Attached to the XDP device, only frames decapsulated by bpf_xdp.o
+	 * are handled here.
+	 */
+	if (!get_decap_meta(skb))
+		return TC_ACT_OK;
+#endif
+
 	bpf_clear_cb(skb);
 
 	send_trace_notify(skb, TRACE_FROM_OVERLAY, 0, 0, 0,
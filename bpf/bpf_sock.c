@@ -0,0 +1,163 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/**
+ * Description: Service load balancing at the socket layer. Attached to the
+ *              cgroup v2 root, the programs translate the destination of
+ *              connect() and of sendmsg() on unconnected UDP sockets from
+ *              a service address to one of its backends. The backend is
+ *              selected once per socket respectively datagram, packets
+ *              of the connection then carry the backend address and no
+ *              longer match a service in the tc datapath, so the per
+ *              packet NAT and reverse NAT is skipped entirely. Traffic
+ *              not covered here is still translated by the tc datapath.
+ *
+ * Configuration:
+ *  - ENABLE_SOCKET_LB_SENDMSG - Also translate the destination of datagrams
+ *                               sent on unconnected UDP sockets. Replies are
+ *                               received from the backend address.
+ */
+
+#include <node_config.h>
+#include <bpf/api.h>
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lib/utils.h"
+#include "lib/common.h"
+#include "lib/ipv6.h"
+#include "lib/ipv4.h"
+#include "lib/l4.h"
+#include "lib/dbg.h"
+#include "lib/lb.h"
+
+#define SYS_REJECT	0
+#define SYS_PROCEED	1
+
+static __always_inline __be16 ctx_dst_port(const struct bpf_sock_addr *ctx)
+{
+	/* The port is stored in network byte order in the lower 16 bits */
+	volatile __u32 dport = ctx->user_port;
+
+	return (__be16)dport;
+}
+
+static __always_inline __u16 sock_select_slave(__u16 count)
+{
+	/* Same distribution as lb4_select_slave(), but there is no packet
+	 * hash yet at socket level. Slave 0 is reserved for the master slot.
+	 */
+	return (get_prandom_u32() % count) + 1;
+}
+
+#ifdef ENABLE_IPV4
+static __always_inline int sock4_xlate(struct bpf_sock_addr *ctx)
+{
+	struct lb4_key key = {
+		.address	= ctx->user_ip4,
+		.dport		= ctx_dst_port(ctx),
+	};
+	struct lb4_service *svc;
+
+	svc = map_lookup_elem(&cilium_lb4_services, &key);
+	if (!svc || svc->count == 0) {
+		/* L3 only service */
+		key.dport = 0;
+		svc = map_lookup_elem(&cilium_lb4_services, &key);
+		if (!svc || svc->count == 0)
+			return SYS_PROCEED;
+	}
+
+	key.slave = sock_select_slave(svc->count);
+	svc = map_lookup_elem(&cilium_lb4_services, &key);
+	if (!svc)
+		return SYS_PROCEED;
+
+	ctx->user_ip4 = svc->target;
+	if (svc->port)
+		ctx->user_port = svc->port;
+
+	return SYS_PROCEED;
+}
+
+__section("connect4")
+int sock4_connect(struct bpf_sock_addr *ctx)
+{
+	return sock4_xlate(ctx);
+}
+
+#ifdef ENABLE_SOCKET_LB_SENDMSG
+__section("sendmsg4")
+int sock4_sendmsg(struct bpf_sock_addr *ctx)
+{
+	return sock4_xlate(ctx);
+}
+#endif
+#endif /* ENABLE_IPV4 */
+
+static __always_inline int sock6_xlate(struct bpf_sock_addr *ctx)
+{
+	struct lb6_key key = {
+		.address.p1	= ctx->user_ip6[0],
+		.address.p2	= ctx->user_ip6[1],
+		.address.p3	= ctx->user_ip6[2],
+		.address.p4	= ctx->user_ip6[3],
+		.dport		= ctx_dst_port(ctx),
+	};
+	struct lb6_service *svc;
+
+	svc = map_lookup_elem(&cilium_lb6_services, &key);
+	if (!svc || svc->count == 0) {
+		/* L3 only service */
+		key.dport = 0;
+		svc = map_lookup_elem(&cilium_lb6_services, &key);
+		if (!svc || svc->count == 0)
+			return SYS_PROCEED;
+	}
+
+	key.slave = sock_select_slave(svc->count);
+	svc = map_lookup_elem(&cilium_lb6_services, &key);
+	if (!svc)
+		return SYS_PROCEED;
+
+	ctx->user_ip6[0] = svc->target.p1;
+	ctx->user_ip6[1] = svc->target.p2;
+	ctx->user_ip6[2] = svc->target.p3;
+	ctx->user_ip6[3] = svc->target.p4;
+	if (svc->port)
+		ctx->user_port = svc->port;
+
+	return SYS_PROCEED;
+}
+
+__section("connect6")
+int sock6_connect(struct bpf_sock_addr *ctx)
+{
+	return sock6_xlate(ctx);
+}
+
+#ifdef ENABLE_SOCKET_LB_SENDMSG
+__section("sendmsg6")
+int sock6_sendmsg(struct bpf_sock_addr *ctx)
+{
+	return sock6_xlate(ctx);
+}
+#endif
+
+BPF_LICENSE("GPL");
@@ -28,13 +28,18 @@
 
 #include <linux/bpf.h>
 #include <linux/if_ether.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
 
 #include "lib/utils.h"
 #include "lib/common.h"
 #include "lib/maps.h"
+#include "lib/ipv4.h"
 #include "lib/xdp.h"
+#include "lib/jhash.h"
 #include "lib/eps.h"
 #include "lib/events.h"
+#include "lib/ratelimit.h"
 
 #ifndef HAVE_LPM_MAP_TYPE
 # undef CIDR4_LPM_PREFILTER
@@ -85,13 +90,496 @@ struct bpf_elf_map __section_maps CIDR6_LMAP_NAME = {
 #endif /* CIDR6_LPM_PREFILTER */
 #endif /* CIDR6_FILTER */
 
+struct bpf_elf_map __section_maps cilium_prefilter_metrics = {
+	.type		= BPF_MAP_TYPE_PERCPU_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct metrics_value),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= PREFILTER_METRICS_SIZE,
+};
+
+static __always_inline int prefilter_drop(struct xdp_md *xdp, int reason,
+					  __u32 family)
+{
+	void *data_end = xdp_data_end(xdp);
+	void *data = xdp_data(xdp);
+	__u64 len = data_end - data;
+	__u32 key = PREFILTER_METRICS_KEY(reason, family);
+	struct metrics_value *entry;
+
+	entry = map_lookup_elem(&cilium_prefilter_metrics, &key);
+	if (entry) {
+		entry->count++;
+		entry->bytes += len;
+	}
+
+#ifdef PREFILTER_SAMPLE_RATE
+	if (get_prandom_u32() % PREFILTER_SAMPLE_RATE == 0) {
+		__u64 cap_len = XDP_EVENT_CAP_LEN(len);
+		struct drop_notify msg = {
+			.type = CILIUM_NOTIFY_DROP,
+			.subtype = -reason,
+			.source = EVENT_SOURCE,
+			.len_orig = len,
+			.len_cap = cap_len,
+		};
+
+		send_xdp_event(xdp, &msg, sizeof(msg), cap_len);
+	}
+#endif /* PREFILTER_SAMPLE_RATE */
+
+	return XDP_DROP;
+}
+
+#ifdef L4_FILTER
+struct bpf_elf_map __section_maps L4_RULE_MAP_NAME = {
+	.type		= BPF_MAP_TYPE_HASH,
+	.size_key	= sizeof(struct l4_rule_key),
+	.size_value	= sizeof(struct l4_rule_val),
+	.flags		= BPF_F_NO_PREALLOC,
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= L4_RULE_ELEMS,
+};
+
+/* Token buckets are per-CPU, see <lib/ratelimit.h> */
+struct bpf_elf_map __section_maps L4_BUCKET_MAP_NAME = {
+#ifdef HAVE_LRU_MAP_TYPE
+	.type		= BPF_MAP_TYPE_LRU_PERCPU_HASH,
+#else
+	.type		= BPF_MAP_TYPE_PERCPU_HASH,
+	.flags		= BPF_F_NO_PREALLOC,
+#endif
+	.size_key	= sizeof(struct l4_bucket_key),
+	.size_value	= sizeof(struct ratelimit_bucket),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= L4_BUCKET_ELEMS,
+};
+
+static __always_inline bool l4_bucket_admit(const struct l4_bucket_key *key,
+					    const struct l4_rule_val *rule)
+{
+	struct ratelimit_bucket *b, init = {};
+
+	b = map_lookup_elem(&L4_BUCKET_MAP_NAME, key);
+	if (!b) {
+		if (!rule->burst)
+			return false;
+		init.last = bpf_ktime_get_nsec();
+		init.tokens = rule->burst - 1;
+		map_update_elem(&L4_BUCKET_MAP_NAME, key, &init, 0);
+		return true;
+	}
+
+	return ratelimit_admit(b, rule->rate, rule->burst);
+}
+
+static __always_inline struct l4_rule_val *l4_rule_lookup(struct l4_rule_key *key)
+{
+	struct l4_rule_val *rule;
+
+	rule = map_lookup_elem(&L4_RULE_MAP_NAME, key);
+	if (rule || !key->dport)
+		return rule;
+
+	/* Fall back to the protocol wide rule, if any. */
+	key->dport = 0;
+	return map_lookup_elem(&L4_RULE_MAP_NAME, key);
+}
+
+/* Returns 0 if the packet may pass, DROP_PREFILTER_* otherwise. */
+static __always_inline int l4_rule_apply(const struct l4_rule_val *rule,
+					 const struct l4_rule_key *rkey,
+					 struct l4_bucket_key *bkey)
+{
+	switch (rule->action) {
+	case L4_RULE_DROP:
+		return DROP_PREFILTER_L4;
+	case L4_RULE_RATELIMIT:
+		bkey->dport = rkey->dport;
+		bkey->proto = rkey->proto;
+		bkey->family = rkey->family;
+		return l4_bucket_admit(bkey, rule) ? 0 : DROP_PREFILTER_RATELIMIT;
+	default:
+		return 0;
+	}
+}
+
+/* Extracts the destination port for TCP/UDP. Returns false if the
+ * header is truncated.
+ */
+static __always_inline bool l4_load_dport(void *l4, void *data_end,
+					  struct l4_rule_key *rkey)
+{
+	__be16 *ports = l4;
+
+	if (rkey->proto != IPPROTO_TCP && rkey->proto != IPPROTO_UDP)
+		return true;
+	if (xdp_no_room(ports + 2, data_end))
+		return false;
+
+	rkey->dport = ports[1];
+	return true;
+}
+
+/* SYN cookies of L4_RULE_SYNCOOKIE rules
+ *
+ * Once a destination receives more SYNs than the token bucket of the rule
+ * admits, SYNs of sources which have not been validated yet are answered
+ * right here with a SYN-ACK which acknowledges the cookie instead of the
+ * initial sequence number of the client. A client in SYN-SENT answers
+ * such an unacceptable ACK with a reset carrying the cookie as sequence
+ * number (RFC 793) and retransmits its SYN after the usual timeout. A
+ * reset with a valid cookie validates its source for
+ * SYNCOOKIE_SRC_LIFETIME, so the retransmitted SYN continues to the
+ * endpoint and the connection tracking entry is only created by tc for
+ * handshakes of sources which proved to receive our packets.
+ *
+ * The cookie is a hash over addresses, ports, a secret written by the
+ * agent and the current time slot, nothing is stored per SYN.
+ */
+#define SYNCOOKIE_SLOT_SHIFT	36	/* ~68s per time slot */
+#define SYNCOOKIE_SRC_LIFETIME	(300ULL * NSEC_PER_SEC)
+#define SYNCOOKIE_REPLY_TTL	64
+
+/* Secret of the cookie hash, written by the agent */
+struct bpf_elf_map __section_maps L4_SYNCOOKIE_SECRET_MAP_NAME = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct syncookie_secret),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= 1,
+};
+
+/* Validated sources, the value is the ktime the validation expires */
+struct bpf_elf_map __section_maps L4_SYNCOOKIE_SRC_MAP_NAME = {
+#ifdef HAVE_LRU_MAP_TYPE
+	.type		= BPF_MAP_TYPE_LRU_HASH,
+#else
+	.type		= BPF_MAP_TYPE_HASH,
+	.flags		= BPF_F_NO_PREALLOC,
+#endif
+	.size_key	= sizeof(struct syncookie_src_key),
+	.size_value	= sizeof(__u64),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= L4_SYNCOOKIE_ELEMS,
+};
+
+struct bpf_elf_map __section_maps L4_SYNCOOKIE_STATS_MAP_NAME = {
+#ifdef HAVE_LRU_MAP_TYPE
+	.type		= BPF_MAP_TYPE_LRU_PERCPU_HASH,
+#else
+	.type		= BPF_MAP_TYPE_PERCPU_HASH,
+	.flags		= BPF_F_NO_PREALLOC,
+#endif
+	.size_key	= sizeof(struct l4_bucket_key),
+	.size_value	= sizeof(struct syncookie_stats),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= L4_SYNCOOKIE_ELEMS,
+};
+
+/* Incremental update of the checksum at @check for a 32 bit word changing
+ * from @from to @to (RFC 1624).
+ */
+static __always_inline void xdp_csum_replace4(__sum16 *check, __be32 from,
+					      __be32 to)
+{
+	__u32 csum = (__u16)~*check;
+
+	csum += (__u16)~from + (__u16)(~from >> 16);
+	csum += (__u16)to + (__u16)(to >> 16);
+	csum = (csum & 0xffff) + (csum >> 16);
+	csum = (csum & 0xffff) + (csum >> 16);
+	*check = (__sum16)~csum;
+}
+
+/* The first @len - 5 words of @words identify the connection, the
+ * remaining ones are filled with the secret and the time slot.
+ */
+static __always_inline __u32 syncookie_hash(__u32 *words, const __u32 len,
+					    const struct syncookie_secret *secret,
+					    __u32 slot)
+{
+	words[len - 5] = secret->key[0];
+	words[len - 4] = secret->key[1];
+	words[len - 3] = secret->key[2];
+	words[len - 2] = secret->key[3];
+	words[len - 1] = slot;
+
+	return jhash2(words, len, 0);
+}
+
+static __always_inline bool syncookie_src_valid(const struct syncookie_src_key *key,
+						__u64 now)
+{
+	__u64 *expiry;
+
+	expiry = map_lookup_elem(&L4_SYNCOOKIE_SRC_MAP_NAME, key);
+	if (!expiry)
+		return false;
+	if (*expiry > now)
+		return true;
+
+	map_delete_elem(&L4_SYNCOOKIE_SRC_MAP_NAME, key);
+	return false;
+}
+
+static __always_inline void syncookie_account(const struct l4_bucket_key *key,
+					      bool validated)
+{
+	struct syncookie_stats *stats, init = {};
+
+	stats = map_lookup_elem(&L4_SYNCOOKIE_STATS_MAP_NAME, key);
+	if (!stats) {
+		if (validated)
+			init.validated = 1;
+		else
+			init.sent = 1;
+		map_update_elem(&L4_SYNCOOKIE_STATS_MAP_NAME, key, &init, 0);
+		return;
+	}
+
+	if (validated)
+		stats->validated++;
+	else
+		stats->sent++;
+}
+
+/* Turns the SYN at @tcp into a SYN-ACK acknowledging @cookie. Options and
+ * window of the SYN are echoed, they are irrelevant for the reset which
+ * is expected in return.
+ */
+static __always_inline void syncookie_tcp_reply(struct tcphdr *tcp, __u32 cookie)
+{
+	__be32 old_seq = tcp->seq, old_ack = tcp->ack_seq;
+	__be32 old_flags = tcp_flag_word(tcp);
+	__be16 port = tcp->source;
+
+	/* Swapping the ports leaves the checksum unchanged. */
+	tcp->source = tcp->dest;
+	tcp->dest = port;
+	tcp->seq = bpf_htonl(~cookie);
+	tcp->ack_seq = bpf_htonl(cookie);
+	tcp_flag_word(tcp) = (old_flags & ~bpf_htonl(0x00ff0000)) |
+			     TCP_FLAG_SYN | TCP_FLAG_ACK;
+
+	xdp_csum_replace4(&tcp->check, old_seq, tcp->seq);
+	xdp_csum_replace4(&tcp->check, old_ack, tcp->ack_seq);
+	xdp_csum_replace4(&tcp->check, old_flags, tcp_flag_word(tcp));
+}
+
+/**
+ * syncookie_apply
+ * @tcp:	TCP header, bounds checked by the caller
+ * @rule:	matching L4_RULE_SYNCOOKIE rule
+ * @bkey:	token bucket and stats key of the destination
+ * @skey:	key of the source
+ * @words:	connection identifier for syncookie_hash()
+ * @len:	number of words in @words, a compile time constant
+ *
+ * Returns XDP_PASS if the segment continues through the prefilter,
+ * XDP_TX if @tcp was turned into a SYN-ACK and the caller needs to swap
+ * the L2/L3 addresses and XDP_DROP for a reset consumed by validation.
+ */
+static __always_inline int syncookie_apply(struct tcphdr *tcp,
+					   const struct l4_rule_val *rule,
+					   const struct l4_bucket_key *bkey,
+					   const struct syncookie_src_key *skey,
+					   __u32 *words, const __u32 len)
+{
+	__be32 flags = tcp_flag_word(tcp) &
+		       (TCP_FLAG_SYN | TCP_FLAG_ACK | TCP_FLAG_RST);
+	struct syncookie_secret *secret;
+	__u64 now, expiry;
+	__u32 slot, seq, key = 0;
+
+	if (flags != TCP_FLAG_SYN && flags != TCP_FLAG_RST)
+		return XDP_PASS;
+
+	secret = map_lookup_elem(&L4_SYNCOOKIE_SECRET_MAP_NAME, &key);
+	if (!secret)
+		return XDP_PASS;
+
+	now = bpf_ktime_get_nsec();
+	slot = now >> SYNCOOKIE_SLOT_SHIFT;
+
+	if (flags == TCP_FLAG_SYN) {
+		if (l4_bucket_admit(bkey, rule) ||
+		    syncookie_src_valid(skey, now))
+			return XDP_PASS;
+
+		syncookie_tcp_reply(tcp, syncookie_hash(words, len, secret, slot));
+		syncookie_account(bkey, false);
+		return XDP_TX;
+	}
+
+	/* Resets are checked against the cookies of the current and the
+	 * previous time slot, all other resets pass.
+	 */
+	seq = bpf_ntohl(tcp->seq);
+	if (seq != syncookie_hash(words, len, secret, slot) &&
+	    seq != syncookie_hash(words, len, secret, slot - 1))
+		return XDP_PASS;
+
+	expiry = now + SYNCOOKIE_SRC_LIFETIME;
+	map_update_elem(&L4_SYNCOOKIE_SRC_MAP_NAME, skey, &expiry, 0);
+	syncookie_account(bkey, true);
+	return XDP_DROP;
+}
+
+static __always_inline void xdp_swap_eth(struct ethhdr *eth)
+{
+	__u8 tmp[ETH_ALEN];
+
+	__builtin_memcpy(tmp, eth->h_source, ETH_ALEN);
+	__builtin_memcpy(eth->h_source, eth->h_dest, ETH_ALEN);
+	__builtin_memcpy(eth->h_dest, tmp, ETH_ALEN);
+}
+
+static __always_inline int syncookie_v4(struct xdp_md *xdp,
+					struct iphdr *ipv4_hdr,
+					const struct l4_rule_val *rule,
+					const struct l4_rule_key *rkey)
+{
+	void *data_end = xdp_data_end(xdp);
+	struct tcphdr *tcp = (void *)ipv4_hdr + ipv4_hdrlen(ipv4_hdr);
+	struct syncookie_src_key skey = {};
+	struct l4_bucket_key bkey = {};
+	__be16 *ttl_proto = (__be16 *)&ipv4_hdr->ttl;
+	__be32 addr, old_ttl;
+	__u32 words[8];
+	int ret;
+
+	if (rkey->proto != IPPROTO_TCP ||
+	    ipv4_hdr->frag_off & bpf_htons(IPV4_FRAG_OFFSET))
+		return XDP_PASS;
+	if (xdp_no_room(tcp + 1, data_end))
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV4);
+
+	__builtin_memcpy(bkey.addr, &ipv4_hdr->daddr, sizeof(ipv4_hdr->daddr));
+	bkey.dport = rkey->dport;
+	bkey.proto = rkey->proto;
+	bkey.family = rkey->family;
+	__builtin_memcpy(skey.addr, &ipv4_hdr->saddr, sizeof(ipv4_hdr->saddr));
+	skey.family = rkey->family;
+
+	words[0] = ipv4_hdr->saddr;
+	words[1] = ipv4_hdr->daddr;
+	words[2] = ((union tcp_word_hdr *)tcp)->words[0];
+
+	ret = syncookie_apply(tcp, rule, &bkey, &skey, words, 8);
+	if (ret != XDP_TX)
+		return ret;
+
+	/* Swapping the addresses leaves both checksums unchanged. */
+	addr = ipv4_hdr->saddr;
+	ipv4_hdr->saddr = ipv4_hdr->daddr;
+	ipv4_hdr->daddr = addr;
+	old_ttl = *ttl_proto;
+	ipv4_hdr->ttl = SYNCOOKIE_REPLY_TTL;
+	xdp_csum_replace4(&ipv4_hdr->check, old_ttl, *ttl_proto);
+	xdp_swap_eth(xdp_data(xdp));
+
+	return XDP_TX;
+}
+
+static __always_inline int syncookie_v6(struct xdp_md *xdp,
+					struct ipv6hdr *ipv6_hdr,
+					const struct l4_rule_val *rule,
+					const struct l4_rule_key *rkey)
+{
+	void *data_end = xdp_data_end(xdp);
+	struct tcphdr *tcp = (void *)(ipv6_hdr + 1);
+	struct syncookie_src_key skey = {};
+	struct l4_bucket_key bkey = {};
+	struct in6_addr addr;
+	__u32 words[14];
+	int ret;
+
+	if (rkey->proto != IPPROTO_TCP)
+		return XDP_PASS;
+	if (xdp_no_room(tcp + 1, data_end))
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV6);
+
+	__builtin_memcpy(bkey.addr, &ipv6_hdr->daddr, sizeof(bkey.addr));
+	bkey.dport = rkey->dport;
+	bkey.proto = rkey->proto;
+	bkey.family = rkey->family;
+	__builtin_memcpy(skey.addr, &ipv6_hdr->saddr, sizeof(skey.addr));
+	skey.family = rkey->family;
+
+	__builtin_memcpy(&words[0], &ipv6_hdr->saddr, 16);
+	__builtin_memcpy(&words[4], &ipv6_hdr->daddr, 16);
+	words[8] = ((union tcp_word_hdr *)tcp)->words[0];
+
+	ret = syncookie_apply(tcp, rule, &bkey, &skey, words, 14);
+	if (ret != XDP_TX)
+		return ret;
+
+	/* Swapping the addresses leaves the pseudo header sum unchanged. */
+	addr = ipv6_hdr->saddr;
+	ipv6_hdr->saddr = ipv6_hdr->daddr;
+	ipv6_hdr->daddr = addr;
+	ipv6_hdr->hop_limit = SYNCOOKIE_REPLY_TTL;
+	xdp_swap_eth(xdp_data(xdp));
+
+	return XDP_TX;
+}
+#endif /* L4_FILTER */
+
 static __always_inline int check_v4_endpoint(struct xdp_md *xdp,
 					     struct iphdr *ipv4_hdr)
 {
 	if (lookup_ip4_endpoint(ipv4_hdr))
 		return XDP_PASS;
 
-	return XDP_DROP;
+	return prefilter_drop(xdp, DROP_PREFILTER_NO_LXC,
+			      PREFILTER_FAMILY_IPV4);
+}
+
+static __always_inline int check_v4_l4(struct xdp_md *xdp,
+				       struct iphdr *ipv4_hdr)
+{
+#ifdef L4_FILTER
+	void *data_end = xdp_data_end(xdp);
+	struct l4_bucket_key bkey = {};
+	struct l4_rule_key rkey = {};
+	int prefix = L4_RL_PREFIX4;
+	struct l4_rule_val *rule;
+	__be32 saddr;
+	int ret;
+
+	if (ipv4_hdr->ihl < 5)
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV4);
+
+	rkey.proto = ipv4_hdr->protocol;
+	rkey.family = ENDPOINT_KEY_IPV4;
+	/* Non-first fragments carry no L4 header, match them on the
+	 * protocol wide rule only.
+	 */
+	if (!(ipv4_hdr->frag_off & bpf_htons(IPV4_FRAG_OFFSET)) &&
+	    !l4_load_dport((void *)ipv4_hdr + ipv4_hdrlen(ipv4_hdr),
+			   data_end, &rkey))
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV4);
+
+	rule = l4_rule_lookup(&rkey);
+	if (rule && rule->action == L4_RULE_SYNCOOKIE) {
+		ret = syncookie_v4(xdp, ipv4_hdr, rule, &rkey);
+		if (ret != XDP_PASS)
+			return ret;
+	} else if (rule) {
+		saddr = ipv4_hdr->saddr & GET_PREFIX(prefix);
+		__builtin_memcpy(bkey.addr, &saddr, sizeof(saddr));
+
+		ret = l4_rule_apply(rule, &rkey, &bkey);
+		if (ret < 0)
+			return prefilter_drop(xdp, ret, PREFILTER_FAMILY_IPV4);
+	}
+#endif /* L4_FILTER */
+	return check_v4_endpoint(xdp, ipv4_hdr);
 }
 
 static __always_inline int check_v4(struct xdp_md *xdp)
@@ -102,7 +590,8 @@ static __always_inline int check_v4(struct xdp_md *xdp)
 	struct lpm_v4_key pfx __maybe_unused;
 
 	if (xdp_no_room(ipv4_hdr + 1, data_end))
-		return XDP_DROP;
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV4);
 
 #ifdef CIDR4_FILTER
 	__builtin_memcpy(pfx.lpm.data, &ipv4_hdr->saddr, sizeof(pfx.addr));
@@ -110,13 +599,16 @@ static __always_inline int check_v4(struct xdp_md *xdp)
 
 #ifdef CIDR4_LPM_PREFILTER
 	if (map_lookup_elem(&CIDR4_LMAP_NAME, &pfx))
-		return XDP_DROP;
+		return prefilter_drop(xdp, DROP_PREFILTER_DENY,
+				      PREFILTER_FAMILY_IPV4);
 	else
 #endif /* CIDR4_LPM_PREFILTER */
 		return map_lookup_elem(&CIDR4_HMAP_NAME, &pfx) ?
-		       XDP_DROP : check_v4_endpoint(xdp, ipv4_hdr);
+		       prefilter_drop(xdp, DROP_PREFILTER_DENY,
+				      PREFILTER_FAMILY_IPV4) :
+		       check_v4_l4(xdp, ipv4_hdr);
 #else
-	return check_v4_endpoint(xdp, ipv4_hdr);
+	return check_v4_l4(xdp, ipv4_hdr);
 #endif /* CIDR4_FILTER */
 }
 
@@ -126,7 +618,46 @@ static __always_inline int check_v6_endpoint(struct xdp_md *xdp,
 	if (lookup_ip6_endpoint(ipv6_hdr))
 		return XDP_PASS;
 
-	return XDP_DROP;
+	return prefilter_drop(xdp, DROP_PREFILTER_NO_LXC,
+			      PREFILTER_FAMILY_IPV6);
+}
+
+static __always_inline int check_v6_l4(struct xdp_md *xdp,
+				       struct ipv6hdr *ipv6_hdr)
+{
+#ifdef L4_FILTER
+	void *data_end = xdp_data_end(xdp);
+	struct l4_bucket_key bkey = {};
+	struct l4_rule_key rkey = {};
+	struct l4_rule_val *rule;
+	union v6addr saddr;
+	int ret;
+
+	/* Extension headers are not walked here, such packets only match
+	 * on a protocol wide rule for their first next header.
+	 */
+	rkey.proto = ipv6_hdr->nexthdr;
+	rkey.family = ENDPOINT_KEY_IPV6;
+	if (!l4_load_dport(ipv6_hdr + 1, data_end, &rkey))
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV6);
+
+	rule = l4_rule_lookup(&rkey);
+	if (rule && rule->action == L4_RULE_SYNCOOKIE) {
+		ret = syncookie_v6(xdp, ipv6_hdr, rule, &rkey);
+		if (ret != XDP_PASS)
+			return ret;
+	} else if (rule) {
+		__builtin_memcpy(saddr.addr, &ipv6_hdr->saddr, sizeof(saddr.addr));
+		ipv6_addr_clear_suffix(&saddr, L4_RL_PREFIX6);
+		__builtin_memcpy(bkey.addr, saddr.addr, sizeof(bkey.addr));
+
+		ret = l4_rule_apply(rule, &rkey, &bkey);
+		if (ret < 0)
+			return prefilter_drop(xdp, ret, PREFILTER_FAMILY_IPV6);
+	}
+#endif /* L4_FILTER */
+	return check_v6_endpoint(xdp, ipv6_hdr);
 }
 
 static __always_inline int check_v6(struct xdp_md *xdp)
@@ -137,7 +668,8 @@ static __always_inline int check_v6(struct xdp_md *xdp)
 	struct lpm_v6_key pfx __maybe_unused;
 
 	if (xdp_no_room(ipv6_hdr + 1, data_end))
-		return XDP_DROP;
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_IPV6);
 
 #ifdef CIDR6_FILTER
 	__builtin_memcpy(pfx.lpm.data, &ipv6_hdr->saddr, sizeof(pfx.addr));
@@ -145,13 +677,16 @@ static __always_inline int check_v6(struct xdp_md *xdp)
 
 #ifdef CIDR6_LPM_PREFILTER
 	if (map_lookup_elem(&CIDR6_LMAP_NAME, &pfx))
-		return XDP_DROP;
+		return prefilter_drop(xdp, DROP_PREFILTER_DENY,
+				      PREFILTER_FAMILY_IPV6);
 	else
 #endif /* CIDR6_LPM_PREFILTER */
 		return map_lookup_elem(&CIDR6_HMAP_NAME, &pfx) ?
-		       XDP_DROP : check_v6_endpoint(xdp, ipv6_hdr);
+		       prefilter_drop(xdp, DROP_PREFILTER_DENY,
+				      PREFILTER_FAMILY_IPV6) :
+		       check_v6_l4(xdp, ipv6_hdr);
 #else
-	return check_v6_endpoint(xdp, ipv6_hdr);
+	return check_v6_l4(xdp, ipv6_hdr);
 #endif /* CIDR6_FILTER */
 }
 
@@ -163,7 +698,8 @@ static __always_inline int check_filters(struct xdp_md *xdp)
 	__u16 proto;
 
 	if (xdp_no_room(eth + 1, data_end))
-		return XDP_DROP;
+		return prefilter_drop(xdp, DROP_PREFILTER_INVALID,
+				      PREFILTER_FAMILY_OTHER);
 
 	proto = eth->h_proto;
 	if (proto == bpf_htons(ETH_P_IP))
@@ -177,10 +713,127 @@ static __always_inline int check_filters(struct xdp_md *xdp)
 		return XDP_PASS;
 }
 
+#ifdef ENABLE_XDP_DECAP
+/* Overlay fast path
+ *
+ * Frames encapsulated by remote nodes towards a local endpoint are
+ * decapsulated right here instead of going through the UDP receive path
+ * and the tunnel device. The security identity carried in the VNI is
+ * passed in the XDP metadata to bpf_overlay.o on tc ingress of this
+ * device, which delivers the inner frame to the endpoint including the
+ * ingress policy of the endpoint, exactly like on the tunnel device.
+ *
+ * Only IPv4 outer headers without options addressed to this node are
+ * handled, with Geneve only if no options are present. Everything else,
+ * e.g. fragments or inner destinations which are not local endpoints,
+ * is passed untouched to the regular path.
+ */
+#ifdef ENCAP_GENEVE
+# define XDP_DECAP_PORT		6081
+# define XDP_DECAP_FLAGS	0x00006558	/* No options, ETH_P_TEB */
+#else
+# define XDP_DECAP_PORT		8472
+# define XDP_DECAP_FLAGS	0x08000000	/* Valid VNI */
+#endif
+
+/* VXLAN header, Geneve header without options uses the same layout */
+struct xdp_tunnel_hdr {
+	__be32 flags;
+	__be32 vni;	/* VNI in the upper 24 bits */
+};
+
+#define XDP_DECAP_HLEN	(ETH_HLEN + sizeof(struct iphdr) +		\
+			 sizeof(struct udphdr) + sizeof(struct xdp_tunnel_hdr))
+
+static __always_inline bool xdp_decap_local_ep(void *inner, void *data_end)
+{
+	struct ethhdr *eth = inner;
+	struct endpoint_info *ep;
+
+	if (xdp_no_room(eth + 1, data_end))
+		return false;
+
+	if (eth->h_proto == bpf_htons(ETH_P_IP)) {
+		struct iphdr *ip4 = (void *)(eth + 1);
+
+		if (xdp_no_room(ip4 + 1, data_end))
+			return false;
+		ep = lookup_ip4_endpoint(ip4);
+	} else if (eth->h_proto == bpf_htons(ETH_P_IPV6)) {
+		struct ipv6hdr *ip6 = (void *)(eth + 1);
+
+		if (xdp_no_room(ip6 + 1, data_end))
+			return false;
+		ep = lookup_ip6_endpoint(ip6);
+	} else {
+		return false;
+	}
+
+	return ep && !(ep->flags & ENDPOINT_F_HOST);
+}
+
+static __always_inline int xdp_decap(struct xdp_md *xdp)
+{
+	void *data_end = xdp_data_end(xdp);
+	void *data = xdp_data(xdp);
+	struct ethhdr *eth = data;
+	struct iphdr *ip4 = data + ETH_HLEN;
+	struct udphdr *udp = (void *)(ip4 + 1);
+	struct xdp_tunnel_hdr *tun = (void *)(udp + 1);
+	struct xdp_decap_meta *meta;
+	struct endpoint_info *ep;
+	__u32 identity;
+
+	if (xdp_no_room(tun + 1, data_end) ||
+	    eth->h_proto != bpf_htons(ETH_P_IP) ||
+	    ip4->ihl != 5 || ip4->protocol != IPPROTO_UDP ||
+	    ip4->frag_off & bpf_htons(IPV4_FRAG_OFFSET | IPV4_MORE_FRAGMENTS) ||
+	    udp->dest != bpf_htons(XDP_DECAP_PORT) ||
+	    tun->flags != bpf_htonl(XDP_DECAP_FLAGS))
+		return XDP_PASS;
+
+	ep = lookup_ip4_endpoint(ip4);
+	if (!ep || !(ep->flags & ENDPOINT_F_HOST))
+		return XDP_PASS;
+
+	if (!xdp_decap_local_ep(tun + 1, data_end))
+		return XDP_PASS;
+
+	identity = bpf_ntohl(tun->vni) >> 8;
+
+	/* Drivers without metadata support keep the regular path. */
+	if (xdp_adjust_meta(xdp, -(int)sizeof(*meta)))
+		return XDP_PASS;
+
+	meta = xdp_data_meta(xdp);
+	if (xdp_no_room(meta + 1, xdp_data(xdp)))
+		return XDP_PASS;
+	meta->magic = 0;
+
+	if (xdp_adjust_head(xdp, XDP_DECAP_HLEN))
+		return XDP_PASS;
+
+	/* Moving the head moved the metadata along. */
+	meta = xdp_data_meta(xdp);
+	if (xdp_no_room(meta + 1, xdp_data(xdp)))
+		return XDP_PASS;
+	meta->magic = XDP_DECAP_MAGIC;
+	meta->identity = identity;
+
+	return XDP_PASS;
+}
+#endif /* ENABLE_XDP_DECAP */
+
 __section("from-netdev")
 int xdp_start(struct xdp_md *xdp)
 {
-	return check_filters(xdp);
+	int ret = check_filters(xdp);
+
+#ifdef ENABLE_XDP_DECAP
+	if (ret == XDP_PASS)
+		ret = xdp_decap(xdp);
+#endif
+	return ret;
 }
 
 BPF_LICENSE("GPL");
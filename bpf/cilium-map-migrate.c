@@ -38,6 +38,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 
 #include <sys/syscall.h>
 #include <sys/stat.h>
@@ -51,6 +52,8 @@
 
 #include "iproute2/bpf_elf.h"
 
+#include "cilium-map-migrate.h"
+
 #ifndef EM_BPF
 # define EM_BPF		247
 #endif
@@ -59,6 +62,12 @@
 
 #define STATE_PENDING	"pending"
 
+#define MIGRATE_BATCH	256
+
+#ifndef ENOTSUPP
+# define ENOTSUPP	524
+#endif
+
 #define BPF_ENV_MNT "CILIUM_BPF_MNT"
 
 struct bpf_elf_sec_data {
@@ -96,24 +105,6 @@ static int bpf(int cmd, union bpf_attr *attr, unsigned int size)
 	return syscall(__NR_bpf, cmd, attr, size);
 }
 
-static int renameat2(int dfd1, const char *path1,
-		     int dfd2, const char *path2,
-		     unsigned int flags)
-{
-#ifndef __NR_renameat2
-# if defined(__i386__)
-#  define __NR_renameat2 353
-# elif defined(__x86_64__)
-#  define __NR_renameat2 316
-# elif defined(__aarch64__)
-#  define __NR_renameat2 276
-# else
-#  error __NR_renameat2 not defined.
-# endif
-#endif
-	return syscall(__NR_renameat2, dfd1, path1, dfd2, path2, flags);
-}
-
 static inline __u64 bpf_ptr_to_u64(const void *ptr)
 {
 	return (__u64)(unsigned long)ptr;
@@ -303,6 +294,337 @@ static int bpf_obj_get(const char *pathname)
 	return bpf(BPF_OBJ_GET, &attr, sizeof(attr));
 }
 
+static int bpf_obj_pin(int fd, const char *pathname)
+{
+	union bpf_attr attr = {};
+
+	attr.pathname = bpf_ptr_to_u64(pathname);
+	attr.bpf_fd = fd;
+	return bpf(BPF_OBJ_PIN, &attr, sizeof(attr));
+}
+
+static int bpf_map_create(const struct bpf_elf_map *map, const char *name)
+{
+	union bpf_attr attr = {};
+	int fd;
+
+	attr.map_type = map->type;
+	attr.key_size = map->size_key;
+	attr.value_size = map->size_value;
+	attr.max_entries = map->max_elem;
+	attr.map_flags = map->flags;
+	strncpy(attr.map_name, name, sizeof(attr.map_name) - 1);
+
+	fd = bpf(BPF_MAP_CREATE, &attr, sizeof(attr));
+	if (fd < 0 && errno == EINVAL) {
+		/* Kernels prior to 4.15 do not support map names. */
+		memset(attr.map_name, 0, sizeof(attr.map_name));
+		fd = bpf(BPF_MAP_CREATE, &attr, sizeof(attr));
+	}
+	return fd;
+}
+
+static int bpf_map_lookup(int fd, const void *key, void *value)
+{
+	union bpf_attr attr = {};
+
+	attr.map_fd = fd;
+	attr.key = bpf_ptr_to_u64(key);
+	attr.value = bpf_ptr_to_u64(value);
+	return bpf(BPF_MAP_LOOKUP_ELEM, &attr, sizeof(attr));
+}
+
+static int bpf_map_update(int fd, const void *key, const void *value,
+			  __u64 flags)
+{
+	union bpf_attr attr = {};
+
+	attr.map_fd = fd;
+	attr.key = bpf_ptr_to_u64(key);
+	attr.value = bpf_ptr_to_u64(value);
+	attr.flags = flags;
+	return bpf(BPF_MAP_UPDATE_ELEM, &attr, sizeof(attr));
+}
+
+static int bpf_map_next_key(int fd, const void *key, void *next_key)
+{
+	union bpf_attr attr = {};
+
+	attr.map_fd = fd;
+	attr.key = bpf_ptr_to_u64(key);
+	attr.next_key = bpf_ptr_to_u64(next_key);
+	return bpf(BPF_MAP_GET_NEXT_KEY, &attr, sizeof(attr));
+}
+
+static int bpf_num_possible_cpus(void)
+{
+	int start, end, c, num = 0;
+	FILE *fp;
+
+	fp = fopen("/sys/devices/system/cpu/possible", "r");
+	if (!fp) {
+		fprintf(stderr, "Cannot determine number of possible CPUs!\n");
+		return -EIO;
+	}
+
+	/* Format is a list of ranges, e.g. "0-3,6,8-11". */
+	while (fscanf(fp, "%d", &start) == 1) {
+		end = start;
+		c = fgetc(fp);
+		if (c == '-') {
+			if (fscanf(fp, "%d", &end) != 1)
+				break;
+			c = fgetc(fp);
+		}
+		num += end - start + 1;
+		if (c != ',')
+			break;
+	}
+
+	fclose(fp);
+	return num > 0 ? num : -EIO;
+}
+
+static bool bpf_map_is_percpu(__u32 type)
+{
+	return type == BPF_MAP_TYPE_PERCPU_HASH ||
+	       type == BPF_MAP_TYPE_PERCPU_ARRAY ||
+	       type == BPF_MAP_TYPE_LRU_PERCPU_HASH;
+}
+
+/* Maps of a type which can be migrated to a map of type @to, or 0 if
+ * entries of the type cannot be migrated at all. Hash tables can be
+ * migrated to and from LRU hash tables, e.g. if support for LRU maps
+ * changes across kernel upgrades.
+ */
+static __u32 bpf_map_type_compat(__u32 to)
+{
+	switch (to) {
+	case BPF_MAP_TYPE_LRU_HASH:
+		return BPF_MAP_TYPE_HASH;
+	case BPF_MAP_TYPE_LRU_PERCPU_HASH:
+		return BPF_MAP_TYPE_PERCPU_HASH;
+	case BPF_MAP_TYPE_HASH:
+		return BPF_MAP_TYPE_LRU_HASH;
+	case BPF_MAP_TYPE_PERCPU_HASH:
+		return BPF_MAP_TYPE_LRU_PERCPU_HASH;
+	case BPF_MAP_TYPE_ARRAY:
+	case BPF_MAP_TYPE_PERCPU_ARRAY:
+	case BPF_MAP_TYPE_LPM_TRIE:
+		return to;
+	default:
+		return 0;
+	}
+}
+
+/* Entries can be migrated if the key layout is unchanged and values did
+ * not shrink. Values which grew are zero extended, so members must only
+ * ever be appended to value structs of pinned maps and zero must be a
+ * sane default for them, unless a conversion of the old layout is listed
+ * in bpf_value_layouts. Other changes, e.g. of the key layout, still
+ * require the new program to start from an empty map.
+ */
+static bool bpf_map_migratable(const struct bpf_elf_map *from,
+			       const struct bpf_elf_map *to)
+{
+	__u32 compat = bpf_map_type_compat(to->type);
+
+	return compat && (from->type == to->type || from->type == compat) &&
+	       from->size_key == to->size_key &&
+	       from->size_value <= to->size_value;
+}
+
+/* Insert @count converted entries into the new map. Entries which do not
+ * fit, e.g. because the new map is smaller, are skipped. If the new map
+ * is only to be completed, existing entries are left untouched.
+ */
+static void bpf_migration_insert(struct bpf_map_migration *m, __u32 count)
+{
+	union bpf_attr attr = {};
+	__u32 i = 0;
+
+	bpf_migration_convert(m, count);
+
+	if (m->batch_update) {
+		attr.batch.map_fd = m->new_fd;
+		attr.batch.keys = bpf_ptr_to_u64(m->keys);
+		attr.batch.values = bpf_ptr_to_u64(m->new_values);
+		attr.batch.count = count;
+		if (bpf(BPF_MAP_UPDATE_BATCH, &attr, sizeof(attr)) == 0) {
+			m->migrated += count;
+			return;
+		}
+		if (errno == EINVAL || errno == ENOTSUPP || errno == EOPNOTSUPP) {
+			m->batch_update = false;
+		} else {
+			/* Count holds the number of entries updated before
+			 * the failing one.
+			 */
+			i = attr.batch.count;
+			m->migrated += i;
+		}
+	}
+
+	for (; i < count; i++) {
+		if (bpf_map_update(m->new_fd, bpf_migration_key(m, i),
+				   bpf_migration_new(m, i), m->flags) == 0)
+			m->migrated++;
+		else if (errno != EEXIST)
+			m->skipped++;
+	}
+}
+
+static int bpf_migrate_batched(struct bpf_map_migration *m)
+{
+	union bpf_attr attr;
+	bool first = true;
+	int ret;
+
+	do {
+		memset(&attr, 0, sizeof(attr));
+		attr.batch.map_fd = m->old_fd;
+		attr.batch.in_batch = first ? 0 : bpf_ptr_to_u64(m->token);
+		attr.batch.out_batch = bpf_ptr_to_u64(m->token);
+		attr.batch.keys = bpf_ptr_to_u64(m->keys);
+		attr.batch.values = bpf_ptr_to_u64(m->old_values);
+		attr.batch.count = MIGRATE_BATCH;
+
+		/* ENOENT signals the last batch, which may be partial. */
+		ret = bpf(BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr));
+		if (ret < 0 && errno != ENOENT)
+			return -errno;
+		if (attr.batch.count)
+			bpf_migration_insert(m, attr.batch.count);
+		first = false;
+	} while (ret == 0);
+
+	return 0;
+}
+
+static int bpf_migrate_iterate(struct bpf_map_migration *m)
+{
+	char *key = NULL;
+	__u32 i;
+
+	/* Bound the walk as it restarts whenever the old programs delete
+	 * the current key.
+	 */
+	for (i = 0; i < m->max_iter; i++) {
+		if (bpf_map_next_key(m->old_fd, key, m->keys) < 0)
+			return errno == ENOENT ? 0 : -errno;
+		if (bpf_map_lookup(m->old_fd, m->keys, m->old_values) == 0)
+			bpf_migration_insert(m, 1);
+		memcpy(m->token, m->keys, m->key_size);
+		key = m->token;
+	}
+
+	return 0;
+}
+
+static int bpf_migration_init(struct bpf_map_migration *m,
+			      int old_fd, const struct bpf_elf_map *from,
+			      int new_fd, const struct bpf_elf_map *to,
+			      __u64 flags)
+{
+	int ncpus = 1;
+
+	memset(m, 0, sizeof(*m));
+	if (bpf_map_is_percpu(to->type)) {
+		ncpus = bpf_num_possible_cpus();
+		if (ncpus < 0)
+			return ncpus;
+		m->old_stride = (from->size_value + 7) & ~7U;
+		m->new_stride = (to->size_value + 7) & ~7U;
+	} else {
+		m->old_stride = from->size_value;
+		m->new_stride = to->size_value;
+	}
+
+	m->old_fd = old_fd;
+	m->new_fd = new_fd;
+	m->flags = flags;
+	m->key_size = from->size_key;
+	m->old_size = from->size_value;
+	m->new_size = to->size_value;
+	m->ncpus = ncpus;
+	m->max_iter = from->max_elem * 2;
+	/* Batched updates do not support BPF_NOEXIST. */
+	m->batch_update = flags == BPF_ANY;
+
+	/* Hash tables use a bucket index as batch token. */
+	m->token = calloc(1, m->key_size < 8 ? 8 : m->key_size);
+	m->keys = calloc(MIGRATE_BATCH, m->key_size);
+	m->old_values = calloc(MIGRATE_BATCH, (size_t)m->old_stride * ncpus);
+	m->new_values = calloc(MIGRATE_BATCH, (size_t)m->new_stride * ncpus);
+	if (!m->token || !m->keys || !m->old_values || !m->new_values)
+		return -ENOMEM;
+	return 0;
+}
+
+static void bpf_migration_free(struct bpf_map_migration *m)
+{
+	free(m->token);
+	free(m->keys);
+	free(m->old_values);
+	free(m->new_values);
+}
+
+static unsigned long long bpf_migration_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Copy all entries of the map @old_fd into the map @new_fd and convert
+ * their values from layout @from to layout @to. Lookups and updates are
+ * batched if supported by the kernel (5.6+), otherwise the old map is
+ * walked key by key.
+ */
+static int bpf_map_migrate(int old_fd, const struct bpf_elf_map *from,
+			   int new_fd, const struct bpf_elf_map *to,
+			   const char *file, __u64 flags)
+{
+	const struct bpf_value_layout *layout;
+	struct bpf_map_migration m;
+	unsigned long long start, usec;
+	int ret;
+
+	start = bpf_migration_now();
+	ret = bpf_migration_init(&m, old_fd, from, new_fd, to, flags);
+	if (ret < 0)
+		goto out;
+	layout = bpf_value_layout_find(file, from->size_value, to->size_value);
+	if (layout)
+		m.convert = layout->convert;
+
+	ret = bpf_migrate_batched(&m);
+	if (ret < 0) {
+		/* Not supported by the kernel or map type. Entries may be
+		 * visited again, so start counting from scratch.
+		 */
+		m.migrated = m.skipped = 0;
+		ret = bpf_migrate_iterate(&m);
+	}
+	if (ret < 0)
+		goto out;
+
+	usec = (bpf_migration_now() - start) / 1000;
+	syslog(LOG_INFO, "Migrated %u entries of %s in %llu.%03llu ms, %u skipped "
+	       "(value size %u -> %u, max entries %u -> %u)\n",
+	       m.migrated, file, usec / 1000, usec % 1000, m.skipped,
+	       from->size_value, to->size_value, from->max_elem, to->max_elem);
+	printf("Migrated %u entries of %s in %llu.%03llu ms, %u skipped\n",
+	       m.migrated, file, usec / 1000, usec % 1000, m.skipped);
+out:
+	if (ret < 0)
+		fprintf(stderr, "Cannot migrate entries of %s: %s\n", file,
+			strerror(-ret));
+	bpf_migration_free(&m);
+	return ret;
+}
+
 typedef int (*bpf_handle_state_t)(struct bpf_elf_ctx *ctx,
 				  const struct bpf_elf_map *map,
 				  const char *name, int exit);
@@ -326,8 +648,8 @@ static int bpf_handle_pending(struct bpf_elf_ctx *ctx,
 {
 	char file[PATH_MAX + 1], dest[PATH_MAX + 1];
 	struct bpf_elf_map pinned;
+	int fd, new_fd = -1, ret;
 	struct stat sb;
-	int fd, ret;
 
 	snprintf(file, sizeof(file), "%s/%s", fs_base, name);
 	ret = stat(file, &sb);
@@ -344,22 +666,88 @@ static int bpf_handle_pending(struct bpf_elf_ctx *ctx,
 		return -errno;
 	}
 	ret = bpf_derive_elf_map_from_fdinfo(fd, &pinned);
-	close(fd);
 	if (ret < 0) {
 		fprintf(stderr, "Cannot fetch fdinfo from %s!\n", file);
+		close(fd);
 		return ret;
 	}
 
 	pinned.id = map->id;
         pinned.pinning = map->pinning;
-	if (!memcmp(map, &pinned, sizeof(pinned)))
+	if (!memcmp(map, &pinned, sizeof(pinned))) {
+		close(fd);
 		return 0;
+	}
 
 	snprintf(dest, sizeof(dest), "%s:%s", file, STATE_PENDING);
 	syslog(LOG_WARNING, "Property mismatch in %s, migrating node to %s!\n",
 	       file, dest);
+
+	/* Populate a map with the new properties and pin it in place of the
+	 * old one, so that the loader picks it up instead of creating an
+	 * empty map. The old programs keep using the old map until the new
+	 * programs are attached. Entries they add in the meantime are copied
+	 * over by bpf_complete_migration(), changes to entries copied here
+	 * are lost.
+	 */
+	if (bpf_map_migratable(&pinned, map)) {
+		new_fd = bpf_map_create(map, name);
+		if (new_fd < 0) {
+			syslog(LOG_WARNING, "Cannot create new map for %s: %s\n",
+			       file, strerror(errno));
+		} else if (bpf_map_migrate(fd, &pinned, new_fd, map, file,
+					   BPF_ANY) < 0) {
+			close(new_fd);
+			new_fd = -1;
+		}
+	}
+	close(fd);
+
 	utimensat(AT_FDCWD, file, NULL, 0);
-	return rename(file, dest);
+	ret = rename(file, dest);
+	if (new_fd >= 0) {
+		if (!ret && bpf_obj_pin(new_fd, file) < 0)
+			syslog(LOG_WARNING, "Cannot pin migrated map %s: %s\n",
+			       file, strerror(errno));
+		close(new_fd);
+	}
+	return ret;
+}
+
+/* Copy entries which the old programs added after bpf_handle_pending()
+ * ran, or all entries if the loader created the new map. Entries already
+ * present in the new map are left untouched as they may have been
+ * updated by the new programs.
+ *
+ * Updates and deletions of the old programs between the copy and the
+ * switch to the new programs are therefore lost. For the maps this is
+ * used for, this only affects the window in which the new programs are
+ * loaded: a stale conntrack lifetime or counter is refreshed by the next
+ * packet of the connection, and an entry the old programs deleted stays
+ * until it expires and is removed by the garbage collector. Maps which
+ * cannot tolerate this must not rely on the migration.
+ */
+static void bpf_complete_migration(const char *file, const char *dest)
+{
+	struct bpf_elf_map from, to;
+	int old_fd, new_fd;
+
+	old_fd = bpf_obj_get(file);
+	if (old_fd < 0)
+		return;
+	new_fd = bpf_obj_get(dest);
+	if (new_fd < 0)
+		goto out_old;
+
+	if (bpf_derive_elf_map_from_fdinfo(old_fd, &from) < 0 ||
+	    bpf_derive_elf_map_from_fdinfo(new_fd, &to) < 0)
+		goto out_new;
+	if (bpf_map_migratable(&from, &to))
+		bpf_map_migrate(old_fd, &from, new_fd, &to, dest, BPF_NOEXIST);
+out_new:
+	close(new_fd);
+out_old:
+	close(old_fd);
 }
 
 static int bpf_handle_finalize(struct bpf_elf_ctx *ctx,
@@ -380,14 +768,18 @@ static int bpf_handle_finalize(struct bpf_elf_ctx *ctx,
 		return -errno;
 	}
 
+	snprintf(dest, sizeof(dest), "%s/%s", fs_base, name);
 	if (exit) {
-		snprintf(dest, sizeof(dest), "%s/%s", fs_base, name);
+		/* The old programs remain attached, restore their map in
+		 * place of the one pinned for the new programs.
+		 */
 		syslog(LOG_WARNING, "Restoring migrated node %s into %s due to bad exit.\n",
 		       file, dest);
 		utimensat(AT_FDCWD, file, NULL, 0);
-		renameat2(AT_FDCWD, file, AT_FDCWD, dest, 1);
+		rename(file, dest);
 		return 0;
 	} else {
+		bpf_complete_migration(file, dest);
 		syslog(LOG_WARNING, "Unlinking migrated node %s due to good exit.\n",
 		       file);
 		return unlink(file);
@@ -0,0 +1,186 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Conversion of map values by cilium-map-migrate, kept apart from the
+ * loader code so that it can be tested without a kernel (see
+ * test/bpf/map-migrate-test.c).
+ */
+
+#ifndef __CILIUM_MAP_MIGRATE_H_
+#define __CILIUM_MAP_MIGRATE_H_
+
+#include <stdbool.h>
+#include <string.h>
+
+/* struct ct_entry in <bpf/lib/common.h> before the members which are
+ * written per packet were moved to the end.
+ */
+struct ct_entry_v1 {
+	__u64 rx_packets;
+	__u64 rx_bytes;
+	__u64 tx_packets;
+	__u64 tx_bytes;
+	__u32 lifetime;
+	__u16 flags;
+	__u16 rev_nat_index;
+	__u16 slave;
+	__u8  tx_flags_seen;
+	__u8  rx_flags_seen;
+	__u32 src_sec_id;
+	__u32 last_tx_report;
+	__u32 last_rx_report;
+};
+
+/* Must match struct ct_entry in <bpf/lib/common.h> */
+struct ct_entry_v2 {
+	__u16 rev_nat_index;
+	__u16 slave;
+	__u16 flags;
+	__be16 proxy_port;
+	__u32 src_sec_id;
+	__u32 policy_rev;
+	__u32 remote_sec_id;
+	__be32 tunnel_endpoint;
+	__u32 lifetime;
+	__u8  tx_flags_seen;
+	__u8  rx_flags_seen;
+	__u16 pad;
+	__u32 last_tx_report;
+	__u32 last_rx_report;
+	__u64 rx_packets;
+	__u64 rx_bytes;
+	__u64 tx_packets;
+	__u64 tx_bytes;
+};
+
+static void bpf_ct_entry_convert_v1(void *dst, const void *src)
+{
+	const struct ct_entry_v1 *from = src;
+	struct ct_entry_v2 *to = dst;
+
+	memset(to, 0, sizeof(*to));
+	to->rev_nat_index = from->rev_nat_index;
+	to->slave = from->slave;
+	to->flags = from->flags;
+	to->src_sec_id = from->src_sec_id;
+	to->lifetime = from->lifetime;
+	to->tx_flags_seen = from->tx_flags_seen;
+	to->rx_flags_seen = from->rx_flags_seen;
+	to->last_tx_report = from->last_tx_report;
+	to->last_rx_report = from->last_rx_report;
+	to->rx_packets = from->rx_packets;
+	to->rx_bytes = from->rx_bytes;
+	to->tx_packets = from->tx_packets;
+	to->tx_bytes = from->tx_bytes;
+}
+
+/* Value layouts which changed other than by appending members. Entries of
+ * maps whose name starts with @prefix are converted by @convert if their
+ * values have the sizes of the old and new layout.
+ */
+struct bpf_value_layout {
+	const char	*prefix;
+	__u32		old_size;
+	__u32		new_size;
+	void		(*convert)(void *dst, const void *src);
+};
+
+static const struct bpf_value_layout bpf_value_layouts[] = {
+	{ "cilium_ct", sizeof(struct ct_entry_v1), sizeof(struct ct_entry_v2),
+	  bpf_ct_entry_convert_v1 },
+};
+
+static const struct bpf_value_layout *
+bpf_value_layout_find(const char *file, __u32 old_size, __u32 new_size)
+{
+	const char *name = strrchr(file, '/');
+	unsigned int i;
+
+	name = name ? name + 1 : file;
+	for (i = 0; i < sizeof(bpf_value_layouts) / sizeof(bpf_value_layouts[0]); i++) {
+		const struct bpf_value_layout *l = &bpf_value_layouts[i];
+
+		if (!strncmp(name, l->prefix, strlen(l->prefix)) &&
+		    l->old_size == old_size && l->new_size == new_size)
+			return l;
+	}
+	return NULL;
+}
+
+struct bpf_map_migration {
+	int		old_fd;
+	int		new_fd;
+	__u64		flags;		/* BPF_ANY or BPF_NOEXIST */
+	__u32		key_size;
+	__u32		old_size;	/* Size of a value on a single CPU */
+	__u32		new_size;
+	__u32		old_stride;	/* Distance of per-CPU values */
+	__u32		new_stride;
+	__u32		ncpus;		/* 1 for maps which are not per-CPU */
+	__u32		max_iter;
+	void		(*convert)(void *dst, const void *src);
+	bool		batch_update;
+	unsigned int	migrated;
+	unsigned int	skipped;
+	char		*token;
+	char		*keys;
+	char		*old_values;
+	char		*new_values;
+};
+
+static inline char *bpf_migration_key(const struct bpf_map_migration *m,
+				      __u32 i)
+{
+	return m->keys + (size_t)i * m->key_size;
+}
+
+static inline char *bpf_migration_old(const struct bpf_map_migration *m,
+				      __u32 i)
+{
+	return m->old_values + (size_t)i * m->old_stride * m->ncpus;
+}
+
+static inline char *bpf_migration_new(const struct bpf_map_migration *m,
+				      __u32 i)
+{
+	return m->new_values + (size_t)i * m->new_stride * m->ncpus;
+}
+
+/* Convert @count values from the old into the new layout. */
+static void bpf_migration_convert(struct bpf_map_migration *m, __u32 count)
+{
+	char *src, *dst;
+	__u32 i, cpu;
+
+	for (i = 0; i < count; i++) {
+		src = bpf_migration_old(m, i);
+		dst = bpf_migration_new(m, i);
+		for (cpu = 0; cpu < m->ncpus; cpu++) {
+			if (m->convert) {
+				m->convert(dst, src);
+			} else {
+				memcpy(dst, src, m->old_size);
+				memset(dst + m->old_size, 0, m->new_stride - m->old_size);
+			}
+			src += m->old_stride;
+			dst += m->new_stride;
+		}
+	}
+}
+
+#endif /* __CILIUM_MAP_MIGRATE_H_ */
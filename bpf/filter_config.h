@@ -29,3 +29,15 @@
 #define CIDR6_LMAP_NAME v6_dyn
 #define CIDR6_FILTER
 #define CIDR6_LPM_PREFILTER
+#define L4_RULE_ELEMS 1024
+#define L4_BUCKET_ELEMS 65536
+#define L4_RULE_MAP_NAME l4_rules
+#define L4_BUCKET_MAP_NAME l4_buckets
+#define L4_SYNCOOKIE_ELEMS 65536
+#define L4_SYNCOOKIE_STATS_MAP_NAME l4_sc_stats
+#define L4_SYNCOOKIE_SRC_MAP_NAME l4_sc_src
+#define L4_SYNCOOKIE_SECRET_MAP_NAME l4_sc_secret
+#define L4_RL_PREFIX4 24
+#define L4_RL_PREFIX6 64
+#define L4_FILTER
+#define PREFILTER_SAMPLE_RATE 1000
@@ -157,6 +157,10 @@ static int BPF_FUNC(redirect, int ifindex, uint32_t flags);
 static int BPF_FUNC(clone_redirect, struct __sk_buff *skb, int ifindex,
 		    uint32_t flags);
 
+/* XDP packet manipulation */
+static int BPF_FUNC(xdp_adjust_head, struct xdp_md *xdp, int delta);
+static int BPF_FUNC(xdp_adjust_meta, struct xdp_md *xdp, int delta);
+
 /* Packet manipulation */
 static int BPF_FUNC(skb_load_bytes, struct __sk_buff *skb, uint32_t off,
 		    void *to, uint32_t len);
@@ -196,6 +200,30 @@ static int BPF_FUNC(skb_set_tunnel_opt, struct __sk_buff *skb,
 /* Events for user space */
 static int BPF_FUNC2(skb_event_output, struct __sk_buff *skb, void *map, uint64_t index,
 		     const void *data, uint32_t size) = (void *)BPF_FUNC_perf_event_output;
+static int BPF_FUNC2(xdp_event_output, struct xdp_md *xdp, void *map, uint64_t index,
+		     const void *data, uint32_t size) = (void *)BPF_FUNC_perf_event_output;
+
+/* Shared ring buffer */
+static int BPF_FUNC(ringbuf_output, void *ringbuf, const void *data,
+		    uint64_t size, uint64_t flags);
+static void *BPF_FUNC(ringbuf_reserve, void *ringbuf, uint64_t size,
+		      uint64_t flags);
+static void BPF_FUNC(ringbuf_submit, void *data, uint64_t flags);
+static void BPF_FUNC(ringbuf_discard, void *data, uint64_t flags);
+static uint64_t BPF_FUNC(ringbuf_query, void *ringbuf, uint64_t flags);
+
+/* Socket lookup and assignment */
+static struct bpf_sock *BPF_FUNC(sk_lookup_tcp, struct __sk_buff *skb,
+				 struct bpf_sock_tuple *tuple,
+				 uint32_t tuple_size, uint64_t netns,
+				 uint64_t flags);
+static struct bpf_sock *BPF_FUNC(sk_lookup_udp, struct __sk_buff *skb,
+				 struct bpf_sock_tuple *tuple,
+				 uint32_t tuple_size, uint64_t netns,
+				 uint64_t flags);
+static int BPF_FUNC(sk_release, struct bpf_sock *sk);
+static int BPF_FUNC(sk_assign, struct __sk_buff *skb, struct bpf_sock *sk,
+		    uint64_t flags);
 
 /** LLVM built-ins, mem*() routines work for constant size */
 
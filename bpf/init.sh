@@ -24,11 +24,13 @@ NATIVE_DEV=$6
 XDP_DEV=$7
 XDP_MODE=$8
 MTU=$9
+CGROUP_ROOT=${10}
 
 ID_HOST=1
 ID_WORLD=2
 
 PROXY_RT_TABLE=2005
+TO_PROXY_RT_TABLE=2004
 
 set -e
 set -x
@@ -167,6 +169,63 @@ function setup_proxy_rules()
 	fi
 }
 
+function setup_to_proxy_rules()
+{
+	# delete old ip rules and flush table
+	delete_old_ip_rules $TO_PROXY_RT_TABLE
+
+	grep -q "ENABLE_PROXY_SK_ASSIGN" $RUNDIR/globals/node_config.h || return 0
+
+	# Connections accepted by a proxy inherit the mark of their first
+	# packet, which carries the source identity
+	echo 1 > /proc/sys/net/ipv4/tcp_fwmark_accept
+
+	# Packets assigned to a proxy socket keep their original destination
+	# and must be delivered locally
+	if [ -n "$(ip -4 rule list)" ]; then
+		ip -4 route flush table $TO_PROXY_RT_TABLE
+		ip -4 rule add fwmark 0x200/0xF00 pref 9 lookup $TO_PROXY_RT_TABLE
+		ip -4 route replace table $TO_PROXY_RT_TABLE local 0.0.0.0/0 dev lo
+	fi
+
+	if [ -n "$(ip -6 rule list)" ]; then
+		ip -6 route flush table $TO_PROXY_RT_TABLE
+		ip -6 rule add fwmark 0x200/0xF00 pref 9 lookup $TO_PROXY_RT_TABLE
+		ip -6 route replace table $TO_PROXY_RT_TABLE local ::/0 dev lo
+	fi
+}
+
+function default_route_dev()
+{
+	ip -4 route show default | awk '{ for (i = 1; i < NF; i++) if ($i == "dev") print $(i + 1) }' | head -1
+}
+
+function setup_bandwidth_manager()
+{
+	grep -q "ENABLE_BANDWIDTH_MANAGER" $RUNDIR/globals/node_config.h || return 0
+
+	local DEV=$NATIVE_DEV
+	if [ -z "$DEV" ]; then
+		DEV=$(default_route_dev)
+	fi
+	if [ -z "$DEV" ]; then
+		echo "No device found for bandwidth limits, ignoring..."
+		return 0
+	fi
+
+	# fq releases packets at the departure time set by the datapath. One
+	# instance per transmit queue avoids a qdisc lock shared by all CPUs.
+	local NQUEUES=$(ls -d /sys/class/net/$DEV/queues/tx-* | wc -l)
+	if [ "$NQUEUES" -gt 1 ]; then
+		tc qdisc replace dev $DEV root handle 1: mq
+		for i in $(seq 1 $NQUEUES); do
+			tc qdisc replace dev $DEV parent 1:$(printf '%x' $i) fq
+		done
+	else
+		tc qdisc replace dev $DEV root fq
+	fi
+}
+
 function mac2array()
 {
 	echo "{0x${1//:/,0x}}"
@@ -240,6 +299,72 @@ function bpf_load()
 	return $RETCODE
 }
 
+# Attaches the egress program of an object previously loaded by bpf_load
+# to the same device, the clsact qdisc is left alone. It masquerades and
+# enforces the bandwidth limits of endpoints on traffic routed by the stack.
+function bpf_load_egress()
+{
+	DEV=$1
+	OUT=$2
+
+	cilium-map-migrate -s $OUT
+	set +e
+	tc filter replace dev $DEV egress prio 1 handle 1 bpf da obj $OUT sec to-netdev
+	RETCODE=$?
+	set -e
+	cilium-map-migrate -e $OUT -r $RETCODE
+	return $RETCODE
+}
+
+function bpf_load_cgroups()
+{
+	OPTS=$1
+	IN=$2
+	OUT=$3
+	CGRP=$4
+	HOOK=$5
+
+	PIN="$CILIUM_BPF_MNT/tc/globals/cilium_cgroups_$HOOK"
+	rm -f $PIN
+
+	cilium-map-migrate -s $OUT
+	set +e
+	tc exec bpf pin $PIN type sock_addr attach_type $HOOK obj $OUT sec $HOOK
+	RETCODE=$?
+	set -e
+	cilium-map-migrate -e $OUT -r $RETCODE
+
+	if [ "$RETCODE" -eq "0" ]; then
+		set +e
+		bpftool cgroup attach $CGRP $HOOK pinned $PIN
+		RETCODE=$?
+		set -e
+		rm -f $PIN
+	fi
+	return $RETCODE
+}
+
+function bpf_clear_cgroups()
+{
+	CGRP=$1
+	HOOK=$2
+
+	set +e
+	ID=$(bpftool cgroup show $CGRP 2> /dev/null | grep -w $HOOK | awk '{print $1}')
+	set -e
+	if [ -n "$ID" ]; then
+		bpftool cgroup detach $CGRP $HOOK id $ID
+	fi
+}
+
+function setup_cgroup_root()
+{
+	if ! mountpoint -q $CGROUP_ROOT; then
+		mkdir -p $CGROUP_ROOT
+		mount -t cgroup2 none $CGROUP_ROOT
+	fi
+}
+
 function encap_fail()
 {
 	(>&2 echo "ERROR: Setup of encapsulation device $ENCAP_DEV has failed. Is another program using a $MODE device?")
@@ -299,6 +424,8 @@ move_local_rules
 # Install new rules before local rule to ensure that packets from the proxy are
 # using a separate routing table
 setup_proxy_rules
+setup_to_proxy_rules
+setup_bandwidth_manager
 
 sed -i '/ENCAP_GENEVE/d' $RUNDIR/globals/node_config.h
 sed -i '/ENCAP_VXLAN/d' $RUNDIR/globals/node_config.h
@@ -339,6 +466,9 @@ if [ "$MODE" = "direct" ]; then
 		POLICY_MAP="cilium_policy_reserved_${ID_WORLD}"
 		OPTS="-DSECLABEL=${ID_WORLD} -DPOLICY_MAP=${POLICY_MAP}"
 		bpf_load $NATIVE_DEV "$OPTS" "ingress" bpf_netdev.c bpf_netdev.o from-netdev $CALLS_MAP
+		if grep -q "ENABLE_MASQUERADE\|ENABLE_BANDWIDTH_MANAGER" $RUNDIR/globals/node_config.h; then
+			bpf_load_egress $NATIVE_DEV bpf_netdev.o
+		fi
 
 		echo "$NATIVE_DEV" > $RUNDIR/device.state
 	fi
@@ -355,12 +485,51 @@ elif [ "$MODE" = "lb" ]; then
 		echo "$NATIVE_DEV" > $RUNDIR/device.state
 	fi
 else
+	# With masquerading in BPF, replies to masqueraded flows are
+	# translated on ingress of the device holding the default route.
+	MASQ_DEV=""
+	if grep -q "ENABLE_MASQUERADE" $RUNDIR/globals/node_config.h; then
+		MASQ_DEV=$(default_route_dev)
+		if [ -z "$MASQ_DEV" ]; then
+			echo "No device found for masquerading, ignoring..."
+		fi
+	fi
+
+	# Frames decapsulated by the XDP overlay fast path are delivered by
+	# bpf_overlay.o on ingress of the XDP device. The agent never enables
+	# it together with masquerading in BPF.
+	DECAP_DEV=""
+	if [ -n "$XDP_DEV" ] && grep -q "ENABLE_XDP_DECAP" $RUNDIR/globals/node_config.h; then
+		DECAP_DEV=$XDP_DEV
+	fi
+
 	FILE=$RUNDIR/device.state
 	if [ -f $FILE ]; then
 		DEV=$(cat $FILE)
-		echo "Removed BPF program from device $DEV"
-		tc qdisc del dev $DEV clsact 2> /dev/null || true
-		rm $FILE
+		if [ "$DEV" != "$MASQ_DEV" -a "$DEV" != "$DECAP_DEV" ]; then
+			echo "Removed BPF program from device $DEV"
+			tc qdisc del dev $DEV clsact 2> /dev/null || true
+			rm $FILE
+		fi
+	fi
+
+	if [ -n "$MASQ_DEV" ]; then
+		CALLS_MAP=cilium_calls_netdev_${ID_WORLD}
+		POLICY_MAP="cilium_policy_reserved_${ID_WORLD}"
+		OPTS="-DSECLABEL=${ID_WORLD} -DPOLICY_MAP=${POLICY_MAP}"
+		bpf_load $MASQ_DEV "$OPTS" "ingress" bpf_netdev.c bpf_netdev.o from-netdev $CALLS_MAP
+		bpf_load_egress $MASQ_DEV bpf_netdev.o
+
+		echo "$MASQ_DEV" > $RUNDIR/device.state
+	fi
+
+	if [ -n "$DECAP_DEV" ]; then
+		CALLS_MAP="cilium_calls_xdp_decap_${ID_WORLD}"
+		POLICY_MAP="cilium_policy_reserved_${ID_WORLD}"
+		OPTS="-DSECLABEL=${ID_WORLD} -DPOLICY_MAP=${POLICY_MAP} -DXDP_DECAP"
+		bpf_load $DECAP_DEV "$OPTS" "ingress" bpf_overlay.c bpf_overlay_decap.o from-overlay ${CALLS_MAP}
+
+		echo "$DECAP_DEV" > $RUNDIR/device.state
 	fi
 fi
 
@@ -370,6 +539,34 @@ POLICY_MAP="cilium_policy_reserved_${ID_HOST}"
 OPTS="-DFROM_HOST -DFIXED_SRC_SECCTX=${ID_HOST} -DSECLABEL=${ID_HOST} -DPOLICY_MAP=${POLICY_MAP}"
 bpf_load $HOST_DEV1 "$OPTS" "egress" bpf_netdev.c bpf_host.o from-netdev $CALLS_MAP
 
+# Socket programs translating services at connect() and sendmsg() of all
+# processes, attached to the root of the cgroup v2 hierarchy
+HOOKS="connect4 sendmsg4 connect6 sendmsg6"
+if grep -q "ENABLE_SOCKET_LB" $RUNDIR/globals/node_config.h; then
+	setup_cgroup_root
+	bpf_compile bpf_sock.c bpf_sock.o obj ""
+
+	ATTACH="connect6"
+	if grep -q "ENABLE_IPV4" $RUNDIR/globals/node_config.h; then
+		ATTACH="$ATTACH connect4"
+	fi
+	if grep -q "ENABLE_SOCKET_LB_SENDMSG" $RUNDIR/globals/node_config.h; then
+		ATTACH="$ATTACH ${ATTACH//connect/sendmsg}"
+	fi
+
+	for HOOK in $HOOKS; do
+		if [[ " $ATTACH " == *" $HOOK "* ]]; then
+			bpf_load_cgroups "" bpf_sock.c bpf_sock.o $CGROUP_ROOT $HOOK
+		else
+			bpf_clear_cgroups $CGROUP_ROOT $HOOK
+		fi
+	done
+elif mountpoint -q $CGROUP_ROOT; then
+	for HOOK in $HOOKS; do
+		bpf_clear_cgroups $CGROUP_ROOT $HOOK
+	done
+fi
+
 if [ -n "$XDP_DEV" ]; then
 	CIDR_MAP="cilium_cidr_v*"
 	OPTS=""
@@ -22,6 +22,14 @@ EPDIR=$3
 IFNAME=$4
 DEBUG=$5
 EPID=$6
+# Maximum number of objects in the compile cache, 0 disables the cache
+CACHE_SIZE=${7:-0}
+# "compile" only compiles the program, "load" only loads an existing object,
+# both are done by default
+MODE=${8:-all}
+
+# Compiled objects are cached across regenerations and agent restarts.
+CACHE_DIR="$RUNDIR/bpf_lxc.cache"
 
 function bpf_preprocess()
 {
@@ -31,6 +39,19 @@ function bpf_preprocess()
 		-I$LIB/include -c $LIB/$SRC -o $EPDIR/$SRC
 }
 
+# Flags other than include paths, which are part of the cache key
+function bpf_codegen_flags()
+{
+	echo "-O2 -g -target bpf -emit-llvm" \
+	     "-Wno-address-of-packed-member -Wno-unknown-warning-option" \
+	     "-D__NR_CPUS__=$(nproc)"
+}
+
+function bpf_cflags()
+{
+	echo "$(bpf_codegen_flags) -I$RUNDIR/globals -I$EPDIR -I$LIB/include"
+}
+
 function bpf_compile()
 {
 	IN=$1
@@ -38,25 +59,78 @@ function bpf_compile()
 	TYPE=$3
 	EXTRA_CFLAGS=$4
 
-	clang -O2 -g -target bpf -emit-llvm $EXTRA_CFLAGS			\
-	      -Wno-address-of-packed-member -Wno-unknown-warning-option	\
-	      -I$RUNDIR/globals -I$EPDIR -I$LIB/include			\
-	      -D__NR_CPUS__=$(nproc)					\
-	      -c $LIB/$IN -o - |					\
+	clang $(bpf_cflags) $EXTRA_CFLAGS -c $LIB/$IN -o - |		\
 	llc -march=bpf -mcpu=probe -mattr=dwarfris -filetype=$TYPE -o $EPDIR/$OUT
 }
 
+# The preprocessed source covers all headers, including the endpoint, node
+# and feature configuration. Neither the include paths nor the line markers
+# are part of the key as they contain the path of the endpoint directory,
+# so that endpoints with the same configuration share objects. Only the
+# debug info of a shared object names the directory it was compiled in.
+# The kernel is part of the key because llc probes it for the instruction
+# set to use.
+function bpf_cache_key()
+{
+	IN=$1
+
+	(echo "$(bpf_codegen_flags)"; uname -r; clang --version; llc --version
+	 clang $(bpf_cflags) -E -P -c $LIB/$IN -o -) |
+	sha1sum | cut -d' ' -f1
+}
+
+# Compiles $1 into the object $2 unless the cache has an object for the
+# same input. The result is reported on stdout for the agent.
+function bpf_compile_cached()
+{
+	IN=$1
+	OUT=$2
+
+	if [ "$CACHE_SIZE" -le 0 ]; then
+		rm -rf "$CACHE_DIR"
+		bpf_compile $IN $OUT obj
+		return
+	fi
+
+	KEY=$(bpf_cache_key $IN)
+	ENTRY="$CACHE_DIR/$KEY.o"
+	if [ -f "$ENTRY" ] && cp "$ENTRY" "$EPDIR/$OUT" 2> /dev/null; then
+		touch "$ENTRY"
+		echo "Compile cache: hit"
+		return
+	fi
+
+	echo "Compile cache: miss"
+	bpf_compile $IN $OUT obj
+
+	# Entries are moved into place in one step so that concurrent runs
+	# never see a partial object. The least recently used entries are
+	# evicted.
+	mkdir -p "$CACHE_DIR"
+	TMP="$CACHE_DIR/.$KEY.$$"
+	cp "$EPDIR/$OUT" "$TMP" && mv "$TMP" "$ENTRY"
+	ls -t "$CACHE_DIR"/*.o 2> /dev/null | tail -n +$((CACHE_SIZE + 1)) |
+	xargs -r rm -f
+}
+
 echo "Join EP id=$EPDIR ifname=$IFNAME"
 
-# Only generate ASM output if debug is enabled.
-if [[ "${DEBUG}" == "true" ]]; then
-  echo "kernel version: " `uname -a`
-  echo "clang version: " `clang --version`
-  bpf_compile bpf_lxc.c bpf_lxc.asm asm -g
-  bpf_preprocess bpf_lxc.c
+if [ "$MODE" != "load" ]; then
+	# Only generate ASM output if debug is enabled.
+	if [[ "${DEBUG}" == "true" ]]; then
+	  echo "kernel version: " `uname -a`
+	  echo "clang version: " `clang --version`
+	  bpf_compile bpf_lxc.c bpf_lxc.asm asm -g
+	  bpf_preprocess bpf_lxc.c
+	fi
+
+	bpf_compile_cached bpf_lxc.c bpf_lxc.o
+fi
+
+if [ "$MODE" == "compile" ]; then
+	exit 0
 fi
 
-bpf_compile bpf_lxc.c bpf_lxc.o obj
 tc qdisc replace dev $IFNAME clsact || true
 cilium-map-migrate -s $EPDIR/bpf_lxc.o
 set +e
@@ -36,6 +36,16 @@
 #define EVENT_SOURCE 0
 #endif
 
+/* Flags of hash tables whose entries are allocated on insertion unless the
+ * agent runs with --preallocate-bpf-maps. LRU hash tables are always
+ * preallocated.
+ */
+#ifdef PREALLOCATE_MAPS
+#define CONDITIONAL_PREALLOC 0
+#else
+#define CONDITIONAL_PREALLOC BPF_F_NO_PREALLOC
+#endif
+
 #define __inline__ __attribute__((always_inline))
 
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
@@ -90,8 +100,19 @@ static inline bool __revalidate_data(struct __sk_buff *skb, void **data_,
 #define revalidate_data(skb, data, data_end, ip)	\
 	__revalidate_data(skb, data, data_end, (void **)ip, sizeof(**ip))
 
-/* Macros for working with L3 cilium defined IPV6 addresses */
-#define BPF_V6(dst, ...)	BPF_V6_16(dst, __VA_ARGS__)
+/* Macros for working with L3 cilium defined IPV6 addresses. The address is
+ * given either as 16 bytes or as 4 words in network byte order. */
+#define __BPF_V6_SELECT(a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16, NAME, ...) NAME
+#define BPF_V6(dst, ...)							\
+	__BPF_V6_SELECT(__VA_ARGS__, BPF_V6_16, _, _, _, _, _, _, _, _, _, _, _,	\
+			BPF_V6_4, _, _, _)(dst, __VA_ARGS__)
+#define BPF_V6_4(dst, w1, w2, w3, w4)	\
+	({				\
+		dst.p1 = (w1);		\
+		dst.p2 = (w2);		\
+		dst.p3 = (w3);		\
+		dst.p4 = (w4);		\
+	})
 #define BPF_V6_16(dst, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, a13, a14, a15, a16) \
 	({										\
 		dst.p1 = bpf_htonl( (a1) << 24 |  (a2) << 16 |  (a3) << 8 |  (a4));	\
@@ -177,6 +198,34 @@ struct remote_endpoint_info {
 	__u32		tunnel_endpoint;
 };
 
+enum {
+	IPCACHE_CACHE_FOUND = (1 << 0),	/* Address is in the ipcache */
+};
+
+struct ipcache_cache_entry {
+	struct remote_endpoint_info info;
+	__u32		generation;	/* Valid if equal to cilium_ipcache_gen */
+	__u8		flags;
+	__u8		pad1;
+	__u16		pad2;
+};
+
+#ifdef POLICY_LPM
+/* Policy maps backed by an LPM trie resolve L4 and L3 rules of an identity
+ * with a single lookup. L3 rules cover the identity and direction only,
+ * L4 rules the full key.
+ */
+#define POLICY_PREFIX_L3	40
+#define POLICY_PREFIX_FULL	64
+
+struct policy_key {
+	__u32		prefixlen;
+	__u32		sec_label;
+	__u8		egress;
+	__u8		protocol;
+	__u16		dport;
+};
+#else
 struct policy_key {
 	__u32		sec_label;
 	__u16		dport;
@@ -184,10 +233,20 @@ struct policy_key {
 	__u8		egress:1,
 			pad:7;
 };
+#endif
+
+enum {
+	POLICY_F_L3 = (1 << 0),			/* Entry applies to all ports */
+	POLICY_F_DEFAULT = (1 << 1),		/* Catch-all entry, does not allow */
+	POLICY_F_WILDCARD_INGRESS = (1 << 2),	/* L4 rules for identity 0 exist */
+	POLICY_F_WILDCARD_EGRESS = (1 << 3),
+};
 
 struct policy_entry {
 	__be16		proxy_port;
-	__u16		pad[3];
+	__u8		flags;
+	__u8		pad0;
+	__u16		pad[2];
 	__u64		packets;
 	__u64		bytes;
 };
@@ -205,6 +264,20 @@ struct metrics_value {
      __u64	bytes;
 };
 
+struct ep_metrics_key {
+	__u32	identity;	/* Remote identity, 0: any other identity */
+	__u16	ep_id;
+	__u8	reason;		/* 0: forwarded, >0 dropped */
+	__u8	dir;		/* 1: ingress 2: egress */
+};
+
+/* Egress bandwidth limit of an endpoint, see <bpf/lib/edt.h> */
+struct edt_info {
+	__u64	bps;		/* Rate in bytes per second, 0: unlimited */
+	__u64	t_last;		/* Departure time of the last packet in ns */
+	__u64	t_horizon_drop;	/* Maximum delay of a packet in ns */
+};
+
 
 enum {
 	CILIUM_NOTIFY_UNSPEC,
@@ -212,6 +285,7 @@ enum {
 	CILIUM_NOTIFY_DBG_MSG,
 	CILIUM_NOTIFY_DBG_CAPTURE,
 	CILIUM_NOTIFY_TRACE,
+	CILIUM_NOTIFY_TRACE_FLOW,
 };
 
 #define NOTIFY_COMMON_HDR \
@@ -224,6 +298,16 @@ enum {
 #define TRACE_PAYLOAD_LEN 128ULL
 #endif
 
+struct drop_notify {
+	NOTIFY_COMMON_HDR
+	__u32		len_orig;
+	__u32		len_cap;
+	__u32		src_label;
+	__u32		dst_label;
+	__u32		dst_id;
+	__u32		ifindex;
+};
+
 #ifndef BPF_F_PSEUDO_HDR
 # define BPF_F_PSEUDO_HDR                (1ULL << 4)
 #endif
@@ -267,6 +351,15 @@ enum {
 #define DROP_NO_TUNNEL_ENDPOINT -160
 #define DROP_PROXYMAP_CREATE_FAILED	-161
 #define DROP_POLICY_CIDR		-162
+#define DROP_PREFILTER_DENY	-163
+#define DROP_PREFILTER_NO_LXC	-164
+#define DROP_PREFILTER_INVALID	-165
+#define DROP_PREFILTER_L4	-166
+#define DROP_PREFILTER_RATELIMIT	-167
+#define DROP_PROXY_SOCKET	-168
+#define DROP_EDT_HORIZON	-169
+#define DROP_NAT_NO_MAPPING	-170
+#define DROP_FRAG_NOT_FOUND	-171
 
 /* Cilium metrics reason for forwarding packet.
  * If reason > 0 then this is a drop reason and value corresponds to -(DROP_*)
@@ -277,6 +370,16 @@ enum {
 #define METRIC_INGRESS  1
 #define METRIC_EGRESS   2
 
+/* Cilium metrics direction of datapath internal counters, the reason is
+ * one of the METRIC_REASON_* values below.
+ */
+#define METRIC_INTERNAL 3
+
+#define METRIC_REASON_IPCACHE_CACHE_HIT		1
+#define METRIC_REASON_IPCACHE_CACHE_MISS	2
+#define METRIC_REASON_EDT_DELAYED		3
+#define METRIC_REASON_EDT_DROPPED		4
+
 /* Magic skb->mark markers which identify packets originating from the host
  *
  * The upper 16 bits contain
@@ -288,6 +391,7 @@ enum {
  * endpoint.
  */
 #define MARK_MAGIC_HOST_MASK		0xF00
+#define MARK_MAGIC_TO_PROXY		0x200
 #define MARK_MAGIC_PROXY_INGRESS	0xA00
 #define MARK_MAGIC_PROXY_EGRESS		0xB00
 #define MARK_MAGIC_HOST			0xC00
@@ -300,6 +404,19 @@ static inline int __inline__ get_identity_via_proxy(struct __sk_buff *skb)
 	return ((skb->mark & 0xFF) << 16) | skb->mark >> 16;
 }
 
+/**
+ * set_identity_to_proxy - mark packet as assigned to a proxy socket
+ *
+ * The identity is encoded as expected by get_identity_via_proxy() so that
+ * the proxy can read it from the accepted socket.
+ */
+static inline void __inline__ set_identity_to_proxy(struct __sk_buff *skb,
+						    __u32 identity)
+{
+	skb->mark = MARK_MAGIC_TO_PROXY | ((identity & 0xFFFF) << 16) |
+		    ((identity >> 16) & 0xFF);
+}
+
 /*
  * skb->tc_index uses
  *
@@ -377,32 +494,51 @@ ipv4_ct_tuple_get_daddr(struct ipv4_ct_tuple *tuple)
 #endif
 }
 
+/* Members which are only written when a connection is created or closed
+ * come first, members which are written while packets pass come last, so
+ * that established connections dirty as few cache lines shared with the
+ * readers on other CPUs as possible. cilium-map-migrate converts entries
+ * of the previous layout, see bpf_ct_entry_convert_v1().
+ */
 struct ct_entry {
-	__u64 rx_packets;
-	__u64 rx_bytes;
-	__u64 tx_packets;
-	__u64 tx_bytes;
-	__u32 lifetime;
+	__u16 rev_nat_index;
+	__u16 slave;
 	__u16 rx_closing:1,
 	      tx_closing:1,
 	      nat46:1,
 	      lb_loopback:1,
 	      seen_non_syn:1,
 	      reserve:11;
-	__u16 rev_nat_index;
-	__u16 slave;
+
+	/* Policy verdict cached for established connections, see
+	 * CT_POLICY_CACHE. The cache is valid as long as policy_rev matches
+	 * policy_revision(), a value of 0 marks it as unset. proxy_port is
+	 * in network byte order. */
+	__be16 proxy_port;
+	__u32 src_sec_id;
+	__u32 policy_rev;
+	__u32 remote_sec_id;
+	__be32 tunnel_endpoint;
+
+	/* Refreshed at most once per CT_LIFETIME_SLACK seconds */
+	__u32 lifetime;
 
 	/* *x_flags_seen represents the OR of all TCP flags seen for the
 	 * transmit/receive direction of this entry. */
 	__u8  tx_flags_seen;
 	__u8  rx_flags_seen;
-
-	__u32 src_sec_id;
+	__u16 pad;
 
 	/* last_*x_report is a timestamp of the last time a monitor
 	 * notification was sent for the transmit/receive direction. */
 	__u32 last_tx_report;
 	__u32 last_rx_report;
+
+	/* Written by every packet with CONNTRACK_ACCOUNTING */
+	__u64 rx_packets;
+	__u64 rx_bytes;
+	__u64 tx_packets;
+	__u64 tx_bytes;
 };
 
 struct lb6_key {
@@ -458,6 +594,10 @@ struct ct_state {
 	__be32 svc_addr;
 	__u32 src_sec_id;
 	__u16 slave;
+	__be16 proxy_port;
+	__u32 policy_rev;
+	__u32 remote_sec_id;
+	__be32 tunnel_endpoint;
 };
 
 /* Lifetime of a proxy redirection entry. All proxies should be using TCP
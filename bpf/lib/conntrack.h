@@ -33,6 +33,7 @@
 #define CT_DEFAULT_SYN_TIMEOUT		60	/* 60 seconds */
 #define CT_DEFAULT_CLOSE_TIMEOUT	10	/* 10 seconds */
 #define CT_DEFAULT_REPORT_INTERVAL	5	/* 5 seconds */
+#define CT_DEFAULT_LIFETIME_SLACK	0	/* Refresh once per second */
 
 #ifndef CT_LIFETIME_TCP
 #define CT_LIFETIME_TCP CT_DEFAULT_LIFETIME_TCP
@@ -58,6 +59,22 @@
 #define CT_REPORT_INTERVAL CT_DEFAULT_REPORT_INTERVAL
 #endif
 
+/* CT_LIFETIME_SLACK is the number of seconds by which the lifetime stored in
+ * an entry may fall behind before it is refreshed. Writing the lifetime on
+ * every packet would invalidate the cache line of the entry on all other
+ * CPUs handling the connection. Entries may expire up to this many seconds
+ * early. It must not exceed half of CT_CLOSE_TIMEOUT, the shortest lifetime,
+ * so that retransmitted FIN or RST packets still extend the lifetime of a
+ * closing connection.
+ */
+#ifndef CT_LIFETIME_SLACK
+#define CT_LIFETIME_SLACK CT_DEFAULT_LIFETIME_SLACK
+#endif
+
+#if CT_LIFETIME_SLACK > CT_CLOSE_TIMEOUT / 2
+#error "CT_LIFETIME_SLACK must not exceed half of CT_CLOSE_TIMEOUT"
+#endif
+
 #ifdef CONNTRACK
 
 #define TUPLE_F_OUT		0	/* Outgoing flow */
@@ -88,6 +105,10 @@ union tcp_flags {
 /**
  * Update the CT timeout and TCP flags for the specified entry.
  *
+ * The entry is only written if something changed: the lifetime when it
+ * falls more than CT_LIFETIME_SLACK behind or is shortened, e.g. on close,
+ * and the flags and report timestamp as described below.
+ *
  * We track the OR'd accumulation of seen tcp flags in the entry, and the
  * last time that a notification was sent. Multiple CPUs may enter this
  * function with packets for the same connection, in which case it is possible
@@ -110,7 +131,10 @@ static inline bool __inline__ __ct_update_timeout(struct ct_entry *entry,
 	__u32 *last_report;
 
 #ifdef NEEDS_TIMEOUT
-	entry->lifetime = now + lifetime;
+	__s32 behind = (__s32) (now + lifetime - entry->lifetime);
+
+	if (behind < 0 || behind > CT_LIFETIME_SLACK)
+		entry->lifetime = now + lifetime;
 #endif
 	if (dir == CT_INGRESS) {
 		accumulated_flags = &entry->rx_flags_seen;
@@ -174,7 +198,8 @@ static inline bool __inline__ ct_update_timeout(struct ct_entry *entry,
 	bool syn = seen_flags.syn;
 
 	if (tcp) {
-		entry->seen_non_syn |= !syn;
+		if (!syn && !entry->seen_non_syn)
+			entry->seen_non_syn = 1;
 
 		if (entry->seen_non_syn)
 			lifetime = CT_LIFETIME_TCP;
@@ -214,6 +239,10 @@ static inline int __inline__ __ct_lookup(void *map, struct __sk_buff *skb,
 			ct_state->rev_nat_index = entry->rev_nat_index;
 			ct_state->loopback = entry->lb_loopback;
 			ct_state->slave = entry->slave;
+			ct_state->policy_rev = entry->policy_rev;
+			ct_state->remote_sec_id = entry->remote_sec_id;
+			ct_state->tunnel_endpoint = entry->tunnel_endpoint;
+			ct_state->proxy_port = entry->proxy_port;
 		}
 
 #ifdef LXC_NAT46
@@ -583,6 +612,24 @@ static inline void __inline__ ct_update6_slave(void *map,
 	return;
 }
 
+/* Caches the policy verdict in @state in the entry of @tuple, @tuple must be
+ * the tuple of a previous ct_lookup6() that returned CT_ESTABLISHED. */
+static inline void __inline__ ct_update6_policy(void *map,
+						struct ipv6_ct_tuple *tuple,
+						struct ct_state *state)
+{
+	struct ct_entry *entry;
+
+	entry = map_lookup_elem(map, tuple);
+	if (!entry)
+		return;
+
+	entry->remote_sec_id = state->remote_sec_id;
+	entry->tunnel_endpoint = state->tunnel_endpoint;
+	entry->proxy_port = state->proxy_port;
+	entry->policy_rev = state->policy_rev;
+}
+
 
 /* Offset must point to IPv6 */
 static inline int __inline__ ct_create6(void *map, struct ipv6_ct_tuple *tuple,
@@ -597,6 +644,10 @@ static inline int __inline__ ct_create6(void *map, struct ipv6_ct_tuple *tuple,
 	entry.rev_nat_index = ct_state->rev_nat_index;
 	entry.lb_loopback = ct_state->loopback;
 	entry.slave = ct_state->slave;
+	entry.policy_rev = ct_state->policy_rev;
+	entry.remote_sec_id = ct_state->remote_sec_id;
+	entry.tunnel_endpoint = ct_state->tunnel_endpoint;
+	entry.proxy_port = ct_state->proxy_port;
 	seen_flags.syn = is_tcp;
 	ct_update_timeout(&entry, is_tcp, dir, seen_flags);
 
@@ -623,6 +674,7 @@ static inline int __inline__ ct_create6(void *map, struct ipv6_ct_tuple *tuple,
 	};
 
 	entry.seen_non_syn = true; /* For ICMP, there is no SYN. */
+	entry.policy_rev = 0;
 
 	ipv6_addr_copy(&icmp_tuple.daddr, &tuple->daddr);
 	ipv6_addr_copy(&icmp_tuple.saddr, &tuple->saddr);
@@ -660,6 +712,24 @@ static inline void __inline__ ct_update4_slave(void *map,
 	return;
 }
 
+/* Caches the policy verdict in @state in the entry of @tuple, @tuple must be
+ * the tuple of a previous ct_lookup4() that returned CT_ESTABLISHED. */
+static inline void __inline__ ct_update4_policy(void *map,
+						struct ipv4_ct_tuple *tuple,
+						struct ct_state *state)
+{
+	struct ct_entry *entry;
+
+	entry = map_lookup_elem(map, tuple);
+	if (!entry)
+		return;
+
+	entry->remote_sec_id = state->remote_sec_id;
+	entry->tunnel_endpoint = state->tunnel_endpoint;
+	entry->proxy_port = state->proxy_port;
+	entry->policy_rev = state->policy_rev;
+}
+
 static inline int __inline__ ct_create4(void *map, struct ipv4_ct_tuple *tuple,
 					struct __sk_buff *skb, int dir,
 					struct ct_state *ct_state)
@@ -672,6 +742,10 @@ static inline int __inline__ ct_create4(void *map, struct ipv4_ct_tuple *tuple,
 	entry.rev_nat_index = ct_state->rev_nat_index;
 	entry.lb_loopback = ct_state->loopback;
 	entry.slave = ct_state->slave;
+	entry.policy_rev = ct_state->policy_rev;
+	entry.remote_sec_id = ct_state->remote_sec_id;
+	entry.tunnel_endpoint = ct_state->tunnel_endpoint;
+	entry.proxy_port = ct_state->proxy_port;
 	seen_flags.syn = is_tcp;
 	ct_update_timeout(&entry, is_tcp, dir, seen_flags);
 
@@ -694,6 +768,9 @@ static inline int __inline__ ct_create4(void *map, struct ipv4_ct_tuple *tuple,
 	if (map_update_elem(map, tuple, &entry, 0) < 0)
 		return DROP_CT_CREATE_FAILED;
 
+	/* The verdict was computed for the original tuple only */
+	entry.policy_rev = 0;
+
 	if (ct_state->addr) {
 		__u8 flags = tuple->flags;
 		__be32 saddr, daddr;
@@ -768,6 +845,12 @@ static inline void __inline__ ct_update6_slave(void *map,
 {
 }
 
+static inline void __inline__ ct_update6_policy(void *map,
+						struct ipv6_ct_tuple *tuple,
+						struct ct_state *state)
+{
+}
+
 static inline int __inline__ ct_create6(void *map, struct ipv6_ct_tuple *tuple,
 					struct __sk_buff *skb, int dir,
 					struct ct_state *ct_state)
@@ -785,6 +868,12 @@ static inline void __inline__ ct_update4_slave(void *map,
 {
 }
 
+static inline void __inline__ ct_update4_policy(void *map,
+						struct ipv4_ct_tuple *tuple,
+						struct ct_state *state)
+{
+}
+
 static inline int __inline__ ct_create4(void *map, struct ipv4_ct_tuple *tuple,
 					struct __sk_buff *skb, int dir,
 					struct ct_state *ct_state)
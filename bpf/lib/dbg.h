@@ -127,19 +127,110 @@ enum {
 #define EVENT_SOURCE 0
 #endif
 
-#if defined DEBUG
+#include <bpf/api.h>
+
+#include "common.h"
+#include "utils.h"
 #include "events.h"
+#include "ratelimit.h"
+
+/* Debug messages are compiled in and enabled per endpoint at runtime by
+ * the agent through cilium_dbg_config, indexed by endpoint ID. Programs
+ * not attached to an endpoint use the entry at index 0. Defining DEBUG
+ * enables all messages at compile time instead.
+ */
+#ifndef DBG_CONFIG_MAP_SIZE
+#define DBG_CONFIG_MAP_SIZE 65536
+#endif
+
+/* Maximum number of endpoints with a rate limited debug configuration */
+#define DBG_BUCKETS_MAP_SIZE 1024
+
+enum {
+	DBG_CONFIG_ENABLED = (1 << 0),
+};
+
+struct dbg_config {
+	__u32	flags;
+	__u32	rate;	/* messages per second and CPU, 0: no limit */
+};
+
+struct bpf_elf_map __section_maps cilium_dbg_config = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct dbg_config),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= DBG_CONFIG_MAP_SIZE,
+};
+
+/* Buckets are only created for endpoints with a rate limit when they emit
+ * their first message, indexing by endpoint ID would need a per-CPU entry
+ * for every possible ID.
+ */
+struct bpf_elf_map __section_maps cilium_dbg_buckets = {
+#ifdef HAVE_LRU_MAP_TYPE
+	.type		= BPF_MAP_TYPE_LRU_PERCPU_HASH,
+#else
+	.type		= BPF_MAP_TYPE_PERCPU_HASH,
 #endif
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct ratelimit_bucket),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= DBG_BUCKETS_MAP_SIZE,
+};
+
+static __always_inline bool dbg_ratelimit_admit(__u32 rate)
+{
+	struct ratelimit_bucket *b, zero = {};
+	__u32 key = EVENT_SOURCE;
+
+	b = map_lookup_elem(&cilium_dbg_buckets, &key);
+	if (!b) {
+		map_update_elem(&cilium_dbg_buckets, &key, &zero, BPF_NOEXIST);
+		b = map_lookup_elem(&cilium_dbg_buckets, &key);
+		if (!b)
+			return false;
+	}
 
+	return ratelimit_admit(b, rate, rate);
+}
+
+/**
+ * cilium_dbg_enabled
+ *
+ * Returns true if a debug message should be emitted. With debugging
+ * disabled, every call site still looks up the array entry and branches
+ * on it.
+ */
+static __always_inline bool cilium_dbg_enabled(void)
+{
 #ifdef DEBUG
-#include "utils.h"
+	return true;
+#else
+	struct dbg_config *cfg;
+	__u32 key = EVENT_SOURCE;
+
+	cfg = map_lookup_elem(&cilium_dbg_config, &key);
+	if (likely(!cfg || !(cfg->flags & DBG_CONFIG_ENABLED)))
+		return false;
 
+	if (cfg->rate)
+		return dbg_ratelimit_admit(cfg->rate);
+	return true;
+#endif
+}
+
+#ifdef DEBUG
 # define printk(fmt, ...)					\
 		({						\
 			char ____fmt[] = fmt;			\
 			trace_printk(____fmt, sizeof(____fmt),	\
 				     ##__VA_ARGS__);		\
 		})
+#else
+# define printk(fmt, ...)					\
+		do { } while (0)
+#endif
 
 struct debug_msg {
 	NOTIFY_COMMON_HDR
@@ -150,6 +241,9 @@ struct debug_msg {
 
 static inline void cilium_dbg(struct __sk_buff *skb, __u8 type, __u32 arg1, __u32 arg2)
 {
+	if (!cilium_dbg_enabled())
+		return;
+
 	uint32_t hash = get_hash_recalc(skb);
 	struct debug_msg msg = {
 		.type = CILIUM_NOTIFY_DBG_MSG,
@@ -160,12 +254,15 @@ static inline void cilium_dbg(struct __sk_buff *skb, __u8 type, __u32 arg1, __u3
 		.arg2 = arg2,
 	};
 
-	skb_event_output(skb, &cilium_events, BPF_F_CURRENT_CPU, &msg, sizeof(msg));
+	send_event(skb, &msg, sizeof(msg), 0);
 }
 
 static inline void cilium_dbg3(struct __sk_buff *skb, __u8 type, __u32 arg1,
 			       __u32 arg2, __u32 arg3)
 {
+	if (!cilium_dbg_enabled())
+		return;
+
 	uint32_t hash = get_hash_recalc(skb);
 	struct debug_msg msg = {
 		.type = CILIUM_NOTIFY_DBG_MSG,
@@ -177,7 +274,7 @@ static inline void cilium_dbg3(struct __sk_buff *skb, __u8 type, __u32 arg1,
 		.arg3 = arg3,
 	};
 
-	skb_event_output(skb, &cilium_events, BPF_F_CURRENT_CPU, &msg, sizeof(msg));
+	send_event(skb, &msg, sizeof(msg), 0);
 }
 
 struct debug_capture_msg {
@@ -190,6 +287,9 @@ struct debug_capture_msg {
 
 static inline void cilium_dbg_capture2(struct __sk_buff *skb, __u8 type, __u32 arg1, __u32 arg2)
 {
+	if (!cilium_dbg_enabled())
+		return;
+
 	uint64_t skb_len = (uint64_t)skb->len, cap_len = min((uint64_t)TRACE_PAYLOAD_LEN, (uint64_t)skb_len);
 	uint32_t hash = get_hash_recalc(skb);
 	struct debug_capture_msg msg = {
@@ -203,9 +303,7 @@ static inline void cilium_dbg_capture2(struct __sk_buff *skb, __u8 type, __u32 a
 		.arg2 = arg2,
 	};
 
-	skb_event_output(skb, &cilium_events,
-			 (cap_len << 32) | BPF_F_CURRENT_CPU,
-			 &msg, sizeof(msg));
+	send_event(skb, &msg, sizeof(msg), cap_len);
 }
 
 static inline void cilium_dbg_capture(struct __sk_buff *skb, __u8 type, __u32 arg1)
@@ -213,28 +311,4 @@ static inline void cilium_dbg_capture(struct __sk_buff *skb, __u8 type, __u32 ar
 	cilium_dbg_capture2(skb, type, arg1, 0);
 }
 
-#else
-
-# define printk(fmt, ...)					\
-		do { } while (0)
-
-static inline void cilium_dbg(struct __sk_buff *skb, __u8 type, __u32 arg1, __u32 arg2)
-{
-}
-
-static inline void cilium_dbg3(struct __sk_buff *skb, __u8 type, __u32 arg1,
-			       __u32 arg2, __u32 arg3)
-{
-}
-
-static inline void cilium_dbg_capture(struct __sk_buff *skb, __u8 type, __u32 arg1)
-{
-}
-
-static inline void cilium_dbg_capture2(struct __sk_buff *skb, __u8 type, __u32 arg1, __u32 arg2)
-{
-}
-
-#endif
-
 #endif /* __LIB_DBG__ */
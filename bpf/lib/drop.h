@@ -24,6 +24,10 @@
  * int send_drop_notify_error(skb, error, exitcode, __u8 direction)
  *
  * If DROP_NOTIFY is not defined, the API will be compiled in as a NOP.
+ *
+ * With DROP_NOTIFY_RATELIMIT, notifications pass a per-CPU token bucket per
+ * drop reason configured by the agent. Drops beyond the limit are only
+ * accounted in the metrics and counted as suppressed in the bucket.
  */
 
 #ifndef __LIB_DROP__
@@ -34,22 +38,74 @@
 #include "common.h"
 #include "utils.h"
 #include "metrics.h"
+#include "trace_config.h"
+#include "ratelimit.h"
 
 #ifdef DROP_NOTIFY
 
-struct drop_notify {
-	NOTIFY_COMMON_HDR
-	__u32		len_orig;
-	__u32		len_cap;
-	__u32		src_label;
-	__u32		dst_label;
-	__u32		dst_id;
-	__u32		ifindex;
+#ifdef DROP_NOTIFY_RATELIMIT
+/* Indexed by drop reason, must be in sync with DropLimitMaxEntries in
+ * pkg/maps/tracemap/droplimit.go
+ */
+#define DROP_NOTIFY_LIMITS_SIZE 256
+
+struct drop_notify_limit {
+	__u32	rate;	/* notifications per second and CPU */
+	__u32	burst;	/* maximum bucket depth, 0: no limit */
+};
+
+struct bpf_elf_map __section_maps cilium_drop_notify_limits = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct drop_notify_limit),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= DROP_NOTIFY_LIMITS_SIZE,
 };
 
+struct bpf_elf_map __section_maps cilium_drop_notify_buckets = {
+	.type		= BPF_MAP_TYPE_PERCPU_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct ratelimit_bucket),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= DROP_NOTIFY_LIMITS_SIZE,
+};
+
+/**
+ * drop_notify_admit
+ * @reason:	drop reason, positive
+ *
+ * Returns true if a notification may be sent for a drop with @reason.
+ */
+static __always_inline bool drop_notify_admit(__u8 reason)
+{
+	struct drop_notify_limit *limit;
+	struct ratelimit_bucket *b;
+	__u32 key = reason;
+
+	limit = map_lookup_elem(&cilium_drop_notify_limits, &key);
+	if (!limit || !limit->burst)
+		return true;
+	b = map_lookup_elem(&cilium_drop_notify_buckets, &key);
+	if (!b)
+		return true;
+
+	return ratelimit_admit(b, limit->rate, limit->burst);
+}
+#else
+static __always_inline bool drop_notify_admit(__u8 reason)
+{
+	return true;
+}
+#endif /* DROP_NOTIFY_RATELIMIT */
+
 __section_tail(CILIUM_MAP_CALLS, CILIUM_CALL_DROP_NOTIFY) int __send_drop_notify(struct __sk_buff *skb)
 {
-	uint64_t skb_len = (uint64_t)skb->len, cap_len = min((uint64_t)TRACE_PAYLOAD_LEN, (uint64_t)skb_len);
+	struct trace_config *cfg = trace_config_lookup();
+
+	if (!trace_config_sample(cfg))
+		return skb->cb[0];
+
+	uint64_t skb_len = (uint64_t)skb->len, cap_len = trace_config_cap_len(cfg, skb_len);
 	uint32_t hash = get_hash_recalc(skb);
 	uint32_t srcdst_info = skb->cb[1];
 	struct drop_notify msg = {
@@ -70,9 +126,7 @@ __section_tail(CILIUM_MAP_CALLS, CILIUM_CALL_DROP_NOTIFY) int __send_drop_notify
 
 	msg.subtype = error;
 
-	skb_event_output(skb, &cilium_events,
-			 (cap_len << 32) | BPF_F_CURRENT_CPU,
-			 &msg, sizeof(msg));
+	send_event(skb, &msg, sizeof(msg), cap_len);
 
 	return skb->cb[0];
 }
@@ -87,7 +141,9 @@ __section_tail(CILIUM_MAP_CALLS, CILIUM_CALL_DROP_NOTIFY) int __send_drop_notify
  * @reason:	Reason for drop
  * @exitcode:	error code to return to the kernel
  *
- * Generate a notification to indicate a packet was dropped.
+ * Generate a notification to indicate a packet was dropped. The drop is
+ * always accounted in the metrics, the notification only if the rate limit
+ * of @reason allows.
  *
  * NOTE: This is terminal function and will cause the BPF program to exit
  */
@@ -102,6 +158,11 @@ static inline int send_drop_notify(struct __sk_buff *skb, __u32 src, __u32 dst,
 	skb->cb[4] = ifindex,
 
 	update_metrics(skb->len, direction, -reason);
+	update_ep_metrics(skb->len, direction, -reason,
+			  direction == METRIC_INGRESS ? src : dst);
+
+	if (!drop_notify_admit(-reason))
+		return exitcode;
 
 	ep_tail_call(skb, CILIUM_CALL_DROP_NOTIFY);
 
@@ -115,6 +176,8 @@ static inline int send_drop_notify(struct __sk_buff *skb, __u32 src, __u32 dst,
 				   int exitcode, __u8 direction)
 {
 	update_metrics(skb->len, direction, -reason);
+	update_ep_metrics(skb->len, direction, -reason,
+			  direction == METRIC_INGRESS ? src : dst);
 	return exitcode;
 }
 
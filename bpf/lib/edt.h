@@ -0,0 +1,104 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Egress bandwidth limits of endpoints based on earliest departure times
+ *
+ * Instead of queueing packets in a shaping qdisc, every packet is stamped
+ * with the earliest time it may leave the node. Consecutive packets of an
+ * endpoint are spaced by their length at the rate of the endpoint and the
+ * fq qdisc on the physical device holds them back until then. The only
+ * state shared between CPUs is the departure time of the last packet of
+ * the endpoint, no qdisc lock is taken.
+ */
+
+#ifndef __LIB_EDT_H_
+#define __LIB_EDT_H_
+
+#include "common.h"
+#include "maps.h"
+#include "metrics.h"
+#include "utils.h"
+
+#if defined(ENABLE_BANDWIDTH_MANAGER) && defined(HAVE_SKB_TSTAMP)
+/**
+ * edt_sched_departure_ep
+ * @skb:	packet leaving the endpoint
+ * @ep_id:	ID of the endpoint
+ *
+ * Sets the departure time of @skb according to the bandwidth limit of the
+ * endpoint. Packets which would have to wait longer than the drop horizon
+ * are dropped, so that a sender exceeding its rate gets backpressure
+ * rather than filling up fq.
+ *
+ * The departure time of the last packet is updated without atomics, CPUs
+ * sending packets of the same endpoint concurrently may exceed the rate
+ * slightly.
+ *
+ * Returns TC_ACT_OK or DROP_EDT_HORIZON.
+ */
+static inline int edt_sched_departure_ep(struct __sk_buff *skb, __u32 ep_id)
+{
+	__u64 now, t, t_next, delay;
+	struct edt_info *info;
+	__u32 key = ep_id;
+
+	info = map_lookup_elem(&cilium_throttle, &key);
+	if (!info || !info->bps)
+		return TC_ACT_OK;
+
+	now = bpf_ktime_get_nsec();
+	t = skb->tstamp;
+	if (t < now)
+		t = now;
+
+	delay = (__u64) skb->len * NSEC_PER_SEC / info->bps;
+	t_next = info->t_last + delay;
+	if (t_next <= t) {
+		info->t_last = t;
+		return TC_ACT_OK;
+	}
+
+	if (t_next - now >= info->t_horizon_drop) {
+		update_metrics(skb->len, METRIC_INTERNAL, METRIC_REASON_EDT_DROPPED);
+		return DROP_EDT_HORIZON;
+	}
+
+	info->t_last = t_next;
+	skb->tstamp = t_next;
+	update_metrics(skb->len, METRIC_INTERNAL, METRIC_REASON_EDT_DELAYED);
+	return TC_ACT_OK;
+}
+#else
+static inline int edt_sched_departure_ep(struct __sk_buff *skb, __u32 ep_id)
+{
+	return TC_ACT_OK;
+}
+#endif
+
+/* Sets the departure time of @skb leaving the endpoint of this program.
+ * Programs of other devices go by the source address, see bpf_netdev.c. */
+static inline int edt_sched_departure(struct __sk_buff *skb)
+{
+#ifdef LXC_ID
+	return edt_sched_departure_ep(skb, LXC_ID);
+#else
+	return TC_ACT_OK;
+#endif
+}
+
+#endif /* __LIB_EDT_H_ */
@@ -20,6 +20,7 @@
 
 #include "common.h"
 #include "dbg.h"
+#include "edt.h"
 
 #ifdef ENCAP_IFINDEX
 static inline int __inline__
@@ -36,6 +37,14 @@ encap_and_redirect_with_nodeid(struct __sk_buff *skb, __u32 tunnel_endpoint,
 
 	cilium_dbg(skb, DBG_ENCAP, node_id, seclabel);
 
+	/* The departure time survives the redirect to the tunnel device
+	 * until the encapsulated packet reaches fq on the physical device.
+	 * Packets passed to the stack lose it when they are forwarded and
+	 * are stamped again by to-netdev on the native device. */
+	ret = edt_sched_departure(skb);
+	if (IS_ERR(ret))
+		return ret;
+
 	ret = skb_set_tunnel_key(skb, &key, sizeof(key), 0);
 	if (unlikely(ret < 0))
 		return DROP_WRITE_ERROR;
@@ -22,29 +22,42 @@
 #include <linux/ipv6.h>
 
 #include "maps.h"
+#include "metrics.h"
 
 static __always_inline struct endpoint_info *
-lookup_ip6_endpoint(struct ipv6hdr *ip6)
+__lookup_ip6_endpoint(union v6addr *ip6)
 {
 	struct endpoint_key key = {};
 
-	key.ip6 = *((union v6addr *) &ip6->daddr);
+	key.ip6 = *ip6;
 	key.family = ENDPOINT_KEY_IPV6;
 
 	return map_lookup_elem(&cilium_lxc, &key);
 }
 
 static __always_inline struct endpoint_info *
-lookup_ip4_endpoint(struct iphdr *ip4)
+lookup_ip6_endpoint(struct ipv6hdr *ip6)
+{
+	return __lookup_ip6_endpoint((union v6addr *) &ip6->daddr);
+}
+
+static __always_inline struct endpoint_info *
+__lookup_ip4_endpoint(__be32 ip4)
 {
 	struct endpoint_key key = {};
 
-	key.ip4 = ip4->daddr;
+	key.ip4 = ip4;
 	key.family = ENDPOINT_KEY_IPV4;
 
 	return map_lookup_elem(&cilium_lxc, &key);
 }
 
+static __always_inline struct endpoint_info *
+lookup_ip4_endpoint(struct iphdr *ip4)
+{
+	return __lookup_ip4_endpoint(ip4->daddr);
+}
+
 /* IPCACHE_STATIC_PREFIX gets sizeof non-IP, non-prefix part of ipcache_key */
 #define IPCACHE_STATIC_PREFIX							\
 	(8 * (sizeof(struct ipcache_key) - sizeof(struct bpf_lpm_trie_key)	\
@@ -102,17 +115,115 @@ _Pragma("unroll")							\
 									\
 	return NULL;							\
 }
-LPM_LOOKUP_FN(lookup_ip6_remote_endpoint, union v6addr *, IPCACHE6_PREFIXES,
+LPM_LOOKUP_FN(__lookup_ip6_remote_endpoint, union v6addr *, IPCACHE6_PREFIXES,
 	      cilium_ipcache, ipcache_lookup6)
-LPM_LOOKUP_FN(lookup_ip4_remote_endpoint, __be32, IPCACHE4_PREFIXES,
+LPM_LOOKUP_FN(__lookup_ip4_remote_endpoint, __be32, IPCACHE4_PREFIXES,
 	      cilium_ipcache, ipcache_lookup4)
 #undef LPM_LOOKUP_FN
 #else /* HAVE_LPM_MAP_TYPE */
-#define lookup_ip6_remote_endpoint(addr) \
+#define __lookup_ip6_remote_endpoint(addr) \
 	ipcache_lookup6(&cilium_ipcache, addr, V6_CACHE_KEY_LEN)
-#define lookup_ip4_remote_endpoint(addr) \
+#define __lookup_ip4_remote_endpoint(addr) \
 	ipcache_lookup4(&cilium_ipcache, addr, V4_CACHE_KEY_LEN)
 #endif /* HAVE_LPM_MAP_TYPE */
+
+#ifndef IPCACHE_CACHE_MAP
+#define lookup_ip6_remote_endpoint __lookup_ip6_remote_endpoint
+#define lookup_ip4_remote_endpoint __lookup_ip4_remote_endpoint
+#else
+
+/**
+ * ipcache_cache_get
+ * @key:	address to look up
+ * @gen:	returns the current ipcache generation
+ *
+ * Returns the cache entry of @key if it was added in the current generation,
+ * NULL otherwise. Entries of other CPUs read as generation 0, which is never
+ * current.
+ */
+static __always_inline struct ipcache_cache_entry *
+ipcache_cache_get(struct endpoint_key *key, __u32 *gen)
+{
+	struct ipcache_cache_entry *entry;
+	__u32 zero = 0, *current;
+
+	current = map_lookup_elem(&cilium_ipcache_gen, &zero);
+	*gen = current ? *current : 0;
+
+	entry = map_lookup_elem(&IPCACHE_CACHE_MAP, key);
+	if (entry && *gen && entry->generation == *gen) {
+		update_metrics(0, METRIC_INTERNAL, METRIC_REASON_IPCACHE_CACHE_HIT);
+		return entry;
+	}
+
+	update_metrics(0, METRIC_INTERNAL, METRIC_REASON_IPCACHE_CACHE_MISS);
+	return NULL;
+}
+
+/**
+ * ipcache_cache_put
+ * @key:	address looked up
+ * @gen:	generation returned by ipcache_cache_get()
+ * @info:	result of the ipcache lookup, NULL if not found
+ *
+ * Caches @info, including a negative result, for @key and returns @info.
+ * The generation must be read before the ipcache lookup so that an entry
+ * never outlives a concurrent update of the ipcache.
+ */
+static __always_inline struct remote_endpoint_info *
+ipcache_cache_put(struct endpoint_key *key, __u32 gen,
+		  struct remote_endpoint_info *info)
+{
+	struct ipcache_cache_entry entry = {
+		.generation = gen,
+	};
+
+	if (!gen)
+		return info;
+
+	if (info) {
+		entry.info = *info;
+		entry.flags = IPCACHE_CACHE_FOUND;
+	}
+
+	map_update_elem(&IPCACHE_CACHE_MAP, key, &entry, 0);
+	return info;
+}
+
+static __always_inline struct remote_endpoint_info *
+lookup_ip6_remote_endpoint(union v6addr *addr)
+{
+	struct endpoint_key key = {
+		.ip6 = *addr,
+		.family = ENDPOINT_KEY_IPV6,
+	};
+	struct ipcache_cache_entry *entry;
+	__u32 gen;
+
+	entry = ipcache_cache_get(&key, &gen);
+	if (entry)
+		return entry->flags & IPCACHE_CACHE_FOUND ? &entry->info : NULL;
+
+	return ipcache_cache_put(&key, gen, __lookup_ip6_remote_endpoint(addr));
+}
+
+static __always_inline struct remote_endpoint_info *
+lookup_ip4_remote_endpoint(__be32 addr)
+{
+	struct endpoint_key key = {
+		.ip4 = addr,
+		.family = ENDPOINT_KEY_IPV4,
+	};
+	struct ipcache_cache_entry *entry;
+	__u32 gen;
+
+	entry = ipcache_cache_get(&key, &gen);
+	if (entry)
+		return entry->flags & IPCACHE_CACHE_FOUND ? &entry->info : NULL;
+
+	return ipcache_cache_put(&key, gen, __lookup_ip4_remote_endpoint(addr));
+}
+#endif /* IPCACHE_CACHE_MAP */
 #endif /* LXC_ID */
 
 #endif /* __LIB_EPS_H_ */
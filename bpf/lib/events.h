@@ -20,6 +20,27 @@
 
 #include <bpf/api.h>
 
+#include "common.h"
+#include "utils.h"
+
+/* EVENTS_RINGBUF_SIZE is set by the agent if a shared ring buffer was
+ * requested, it is only used if the kernel supports it.
+ */
+#if defined(EVENTS_RINGBUF_SIZE) && defined(HAVE_RINGBUF_MAP_TYPE)
+# define EVENTS_RINGBUF
+#endif
+
+#ifdef EVENTS_RINGBUF
+/* A single buffer shared by all CPUs. Records are ordered, so the reader
+ * does not need to merge per-CPU streams, and with the default adaptive
+ * wakeup it is only notified once it has caught up with the producers.
+ */
+struct bpf_elf_map __section_maps cilium_events_rb = {
+	.type		= BPF_MAP_TYPE_RINGBUF,
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= EVENTS_RINGBUF_SIZE,
+};
+#else
 struct bpf_elf_map __section_maps cilium_events = {
 	.type		= BPF_MAP_TYPE_PERF_EVENT_ARRAY,
 	.size_key	= sizeof(__u32),
@@ -27,5 +48,91 @@ struct bpf_elf_map __section_maps cilium_events = {
 	.pinning	= PIN_GLOBAL_NS,
 	.max_elem	= __NR_CPUS__,
 };
+#endif
+
+/**
+ * send_event
+ * @skb:	socket buffer
+ * @msg:	notification starting with NOTIFY_COMMON_HDR
+ * @msg_len:	size of @msg, must be a compile time constant
+ * @cap_len:	number of packet bytes to append, at most TRACE_PAYLOAD_LEN
+ *
+ * With the ring buffer, records carrying packet data are always reserved
+ * with room for TRACE_PAYLOAD_LEN bytes as the size of a reservation must
+ * be known to the verifier. Readers must rely on the capture length in
+ * the notification rather than on the record size.
+ */
+static __always_inline void
+send_event(struct __sk_buff *skb, const void *msg, __u32 msg_len, __u64 cap_len)
+{
+#ifdef EVENTS_RINGBUF
+	__u8 *rec;
+
+	if (!cap_len) {
+		rec = ringbuf_reserve(&cilium_events_rb, msg_len, 0);
+		if (!rec)
+			return;
+		memcpy(rec, msg, msg_len);
+		ringbuf_submit(rec, 0);
+		return;
+	}
+
+	rec = ringbuf_reserve(&cilium_events_rb, msg_len + TRACE_PAYLOAD_LEN, 0);
+	if (!rec)
+		return;
+	memcpy(rec, msg, msg_len);
+	if (cap_len > TRACE_PAYLOAD_LEN)
+		cap_len = TRACE_PAYLOAD_LEN;
+	if (skb_load_bytes(skb, 0, rec + msg_len, cap_len) < 0) {
+		ringbuf_discard(rec, 0);
+		return;
+	}
+	ringbuf_submit(rec, 0);
+#else
+	skb_event_output(skb, &cilium_events, (cap_len << 32) | BPF_F_CURRENT_CPU,
+			 msg, msg_len);
+#endif
+}
+
+/* XDP_EVENT_CAP_LEN returns the capture length to pass to send_xdp_event()
+ * for a packet of length len. It is rounded down to 8 bytes so that the
+ * ring buffer path can copy the payload in words.
+ */
+#define XDP_EVENT_CAP_LEN(len)	(min((__u64)TRACE_PAYLOAD_LEN, (__u64)(len)) & ~7ULL)
+
+/**
+ * send_xdp_event
+ * @xdp:	XDP context
+ * @msg:	notification starting with NOTIFY_COMMON_HDR
+ * @msg_len:	size of @msg, must be a compile time constant
+ * @cap_len:	number of packet bytes to append, see XDP_EVENT_CAP_LEN()
+ */
+static __always_inline void
+send_xdp_event(struct xdp_md *xdp, const void *msg, __u32 msg_len, __u64 cap_len)
+{
+#ifdef EVENTS_RINGBUF
+	void *data_end = (void *)(long) xdp->data_end;
+	__u64 *data = (void *)(long) xdp->data;
+	__u8 *rec;
+	int i;
+
+	rec = ringbuf_reserve(&cilium_events_rb, msg_len + TRACE_PAYLOAD_LEN, 0);
+	if (!rec)
+		return;
+	memcpy(rec, msg, msg_len);
+
+#pragma unroll
+	for (i = 0; i < TRACE_PAYLOAD_LEN / sizeof(__u64); i++) {
+		if (i * sizeof(__u64) >= cap_len ||
+		    (void *) (data + i + 1) > data_end)
+			break;
+		*((__u64 *) (rec + msg_len) + i) = data[i];
+	}
+	ringbuf_submit(rec, 0);
+#else
+	xdp_event_output(xdp, &cilium_events, (cap_len << 32) | BPF_F_CURRENT_CPU,
+			 msg, msg_len);
+#endif
+}
 
 #endif
@@ -22,6 +22,9 @@
 
 #include "dbg.h"
 
+#define IPV4_FRAG_OFFSET	0x1FFF
+#define IPV4_MORE_FRAGMENTS	0x2000
+
 static inline int ipv4_load_daddr(struct __sk_buff *skb, int off, __u32 *dst)
 {
 	return skb_load_bytes(skb, off + offsetof(struct iphdr, daddr), dst, 4);
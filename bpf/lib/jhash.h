@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Jenkins hash, as in <linux/jhash.h>
+ */
+
+#ifndef __LIB_JHASH_H_
+#define __LIB_JHASH_H_
+
+#include <linux/type_mapper.h>
+
+#define JHASH_INITVAL	0xdeadbeef
+
+static __always_inline __u32 rol32(__u32 word, unsigned int shift)
+{
+	return (word << shift) | (word >> ((-shift) & 31));
+}
+
+#define __jhash_mix(a, b, c)			\
+{						\
+	a -= c;  a ^= rol32(c, 4);  c += b;	\
+	b -= a;  b ^= rol32(a, 6);  a += c;	\
+	c -= b;  c ^= rol32(b, 8);  b += a;	\
+	a -= c;  a ^= rol32(c, 16); c += b;	\
+	b -= a;  b ^= rol32(a, 19); a += c;	\
+	c -= b;  c ^= rol32(b, 4);  b += a;	\
+}
+
+#define __jhash_final(a, b, c)			\
+{						\
+	c ^= b; c -= rol32(b, 14);		\
+	a ^= c; a -= rol32(c, 11);		\
+	b ^= a; b -= rol32(a, 25);		\
+	c ^= b; c -= rol32(b, 16);		\
+	a ^= c; a -= rol32(c, 4);		\
+	b ^= a; b -= rol32(a, 14);		\
+	c ^= b; c -= rol32(b, 24);		\
+}
+
+/* Hashes an array of 32 bit words, @length must be a compile time
+ * constant so that the loop can be unrolled.
+ */
+static __always_inline __u32 jhash2(const __u32 *k, const __u32 length,
+				    __u32 initval)
+{
+	__u32 a, b, c, i;
+
+	a = b = c = JHASH_INITVAL + (length << 2) + initval;
+
+#pragma unroll
+	for (i = 0; i + 3 < length; i += 3) {
+		a += k[i];
+		b += k[i + 1];
+		c += k[i + 2];
+		__jhash_mix(a, b, c);
+	}
+
+	switch (length - i) {
+	case 3: c += k[i + 2];
+	case 2: b += k[i + 1];
+	case 1: a += k[i];
+		__jhash_final(a, b, c);
+	case 0:
+		break;
+	}
+
+	return c;
+}
+
+#endif /* __LIB_JHASH_H_ */
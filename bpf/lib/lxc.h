@@ -28,6 +28,15 @@
 #include "csum.h"
 #include "l4.h"
 
+#include <linux/if_packet.h>
+
+/* Assigning packets to sockets requires kernel support, packets are
+ * redirected to proxies by translating their destination otherwise.
+ */
+#if defined(ENABLE_PROXY_SK_ASSIGN) && !defined(HAVE_SK_ASSIGN)
+#undef ENABLE_PROXY_SK_ASSIGN
+#endif
+
 #ifndef DISABLE_SMAC_VERIFICATION
 static inline int is_valid_lxc_src_mac(struct ethhdr *eth)
 {
@@ -190,16 +199,156 @@ ipv6_redirect_to_host_port(struct __sk_buff *skb, struct csum_offset *csum,
 	return 0;
 }
 
+#ifdef ENABLE_PROXY_SK_ASSIGN
+/**
+ * proxy_sk_assign
+ * @skb:	packet to assign
+ * @tuple:	socket tuple to look up
+ * @size:	size of the IPv4 or IPv6 part of @tuple
+ * @listener:	true if the socket must be a listener
+ *
+ * Assigns the packet to the TCP socket matching @tuple. Returns 0 on
+ * success or DROP_PROXY_SOCKET if no suitable socket was found.
+ */
+static inline int __inline__
+proxy_sk_assign(struct __sk_buff *skb, struct bpf_sock_tuple *tuple,
+		__u32 size, bool listener)
+{
+	struct bpf_sock *sk;
+	int ret;
+
+	sk = sk_lookup_tcp(skb, tuple, size, BPF_F_CURRENT_NETNS, 0);
+	if (!sk)
+		return DROP_PROXY_SOCKET;
+
+	if ((sk->state == BPF_TCP_LISTEN) != listener) {
+		sk_release(sk);
+		return DROP_PROXY_SOCKET;
+	}
+
+	ret = sk_assign(skb, sk, 0);
+	sk_release(sk);
+
+	return ret ? DROP_PROXY_SOCKET : 0;
+}
+
+/**
+ * proxy_assign_finish
+ *
+ * Marks a packet assigned to a proxy socket with the source identity and
+ * makes sure it is delivered locally when passed up the stack. The mark
+ * selects a routing table with a local default route, see init.sh.
+ */
+static inline int __inline__
+proxy_assign_finish(struct __sk_buff *skb, __be16 proxy_port, __u32 identity,
+		    int forwarding_reason, bool monitor)
+{
+	set_identity_to_proxy(skb, identity);
+
+	if (skb->pkt_type != PACKET_HOST &&
+	    skb_change_type(skb, PACKET_HOST) < 0)
+		return DROP_WRITE_ERROR;
+
+	send_trace_notify(skb, TRACE_TO_PROXY, SECLABEL, 0, 0, HOST_IFINDEX,
+			  forwarding_reason, monitor);
+	cilium_dbg_capture(skb, DBG_CAPTURE_PROXY_POST, proxy_port);
+
+	return TC_ACT_OK;
+}
+
+#ifdef LXC_IPV4
+/**
+ * ipv4_redirect_to_proxy_sk
+ *
+ * Redirects a packet to the proxy listening on @proxy_port without
+ * translating its destination. Packets of connections already accepted
+ * by the proxy are assigned to the accepted socket, which is found by the
+ * original tuple. Returns TC_ACT_OK if the packet must be passed to the
+ * stack or a negative drop reason.
+ *
+ * DROP_PROXY_SOCKET is returned if the packet cannot be assigned, e.g.
+ * for protocols other than TCP or when the program runs at egress of
+ * cilium_host. Callers fall back to ipv4_redirect_to_host_port() then.
+ */
+static inline int __inline__
+ipv4_redirect_to_proxy_sk(struct __sk_buff *skb, __be16 proxy_port,
+			  __be16 orig_dport, __be32 orig_daddr,
+			  struct ipv4_ct_tuple *tuple, __u32 identity,
+			  int forwarding_reason, bool monitor)
+{
+	struct bpf_sock_tuple sk_tuple = {};
+	int ret;
+
+	if (tuple->nexthdr != IPPROTO_TCP)
+		return DROP_PROXY_SOCKET;
+
+	/* The address of the client is stored in daddr of the tuple, the
+	 * same as for the proxy map key in ipv4_redirect_to_host_port().
+	 */
+	sk_tuple.ipv4.saddr = tuple->daddr;
+	sk_tuple.ipv4.sport = tuple->sport;
+	sk_tuple.ipv4.daddr = orig_daddr;
+	sk_tuple.ipv4.dport = orig_dport;
+
+	ret = proxy_sk_assign(skb, &sk_tuple, sizeof(sk_tuple.ipv4), false);
+	if (ret < 0) {
+		sk_tuple.ipv4.daddr = 0;
+		sk_tuple.ipv4.dport = proxy_port;
+		ret = proxy_sk_assign(skb, &sk_tuple, sizeof(sk_tuple.ipv4), true);
+		if (ret < 0)
+			return ret;
+	}
+
+	return proxy_assign_finish(skb, proxy_port, identity,
+				   forwarding_reason, monitor);
+}
+#endif /* LXC_IPV4 */
+
+/**
+ * ipv6_redirect_to_proxy_sk
+ *
+ * IPv6 version of ipv4_redirect_to_proxy_sk()
+ */
+static inline int __inline__
+ipv6_redirect_to_proxy_sk(struct __sk_buff *skb, __be16 proxy_port,
+			  __be16 orig_dport, union v6addr *orig_daddr,
+			  struct ipv6_ct_tuple *tuple, __u32 identity,
+			  int forwarding_reason, bool monitor)
+{
+	struct bpf_sock_tuple sk_tuple = {};
+	int ret;
+
+	if (tuple->nexthdr != IPPROTO_TCP)
+		return DROP_PROXY_SOCKET;
+
+	ipv6_addr_copy((union v6addr *) sk_tuple.ipv6.saddr, &tuple->daddr);
+	ipv6_addr_copy((union v6addr *) sk_tuple.ipv6.daddr, orig_daddr);
+	sk_tuple.ipv6.sport = tuple->sport;
+	sk_tuple.ipv6.dport = orig_dport;
+
+	ret = proxy_sk_assign(skb, &sk_tuple, sizeof(sk_tuple.ipv6), false);
+	if (ret < 0) {
+		memset(sk_tuple.ipv6.daddr, 0, sizeof(sk_tuple.ipv6.daddr));
+		sk_tuple.ipv6.dport = proxy_port;
+		ret = proxy_sk_assign(skb, &sk_tuple, sizeof(sk_tuple.ipv6), true);
+		if (ret < 0)
+			return ret;
+	}
+
+	return proxy_assign_finish(skb, proxy_port, identity,
+				   forwarding_reason, monitor);
+}
+#endif /* ENABLE_PROXY_SK_ASSIGN */
+
 /**
  * tc_index_is_from_proxy - returns true if packet originates from egress proxy
  */
 static inline bool __inline__ tc_index_skip_proxy(struct __sk_buff *skb)
 {
 	volatile __u32 tc_index = skb->tc_index;
-#ifdef DEBUG
+
 	if (tc_index & TC_INDEX_F_SKIP_PROXY)
 		cilium_dbg(skb, DBG_SKIP_PROXY, tc_index, 0);
-#endif
 
 	return tc_index & TC_INDEX_F_SKIP_PROXY;
 }
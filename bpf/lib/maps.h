@@ -40,6 +40,19 @@ struct bpf_elf_map __section_maps cilium_metrics = {
 	.max_elem	= METRICS_MAP_SIZE,
 };
 
+/* Per endpoint and remote identity metrics, see <bpf/lib/metrics.h> */
+#if defined(ENDPOINT_METRICS) && defined(HAVE_LRU_MAP_TYPE) && defined(LXC_ID)
+#define EP_METRICS
+
+struct bpf_elf_map __section_maps cilium_ep_metrics = {
+	.type		= BPF_MAP_TYPE_LRU_PERCPU_HASH,
+	.size_key	= sizeof(struct ep_metrics_key),
+	.size_value	= sizeof(struct metrics_value),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= EP_METRICS_MAP_SIZE,
+};
+#endif
+
 /* Global map to jump into policy enforcement of receiving endpoint */
 struct bpf_elf_map __section_maps cilium_policy = {
 	.type		= BPF_MAP_TYPE_PROG_ARRAY,
@@ -53,7 +66,13 @@ struct bpf_elf_map __section_maps cilium_policy = {
 /* Per-endpoint policy enforcement map */
 #ifdef POLICY_MAP
 struct bpf_elf_map __section_maps POLICY_MAP = {
+#ifdef POLICY_LPM
+	.type		= BPF_MAP_TYPE_LPM_TRIE,
+	.flags		= BPF_F_NO_PREALLOC,
+#else
 	.type		= BPF_MAP_TYPE_HASH,
+	.flags		= CONDITIONAL_PREALLOC,
+#endif
 	.size_key	= sizeof(struct policy_key),
 	.size_value	= sizeof(struct policy_entry),
 	.pinning	= PIN_GLOBAL_NS,
@@ -157,6 +176,55 @@ struct bpf_elf_map __section_maps cilium_ipcache = {
 	.flags		= BPF_F_NO_PREALLOC,
 };
 
+#if ((defined(IPCACHE_CACHE) && defined(HAVE_LRU_MAP_TYPE)) || \
+     defined(CT_POLICY_CACHE)) && defined(LXC_ID)
+/* Generation of the ipcache, bumped by the agent on every change */
+struct bpf_elf_map __section_maps cilium_ipcache_gen = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(__u32),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= 1,
+};
+#endif
+
+#if defined(CT_POLICY_CACHE) && defined(LXC_ID)
+/* Policy revision of each endpoint, indexed by endpoint ID. Written by the
+ * agent once the policy map of the endpoint is in sync with the revision. */
+struct bpf_elf_map __section_maps cilium_ep_policy_rev = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(__u32),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= EP_POLICY_REV_MAP_SIZE,
+};
+#endif
+
+#ifdef ENABLE_BANDWIDTH_MANAGER
+/* Egress bandwidth limit of each endpoint, keyed by endpoint ID. Written
+ * by the agent, except for the departure time of the last packet. */
+struct bpf_elf_map __section_maps cilium_throttle = {
+	.type		= BPF_MAP_TYPE_HASH,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct edt_info),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= THROTTLE_MAP_SIZE,
+};
+#endif
+
+#if defined(IPCACHE_CACHE) && defined(HAVE_LRU_MAP_TYPE) && defined(LXC_ID)
+#define IPCACHE_CACHE_MAP cilium_ipcache_cache
+
+/* Per-CPU cache of exact addresses in front of cilium_ipcache */
+struct bpf_elf_map __section_maps IPCACHE_CACHE_MAP = {
+	.type		= BPF_MAP_TYPE_LRU_PERCPU_HASH,
+	.size_key	= sizeof(struct endpoint_key),
+	.size_value	= sizeof(struct ipcache_cache_entry),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= IPCACHE_CACHE_SIZE,
+};
+#endif
+
 #ifndef SKIP_CALLS_MAP
 static __always_inline void ep_tail_call(struct __sk_buff *skb, uint32_t index)
 {
@@ -59,4 +59,51 @@ static inline void update_metrics(__u32 bytes, __u8 direction, __u8 reason)
     }
 }
 
+#ifdef EP_METRICS
+/**
+ * update_ep_metrics
+ * @direction:	1: Ingress 2: Egress
+ * @reason:	0 if forwarded, else the drop error code
+ * @remote:	security identity of the peer
+ *
+ * Update the metrics of the endpoint for traffic with @remote. The agent
+ * creates the entries of a limited number of identities when regenerating
+ * the endpoint, all other traffic is accounted to identity 0. Only the
+ * latter entries are created here if missing, e.g. after LRU eviction.
+ */
+static inline void update_ep_metrics(__u32 bytes, __u8 direction, __u8 reason,
+				     __u32 remote)
+{
+	struct ep_metrics_key key = {
+		.identity = remote,
+		.ep_id = LXC_ID,
+		.reason = reason,
+		.dir = direction,
+	};
+	struct metrics_value *entry;
+
+	entry = map_lookup_elem(&cilium_ep_metrics, &key);
+	if (!entry) {
+		key.identity = 0;
+		entry = map_lookup_elem(&cilium_ep_metrics, &key);
+	}
+	if (entry) {
+		entry->count += 1;
+		entry->bytes += (__u64)bytes;
+	} else {
+		struct metrics_value new_entry = {
+			.count = 1,
+			.bytes = (__u64)bytes,
+		};
+
+		map_update_elem(&cilium_ep_metrics, &key, &new_entry, 0);
+	}
+}
+#else
+static inline void update_ep_metrics(__u32 bytes, __u8 direction, __u8 reason,
+				     __u32 remote)
+{
+}
+#endif
+
 #endif /* __LIB_METRICS__ */
@@ -0,0 +1,495 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Masquerading of endpoint traffic leaving the node on the native device
+ *
+ * TCP and UDP flows from local endpoints to destinations outside of
+ * SNAT_IPV4_EXCLUDE_DST_CIDR are translated to SNAT_IPV4_EXTERNAL and a
+ * port from the SNAT port range on egress of the native device. Every flow
+ * is represented by two entries in cilium_snat_v4_external, keyed by the
+ * same tuple layout as the conntrack table: the original tuple maps to the
+ * translated source and the reply tuple maps back to the endpoint. Replies
+ * are translated on ingress of the native device before the endpoint
+ * lookup, so they are delivered to the endpoint without passing the stack.
+ *
+ * The port range is split into one partition per CPU. Each CPU starts its
+ * search in its own partition, so concurrent allocations on different CPUs
+ * do not collide on the same candidate ports. A port only needs to be
+ * unique per remote address and port, the insertion of the reply tuple
+ * with BPF_NOEXIST is what reserves it.
+ *
+ * Fragments after the first carry no L4 header. The ports of a fragmented
+ * datagram are recorded from its first fragment in cilium_snat_v4_frags,
+ * keyed by addresses, protocol and IP ID, and the following fragments are
+ * translated with them. Fragments which arrive ahead of the first one
+ * cannot be translated.
+ */
+
+#ifndef __LIB_NAT_H_
+#define __LIB_NAT_H_
+
+#include <linux/ip.h>
+#include <linux/tcp.h>
+
+#include "common.h"
+#include "conntrack.h"
+#include "csum.h"
+#include "l4.h"
+#include "utils.h"
+
+#if defined(ENABLE_MASQUERADE) && defined(ENABLE_IPV4)
+
+/* The default range lies above the default ip_local_port_range of Linux
+ * (32768-60999), so translated flows do not collide with connections of
+ * the node itself.
+ */
+#ifndef SNAT_PORT_MIN
+#define SNAT_PORT_MIN		61000
+#endif
+#ifndef SNAT_PORT_MAX
+#define SNAT_PORT_MAX		65535
+#endif
+#define SNAT_PORT_RANGE		(SNAT_PORT_MAX - SNAT_PORT_MIN + 1)
+#define SNAT_PORTS_PER_CPU	(SNAT_PORT_RANGE / __NR_CPUS__)
+#define SNAT_COLLISION_RETRIES	16
+
+#define NAT_DIR_EGRESS		0
+#define NAT_DIR_INGRESS		1
+
+struct ipv4_nat_entry {
+	__be32 to_addr;
+	__be16 to_port;
+	__u16 pad1;
+	__u32 lifetime;	/* expiry in bpf_ktime_get_sec() */
+	__u32 pad2;
+};
+
+struct snat_port_cursor {
+	__u32 next;
+};
+
+struct ipv4_frag_id {
+	__be32 daddr;
+	__be32 saddr;
+	__be16 id;
+	__u8 proto;
+	__u8 pad;
+};
+
+struct ipv4_frag_l4ports {
+	__be16 sport;
+	__be16 dport;
+};
+
+struct bpf_elf_map __section_maps cilium_snat_v4_external = {
+#ifdef HAVE_LRU_MAP_TYPE
+	.type		= BPF_MAP_TYPE_LRU_HASH,
+#else
+	.type		= BPF_MAP_TYPE_HASH,
+#endif
+	.size_key	= sizeof(struct ipv4_ct_tuple),
+	.size_value	= sizeof(struct ipv4_nat_entry),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= SNAT_MAPPING_MAP_SIZE,
+};
+
+/* Ports of fragmented datagrams, recorded from their first fragment */
+struct bpf_elf_map __section_maps cilium_snat_v4_frags = {
+#ifdef HAVE_LRU_MAP_TYPE
+	.type		= BPF_MAP_TYPE_LRU_HASH,
+#else
+	.type		= BPF_MAP_TYPE_HASH,
+#endif
+	.size_key	= sizeof(struct ipv4_frag_id),
+	.size_value	= sizeof(struct ipv4_frag_l4ports),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= SNAT_FRAG_MAP_SIZE,
+};
+
+/* Position of the port search of each CPU */
+struct bpf_elf_map __section_maps cilium_snat_v4_ports = {
+	.type		= BPF_MAP_TYPE_PERCPU_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct snat_port_cursor),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= 1,
+};
+
+static __always_inline bool snat_v4_needed(const struct iphdr *ip4)
+{
+	return (ip4->saddr & IPV4_MASK) == (IPV4_GATEWAY & IPV4_MASK) &&
+	       (ip4->daddr & SNAT_IPV4_EXCLUDE_DST_MASK) != SNAT_IPV4_EXCLUDE_DST_CIDR;
+}
+
+/* Returns the lifetime of a mapping seeing a packet with the TCP flag word
+ * @flags, which is 0 for UDP.
+ */
+static __always_inline __u32 snat_v4_lifetime(__u8 nexthdr, __be32 flags)
+{
+	if (nexthdr != IPPROTO_TCP)
+		return CT_LIFETIME_NONTCP;
+	if (flags & (TCP_FLAG_FIN | TCP_FLAG_RST))
+		return CT_CLOSE_TIMEOUT;
+	if (flags & TCP_FLAG_SYN)
+		return CT_SYN_TIMEOUT;
+	return CT_LIFETIME_TCP;
+}
+
+/* Refreshes the lifetime of both entries of a flow under the same rules as
+ * conntrack entries, i.e. at most once per CT_LIFETIME_SLACK seconds unless
+ * the lifetime gets shortened. As CT_LIFETIME_SLACK is at most half of
+ * CT_CLOSE_TIMEOUT, retransmits after a FIN or RST still extend the lifetime
+ * of a closing flow. @other is the tuple of the opposite direction.
+ */
+static __always_inline void snat_v4_refresh(struct ipv4_nat_entry *entry,
+					    const struct ipv4_ct_tuple *other,
+					    __u32 lifetime)
+{
+	__u32 now = bpf_ktime_get_sec();
+	__s32 behind = (__s32) (now + lifetime - entry->lifetime);
+	struct ipv4_nat_entry *rev;
+
+	if (behind >= 0 && behind <= CT_LIFETIME_SLACK)
+		return;
+
+	entry->lifetime = now + lifetime;
+	rev = map_lookup_elem(&cilium_snat_v4_external, other);
+	if (rev)
+		rev->lifetime = now + lifetime;
+}
+
+/* Reserves a port for the flow @otuple by inserting its reply tuple. On
+ * success, @rtuple holds the reply tuple with the allocated port. Ports of
+ * expired mappings which were not collected yet are taken over.
+ */
+static __always_inline int snat_v4_alloc(const struct ipv4_ct_tuple *otuple,
+					 struct ipv4_ct_tuple *rtuple,
+					 __u32 lifetime)
+{
+	__u32 now = bpf_ktime_get_sec(), key = 0, base, i;
+	struct ipv4_nat_entry rev = {}, *old;
+	struct snat_port_cursor *cursor;
+
+	cursor = map_lookup_elem(&cilium_snat_v4_ports, &key);
+	if (!cursor)
+		return DROP_NAT_NO_MAPPING;
+
+	rev.to_addr = otuple->saddr;
+	rev.to_port = otuple->sport;
+	rev.lifetime = now + lifetime;
+
+	rtuple->daddr = SNAT_IPV4_EXTERNAL;
+	rtuple->saddr = otuple->daddr;
+	rtuple->sport = otuple->dport;
+	rtuple->nexthdr = otuple->nexthdr;
+	rtuple->flags = NAT_DIR_INGRESS;
+
+	base = (get_smp_processor_id() % __NR_CPUS__) * SNAT_PORTS_PER_CPU;
+
+#pragma unroll
+	for (i = 0; i < SNAT_COLLISION_RETRIES; i++) {
+		rtuple->dport = bpf_htons(SNAT_PORT_MIN +
+					  (base + cursor->next++) % SNAT_PORT_RANGE);
+		if (map_update_elem(&cilium_snat_v4_external, rtuple, &rev,
+				    BPF_NOEXIST) == 0)
+			return 0;
+
+		old = map_lookup_elem(&cilium_snat_v4_external, rtuple);
+		if (old && (__s32) (old->lifetime - now) < 0) {
+			map_update_elem(&cilium_snat_v4_external, rtuple, &rev, 0);
+			return 0;
+		}
+	}
+
+	return DROP_NAT_NO_MAPPING;
+}
+
+/* Returns the forward entry of the flow @otuple if it is still in use by
+ * the flow, i.e. it did not expire and its reply tuple, stored in @rtuple,
+ * was not taken over by another flow in the meantime.
+ */
+static __always_inline struct ipv4_nat_entry *
+snat_v4_lookup_egress(const struct ipv4_ct_tuple *otuple,
+		      struct ipv4_ct_tuple *rtuple)
+{
+	__u32 now = bpf_ktime_get_sec();
+	struct ipv4_nat_entry *entry, *rev;
+
+	entry = map_lookup_elem(&cilium_snat_v4_external, otuple);
+	if (!entry || (__s32) (entry->lifetime - now) < 0)
+		return NULL;
+
+	rtuple->daddr = entry->to_addr;
+	rtuple->saddr = otuple->daddr;
+	rtuple->dport = entry->to_port;
+	rtuple->sport = otuple->dport;
+	rtuple->nexthdr = otuple->nexthdr;
+	rtuple->flags = NAT_DIR_INGRESS;
+
+	rev = map_lookup_elem(&cilium_snat_v4_external, rtuple);
+	if (!rev || rev->to_addr != otuple->saddr ||
+	    rev->to_port != otuple->sport)
+		return NULL;
+
+	return entry;
+}
+
+/* Rewrites the address at @addr_off and, unless @has_l4 is false for
+ * fragments after the first, the port at @port_off of the L4 header. The L4
+ * checksum covering the address is part of the first fragment.
+ */
+static __always_inline int snat_v4_rewrite(struct __sk_buff *skb, int l4_off,
+					   int addr_off, int port_off,
+					   __be32 old_addr, __be32 new_addr,
+					   __be16 old_port, __be16 new_port,
+					   __u8 nexthdr, bool has_l4)
+{
+	struct csum_offset csum = {};
+	__be32 sum;
+	int ret;
+
+	if (skb_store_bytes(skb, ETH_HLEN + addr_off, &new_addr, 4, 0) < 0)
+		return DROP_WRITE_ERROR;
+
+	sum = csum_diff(&old_addr, 4, &new_addr, 4, 0);
+	if (l3_csum_replace(skb, ETH_HLEN + offsetof(struct iphdr, check), 0, sum, 0) < 0)
+		return DROP_CSUM_L3;
+
+	if (!has_l4)
+		return 0;
+
+	csum_l4_offset_and_flags(nexthdr, &csum);
+	if (csum_l4_replace(skb, l4_off, &csum, 0, sum, BPF_F_PSEUDO_HDR) < 0)
+		return DROP_CSUM_L4;
+
+	if (old_port != new_port) {
+		ret = l4_modify_port(skb, l4_off, port_off, &csum, new_port, old_port);
+		if (IS_ERR(ret))
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Loads ports and, for TCP, the flag word of the segment at @l4_off. The
+ * ports of fragments after the first are looked up in cilium_snat_v4_frags,
+ * their flag word is 0 and *has_l4 is cleared.
+ *
+ * Returns 0, DROP_FRAG_NOT_FOUND if the first fragment was not seen or
+ * another negative DROP_* reason.
+ */
+static __always_inline int snat_v4_load_l4(struct __sk_buff *skb, int l4_off,
+					   const struct iphdr *ip4,
+					   __be16 ports[2], __be32 *flags,
+					   bool *has_l4)
+{
+	struct ipv4_frag_id frag_id = {
+		.daddr = ip4->daddr,
+		.saddr = ip4->saddr,
+		.id = ip4->id,
+		.proto = ip4->protocol,
+	};
+	bool more_frags = ip4->frag_off & bpf_htons(IPV4_MORE_FRAGMENTS);
+	struct ipv4_frag_l4ports *frag, frag_ports;
+
+	*flags = 0;
+	*has_l4 = !(ip4->frag_off & bpf_htons(IPV4_FRAG_OFFSET));
+	if (!*has_l4) {
+		frag = map_lookup_elem(&cilium_snat_v4_frags, &frag_id);
+		if (!frag)
+			return DROP_FRAG_NOT_FOUND;
+		ports[0] = frag->sport;
+		ports[1] = frag->dport;
+#ifndef HAVE_LRU_MAP_TYPE
+		/* Without LRU eviction, entries are removed with the last
+		 * fragment. Fragments reordered behind it are dropped. */
+		if (!more_frags)
+			map_delete_elem(&cilium_snat_v4_frags, &frag_id);
+#endif
+		return 0;
+	}
+
+	if (skb_load_bytes(skb, l4_off, ports, 4) < 0)
+		return DROP_INVALID;
+
+	if (frag_id.proto == IPPROTO_TCP &&
+	    skb_load_bytes(skb, l4_off + 12, flags, 4) < 0)
+		return DROP_INVALID;
+
+	if (more_frags) {
+		frag_ports.sport = ports[0];
+		frag_ports.dport = ports[1];
+		if (map_update_elem(&cilium_snat_v4_frags, &frag_id,
+				    &frag_ports, 0) < 0)
+			return DROP_FRAG_NOT_FOUND;
+	}
+
+	return 0;
+}
+
+/**
+ * snat_v4_egress
+ * @skb:	packet about to leave the native device
+ *
+ * Translates the source of TCP and UDP packets of local endpoints, creating
+ * the mapping on the first packet of a flow. Fragments after the first are
+ * translated with the mapping of their first fragment and dropped if it
+ * was not seen.
+ *
+ * Returns TC_ACT_OK or a negative DROP_* reason.
+ */
+static __always_inline int snat_v4_egress(struct __sk_buff *skb)
+{
+	struct ipv4_ct_tuple otuple = {}, rtuple = {};
+	struct ipv4_nat_entry *entry, fwd = {};
+	void *data, *data_end;
+	struct iphdr *ip4;
+	__be16 ports[2];
+	__u32 lifetime;
+	__be32 flags;
+	int l4_off, ret;
+	bool has_l4;
+
+	if (!revalidate_data(skb, &data, &data_end, &ip4))
+		return DROP_INVALID;
+
+	if (ip4->protocol != IPPROTO_TCP && ip4->protocol != IPPROTO_UDP)
+		return TC_ACT_OK;
+	if (!snat_v4_needed(ip4))
+		return TC_ACT_OK;
+
+	l4_off = ETH_HLEN + ipv4_hdrlen(ip4);
+	otuple.daddr = ip4->daddr;
+	otuple.saddr = ip4->saddr;
+	otuple.nexthdr = ip4->protocol;
+	otuple.flags = NAT_DIR_EGRESS;
+
+	ret = snat_v4_load_l4(skb, l4_off, ip4, ports, &flags, &has_l4);
+	if (ret < 0)
+		return ret;
+	otuple.sport = ports[0];
+	otuple.dport = ports[1];
+	lifetime = snat_v4_lifetime(otuple.nexthdr, flags);
+
+	/* Expired mappings and mappings whose port was taken over by another
+	 * flow are replaced. Fragments after the first only use the mapping
+	 * created by the first one. */
+	entry = snat_v4_lookup_egress(&otuple, &rtuple);
+	if (entry) {
+		if (has_l4)
+			snat_v4_refresh(entry, &rtuple, lifetime);
+		fwd = *entry;
+	} else if (!has_l4) {
+		return DROP_NAT_NO_MAPPING;
+	} else {
+		ret = snat_v4_alloc(&otuple, &rtuple, lifetime);
+		if (ret < 0)
+			return ret;
+
+		fwd.to_addr = rtuple.daddr;
+		fwd.to_port = rtuple.dport;
+		fwd.lifetime = bpf_ktime_get_sec() + lifetime;
+		if (map_update_elem(&cilium_snat_v4_external, &otuple, &fwd, 0) < 0) {
+			map_delete_elem(&cilium_snat_v4_external, &rtuple);
+			return DROP_NAT_NO_MAPPING;
+		}
+	}
+
+	ret = snat_v4_rewrite(skb, l4_off, offsetof(struct iphdr, saddr),
+			      TCP_SPORT_OFF, otuple.saddr, fwd.to_addr,
+			      otuple.sport, fwd.to_port, otuple.nexthdr, has_l4);
+	if (ret < 0)
+		return ret;
+
+	return TC_ACT_OK;
+}
+
+/**
+ * snat_v4_ingress
+ * @skb:	packet received on the native device
+ *
+ * Translates replies of masqueraded flows back to the endpoint. Packets
+ * without a valid mapping and fragments ahead of their first fragment are
+ * left untouched.
+ *
+ * Returns TC_ACT_OK or a negative DROP_* reason. The packet must be
+ * revalidated afterwards.
+ */
+static __always_inline int snat_v4_ingress(struct __sk_buff *skb)
+{
+	struct ipv4_ct_tuple rtuple = {}, otuple = {};
+	struct ipv4_nat_entry *entry, rev;
+	void *data, *data_end;
+	struct iphdr *ip4;
+	__be16 ports[2];
+	__be32 flags;
+	int l4_off, ret;
+	bool has_l4;
+
+	if (!revalidate_data(skb, &data, &data_end, &ip4))
+		return DROP_INVALID;
+
+	if (ip4->daddr != SNAT_IPV4_EXTERNAL ||
+	    (ip4->protocol != IPPROTO_TCP && ip4->protocol != IPPROTO_UDP))
+		return TC_ACT_OK;
+
+	l4_off = ETH_HLEN + ipv4_hdrlen(ip4);
+	rtuple.daddr = ip4->daddr;
+	rtuple.saddr = ip4->saddr;
+	rtuple.nexthdr = ip4->protocol;
+	rtuple.flags = NAT_DIR_INGRESS;
+
+	ret = snat_v4_load_l4(skb, l4_off, ip4, ports, &flags, &has_l4);
+	if (ret == DROP_FRAG_NOT_FOUND)
+		return TC_ACT_OK;
+	if (ret < 0)
+		return ret;
+	rtuple.sport = ports[0];
+	rtuple.dport = ports[1];
+
+	entry = map_lookup_elem(&cilium_snat_v4_external, &rtuple);
+	if (!entry || (__s32) (entry->lifetime - bpf_ktime_get_sec()) < 0)
+		return TC_ACT_OK;
+
+	otuple.daddr = rtuple.saddr;
+	otuple.saddr = entry->to_addr;
+	otuple.dport = rtuple.sport;
+	otuple.sport = entry->to_port;
+	otuple.nexthdr = rtuple.nexthdr;
+	otuple.flags = NAT_DIR_EGRESS;
+	if (has_l4)
+		snat_v4_refresh(entry, &otuple, snat_v4_lifetime(rtuple.nexthdr, flags));
+	rev = *entry;
+
+	return snat_v4_rewrite(skb, l4_off, offsetof(struct iphdr, daddr),
+			       TCP_DPORT_OFF, rtuple.daddr, rev.to_addr,
+			       rtuple.dport, rev.to_port, rtuple.nexthdr, has_l4);
+}
+#else
+static __always_inline int snat_v4_egress(struct __sk_buff *skb)
+{
+	return TC_ACT_OK;
+}
+
+static __always_inline int snat_v4_ingress(struct __sk_buff *skb)
+{
+	return TC_ACT_OK;
+}
+#endif /* ENABLE_MASQUERADE && ENABLE_IPV4 */
+
+#endif /* __LIB_NAT_H_ */
@@ -48,6 +48,61 @@ static inline bool identity_is_reserved(__u32 identity)
 	return identity < HEALTH_ID;
 }
 
+#ifdef POLICY_LPM
+/* The agent stores L3 rules with a prefix covering the identity only and
+ * without a proxy port, so the longest match is the rule the lookup
+ * cascade below would find first. L4 rules for any identity (identity 0)
+ * are only looked up if the catch-all entry says they exist.
+ */
+static inline int __inline__
+__policy_can_access(void *map, struct __sk_buff *skb, __u32 identity,
+		    __u16 dport, __u8 proto, size_t cidr_addr_size,
+		    void *cidr_addr, int dir)
+{
+#ifdef DROP_ALL
+	return DROP_POLICY;
+#else
+	__u8 wildcard = dir == CT_EGRESS ? POLICY_F_WILDCARD_EGRESS :
+					   POLICY_F_WILDCARD_INGRESS;
+	struct policy_entry *policy;
+	struct policy_key key = {
+		.prefixlen = POLICY_PREFIX_FULL,
+		.sec_label = identity,
+		.egress = !dir,
+		.protocol = proto,
+		.dport = dport,
+	};
+
+	policy = map_lookup_elem(map, &key);
+	if (policy && (policy->flags & POLICY_F_DEFAULT)) {
+		if (!(policy->flags & wildcard))
+			goto miss;
+
+		key.sec_label = 0;
+		policy = map_lookup_elem(map, &key);
+		if (policy && (policy->flags & (POLICY_F_DEFAULT | POLICY_F_L3)))
+			goto miss;
+	}
+
+	if (likely(policy)) {
+		if (!(policy->flags & POLICY_F_L3))
+			cilium_dbg3(skb, DBG_L4_CREATE, identity, SECLABEL,
+				    dport << 16 | proto);
+
+		/* FIXME: Use per cpu counters */
+		__sync_fetch_and_add(&policy->packets, 1);
+		__sync_fetch_and_add(&policy->bytes, skb->len);
+		return policy->proxy_port;
+	}
+
+miss:
+	if (skb->cb[CB_POLICY])
+		return TC_ACT_OK;
+
+	return DROP_POLICY;
+#endif /* DROP_ALL */
+}
+#else
 static inline int __inline__
 __policy_can_access(void *map, struct __sk_buff *skb, __u32 identity,
 		    __u16 dport, __u8 proto, size_t cidr_addr_size,
@@ -117,6 +172,7 @@ allow:
 	return TC_ACT_OK;
 #endif /* DROP_ALL */
 }
+#endif /* POLICY_LPM */
 
 #endif /* REQUIRES_CAN_ACCESS */
 
@@ -291,4 +347,35 @@ static inline int is_policy_skip(struct __sk_buff *skb)
 }
 #endif /* POLICY_INGRESS || POLICY_EGRESS */
 
+#if defined(CT_POLICY_CACHE) && defined(LXC_ID)
+/**
+ * Returns the revision against which policy verdicts cached in conntrack
+ * entries are validated, or 0 if verdicts must not be cached.
+ *
+ * Both the policy revision of the endpoint and the ipcache generation only
+ * ever increase, so their sum changes whenever the policy of the endpoint
+ * or the identity of any remote address changes.
+ */
+static inline __u32 __inline__ policy_revision(void)
+{
+	__u32 key = LXC_ID, zero = 0;
+	__u32 *rev, *gen;
+
+	rev = map_lookup_elem(&cilium_ep_policy_rev, &key);
+	if (!rev || !*rev)
+		return 0;
+
+	gen = map_lookup_elem(&cilium_ipcache_gen, &zero);
+	if (!gen)
+		return 0;
+
+	return *rev + *gen;
+}
+#else
+static inline __u32 __inline__ policy_revision(void)
+{
+	return 0;
+}
+#endif /* CT_POLICY_CACHE && LXC_ID */
+
 #endif
@@ -0,0 +1,79 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Per-CPU token buckets
+ *
+ * Buckets live in per-CPU maps, so refills and consumption need neither
+ * atomics nor shared cache lines. The limit applies to each CPU
+ * separately.
+ *
+ * API:
+ * bool ratelimit_admit(bucket, rate, burst)
+ */
+
+#ifndef __LIB_RATELIMIT_H_
+#define __LIB_RATELIMIT_H_
+
+#include <bpf/api.h>
+
+#include "utils.h"
+
+struct ratelimit_bucket {
+	__u64	last;		/* ktime of last refill */
+	__u64	tokens;
+	__u64	suppressed;	/* events not admitted */
+};
+
+/**
+ * ratelimit_admit
+ * @b:		per-CPU bucket
+ * @rate:	events per second, must not be 0
+ * @burst:	maximum bucket depth
+ *
+ * Refills @b and returns true if it holds a token for the current event.
+ */
+static __always_inline bool ratelimit_admit(struct ratelimit_bucket *b,
+					    __u32 rate, __u32 burst)
+{
+	__u64 now, delta, refill;
+
+	now = bpf_ktime_get_nsec();
+	delta = now - b->last;
+	if (delta >= NSEC_PER_SEC) {
+		refill = rate;
+		b->last = now;
+	} else {
+		refill = delta * rate / NSEC_PER_SEC;
+		/* Only advance by the time actually converted into tokens,
+		 * so sub-token remainders are not lost at low rates.
+		 */
+		if (refill)
+			b->last += refill * NSEC_PER_SEC / rate;
+	}
+
+	b->tokens = min(b->tokens + refill, (__u64)burst);
+	if (!b->tokens) {
+		b->suppressed++;
+		return false;
+	}
+
+	b->tokens--;
+	return true;
+}
+
+#endif /* __LIB_RATELIMIT_H_ */
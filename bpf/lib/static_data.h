@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Endpoint program templates
+ *
+ * If ENDPOINT_TEMPLATE is defined by the endpoint configuration, the
+ * program is compiled without the constants of a particular endpoint so
+ * that one object can be loaded for all endpoints with the same
+ * configuration. Each constant is taken from the address of an undefined
+ * symbol of the same name. The compiler emits a 64 bit immediate load with
+ * a relocation for each use, which the agent replaces with the value of the
+ * endpoint before loading the program (see pkg/elf). The verifier sees
+ * the same constants as in a program compiled for the endpoint, only the
+ * compiler can no longer fold them.
+ *
+ * The names of all symbols are part of the interface with the agent.
+ */
+
+#ifndef __LIB_STATIC_DATA_H_
+#define __LIB_STATIC_DATA_H_
+
+#define fetch_u32(x) ({ extern char x; (__u32)(unsigned long)&x; })
+#define fetch_u16(x) ({ extern char x; (__u16)(unsigned long)&x; })
+
+#ifdef ENDPOINT_TEMPLATE
+#undef LXC_MAC
+#undef NODE_MAC
+#undef LXC_IP
+#undef LXC_ID
+#undef LXC_ID_NB
+#undef SECLABEL
+#undef SECLABEL_NB
+
+/* Addresses in network byte order are split into words as stored in
+ * union macaddr and union v6addr. */
+#define LXC_MAC { .p1 = fetch_u32(LXC_MAC_1), .p2 = fetch_u16(LXC_MAC_2) }
+#define NODE_MAC { .p1 = fetch_u32(NODE_MAC_1), .p2 = fetch_u16(NODE_MAC_2) }
+#define LXC_IP fetch_u32(LXC_IP_1), fetch_u32(LXC_IP_2), \
+	       fetch_u32(LXC_IP_3), fetch_u32(LXC_IP_4)
+
+/* Only set if the endpoint has an IPv4 address */
+#ifdef LXC_IPV4
+#undef LXC_IPV4
+#define LXC_IPV4 fetch_u32(LXC_IPV4)
+#endif
+
+#define LXC_ID fetch_u16(LXC_ID)
+#define LXC_ID_NB fetch_u16(LXC_ID_NB)
+#define SECLABEL fetch_u32(SECLABEL)
+#define SECLABEL_NB fetch_u32(SECLABEL_NB)
+
+/* Section names must be constant, the agent renames the section of the
+ * policy program to the ID of the endpoint. */
+#define TEMPLATE_LXC_ID 0xffff
+#else
+#define TEMPLATE_LXC_ID LXC_ID
+#endif /* ENDPOINT_TEMPLATE */
+
+#endif /* __LIB_STATIC_DATA_H_ */
@@ -22,6 +22,14 @@
  * void send_trace_notify(skb, obs_point, src, dst, dst_id, ifindex, reason, monitor)
  *
  * If TRACE_NOTIFY is not defined, the API will be compiled in as a NOP.
+ *
+ * With MONITOR_AGGREGATION at TRACE_AGGREGATE_FLOW, packets are accounted
+ * per flow and observation point in cilium_trace_flows. Full notifications
+ * are only sent for the first and the closing packet of a flow, and a
+ * trace_flow_notify summary whenever a flow closes or crosses
+ * TRACE_FLOW_INTERVAL or TRACE_FLOW_BYTES. Packets following the close of
+ * a TCP flow, e.g. the final ACK, are accounted to the closed flow until a
+ * SYN starts a new one.
  */
 
 #ifndef __LIB_TRACE__
@@ -32,6 +40,9 @@
 #include "common.h"
 #include "utils.h"
 #include "metrics.h"
+#include "trace_config.h"
+#include "ipv4.h"
+#include "ipv6.h"
 
 /* Available observation points. */
 enum {
@@ -60,12 +71,21 @@ enum {
 	TRACE_AGGREGATE_NONE = 0,      /* Trace every packet on rx & tx */
 	TRACE_AGGREGATE_RX = 1,        /* Hide trace on packet receive */
 	TRACE_AGGREGATE_ACTIVE_CT = 3, /* Ratelimit active connection traces */
+	TRACE_AGGREGATE_FLOW = 4,      /* Periodic per flow summaries */
 };
 
 #ifndef MONITOR_AGGREGATION
 #define MONITOR_AGGREGATION TRACE_AGGREGATE_NONE
 #endif
 
+/* Flow aggregation relies on LRU eviction to bound its state, without it
+ * we fall back to TRACE_AGGREGATE_ACTIVE_CT. The level is spelled out as
+ * the enum is not visible to the preprocessor.
+ */
+#if defined(TRACE_NOTIFY) && defined(HAVE_LRU_MAP_TYPE) && MONITOR_AGGREGATION >= 4
+# define TRACE_FLOW_AGGREGATION
+#endif
+
 #ifdef TRACE_NOTIFY
 
 struct trace_notify {
@@ -80,6 +100,249 @@ struct trace_notify {
 	__u32		ifindex;
 };
 
+#ifdef TRACE_FLOW_AGGREGATION
+
+#ifndef TRACE_FLOW_MAP_SIZE
+#define TRACE_FLOW_MAP_SIZE	65536
+#endif
+
+#ifndef TRACE_FLOW_INTERVAL
+#define TRACE_FLOW_INTERVAL	(5 * NSEC_PER_SEC)
+#endif
+
+#ifndef TRACE_FLOW_BYTES
+#define TRACE_FLOW_BYTES	(1024 * 1024)
+#endif
+
+#define TRACE_FLOW_TCP_FIN	0x01
+#define TRACE_FLOW_TCP_SYN	0x02
+#define TRACE_FLOW_TCP_RST	0x04
+#define TRACE_FLOW_TCP_ACK	0x10
+
+/* Reasons for sending a flow summary. */
+enum {
+	TRACE_FLOW_REPORT_INTERVAL,
+	TRACE_FLOW_REPORT_BYTES,
+	TRACE_FLOW_REPORT_CLOSE,
+};
+
+/* CT tuple of the packet as seen at the observation point. IPv4
+ * addresses are stored in the first word of saddr/daddr.
+ */
+struct trace_flow_key {
+	union v6addr	saddr;
+	union v6addr	daddr;
+	__be16		sport;
+	__be16		dport;
+	__u8		nexthdr;
+	__u8		family;
+	__u8		obs_point;
+	__u8		pad;
+};
+
+struct trace_flow_stats {
+	__u64		packets;	/* since last report */
+	__u64		bytes;		/* since last report */
+	__u64		first_seen;
+	__u64		last_report;
+	__u32		src_label;
+	__u32		dst_label;
+	__u32		ifindex;
+	__u16		dst_id;
+	__u8		reason;
+	__u8		tcp_flags;	/* OR'd since last report */
+	__u8		closed;		/* FIN or RST seen */
+	__u8		pad[7];
+};
+
+struct trace_flow_notify {
+	NOTIFY_COMMON_HDR
+	__u32		src_label;
+	__u32		dst_label;
+	__u16		dst_id;
+	__u8		report;
+	__u8		tcp_flags;
+	__u32		ifindex;
+	__u8		reason;		/* of the first packet */
+	__u8		pad[7];
+	__u64		packets;
+	__u64		bytes;
+	__u64		duration;
+	struct trace_flow_key key;
+};
+
+/* Per-CPU, so the per packet accounting needs no atomics. A flow is
+ * normally steered to a single CPU, otherwise each CPU reports its share.
+ */
+struct bpf_elf_map __section_maps cilium_trace_flows = {
+	.type		= BPF_MAP_TYPE_LRU_PERCPU_HASH,
+	.size_key	= sizeof(struct trace_flow_key),
+	.size_value	= sizeof(struct trace_flow_stats),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= TRACE_FLOW_MAP_SIZE,
+};
+
+static __always_inline bool
+trace_flow_key_init(struct __sk_buff *skb, __u8 obs_point,
+		    struct trace_flow_key *key, __u8 *tcp_flags)
+{
+	struct {
+		__be16 sport;
+		__be16 dport;
+		__be32 seq;
+		__be32 ack_seq;
+		__u8 doff;
+		__u8 flags;
+	} l4 = {};
+	int l4_off;
+
+	switch (skb->protocol) {
+	case bpf_htons(ETH_P_IP): {
+		struct iphdr ip4;
+
+		if (skb_load_bytes(skb, ETH_HLEN, &ip4, sizeof(ip4)) < 0)
+			return false;
+		key->saddr.p1 = ip4.saddr;
+		key->daddr.p1 = ip4.daddr;
+		key->nexthdr = ip4.protocol;
+		key->family = ENDPOINT_KEY_IPV4;
+		if (ip4.frag_off & bpf_htons(IPV4_FRAG_OFFSET))
+			goto out;
+		l4_off = ETH_HLEN + ipv4_hdrlen(&ip4);
+		break;
+	}
+	case bpf_htons(ETH_P_IPV6): {
+		struct ipv6hdr ip6;
+
+		if (skb_load_bytes(skb, ETH_HLEN, &ip6, sizeof(ip6)) < 0)
+			return false;
+		ipv6_addr_copy(&key->saddr, (union v6addr *) &ip6.saddr);
+		ipv6_addr_copy(&key->daddr, (union v6addr *) &ip6.daddr);
+		key->nexthdr = ip6.nexthdr;
+		key->family = ENDPOINT_KEY_IPV6;
+		l4_off = ETH_HLEN + sizeof(ip6);
+		break;
+	}
+	default:
+		return false;
+	}
+
+	switch (key->nexthdr) {
+	case IPPROTO_TCP:
+		if (skb_load_bytes(skb, l4_off, &l4, sizeof(l4)) < 0)
+			goto out;
+		*tcp_flags = l4.flags;
+		break;
+	case IPPROTO_UDP:
+		if (skb_load_bytes(skb, l4_off, &l4, 2 * sizeof(__be16)) < 0)
+			goto out;
+		break;
+	default:
+		goto out;
+	}
+
+	key->sport = l4.sport;
+	key->dport = l4.dport;
+out:
+	key->obs_point = obs_point;
+	return true;
+}
+
+static __always_inline void
+trace_flow_report(struct __sk_buff *skb, struct trace_flow_key *key,
+		  struct trace_flow_stats *stats, __u64 now, __u8 report)
+{
+	struct trace_flow_notify msg = {
+		.type = CILIUM_NOTIFY_TRACE_FLOW,
+		.subtype = key->obs_point,
+		.source = EVENT_SOURCE,
+		.hash = get_hash_recalc(skb),
+		.src_label = stats->src_label,
+		.dst_label = stats->dst_label,
+		.dst_id = stats->dst_id,
+		.report = report,
+		.tcp_flags = stats->tcp_flags,
+		.ifindex = stats->ifindex,
+		.reason = stats->reason,
+		.packets = stats->packets,
+		.bytes = stats->bytes,
+		.duration = now - stats->first_seen,
+		.key = *key,
+	};
+
+	send_event(skb, &msg, sizeof(msg), 0);
+}
+
+/**
+ * trace_flow_update
+ *
+ * Accounts the packet to its flow. Returns true if a full trace
+ * notification should be sent for this packet, i.e. for the first and
+ * the closing packet of a flow, or if the packet could not be parsed.
+ *
+ * Closed flows are kept, so that the packets completing the close do not
+ * start a new flow. LRU eviction removes them.
+ */
+static __always_inline bool
+trace_flow_update(struct __sk_buff *skb, __u8 obs_point, __u32 src, __u32 dst,
+		  __u16 dst_id, __u32 ifindex, __u8 reason)
+{
+	struct trace_flow_key key = {};
+	struct trace_flow_stats *stats;
+	__u64 now = bpf_ktime_get_nsec();
+	__u8 tcp_flags = 0, report;
+
+	if (!trace_flow_key_init(skb, obs_point, &key, &tcp_flags))
+		return true;
+
+	stats = map_lookup_elem(&cilium_trace_flows, &key);
+	if (!stats || !stats->first_seen ||
+	    (stats->closed && (tcp_flags & (TRACE_FLOW_TCP_SYN | TRACE_FLOW_TCP_ACK)) ==
+			      TRACE_FLOW_TCP_SYN)) {
+		struct trace_flow_stats new_stats = {
+			.first_seen = now,
+			.last_report = now,
+			.src_label = src,
+			.dst_label = dst,
+			.ifindex = ifindex,
+			.dst_id = dst_id,
+			.reason = reason,
+		};
+
+		map_update_elem(&cilium_trace_flows, &key, &new_stats, 0);
+		return true;
+	}
+
+	stats->packets++;
+	stats->bytes += skb->len;
+	stats->tcp_flags |= tcp_flags;
+
+	if (!stats->closed && tcp_flags & (TRACE_FLOW_TCP_FIN | TRACE_FLOW_TCP_RST)) {
+		trace_flow_report(skb, &key, stats, now, TRACE_FLOW_REPORT_CLOSE);
+		stats->packets = 0;
+		stats->bytes = 0;
+		stats->tcp_flags = 0;
+		stats->last_report = now;
+		stats->closed = 1;
+		return true;
+	}
+
+	if (now - stats->last_report >= TRACE_FLOW_INTERVAL)
+		report = TRACE_FLOW_REPORT_INTERVAL;
+	else if (stats->bytes >= TRACE_FLOW_BYTES)
+		report = TRACE_FLOW_REPORT_BYTES;
+	else
+		return false;
+
+	trace_flow_report(skb, &key, stats, now, report);
+	stats->packets = 0;
+	stats->bytes = 0;
+	stats->tcp_flags = 0;
+	stats->last_report = now;
+	return false;
+}
+#endif /* TRACE_FLOW_AGGREGATION */
+
 /**
  * send_trace_notify
  * @skb:	socket buffer
@@ -100,6 +363,7 @@ send_trace_notify(struct __sk_buff *skb, __u8 obs_point, __u32 src, __u32 dst,
 	switch (obs_point) {
 		case TRACE_TO_LXC:
 			update_metrics(skb->len, METRIC_INGRESS, REASON_FORWARDED);
+			update_ep_metrics(skb->len, METRIC_INGRESS, REASON_FORWARDED, src);
 			break;
 
 		/* TRACE_FROM_LXC, i.e endpoint-to-endpoint delivery
@@ -115,23 +379,40 @@ send_trace_notify(struct __sk_buff *skb, __u8 obs_point, __u32 src, __u32 dst,
 		case TRACE_TO_STACK:
 		case TRACE_TO_OVERLAY:
 			update_metrics(skb->len, METRIC_EGRESS, REASON_FORWARDED);
+			update_ep_metrics(skb->len, METRIC_EGRESS, REASON_FORWARDED, dst);
 	}
-	if (MONITOR_AGGREGATION >= TRACE_AGGREGATE_RX) {
-		switch (obs_point) {
-		case TRACE_FROM_LXC:
-		case TRACE_FROM_PROXY:
-		case TRACE_FROM_HOST:
-		case TRACE_FROM_STACK:
-		case TRACE_FROM_OVERLAY:
-			return;
-		default:
-			break;
+
+	struct trace_config *cfg = trace_config_lookup();
+
+	if (cfg && !(cfg->obs_points & (1 << obs_point)))
+		return;
+
+	if (!cfg || !(cfg->flags & TRACE_CONFIG_NO_AGGREGATION)) {
+		if (MONITOR_AGGREGATION >= TRACE_AGGREGATE_RX) {
+			switch (obs_point) {
+			case TRACE_FROM_LXC:
+			case TRACE_FROM_PROXY:
+			case TRACE_FROM_HOST:
+			case TRACE_FROM_STACK:
+			case TRACE_FROM_OVERLAY:
+				return;
+			default:
+				break;
+			}
 		}
+#ifdef TRACE_FLOW_AGGREGATION
+		if (!trace_flow_update(skb, obs_point, src, dst, dst_id, ifindex, reason))
+			return;
+#else
+		if (MONITOR_AGGREGATION >= TRACE_AGGREGATE_ACTIVE_CT && !monitor)
+			return;
+#endif
 	}
-	if (MONITOR_AGGREGATION >= TRACE_AGGREGATE_ACTIVE_CT && !monitor)
+
+	if (!trace_config_sample(cfg))
 		return;
 
-	uint64_t skb_len = (uint64_t)skb->len, cap_len = min((uint64_t)TRACE_PAYLOAD_LEN, (uint64_t)skb_len);
+	uint64_t skb_len = (uint64_t)skb->len, cap_len = trace_config_cap_len(cfg, skb_len);
 	uint32_t hash = get_hash_recalc(skb);
 	struct trace_notify msg = {
 		.type = CILIUM_NOTIFY_TRACE,
@@ -147,9 +428,7 @@ send_trace_notify(struct __sk_buff *skb, __u8 obs_point, __u32 src, __u32 dst,
 		.pad = 0,
 		.ifindex = ifindex,
 	};
-	skb_event_output(skb, &cilium_events,
-			 (cap_len << 32) | BPF_F_CURRENT_CPU,
-			 &msg, sizeof(msg));
+	send_event(skb, &msg, sizeof(msg), cap_len);
 }
 
 #else
@@ -160,6 +439,7 @@ static inline void send_trace_notify(struct __sk_buff *skb, __u8 obs_point, __u3
 	switch (obs_point) {
 		case TRACE_TO_LXC:
 			update_metrics(skb->len, METRIC_INGRESS, REASON_FORWARDED);
+			update_ep_metrics(skb->len, METRIC_INGRESS, REASON_FORWARDED, src);
 			break;
 
 		/* TRACE_FROM_LXC, i.e endpoint-to-endpoint delivery
@@ -175,6 +455,7 @@ static inline void send_trace_notify(struct __sk_buff *skb, __u8 obs_point, __u3
 		case TRACE_TO_STACK:
 		case TRACE_TO_OVERLAY:
 			update_metrics(skb->len, METRIC_EGRESS, REASON_FORWARDED);
+			update_ep_metrics(skb->len, METRIC_EGRESS, REASON_FORWARDED, dst);
 	}
 }
 
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Runtime configuration of trace and drop notifications
+ *
+ * The agent may override the capture length, sample notifications and
+ * select observation points per endpoint without recompiling the program.
+ * Programs not attached to an endpoint use the entry at index 0.
+ *
+ * API:
+ * struct trace_config *trace_config_lookup()
+ * bool trace_config_sample(cfg)
+ * __u64 trace_config_cap_len(cfg, skb_len)
+ */
+
+#ifndef __LIB_TRACE_CONFIG__
+#define __LIB_TRACE_CONFIG__
+
+#include <bpf/api.h>
+
+#include "common.h"
+#include "utils.h"
+
+#if defined(TRACE_NOTIFY) || defined(DROP_NOTIFY)
+
+#ifndef TRACE_CONFIG_MAP_SIZE
+#define TRACE_CONFIG_MAP_SIZE 65536
+#endif
+
+enum {
+	TRACE_CONFIG_ENABLED = (1 << 0),	 /* Entry overrides defaults */
+	TRACE_CONFIG_NO_AGGREGATION = (1 << 1),	 /* Ignore MONITOR_AGGREGATION */
+};
+
+struct trace_config {
+	__u16	cap_len;	/* Bytes of packet to capture, 0: TRACE_PAYLOAD_LEN */
+	__u16	obs_points;	/* Bitmask of enabled TRACE_* points, 0: none */
+	__u32	sample_rate;	/* Notify 1 in N packets, 0 or 1: all */
+	__u8	flags;
+	__u8	pad1;
+	__u16	pad2;
+	__u32	pad3;
+};
+
+/* An array is used so that endpoints without an override only pay for a
+ * lookup which never fails and a flags check.
+ */
+struct bpf_elf_map __section_maps cilium_trace_config = {
+	.type		= BPF_MAP_TYPE_ARRAY,
+	.size_key	= sizeof(__u32),
+	.size_value	= sizeof(struct trace_config),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= TRACE_CONFIG_MAP_SIZE,
+};
+
+/**
+ * trace_config_lookup
+ *
+ * Returns the configuration of the current endpoint or NULL if the agent
+ * did not override the defaults.
+ */
+static __always_inline struct trace_config *trace_config_lookup(void)
+{
+	struct trace_config *cfg;
+	__u32 key = EVENT_SOURCE;
+
+	cfg = map_lookup_elem(&cilium_trace_config, &key);
+	if (cfg && (cfg->flags & TRACE_CONFIG_ENABLED))
+		return cfg;
+	return NULL;
+}
+
+/**
+ * trace_config_sample
+ * @cfg:	configuration returned by trace_config_lookup()
+ *
+ * Returns true if a notification should be sent for the current packet.
+ */
+static __always_inline bool trace_config_sample(const struct trace_config *cfg)
+{
+	if (!cfg || cfg->sample_rate <= 1)
+		return true;
+	return get_prandom_u32() % cfg->sample_rate == 0;
+}
+
+/**
+ * trace_config_cap_len
+ * @cfg:	configuration returned by trace_config_lookup()
+ * @skb_len:	length of the packet
+ *
+ * Returns the number of packet bytes to attach to a notification. With
+ * the events ring buffer it is further limited to TRACE_PAYLOAD_LEN by
+ * send_event().
+ */
+static __always_inline __u64 trace_config_cap_len(const struct trace_config *cfg,
+						  __u64 skb_len)
+{
+	__u64 cap_len = TRACE_PAYLOAD_LEN;
+
+	if (cfg && cfg->cap_len)
+		cap_len = cfg->cap_len;
+	return min(cap_len, skb_len);
+}
+
+#endif /* TRACE_NOTIFY || DROP_NOTIFY */
+#endif /* __LIB_TRACE_CONFIG__ */
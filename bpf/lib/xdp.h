@@ -20,6 +20,8 @@
 
 #include <stdbool.h>
 
+#include "common.h"
+
 struct lpm_v4_key {
 	struct bpf_lpm_trie_key lpm;
 	__u8 addr[4];
@@ -35,6 +37,89 @@ struct lpm_val {
 	__u8 flags;
 };
 
+enum {
+	L4_RULE_PASS,
+	L4_RULE_DROP,
+	L4_RULE_RATELIMIT,
+	L4_RULE_SYNCOOKIE,
+};
+
+/* Key for the L4 prefilter rule table. A dport of 0 acts as wildcard
+ * for all ports of the given protocol.
+ */
+struct l4_rule_key {
+	__be16 dport;
+	__u8 proto;
+	__u8 family;
+};
+
+struct l4_rule_val {
+	__u8 action;
+	__u8 pad1;
+	__u16 pad2;
+	/* Token bucket parameters for L4_RULE_RATELIMIT, enforced
+	 * independently on each CPU.
+	 */
+	__u32 rate;	/* packets per second */
+	__u32 burst;	/* maximum bucket depth in packets */
+	__u32 pad3;
+};
+
+/* L4_RULE_SYNCOOKIE uses the rate and burst of the rule as threshold of
+ * SYNs per destination before SYNs of unvalidated sources are answered
+ * with a cookie. Token buckets of such rules are keyed by destination
+ * address instead of source prefix. The stats of each destination share
+ * the same key.
+ */
+struct syncookie_src_key {
+	__u8 addr[16];
+	__u8 family;
+	__u8 pad1;
+	__u16 pad2;
+};
+
+struct syncookie_stats {
+	__u64 sent;		/* SYN-ACKs carrying a cookie */
+	__u64 validated;	/* Sources which returned a valid cookie */
+};
+
+struct syncookie_secret {
+	__u32 key[4];
+};
+
+/* Token bucket key, source address is masked to L4_RL_PREFIX{4,6}. */
+struct l4_bucket_key {
+	__u8 addr[16];
+	__be16 dport;
+	__u8 proto;
+	__u8 family;
+};
+
+/* Prefilter drop counters live in a per-CPU array indexed by drop reason
+ * and address family, so accounting is a single lookup without atomics.
+ */
+enum {
+	PREFILTER_FAMILY_OTHER,
+	PREFILTER_FAMILY_IPV4,
+	PREFILTER_FAMILY_IPV6,
+	__PREFILTER_FAMILY_MAX,
+};
+
+#define PREFILTER_METRICS_KEY(reason, family) \
+	((__u32)((DROP_PREFILTER_DENY - (reason)) << 2) | (family))
+#define PREFILTER_METRICS_SIZE	32
+
+/* Metadata in front of frames decapsulated by the XDP overlay fast path,
+ * read by bpf_overlay.o compiled with XDP_DECAP on tc ingress of the same
+ * device.
+ */
+struct xdp_decap_meta {
+	__u32 magic;
+	__u32 identity;	/* Security identity of the source, from the VNI */
+};
+
+#define XDP_DECAP_MAGIC	0xdeca9c11
+
 static __always_inline void *xdp_data(const struct xdp_md *xdp)
 {
 	return (void *)(unsigned long)xdp->data;
@@ -45,6 +130,11 @@ static __always_inline void *xdp_data_end(const struct xdp_md *xdp)
 	return (void *)(unsigned long)xdp->data_end;
 }
 
+static __always_inline void *xdp_data_meta(const struct xdp_md *xdp)
+{
+	return (void *)(unsigned long)xdp->data_meta;
+}
+
 static __always_inline bool xdp_no_room(const void *needed, const void *limit)
 {
 	return unlikely(needed > limit);
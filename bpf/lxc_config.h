@@ -20,18 +20,20 @@
  * compilation without the full code generation engine backend.
  */
 
+#ifndef ENDPOINT_TEMPLATE
 #define LXC_MAC { .addr = { 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff } }
 #define LXC_IP 0xbe, 0xef, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x1, 0x1, 0x65, 0x82, 0xbc
-#define LXC_IPV4 0x10203040
 #define LXC_ID 0x1010
 #define LXC_ID_NB 0x1010
-#define LXC_NAT46
 #ifndef SECLABEL
 #define SECLABEL 0xfffff
 #define SECLABEL_NB 0xfffff
 #endif
-#define POLICY_MAP cilium_policy_foo
 #define NODE_MAC { .addr = { 0xde, 0xad, 0xbe, 0xef, 0xc0, 0xde } }
+#endif /* ENDPOINT_TEMPLATE */
+#define LXC_IPV4 0x10203040
+#define LXC_NAT46
+#define POLICY_MAP cilium_policy_foo
 #define DROP_NOTIFY
 #define TRACE_NOTIFY
 #define CT_MAP6 cilium_ct6_111
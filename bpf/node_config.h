@@ -54,6 +54,7 @@
 #define TUNNEL_ENDPOINT_MAP_SIZE 65536
 #define ENDPOINTS_MAP_SIZE 65536
 #define METRICS_MAP_SIZE 65536
+#define TRACE_CONFIG_MAP_SIZE 65536
 #define CILIUM_NET_MAC  { .addr = { 0xce, 0x72, 0xa7, 0x03, 0x88, 0x57 } }
 #define LB_REDIRECT 1
 #define LB_DST_MAC { .addr = { 0xce, 0x72, 0xa7, 0x03, 0x88, 0x58 } }
@@ -62,6 +63,19 @@
 #define POLICY_MAP_SIZE 16384
 #define IPCACHE_MAP_SIZE 512000
 #define POLICY_PROG_MAP_SIZE ENDPOINTS_MAP_SIZE
+#define PREALLOCATE_MAPS
+#define DROP_NOTIFY_RATELIMIT
+#define CT_POLICY_CACHE
+#define EP_POLICY_REV_MAP_SIZE ENDPOINTS_MAP_SIZE
+#define ENABLE_BANDWIDTH_MANAGER
+#define THROTTLE_MAP_SIZE ENDPOINTS_MAP_SIZE
+#define ENABLE_MASQUERADE
+#define SNAT_IPV4_EXTERNAL 0x0100000a
+#define SNAT_IPV4_EXCLUDE_DST_CIDR IPV4_CLUSTER_RANGE
+#define SNAT_IPV4_EXCLUDE_DST_MASK IPV4_CLUSTER_MASK
+#define SNAT_MAPPING_MAP_SIZE 524288
+#define SNAT_FRAG_MAP_SIZE 8192
+#define ENABLE_XDP_DECAP
 #ifndef SKIP_DEBUG
 #define LB_DEBUG
 #endif
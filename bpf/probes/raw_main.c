@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <errno.h>
 
@@ -38,6 +39,7 @@ struct bpf_map_fixup {
 	uint32_t size_key;
 	uint32_t size_val;
 	uint32_t flags;
+	uint32_t max_elem;	/* 1 if unset */
 };
 
 struct bpf_test {
@@ -243,10 +245,30 @@ static void bpf_report(const struct bpf_test *test, int success,
 		fprintf(stderr, "%s: %s\n", test->emits, test->warn);
 }
 
-static void bpf_run_test(struct bpf_test *test, int debug_mode)
+/* Errors which do not tell whether the kernel supports a feature, e.g. due
+ * to the memlock limit, missing privileges or a busy kernel. The result of
+ * the probe must not be cached.
+ */
+static bool bpf_error_transient(int err)
+{
+	switch (err) {
+	case ENOMEM:
+	case EPERM:
+	case EAGAIN:
+	case EBUSY:
+	case EINTR:
+	case ENOSPC:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Returns -1 if the result of the test is not conclusive. */
+static int bpf_run_test(struct bpf_test *test, int debug_mode)
 {
 	struct bpf_map_fixup *map = test->fixup_map;
-	int fd;
+	int fd, err = 0;
 
 	/* We can use off here as it's never first insns. */
 	while (map->off) {
@@ -255,13 +277,15 @@ static void bpf_run_test(struct bpf_test *test, int debug_mode)
 			.size_key	= map->size_key,
 			.size_value	= map->size_val,
 			.pinning	= 0,
-			.max_elem	= 1,
+			.max_elem	= map->max_elem ? : 1,
 			.flags		= map->flags,
 		};
 	  
 		fd = bpf_map_create(map->type, map->size_key,
-				    map->size_val, 1, map->flags);
+				    map->size_val, elf_map.max_elem,
+				    map->flags);
 		if (fd < 0) {
+			err = errno;
 			if (debug_mode) {
 				printf("#if 0\n");
 				printf("%s: bpf_map_create(): %s\n",
@@ -281,16 +305,27 @@ static void bpf_run_test(struct bpf_test *test, int debug_mode)
 
 	fd = bpf_prog_load(test->type, test->insns,
 			   bpf_test_length(test->insns), "GPL", NULL, 0);
+	if (fd < 0 && !err)
+		err = errno;
 	bpf_report(test, fd > 0, debug_mode);
-	if (fd > 0)
+	if (fd > 0) {
 		close(fd);
+		return 0;
+	}
+
+	if (bpf_error_transient(err)) {
+		fprintf(stderr, "%s: probe inconclusive: %s\n", test->emits,
+			strerror(err));
+		return -1;
+	}
+	return 0;
 }
 
 int main(int argc, char **argv)
 {
 	struct rlimit rold, rinf = { RLIM_INFINITY, RLIM_INFINITY };
 	int debug_mode = 0;
-	int i;
+	int i, ret = 0;
 
 	if (argc > 1 && !strncmp(argv[argc - 1], "debug", sizeof("debug")))
 		debug_mode = 1;
@@ -298,9 +333,11 @@ int main(int argc, char **argv)
 	getrlimit(RLIMIT_MEMLOCK, &rold);
 	setrlimit(RLIMIT_MEMLOCK, &rinf);
 
-	for (i = 0; i < ARRAY_SIZE(tests); i++)
-		bpf_run_test(&tests[i], debug_mode);
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		if (bpf_run_test(&tests[i], debug_mode) < 0)
+			ret = 1;
+	}
 
 	setrlimit(RLIMIT_MEMLOCK, &rold);
-	return 0;
+	return ret;
 }
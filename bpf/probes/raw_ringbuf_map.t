@@ -0,0 +1,31 @@
+/* Tests for availability of kernel commits (5.8+):
+ *
+ * 457f44363a88 ("bpf: Implement BPF ring buffer and verifier support for it")
+ */
+	{
+		.emits	= "HAVE_RINGBUF_MAP_TYPE",
+		.type	= BPF_PROG_TYPE_SCHED_CLS,
+		.insns	= {
+			BPF_MOV64_IMM(BPF_REG_2, 8),
+			BPF_LD_MAP_FD(BPF_REG_1, 0),
+			BPF_MOV64_IMM(BPF_REG_3, 0),
+			BPF_EMIT_CALL(BPF_FUNC_ringbuf_reserve),
+			BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 3),
+			BPF_MOV64_REG(BPF_REG_1, BPF_REG_0),
+			BPF_MOV64_IMM(BPF_REG_2, 0),
+			BPF_EMIT_CALL(BPF_FUNC_ringbuf_submit),
+			BPF_MOV64_IMM(BPF_REG_0, 0),
+			BPF_EXIT_INSN(),
+		},
+		.fixup_map = {
+			{
+				.off		= 1,
+				.type		= BPF_MAP_TYPE_RINGBUF,
+				/* Multiple of the page size on all archs */
+				.max_elem	= 65536,
+			},
+		},
+		.warn = "Your kernel doesn't support BPF ring buffers, thus "
+			"datapath events are delivered through per-CPU perf "
+			"buffers. Recommendation is to run 5.8+ kernels.",
+	},
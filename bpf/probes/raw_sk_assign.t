@@ -0,0 +1,33 @@
+/* Tests for availability of kernel commits (5.7+):
+ *
+ * cf7fbe660f2d ("bpf: Add socket assign support")
+ */
+	{
+		.emits	= "HAVE_SK_ASSIGN",
+		.type	= BPF_PROG_TYPE_SCHED_CLS,
+		.insns	= {
+			BPF_MOV64_REG(BPF_REG_6, BPF_REG_1),
+			BPF_ST_MEM(BPF_DW, BPF_REG_10, -16, 0),
+			BPF_ST_MEM(BPF_DW, BPF_REG_10, -8, 0),
+			BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
+			BPF_ALU64_IMM(BPF_ADD, BPF_REG_2, -16),
+			BPF_MOV64_IMM(BPF_REG_3, 12),
+			BPF_MOV64_IMM(BPF_REG_4, -1),
+			BPF_MOV64_IMM(BPF_REG_5, 0),
+			BPF_EMIT_CALL(BPF_FUNC_sk_lookup_tcp),
+			BPF_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 7),
+			BPF_MOV64_REG(BPF_REG_7, BPF_REG_0),
+			BPF_MOV64_REG(BPF_REG_1, BPF_REG_6),
+			BPF_MOV64_REG(BPF_REG_2, BPF_REG_7),
+			BPF_MOV64_IMM(BPF_REG_3, 0),
+			BPF_EMIT_CALL(BPF_FUNC_sk_assign),
+			BPF_MOV64_REG(BPF_REG_1, BPF_REG_7),
+			BPF_EMIT_CALL(BPF_FUNC_sk_release),
+			BPF_MOV64_IMM(BPF_REG_0, 0),
+			BPF_EXIT_INSN(),
+		},
+		.warn = "Your kernel doesn't support socket assignment, thus "
+			"the transparent proxy redirect must rewrite packets "
+			"to the proxy port. Recommendation is to run 5.7+ "
+			"kernels.",
+	},
@@ -0,0 +1,18 @@
+/* Tests for availability of kernel commits (5.0+):
+ *
+ * f11216b24219 ("bpf: add skb->tstamp r/w access from tc clsact and cg skb progs")
+ */
+	{
+		.emits	= "HAVE_SKB_TSTAMP",
+		.type	= BPF_PROG_TYPE_SCHED_CLS,
+		.insns	= {
+			BPF_MOV64_IMM(BPF_REG_2, 0),
+			BPF_STX_MEM(BPF_DW, BPF_REG_1, BPF_REG_2, 152),
+			BPF_MOV64_IMM(BPF_REG_0, 0),
+			BPF_EXIT_INSN(),
+		},
+		.warn = "Your kernel doesn't support setting the departure time "
+			"of packets, thus egress bandwidth limits of endpoints "
+			"are not enforced. Recommendation is to run 5.0+ "
+			"kernels.",
+	},
@@ -26,6 +26,10 @@ FEATURE_FILE="$RUNDIR/globals/bpf_features.h"
 INFO_FILE="$RUNDIR/bpf_features.log"
 WARNING_FILE="$RUNDIR/bpf_requirements.log"
 
+# Results are cached across agent restarts. Remove the directory to
+# force probing.
+CACHE_DIR="$RUNDIR/bpf_features.cache"
+
 function cleanup {
 	if [ ! -z "$PROBE_DIR" ]; then
 		rm -rf "$PROBE_DIR"
@@ -104,18 +108,80 @@ function probe_run_tc()
 function probe_run_ll()
 {
 	PROBE_BASE="${LIB}/probes"
-	OUT="$PROBE_DIR"
 	LIB_INCLUDE="${LIB}/include"
-	PROBE_OPTS="-O2 -I$OUT -I$PROBE_BASE -I$LIB_INCLUDE -Wall"
 
+	# Probes are independent of each other and run in parallel, each
+	# in its own directory as raw_main.c includes raw_probe.t. Results
+	# are collected in the order of the probes afterwards. A probe
+	# which could not be built or run, or which failed for a reason
+	# other than a missing feature, keeps the results from being cached.
 	for PROBE in "${PROBE_BASE}"/*.t
 	do
 		OUT_BIN=`basename "$PROBE"`
+		OUT="$PROBE_DIR/$OUT_BIN.d"
+		PROBE_OPTS="-O2 -I$OUT -I$PROBE_BASE -I$LIB_INCLUDE -Wall"
 
+		mkdir -p "$OUT"
 		cp "$PROBE" "$OUT/raw_probe.t"
-		clang $PROBE_OPTS "$PROBE_BASE/raw_main.c" -o "$OUT/$OUT_BIN" &&
-		"$OUT/$OUT_BIN" 1>> "$FEATURE_FILE" 2>> "$INFO_FILE"
+		(if clang $PROBE_OPTS "$PROBE_BASE/raw_main.c" -o "$OUT/$OUT_BIN" &&
+		    "$OUT/$OUT_BIN" 1> "$OUT/features" 2> "$OUT/info"; then
+			echo 0 > "$OUT/status"
+		 else
+			echo 1 > "$OUT/status"
+		 fi) &
+	done
+	wait
+
+	for PROBE in "${PROBE_BASE}"/*.t
+	do
+		OUT="$PROBE_DIR/`basename "$PROBE"`.d"
+		cat "$OUT/features" >> "$FEATURE_FILE" 2> /dev/null || true
+		cat "$OUT/info" >> "$INFO_FILE" 2> /dev/null || true
+		if [ "`cat "$OUT/status" 2> /dev/null`" != "0" ]; then
+			PROBES_CONCLUSIVE=0
+		fi
+	done
+}
+
+# Results only change with the kernel, its BPF JIT settings or the probes.
+function probe_cache_key()
+{
+	(uname -r; uname -v
+	 cat /proc/sys/net/core/bpf_jit_enable 2> /dev/null || true
+	 cat /proc/sys/net/core/bpf_jit_harden 2> /dev/null || true
+	 cat "${BASH_SOURCE[0]}" "${LIB}"/probes/* "${LIB}/include/linux/bpf.h") |
+	sha1sum | cut -d' ' -f1
+}
+
+function probe_cache_restore()
+{
+	local ENTRY="$CACHE_DIR/$1"
+
+	[ -f "$ENTRY/bpf_features.h" ] || return 1
+	cp "$ENTRY/bpf_features.h" "$FEATURE_FILE"
+	for file in $INFO_FILE $WARNING_FILE
+	do
+		if [ -f "$ENTRY/`basename $file`" ]; then
+			cp "$ENTRY/`basename $file`" "$file"
+		fi
+	done
+}
+
+# Only the entry of the running kernel is kept. The entry is moved into
+# place in one step so that concurrent runs never see a partial entry.
+function probe_cache_store()
+{
+	local TMP="$CACHE_DIR/.$1.$$"
+
+	rm -rf "$CACHE_DIR"/*
+	mkdir -p "$TMP"
+	for file in $FEATURE_FILE $INFO_FILE $WARNING_FILE
+	do
+		if [ -f "$file" ]; then
+			cp "$file" "$TMP/"
+		fi
 	done
+	mv "$TMP" "$CACHE_DIR/$1"
 }
 
 for file in $INFO_FILE $WARNING_FILE
@@ -123,6 +189,14 @@ do
 	rm -f "$file"
 done
 
+# Cleared by probe_run_ll if any result may be due to a transient error
+PROBES_CONCLUSIVE=1
+
+CACHE_KEY=$(probe_cache_key)
+if probe_cache_restore "$CACHE_KEY"; then
+	exit 0
+fi
+
 echo "#ifndef BPF_FEATURES_H_"  > "$FEATURE_FILE"
 echo "#define BPF_FEATURES_H_" >> "$FEATURE_FILE"
 echo "" >> "$FEATURE_FILE"
@@ -133,9 +207,17 @@ probe_run_ll
 
 echo "#endif /* BPF_FEATURES_H_ */" >> "$FEATURE_FILE"
 
+if [ "$PROBES_CONCLUSIVE" != "1" ]; then
+	echo "BPF/probes: Not caching results as some probes were inconclusive" >> $INFO_FILE
+fi
+
 for file in $INFO_FILE $WARNING_FILE
 do
 	if [ ! -s "$file" ]; then
 		rm -f "$file"
 	fi
 done
+
+if [ "$PROBES_CONCLUSIVE" = "1" ]; then
+	probe_cache_store "$CACHE_KEY"
+fi
@@ -0,0 +1,77 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"fmt"
+	"os"
+
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/command"
+	"github.com/cilium/cilium/pkg/maps/metricsmap"
+
+	"github.com/spf13/cobra"
+)
+
+var metricsEndpointID int
+
+var bpfMetricsEndpointCmd = &cobra.Command{
+	Use:   "endpoint",
+	Short: "List BPF datapath traffic metrics per endpoint and remote identity",
+	Long: `List BPF datapath traffic metrics per endpoint and remote identity
+
+Requires the agent to run with --endpoint-metrics-identities. Of the
+remote identities allowed by the policy of an endpoint, the ones with the
+lowest numeric IDs are tracked, starting with the reserved identities.
+Traffic with all other remote identities is listed as identity "other".`,
+	Run: func(cmd *cobra.Command, args []string) {
+		common.RequireRootPrivilege("cilium bpf metrics endpoint")
+
+		bpfMetricsList := make(map[string][]string)
+		err := metricsmap.DumpEndpointMetrics(func(key *metricsmap.EndpointKey, value *metricsmap.Value) {
+			if metricsEndpointID >= 0 && int(key.EndpointID) != metricsEndpointID {
+				return
+			}
+			if value.Count == 0 {
+				return
+			}
+			bpfMetricsList[key.String()] = append(bpfMetricsList[key.String()], value.String())
+		})
+		if err != nil {
+			fmt.Fprintf(os.Stderr, "error dumping contents of map: %s\n", err)
+			os.Exit(1)
+		}
+
+		if command.OutputJSON() {
+			if err := command.PrintOutput(bpfMetricsList); err != nil {
+				fmt.Fprintf(os.Stderr, "error getting output of map in JSON: %s\n", err)
+				os.Exit(1)
+			}
+			return
+		}
+
+		if len(bpfMetricsList) == 0 {
+			fmt.Fprintf(os.Stderr, "No entries found.\n")
+		} else {
+			TablePrinter(DropForward, count, bpfMetricsList)
+		}
+	},
+}
+
+func init() {
+	bpfMetricsCmd.AddCommand(bpfMetricsEndpointCmd)
+	bpfMetricsEndpointCmd.Flags().IntVar(&metricsEndpointID, "id", -1, "Only list metrics of the endpoint with this ID")
+	command.AddJSONOutput(bpfMetricsEndpointCmd)
+}
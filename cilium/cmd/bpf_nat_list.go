@@ -0,0 +1,60 @@
+// Copyright 2017 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"fmt"
+	"os"
+
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/command"
+	"github.com/cilium/cilium/pkg/maps/natmap"
+
+	"github.com/spf13/cobra"
+)
+
+const (
+	natFlowTitle        = "FLOW"
+	natTranslationTitle = "TRANSLATION"
+)
+
+var bpfNatListCmd = &cobra.Command{
+	Use:     "list",
+	Aliases: []string{"ls"},
+	Short:   "List SNAT entries of masqueraded flows",
+	Run: func(cmd *cobra.Command, args []string) {
+		common.RequireRootPrivilege("cilium bpf nat list")
+
+		natList := make(map[string][]string)
+		if err := natmap.Map.Dump(natList); err != nil {
+			fmt.Fprintf(os.Stderr, "Unable to dump SNAT map: %s\n", err)
+			os.Exit(1)
+		}
+
+		if command.OutputJSON() {
+			if err := command.PrintOutput(natList); err != nil {
+				os.Exit(1)
+			}
+			return
+		}
+
+		TablePrinter(natFlowTitle, natTranslationTitle, natList)
+	},
+}
+
+func init() {
+	bpfNatCmd.AddCommand(bpfNatListCmd)
+	command.AddJSONOutput(bpfNatListCmd)
+}
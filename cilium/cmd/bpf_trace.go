@@ -0,0 +1,44 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"strconv"
+
+	"github.com/spf13/cobra"
+)
+
+var bpfTraceCmd = &cobra.Command{
+	Use:   "trace",
+	Short: "Runtime trace and drop notification configuration",
+}
+
+func init() {
+	bpfCmd.AddCommand(bpfTraceCmd)
+}
+
+// parseTraceEndpointID parses the endpoint ID argument of the trace
+// commands, 0 selects programs not attached to an endpoint.
+func parseTraceEndpointID(cmd *cobra.Command, args []string) uint16 {
+	if len(args) < 1 || args[0] == "" {
+		Usagef(cmd, "Please specify the endpoint ID")
+	}
+
+	id, err := strconv.ParseUint(args[0], 10, 16)
+	if err != nil {
+		Fatalf("Unable to parse endpoint ID '%s': %s", args[0], err)
+	}
+	return uint16(id)
+}
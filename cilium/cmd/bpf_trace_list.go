@@ -0,0 +1,63 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"fmt"
+	"os"
+
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/command"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
+
+	"github.com/spf13/cobra"
+)
+
+const (
+	traceEndpointTitle = "ENDPOINT"
+	traceConfigTitle   = "TRACE CONFIGURATION"
+)
+
+var bpfTraceListCmd = &cobra.Command{
+	Use:     "list",
+	Aliases: []string{"ls"},
+	Short:   "List endpoints with overridden trace settings",
+	Run: func(cmd *cobra.Command, args []string) {
+		common.RequireRootPrivilege("cilium bpf trace list")
+
+		traceList := make(map[string][]string)
+		err := tracemap.Dump(func(id uint16, cfg *tracemap.Config) {
+			key := fmt.Sprintf("%d", id)
+			traceList[key] = append(traceList[key], cfg.String())
+		})
+		if err != nil {
+			Fatalf("Unable to dump trace configuration: %s", err)
+		}
+
+		if command.OutputJSON() {
+			if err := command.PrintOutput(traceList); err != nil {
+				os.Exit(1)
+			}
+			return
+		}
+
+		TablePrinter(traceEndpointTitle, traceConfigTitle, traceList)
+	},
+}
+
+func init() {
+	bpfTraceCmd.AddCommand(bpfTraceListCmd)
+	command.AddJSONOutput(bpfTraceListCmd)
+}
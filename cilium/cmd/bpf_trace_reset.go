@@ -0,0 +1,39 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
+
+	"github.com/spf13/cobra"
+)
+
+var bpfTraceResetCmd = &cobra.Command{
+	Use:   "reset <endpoint id>",
+	Short: "Restore default trace and drop notification settings of an endpoint",
+	Run: func(cmd *cobra.Command, args []string) {
+		common.RequireRootPrivilege("cilium bpf trace reset")
+
+		id := parseTraceEndpointID(cmd, args)
+		if err := tracemap.Reset(id); err != nil {
+			Fatalf("Unable to reset trace configuration: %s", err)
+		}
+	},
+}
+
+func init() {
+	bpfTraceCmd.AddCommand(bpfTraceResetCmd)
+}
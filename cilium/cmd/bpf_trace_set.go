@@ -0,0 +1,89 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"math"
+
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
+	"github.com/cilium/cilium/pkg/monitor"
+
+	"github.com/spf13/cobra"
+)
+
+var (
+	traceCapLen        uint
+	traceSampleRate    uint
+	traceObsPoints     []string
+	traceNoAggregation bool
+)
+
+var bpfTraceSetCmd = &cobra.Command{
+	Use:   "set <endpoint id>",
+	Short: "Override trace and drop notification settings of an endpoint",
+	Long: `Override trace and drop notification settings of an endpoint
+
+The settings take effect immediately without regenerating the endpoint.
+Endpoint ID 0 applies to programs which are not attached to an endpoint.
+Settings are cleared when the endpoint is deleted.`,
+	Example: `  cilium bpf trace set 4711 --cap-len 1500 --no-aggregation
+  cilium bpf trace set 4711 --sample 100 --obs-points to-endpoint,from-endpoint`,
+	Run: func(cmd *cobra.Command, args []string) {
+		common.RequireRootPrivilege("cilium bpf trace set")
+
+		id := parseTraceEndpointID(cmd, args)
+
+		if traceCapLen > math.MaxUint16 {
+			Fatalf("Capture length must be at most %d bytes", math.MaxUint16)
+		}
+		if traceSampleRate > math.MaxUint32 {
+			Fatalf("Sample rate must be at most %d", uint32(math.MaxUint32))
+		}
+
+		cfg := tracemap.Config{
+			CapLen:     uint16(traceCapLen),
+			SampleRate: uint32(traceSampleRate),
+			ObsPoints:  tracemap.AllObsPoints,
+		}
+
+		if len(traceObsPoints) > 0 {
+			cfg.ObsPoints = 0
+			for _, name := range traceObsPoints {
+				point, err := monitor.ParseObsPoint(name)
+				if err != nil {
+					Fatalf("%s, valid observation points: %v", err, monitor.ObsPointNames())
+				}
+				cfg.ObsPoints |= 1 << point
+			}
+		}
+
+		if traceNoAggregation {
+			cfg.Flags |= tracemap.FlagNoAggregation
+		}
+
+		if err := tracemap.Set(id, cfg); err != nil {
+			Fatalf("Unable to set trace configuration: %s", err)
+		}
+	},
+}
+
+func init() {
+	bpfTraceCmd.AddCommand(bpfTraceSetCmd)
+	bpfTraceSetCmd.Flags().UintVar(&traceCapLen, "cap-len", 0, "Number of packet bytes to capture, 0 uses the compiled in default")
+	bpfTraceSetCmd.Flags().UintVar(&traceSampleRate, "sample", 1, "Notify for 1 in N packets")
+	bpfTraceSetCmd.Flags().StringSliceVar(&traceObsPoints, "obs-points", nil, "Trace observation points to notify at (default all)")
+	bpfTraceSetCmd.Flags().BoolVar(&traceNoAggregation, "no-aggregation", false, "Ignore the monitor aggregation level")
+}
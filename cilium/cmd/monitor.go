@@ -168,6 +168,7 @@ func dropEvents(prefix string, data []byte) {
 	if err := binary.Read(bytes.NewReader(data), byteorder.Native, &dn); err != nil {
 		fmt.Printf("Error while parsing drop notification message: %s\n", err)
 	}
+	data = monitor.TrimCapture(data, monitor.DropNotifyLen, dn.CapLen)
 	if match(monitor.MessageTypeDrop, dn.Source, uint16(dn.DstID)) {
 		switch verbosity {
 		case INFO:
@@ -188,6 +189,7 @@ func traceEvents(prefix string, data []byte) {
 	if err := binary.Read(bytes.NewReader(data), byteorder.Native, &tn); err != nil {
 		fmt.Printf("Error while parsing trace notification message: %s\n", err)
 	}
+	data = monitor.TrimCapture(data, monitor.TraceNotifyLen, tn.CapLen)
 	if match(monitor.MessageTypeTrace, tn.Source, tn.DstID) {
 		switch verbosity {
 		case INFO:
@@ -201,6 +203,27 @@ func traceEvents(prefix string, data []byte) {
 	}
 }
 
+// traceFlowEvents prints out all the received flow summaries.
+func traceFlowEvents(prefix string, data []byte) {
+	tf := monitor.TraceFlowNotify{}
+
+	if err := monitor.DecodeTraceFlowNotify(data, &tf); err != nil {
+		fmt.Printf("Error while parsing flow notification message: %s\n", err)
+		return
+	}
+	if match(monitor.MessageTypeTraceFlow, tf.Source, tf.DstID) {
+		switch verbosity {
+		case INFO:
+			tf.DumpInfo()
+		case JSON:
+			tf.DumpJSON(prefix)
+		default:
+			fmt.Println(msgSeparator)
+			tf.DumpVerbose(prefix)
+		}
+	}
+}
+
 // debugEvents prints out all the debug messages.
 func debugEvents(prefix string, data []byte) {
 	dm := monitor.DebugMsg{}
@@ -227,6 +250,7 @@ func captureEvents(prefix string, data []byte) {
 	if err := binary.Read(bytes.NewReader(data), byteorder.Native, &dc); err != nil {
 		fmt.Printf("Error while parsing debug capture message: %s\n", err)
 	}
+	data = monitor.TrimCapture(data, monitor.DebugCaptureLen, dc.Len)
 	if match(monitor.MessageTypeCapture, dc.Source, 0) {
 		switch verbosity {
 		case INFO:
@@ -292,6 +316,8 @@ func receiveEvent(data []byte, cpu int) {
 		captureEvents(prefix, data)
 	case monitor.MessageTypeTrace:
 		traceEvents(prefix, data)
+	case monitor.MessageTypeTraceFlow:
+		traceFlowEvents(prefix, data)
 	case monitor.MessageTypeAccessLog:
 		logRecordEvents(prefix, data)
 	case monitor.MessageTypeAgent:
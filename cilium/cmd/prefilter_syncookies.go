@@ -0,0 +1,74 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package cmd
+
+import (
+	"fmt"
+	"os"
+	"sort"
+	"text/tabwriter"
+
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/command"
+	"github.com/cilium/cilium/pkg/maps/l4filtermap"
+	"github.com/cilium/cilium/pkg/maps/metricsmap"
+
+	"github.com/spf13/cobra"
+)
+
+var preFilterSynCookiesCmd = &cobra.Command{
+	Use:   "syncookies",
+	Short: "List SYN cookies sent and validated per service",
+	Long: `List SYN cookies sent and validated per service
+
+Only destinations matching a syncookie L4 prefilter rule which exceeded the
+SYN rate of the rule are listed.`,
+	Run: func(cmd *cobra.Command, args []string) {
+		common.RequireRootPrivilege("cilium prefilter syncookies")
+
+		stats := make(map[string]l4filtermap.SynCookieStats)
+		err := metricsmap.DumpSynCookieStats(func(key *l4filtermap.BucketKey, value *l4filtermap.SynCookieStats) {
+			stats[key.String()] = *value
+		})
+		if err != nil {
+			Fatalf("Unable to dump SYN cookie stats: %s", err)
+		}
+
+		if command.OutputJSON() {
+			if err := command.PrintOutput(stats); err != nil {
+				os.Exit(1)
+			}
+			return
+		}
+
+		services := make([]string, 0, len(stats))
+		for svc := range stats {
+			services = append(services, svc)
+		}
+		sort.Strings(services)
+
+		w := tabwriter.NewWriter(os.Stdout, 5, 0, 3, ' ', 0)
+		fmt.Fprintln(w, "SERVICE\tSENT\tVALIDATED\t")
+		for _, svc := range services {
+			fmt.Fprintf(w, "%s\t%d\t%d\t\n", svc, stats[svc].Sent, stats[svc].Validated)
+		}
+		w.Flush()
+	},
+}
+
+func init() {
+	preFilterCmd.AddCommand(preFilterSynCookiesCmd)
+	command.AddJSONOutput(preFilterSynCookiesCmd)
+}
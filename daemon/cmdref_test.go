@@ -0,0 +1,59 @@
+// Copyright 2017 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package main
+
+import (
+	"io/ioutil"
+	"path/filepath"
+	"regexp"
+	"testing"
+
+	"github.com/spf13/cobra/doc"
+)
+
+// mtuDefault matches the auto-detected default of --mtu, which depends on
+// the host running the test.
+var mtuDefault = regexp.MustCompile(`(?m)^(\s*--mtu .*\(default )[0-9]+\)$`)
+
+// TestCmdref checks that all agent flags can be registered, which panics on
+// duplicate names as soon as the test binary starts, and that the command
+// reference is up to date with them.
+func TestCmdref(t *testing.T) {
+	dir, err := ioutil.TempDir("", "cilium-cmdref")
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	RootCmd.DisableAutoGenTag = true
+	if err := doc.GenMarkdownTreeCustom(RootCmd, dir, filePrepend, linkHandler); err != nil {
+		t.Fatal(err)
+	}
+
+	generated, err := ioutil.ReadFile(filepath.Join(dir, "cilium-agent.md"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	committed, err := ioutil.ReadFile("../Documentation/cmdref/cilium-agent.md")
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	normalize := func(b []byte) string {
+		return mtuDefault.ReplaceAllString(string(b), "${1})")
+	}
+	if normalize(generated) != normalize(committed) {
+		t.Errorf("Documentation/cmdref/cilium-agent.md is out of date, run 'make -C Documentation cmdref'")
+	}
+}
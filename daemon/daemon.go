@@ -55,13 +55,16 @@ import (
 	"github.com/cilium/cilium/pkg/lock"
 	"github.com/cilium/cilium/pkg/logging"
 	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/maps/bwmap"
 	"github.com/cilium/cilium/pkg/maps/ctmap"
 	ipcachemap "github.com/cilium/cilium/pkg/maps/ipcache"
 	"github.com/cilium/cilium/pkg/maps/lbmap"
 	"github.com/cilium/cilium/pkg/maps/lxcmap"
 	"github.com/cilium/cilium/pkg/maps/metricsmap"
+	"github.com/cilium/cilium/pkg/maps/natmap"
 	"github.com/cilium/cilium/pkg/maps/policymap"
 	"github.com/cilium/cilium/pkg/maps/proxymap"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
 	"github.com/cilium/cilium/pkg/maps/tunnel"
 	"github.com/cilium/cilium/pkg/monitor"
 	"github.com/cilium/cilium/pkg/mtu"
@@ -99,6 +102,7 @@ const (
 	initArgDevicePreFilter
 	initArgModePreFilter
 	initArgMTU
+	initArgCgroupRoot
 	initArgMax
 )
 
@@ -338,9 +342,29 @@ func (d *Daemon) writePreFilterHeader(dir string) error {
 	fmt.Fprintf(fw, " * XDP mode: %s\n", option.Config.ModePreFilter)
 	fmt.Fprint(fw, " */\n\n")
 	d.preFilter.WriteConfig(fw)
+	if option.Config.PreFilterSampleRate > 0 {
+		fmt.Fprintf(fw, "#define PREFILTER_SAMPLE_RATE %d\n", option.Config.PreFilterSampleRate)
+	}
 	return fw.Flush()
 }
 
+func (d *Daemon) initPreFilterL4() error {
+	rules := make([]policy.L4FilterRule, 0, len(option.Config.PreFilterL4Rules))
+	for _, s := range option.Config.PreFilterL4Rules {
+		rule, err := policy.ParseL4FilterRule(s)
+		if err != nil {
+			return err
+		}
+		rules = append(rules, rule)
+	}
+
+	if err := d.preFilter.EnableL4Filter(option.Config.PreFilterRateLimitPrefixV4,
+		option.Config.PreFilterRateLimitPrefixV6); err != nil {
+		return err
+	}
+	return d.preFilter.ReplaceL4Rules(rules)
+}
+
 func (d *Daemon) setHostAddresses() error {
 	l, err := netlink.LinkByName(option.Config.LBInterface)
 	if err != nil {
@@ -410,6 +434,7 @@ const (
 	ciliumPostNatChain    = "CILIUM_POST"
 	ciliumPostMangleChain = "CILIUM_POST_mangle"
 	ciliumForwardChain    = "CILIUM_FORWARD"
+	ciliumPreRawChain     = "CILIUM_PRE_raw"
 	feederDescription     = "cilium-feeder:"
 )
 
@@ -530,6 +555,12 @@ var ciliumChains = []customChain{
 		hook:       "FORWARD",
 		feederArgs: []string{""},
 	},
+	{
+		name:       ciliumPreRawChain,
+		table:      "raw",
+		hook:       "PREROUTING",
+		feederArgs: []string{""},
+	},
 }
 
 func (d *Daemon) removeIptablesRules() {
@@ -669,6 +700,27 @@ func (d *Daemon) installIptablesRules() error {
 			"-j", "MASQUERADE"}, false); err != nil {
 			return err
 		}
+
+		// TCP and UDP traffic matching the rule above is masqueraded by
+		// the datapath when leaving the native device, exclude it from
+		// connection tracking so it bypasses the MASQUERADE rule as well.
+		// Traffic towards local addresses, including service addresses
+		// which are not handled by Cilium, is still tracked.
+		if option.Config.EnableBPFMasquerade {
+			for _, proto := range []string{"tcp", "udp"} {
+				if err := runProg("iptables", []string{
+					"-t", "raw",
+					"-A", ciliumPreRawChain,
+					"-p", proto,
+					"-s", node.GetIPv4AllocRange().String(),
+					"!", "-d", egressSnatDstAddrExclusion,
+					"-m", "addrtype", "!", "--dst-type", "LOCAL",
+					"-m", "comment", "--comment", "cilium: bpf masquerade notrack",
+					"-j", "NOTRACK"}, false); err != nil {
+					return err
+				}
+			}
+		}
 	}
 
 	for _, c := range ciliumChains {
@@ -715,6 +767,13 @@ func (d *Daemon) compileBase() error {
 			return ret
 		}
 
+		if len(option.Config.PreFilterL4Rules) > 0 {
+			if err := d.initPreFilterL4(); err != nil {
+				scopedLog.WithError(err).Warn("Unable to init L4 prefilter")
+				return err
+			}
+		}
+
 		if err := d.writePreFilterHeader("./"); err != nil {
 			scopedLog.WithError(err).Warn("Unable to write prefilter header")
 			return err
@@ -729,6 +788,7 @@ func (d *Daemon) compileBase() error {
 	args[initArgIPv4NodeIP] = node.GetInternalIPv4().String()
 	args[initArgIPv6NodeIP] = node.GetIPv6().String()
 	args[initArgMTU] = fmt.Sprintf("%d", mtu.GetDeviceMTU())
+	args[initArgCgroupRoot] = option.Config.CgroupRoot
 
 	if option.Config.Device != "undefined" {
 		_, err := netlink.LinkByName(option.Config.Device)
@@ -831,6 +891,22 @@ func (d *Daemon) init() error {
 			return err
 		}
 
+		d.syncDebugConfig()
+
+		// Addresses cached by the datapath while the agent was not
+		// running may be outdated.
+		if err := ipcachemap.BumpCacheGeneration(); err != nil {
+			log.WithError(err).Warning("Unable to invalidate datapath ipcache cache")
+		}
+
+		// Verdicts cached in conntrack entries by the previous instance
+		// of the agent must never be mistaken as current.
+		if option.Config.ConntrackPolicyCache {
+			if err := policymap.InitRevisions(); err != nil {
+				log.WithError(err).Warning("Unable to restore datapath policy revisions")
+			}
+		}
+
 		// Clean all endpoint entries
 		if err := lxcmap.LXCMap.DeleteAll(); err != nil {
 			return err
@@ -865,6 +941,42 @@ func (d *Daemon) init() error {
 				RunInterval: 5 * time.Second,
 			})
 
+		if len(option.Config.DropNotifyRateLimits) > 0 {
+			limits, err := tracemap.ParseDropLimits(option.Config.DropNotifyRateLimits)
+			if err != nil {
+				return err
+			}
+			if err := tracemap.SetDropLimits(limits); err != nil {
+				return err
+			}
+
+			// The bucket map is created once the first program is
+			// loaded, until then the sync simply retries.
+			controller.NewManager().UpdateController("drop-notify-bpf-prom-sync",
+				controller.ControllerParams{
+					DoFunc:      metricsmap.SyncDropNotifyMetrics,
+					RunInterval: 5 * time.Second,
+				})
+		}
+
+		// compileBase() has turned off the prefilter if the device does
+		// not support it. Its maps are created once bpf_xdp.o is loaded
+		// by init.sh, until then the sync simply retries.
+		if option.Config.DevicePreFilter != "undefined" {
+			controller.NewManager().UpdateController("prefilter-metrics-bpf-prom-sync",
+				controller.ControllerParams{
+					DoFunc:      metricsmap.SyncPrefilterMetrics,
+					RunInterval: 5 * time.Second,
+				})
+			if len(option.Config.PreFilterL4Rules) > 0 {
+				controller.NewManager().UpdateController("prefilter-syncookie-bpf-prom-sync",
+					controller.ControllerParams{
+						DoFunc:      metricsmap.SyncSynCookieMetrics,
+						RunInterval: 5 * time.Second,
+					})
+			}
+		}
+
 		if _, err := lbmap.Service6Map.OpenOrCreate(); err != nil {
 			return err
 		}
@@ -981,12 +1093,79 @@ func createNodeConfigHeaderfile() error {
 	fmt.Fprintf(fw, "#define PROXY_MAP_SIZE %d\n", proxymap.MaxEntries)
 	fmt.Fprintf(fw, "#define ENDPOINTS_MAP_SIZE %d\n", lxcmap.MaxEntries)
 	fmt.Fprintf(fw, "#define METRICS_MAP_SIZE %d\n", metricsmap.MaxEntries)
+	fmt.Fprintf(fw, "#define TRACE_CONFIG_MAP_SIZE %d\n", tracemap.MaxEntries)
 	fmt.Fprintf(fw, "#define POLICY_MAP_SIZE %d\n", policymap.MaxEntries)
 	fmt.Fprintf(fw, "#define IPCACHE_MAP_SIZE %d\n", ipcachemap.MaxEntries)
 	fmt.Fprintf(fw, "#define POLICY_PROG_MAP_SIZE %d\n", policymap.ProgArrayMaxEntries)
+	fmt.Fprintf(fw, "#define EP_POLICY_REV_MAP_SIZE %d\n", policymap.RevisionMaxEntries)
+	if policymap.LPMEnabled() {
+		fmt.Fprintf(fw, "#define POLICY_LPM\n")
+	}
+	if option.Config.PreAllocateMaps {
+		fmt.Fprintf(fw, "#define PREALLOCATE_MAPS\n")
+	}
 
 	fmt.Fprintf(fw, "#define TRACE_PAYLOAD_LEN %dULL\n", tracePayloadLen)
 
+	if option.Config.MonitorRingBufPages > 0 {
+		fmt.Fprintf(fw, "#define EVENTS_RINGBUF_SIZE %d\n", option.Config.MonitorRingBufPages*os.Getpagesize())
+	}
+
+	if option.Config.EndpointMetricsIdentities > 0 {
+		fmt.Fprintf(fw, "#define ENDPOINT_METRICS\n")
+		fmt.Fprintf(fw, "#define EP_METRICS_MAP_SIZE %d\n", metricsmap.EndpointMaxEntries)
+	}
+
+	if option.Config.ProxySkAssign {
+		fmt.Fprintf(fw, "#define ENABLE_PROXY_SK_ASSIGN\n")
+	}
+
+	if len(option.Config.DropNotifyRateLimits) > 0 {
+		fmt.Fprintf(fw, "#define DROP_NOTIFY_RATELIMIT\n")
+	}
+
+	if option.Config.ConntrackPolicyCache {
+		fmt.Fprintf(fw, "#define CT_POLICY_CACHE\n")
+	}
+
+	if option.Config.EnableBandwidthManager {
+		fmt.Fprintf(fw, "#define ENABLE_BANDWIDTH_MANAGER\n")
+		fmt.Fprintf(fw, "#define THROTTLE_MAP_SIZE %d\n", bwmap.MaxEntries)
+	}
+
+	if option.Config.EnableBPFMasquerade {
+		snatDstExclusion := node.GetIPv4AllocRange()
+		if option.Config.Tunnel == option.TunnelDisabled {
+			snatDstExclusion = node.GetIPv4ClusterRange()
+		}
+		fmt.Fprintf(fw, "#define ENABLE_MASQUERADE\n")
+		fmt.Fprintf(fw, "#define SNAT_IPV4_EXTERNAL %#x\n", byteorder.HostSliceToNetwork(node.GetExternalIPv4().To4(), reflect.Uint32).(uint32))
+		fmt.Fprintf(fw, "#define SNAT_IPV4_EXCLUDE_DST_CIDR %#x\n", byteorder.HostSliceToNetwork(snatDstExclusion.IP.To4(), reflect.Uint32).(uint32))
+		fmt.Fprintf(fw, "#define SNAT_IPV4_EXCLUDE_DST_MASK %#x\n", byteorder.HostSliceToNetwork(snatDstExclusion.Mask, reflect.Uint32).(uint32))
+		fmt.Fprintf(fw, "#define SNAT_MAPPING_MAP_SIZE %d\n", natmap.MaxEntries)
+		fmt.Fprintf(fw, "#define SNAT_FRAG_MAP_SIZE %d\n", natmap.FragMaxEntries)
+	}
+
+	if option.Config.EnableXDPDecap && option.Config.DevicePreFilter != "undefined" {
+		fmt.Fprintf(fw, "#define ENABLE_XDP_DECAP\n")
+	}
+
+	if option.Config.EnableSocketLB {
+		fmt.Fprintf(fw, "#define ENABLE_SOCKET_LB\n")
+		if option.Config.SocketLBSendmsg {
+			fmt.Fprintf(fw, "#define ENABLE_SOCKET_LB_SENDMSG\n")
+		}
+	}
+
+	if option.Config.ConntrackLifetimeSlack > 0 {
+		fmt.Fprintf(fw, "#define CT_LIFETIME_SLACK %d\n", option.Config.ConntrackLifetimeSlack)
+	}
+
+	if option.Config.IPCacheCacheSize > 0 {
+		fmt.Fprintf(fw, "#define IPCACHE_CACHE\n")
+		fmt.Fprintf(fw, "#define IPCACHE_CACHE_SIZE %d\n", option.Config.IPCacheCacheSize)
+	}
+
 	fw.Flush()
 	f.Close()
 
@@ -1098,6 +1277,46 @@ func NewDaemon() (*Daemon, error) {
 		return nil, fmt.Errorf("invalid daemon configuration: %s", err)
 	}
 
+	// In direct routing, the kernel resets the departure time of packets
+	// routed by the stack. The limits are enforced by the egress program
+	// of the native device, which is only loaded in "direct" mode.
+	if option.Config.EnableBandwidthManager && option.Config.Tunnel == option.TunnelDisabled &&
+		(option.Config.Device == "undefined" || option.Config.IsLBEnabled()) {
+		log.Warningf("--%s requires --device in direct routing mode, disabling it",
+			option.EnableBandwidthManagerName)
+		option.Config.EnableBandwidthManager = false
+	}
+
+	if option.Config.EnableBPFMasquerade && (!masquerade || option.Config.IPv4Disabled) {
+		log.Warningf("--%s requires IPv4 masquerading to be enabled, disabling it",
+			option.EnableBPFMasqueradeName)
+		option.Config.EnableBPFMasquerade = false
+	}
+
+	if option.Config.SocketLBSendmsg && !option.Config.EnableSocketLB {
+		log.Warningf("--%s has no effect without --%s",
+			option.SocketLBSendmsgName, option.EnableSocketLBName)
+	}
+
+	if option.Config.EnableXDPDecap {
+		switch {
+		case option.Config.DevicePreFilter == "undefined":
+			log.Warningf("--%s requires --prefilter-device, disabling it", option.EnableXDPDecapName)
+			option.Config.EnableXDPDecap = false
+		case option.Config.Tunnel == option.TunnelDisabled:
+			log.Warningf("--%s requires tunneling, disabling it", option.EnableXDPDecapName)
+			option.Config.EnableXDPDecap = false
+		case option.Config.EnableBPFMasquerade:
+			log.Warningf("--%s cannot be combined with --%s, disabling it",
+				option.EnableXDPDecapName, option.EnableBPFMasqueradeName)
+			option.Config.EnableXDPDecap = false
+		}
+	}
+
+	if option.Config.DebugRateLimit < 0 {
+		return nil, fmt.Errorf("invalid --%s: must not be negative", option.DebugRateLimitName)
+	}
+
 	if err := workloads.Setup(option.Config.Workloads, map[string]string{}); err != nil {
 		return nil, fmt.Errorf("unable to setup workload: %s", err)
 	}
@@ -1451,9 +1670,53 @@ func (d *Daemon) staleMapWalker(path string) error {
 	return nil
 }
 
+// validateEventsRingBuf reports the events ring buffer as outdated if it
+// has been disabled or resized. The datapath recreates it when compiled.
+func validateEventsRingBuf(path string) (bool, error) {
+	size := option.Config.MonitorRingBufPages * os.Getpagesize()
+	if size == 0 {
+		return false, nil
+	}
+
+	fd, err := bpf.ObjGet(path)
+	if err != nil {
+		return false, err
+	}
+	defer bpf.ObjClose(fd)
+
+	info, err := bpf.GetMapInfo(os.Getpid(), fd)
+	if err != nil {
+		return false, err
+	}
+	return int(info.MaxEntries) == size, nil
+}
+
+// validateIPCacheCache reports the ipcache cache as outdated if it has been
+// disabled or resized. The datapath recreates it when compiled.
+func validateIPCacheCache(path string) (bool, error) {
+	size := option.Config.IPCacheCacheSize
+	if size == 0 {
+		return false, nil
+	}
+
+	fd, err := bpf.ObjGet(path)
+	if err != nil {
+		return false, err
+	}
+	defer bpf.ObjClose(fd)
+
+	info, err := bpf.GetMapInfo(os.Getpid(), fd)
+	if err != nil {
+		return false, err
+	}
+	return int(info.MaxEntries) == size, nil
+}
+
 func mapValidateWalker(path string) error {
 	prefixToValidator := map[string]bpf.MapValidator{
-		policymap.MapName: policymap.Validate,
+		policymap.MapName:        policymap.Validate,
+		bpf.EventsRingBufMapName: validateEventsRingBuf,
+		ipcachemap.CacheMapName:  validateIPCacheCache,
 	}
 
 	filename := filepath.Base(path)
@@ -1476,6 +1739,14 @@ func mapValidateWalker(path string) error {
 	return nil
 }
 
+// syncDebugConfig enables or disables the debug messages of the programs
+// not attached to an endpoint according to the Debug option of the daemon.
+func (d *Daemon) syncDebugConfig() {
+	if err := tracemap.SetDebug(0, d.DebugEnabled(), uint32(option.Config.DebugRateLimit)); err != nil {
+		log.WithError(err).Warning("Unable to update datapath debug configuration")
+	}
+}
+
 func changedOption(key string, value int, data interface{}) {
 	d := data.(*Daemon)
 	if key == option.Debug {
@@ -1483,6 +1754,7 @@ func changedOption(key string, value int, data interface{}) {
 		logging.ToggleDebugLogs(d.DebugEnabled())
 		// Reflect log level change to proxies
 		proxy.ChangeLogLevel(log.Level)
+		d.syncDebugConfig()
 	}
 	d.policy.BumpRevision() // force policy recalculation
 }
@@ -1546,11 +1818,19 @@ func (h *patchConfig) Handle(params PatchConfigParams) middleware.Responder {
 		log.Debug("finished configuring PolicyEnforcement for daemon")
 	}
 
+	// Runtime options are applied to the datapath by changedOption
+	runtimeOnly := changes == 0 && len(cfgSpec.Options) > 0
+	for k := range cfgSpec.Options {
+		if !option.Config.Opts.Library.IsRuntime(k) {
+			runtimeOnly = false
+		}
+	}
+
 	changes += option.Config.Opts.ApplyValidated(cfgSpec.Options, changedOption, d)
 
 	log.WithField("count", changes).Debug("Applied changes to daemon's configuration")
 
-	if changes > 0 {
+	if changes > 0 && !runtimeOnly {
 		// Only recompile if configuration has changed.
 		log.Debug("daemon configuration has changed; recompiling base programs")
 		if err := d.compileBase(); err != nil {
@@ -37,8 +37,12 @@ import (
 	"github.com/cilium/cilium/pkg/ipcache"
 	"github.com/cilium/cilium/pkg/labels"
 	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/maps/bwmap"
 	ipCacheBPF "github.com/cilium/cilium/pkg/maps/ipcache"
 	"github.com/cilium/cilium/pkg/maps/lxcmap"
+	"github.com/cilium/cilium/pkg/maps/metricsmap"
+	"github.com/cilium/cilium/pkg/maps/policymap"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
 	"github.com/cilium/cilium/pkg/node"
 	"github.com/cilium/cilium/pkg/option"
 	"github.com/cilium/cilium/pkg/uuid"
@@ -514,6 +518,33 @@ func (d *Daemon) deleteEndpointQuiet(ep *endpoint.Endpoint, releaseIP bool) []er
 			errors = append(errors, fmt.Errorf("unable to remove IPv4 CT map %s: %s", ep.Ct4MapPathLocked(), err))
 		}
 
+		// Clear any trace configuration so it does not apply to a
+		// future endpoint reusing the ID
+		if err := tracemap.Reset(ep.ID); err != nil {
+			errors = append(errors, fmt.Errorf("unable to reset trace configuration of endpoint %d: %s", ep.ID, err))
+		}
+		if err := tracemap.SetDebug(ep.ID, false, 0); err != nil {
+			errors = append(errors, fmt.Errorf("unable to reset debug configuration of endpoint %d: %s", ep.ID, err))
+		}
+
+		if option.Config.EndpointMetricsIdentities > 0 {
+			if err := metricsmap.DeleteEndpointEntries(ep.ID); err != nil {
+				errors = append(errors, fmt.Errorf("unable to delete metrics of endpoint %d: %s", ep.ID, err))
+			}
+		}
+
+		if option.Config.ConntrackPolicyCache {
+			if err := policymap.DeleteRevision(ep.ID); err != nil {
+				errors = append(errors, fmt.Errorf("unable to delete policy revision of endpoint %d: %s", ep.ID, err))
+			}
+		}
+
+		if option.Config.EnableBandwidthManager {
+			if err := bwmap.Delete(ep.ID); err != nil {
+				errors = append(errors, fmt.Errorf("unable to delete bandwidth limit of endpoint %d: %s", ep.ID, err))
+			}
+		}
+
 		// Remove handle_policy() tail call entry for EP
 		if err := ep.RemoveFromGlobalPolicyMap(); err != nil {
 			errors = append(errors, fmt.Errorf("unable to remove endpoint from global policy map: %s", err))
@@ -904,6 +935,11 @@ func (d *Daemon) OnIPIdentityCacheChange(modType ipcache.CacheModification, cidr
 		}
 	default:
 		scopedLog.Warning("cache modification type not supported")
+		return
+	}
+
+	if err := ipCacheBPF.BumpCacheGeneration(); err != nil {
+		scopedLog.WithError(err).Warning("unable to invalidate datapath ipcache cache")
 	}
 }
 
@@ -952,6 +988,11 @@ func (d *Daemon) OnIPIdentityCacheGC() {
 					return fmt.Errorf("error dumping ipcache BPF map: %s", err)
 				}
 
+				// Deleted addresses may be cached by the datapath.
+				if len(keysToRemove) > 0 {
+					defer ipCacheBPF.BumpCacheGeneration()
+				}
+
 				// Remove all keys which are not in in-memory cache from BPF map
 				// for consistency.
 				for _, k := range keysToRemove {
@@ -40,6 +40,7 @@ import (
 	"github.com/cilium/cilium/pkg/labels"
 	"github.com/cilium/cilium/pkg/lock"
 	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/maps/bwmap"
 	bpfIPCache "github.com/cilium/cilium/pkg/maps/ipcache"
 	"github.com/cilium/cilium/pkg/metrics"
 	"github.com/cilium/cilium/pkg/node"
@@ -1755,6 +1756,44 @@ func (d *Daemon) addK8sPodV1(pod *v1.Pod) {
 	default:
 		logger.Debug("Updated ipcache map entry on pod add")
 	}
+
+	if option.Config.EnableBandwidthManager {
+		d.updatePodBandwidth(pod)
+	}
+}
+
+// updatePodBandwidth applies the egress bandwidth annotation of the pod to
+// its endpoint. The pod is updated with its IP after the endpoint has been
+// created, so the limit is in place shortly after the endpoint is.
+func (d *Daemon) updatePodBandwidth(pod *v1.Pod) {
+	podNSName := k8sUtils.GetObjNamespaceName(&pod.ObjectMeta)
+
+	podEP := endpointmanager.LookupPodName(podNSName)
+	if podEP == nil {
+		return
+	}
+
+	scopedLog := log.WithFields(logrus.Fields{
+		logfields.EndpointID: podEP.ID,
+		"pod":                podNSName,
+	})
+
+	bandwidth, ok := pod.Annotations[annotation.EgressBandwidth]
+	if !ok {
+		if err := bwmap.Delete(podEP.ID); err != nil {
+			scopedLog.WithError(err).Warning("Unable to remove egress bandwidth limit")
+		}
+		return
+	}
+
+	bytesPerSecond, err := bwmap.ParseBandwidth(bandwidth)
+	if err != nil {
+		scopedLog.WithError(err).Warningf("Ignoring annotation %s", annotation.EgressBandwidth)
+		return
+	}
+	if err := bwmap.Update(podEP.ID, bytesPerSecond); err != nil {
+		scopedLog.WithError(err).Warning("Unable to set egress bandwidth limit")
+	}
 }
 
 func (d *Daemon) updateK8sPodV1(oldK8sPod, newK8sPod *v1.Pod) {
@@ -43,6 +43,8 @@ import (
 	"github.com/cilium/cilium/pkg/labels"
 	"github.com/cilium/cilium/pkg/logging"
 	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/maps/ctmap"
+	"github.com/cilium/cilium/pkg/maps/policymap"
 	"github.com/cilium/cilium/pkg/metrics"
 	"github.com/cilium/cilium/pkg/monitor"
 	"github.com/cilium/cilium/pkg/mtu"
@@ -314,6 +316,11 @@ func checkMinRequirements() {
 	if err := os.MkdirAll(globalsDir, defaults.StateDirRights); err != nil {
 		log.WithError(err).WithField(logfields.Path, globalsDir).Fatal("Could not create runtime directory")
 	}
+	// Endpoint program templates are only valid for the configuration of
+	// this run, they are compiled again on demand.
+	if err := os.RemoveAll(option.Config.GetTemplatesDir()); err != nil {
+		log.WithError(err).WithField(logfields.Path, option.Config.GetTemplatesDir()).Warning("Could not remove endpoint program templates")
+	}
 	if err := os.Chdir(option.Config.LibDir); err != nil {
 		log.WithError(err).WithField(logfields.Path, option.Config.LibDir).Fatal("Could not change to runtime directory")
 	}
@@ -436,6 +443,42 @@ func init() {
 	flags.String(option.MonitorAggregationName, "None",
 		"Level of monitor aggregation for traces from the datapath")
 	viper.BindEnv(option.MonitorAggregationName, "CILIUM_MONITOR_AGGREGATION_LEVEL")
+	flags.IntVar(&option.Config.MonitorRingBufPages,
+		option.MonitorRingBufPagesName, 0, "Number of pages (power of 2) of a BPF ring buffer shared by all CPUs for datapath events, used instead of per-CPU perf buffers if supported by the kernel (0 is off)")
+	flags.IntVar(&option.Config.EndpointMetricsIdentities,
+		option.EndpointMetricsIdentitiesName, 0, "Number of remote identities per endpoint with separate datapath traffic counters, requires LRU map support (0 disables per endpoint metrics)")
+	flags.BoolVar(&option.Config.PolicyMapLPM,
+		option.PolicyMapLPMName, false, "Resolve policy with a single lookup in endpoint policy maps backed by LPM tries, if supported by the kernel")
+	flags.BoolVar(&option.Config.ProxySkAssign,
+		option.ProxySkAssignName, false, "Redirect connections to L7 proxies by assigning them to the proxy socket without translating their destination, if supported by the kernel")
+	flags.IntVar(&option.Config.IPCacheCacheSize,
+		option.IPCacheCacheSizeName, 0, "Number of destination addresses cached per CPU in front of the ipcache, requires LRU map support (0 disables the cache)")
+	flags.StringSliceVar(&option.Config.DropNotifyRateLimits,
+		option.DropNotifyRateLimitName, []string{}, "Rate limit of drop notifications <reason>=<pps>[:<burst>] per CPU, reason is a drop reason number or 'all'; drops beyond the limit are only counted")
+	flags.BoolVar(&option.Config.PreAllocateMaps,
+		option.PreAllocateMapsName, true, "Preallocate the entries of endpoint policy and connection tracking hash tables, disabling it reduces memory usage at the cost of an allocation per new entry")
+	flags.IntVar(&option.Config.ConntrackLifetimeSlack,
+		option.ConntrackLifetimeSlackName, 0, "Number of seconds the lifetime of a connection tracking entry may fall behind before the datapath refreshes it, avoids writing entries of busy connections on every packet (0 refreshes once per second)")
+	flags.BoolVar(&option.Config.ConntrackPolicyCache,
+		option.ConntrackPolicyCacheName, false, "Cache policy verdicts in connection tracking entries so that established connections skip policy and ipcache lookups until policy or ipcache change")
+	flags.BoolVar(&option.Config.EnableBandwidthManager,
+		option.EnableBandwidthManagerName, false, "Enforce the egress bandwidth limits of pods given by their kubernetes.io/egress-bandwidth annotation in the datapath, if supported by the kernel")
+	flags.BoolVar(&option.Config.EnableBPFMasquerade,
+		option.EnableBPFMasqueradeName, false, "Masquerade TCP and UDP traffic of endpoints leaving the node in BPF instead of iptables, bypassing netfilter connection tracking (requires services to be handled by Cilium)")
+	flags.BoolVar(&option.Config.EnableSocketLB,
+		option.EnableSocketLBName, false, "Translate services to backends on connect() of sockets instead of on every packet (requires kernel 4.17 or newer)")
+	flags.BoolVar(&option.Config.SocketLBSendmsg,
+		option.SocketLBSendmsgName, false, "Also translate services on sendmsg() of unconnected UDP sockets, replies are received from the backend address")
+	flags.StringVar(&option.Config.CgroupRoot,
+		option.CgroupRootName, defaults.CgroupRoot, "Path to the cgroup v2 hierarchy, mounted there if not mounted yet")
+	flags.IntVar(&option.Config.DebugRateLimit,
+		option.DebugRateLimitName, 0, "Maximum number of datapath debug messages per second and CPU of each endpoint with debugging enabled (0 for no limit)")
+	flags.BoolVar(&option.Config.EnableXDPDecap,
+		option.EnableXDPDecapName, false, "Decapsulate overlay traffic to local endpoints in XDP on the prefilter device")
+	flags.IntVar(&option.Config.BPFCompileCacheSize,
+		option.BPFCompileCacheSizeName, defaults.BPFCompileCacheSize, "Number of compiled endpoint programs cached across regenerations and restarts (0 disables the cache)")
+	flags.BoolVar(&option.Config.EndpointTemplates,
+		option.EndpointTemplatesName, false, "Compile endpoint programs once per configuration and write the constants of each endpoint into the object at load time")
 	flags.IntVar(&option.Config.MTU,
 		option.MTUName, mtu.AutoDetect(), "Overwrite auto-detected MTU of underlying network")
 	flags.StringVar(&v6Address,
@@ -468,6 +511,14 @@ func init() {
 		"prefilter-device", "", "undefined", "Device facing external network for XDP prefiltering")
 	flags.StringVarP(&option.Config.ModePreFilter,
 		"prefilter-mode", "", option.ModePreFilterNative, "Prefilter mode { "+option.ModePreFilterNative+" | "+option.ModePreFilterGeneric+" } (default: "+option.ModePreFilterNative+")")
+	flags.StringSliceVar(&option.Config.PreFilterL4Rules,
+		option.PreFilterL4RuleName, []string{}, "L4 prefilter rule <proto>[/<port>]={pass|drop|ratelimit:<pps>[:<burst>]|syncookie:<pps>[:<burst>]}, rate limits apply per CPU and source prefix, SYN cookie thresholds per CPU and destination")
+	flags.IntVar(&option.Config.PreFilterRateLimitPrefixV4,
+		option.PreFilterRateLimitPrefixV4Name, 24, "IPv4 source prefix length to aggregate prefilter rate limits on")
+	flags.IntVar(&option.Config.PreFilterRateLimitPrefixV6,
+		option.PreFilterRateLimitPrefixV6Name, 64, "IPv6 source prefix length to aggregate prefilter rate limits on")
+	flags.IntVar(&option.Config.PreFilterSampleRate,
+		option.PreFilterSampleRateName, 0, "Emit a drop notification for 1 in N packets dropped by the prefilter (0 is off)")
 	// We expect only one of the possible variables to be filled. The evaluation order is:
 	// --prometheus-serve-addr, CILIUM_PROMETHEUS_SERVE_ADDR, then PROMETHEUS_SERVE_ADDR
 	// The second environment variable (without the CILIUM_ prefix) is here to
@@ -638,6 +689,38 @@ func initEnv(cmd *cobra.Command) {
 			option.AllowLocalhostAuto, option.AllowLocalhostAlways, option.AllowLocalhostPolicy)
 	}
 
+	if n := option.Config.MonitorRingBufPages; n < 0 || n&(n-1) != 0 {
+		log.Fatalf("Invalid setting for --%s, must be 0 or a power of 2", option.MonitorRingBufPagesName)
+	}
+
+	if option.Config.EndpointMetricsIdentities < 0 {
+		log.Fatalf("Invalid setting for --%s, must not be negative", option.EndpointMetricsIdentitiesName)
+	}
+
+	if option.Config.IPCacheCacheSize < 0 {
+		log.Fatalf("Invalid setting for --%s, must not be negative", option.IPCacheCacheSizeName)
+	}
+
+	if option.Config.BPFCompileCacheSize < 0 {
+		log.Fatalf("Invalid setting for --%s, must not be negative", option.BPFCompileCacheSizeName)
+	}
+
+	if err := ctmap.ValidateLifetimeSlack(option.Config.ConntrackLifetimeSlack); err != nil {
+		log.Fatalf("Invalid setting for --%s: %s", option.ConntrackLifetimeSlackName, err)
+	}
+
+	if !option.Config.PreAllocateMaps {
+		bpf.DisableMapPreAllocation()
+	}
+
+	if option.Config.PolicyMapLPM && !policymap.EnableLPM() {
+		log.Warningf("Kernel does not support LPM tries for --%s, using hash tables", option.PolicyMapLPMName)
+	}
+
+	if option.Config.PreFilterSampleRate < 0 {
+		log.Fatalf("Invalid setting for --%s, must not be negative", option.PreFilterSampleRateName)
+	}
+
 	option.Config.ModePreFilter = strings.ToLower(option.Config.ModePreFilter)
 	switch option.Config.ModePreFilter {
 	case option.ModePreFilterNative:
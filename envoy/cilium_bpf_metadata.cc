@@ -29,10 +29,17 @@ public:
   createFilterFactoryFromProto(const Protobuf::Message& proto_config,
 			       Configuration::ListenerFactoryContext& context) override {
     auto config = std::make_shared<Filter::BpfMetadata::Config>(MessageUtil::downcastAndValidate<const ::cilium::BpfMetadata&>(proto_config), context);
-    // Set the socket mark option for the listen socket.
-    // Can use identity 0 on the listen socket option, as the bpf datapath is only interested
-    // in whether the proxy is ingress, egress, or if there is no proxy at all.
-    context.addListenSocketOption(std::make_shared<Cilium::SocketMarkOption>(0, config->is_ingress_));
+    if (config->sk_assign_) {
+      // Accepted connections inherit the mark of their first packet, which carries the source
+      // identity. The mark of the proxy is set on accepted connections instead, see
+      // Config::getMetadata().
+      context.addListenSocketOption(std::make_shared<Cilium::SocketTransparentOption>());
+    } else {
+      // Set the socket mark option for the listen socket.
+      // Can use identity 0 on the listen socket option, as the bpf datapath is only interested
+      // in whether the proxy is ingress, egress, or if there is no proxy at all.
+      context.addListenSocketOption(std::make_shared<Cilium::SocketMarkOption>(0, config->is_ingress_));
+    }
 
     return [config](Network::ListenerFilterManager &filter_manager) mutable -> void {
       filter_manager.addAcceptFilter(std::make_unique<Filter::BpfMetadata::Instance>(config));
@@ -81,7 +88,7 @@ createHostMap(Server::Configuration::ListenerFactoryContext& context) {
 } // namespace
 
 Config::Config(const ::cilium::BpfMetadata &config, Server::Configuration::ListenerFactoryContext& context)
-    : is_ingress_(config.is_ingress()) {
+    : is_ingress_(config.is_ingress()), sk_assign_(config.sk_assign()) {
   // Note: all instances use the bpf root of the first filter with non-empty bpf_root instantiated!
   std::string bpf_root = config.bpf_root();
   if (bpf_root.length() > 0) {
@@ -96,12 +103,39 @@ Config::Config(const ::cilium::BpfMetadata &config, Server::Configuration::Liste
   hosts_ = createHostMap(context);
 }
 
+// Connections assigned to the listen socket by the datapath keep their original destination and
+// carry the source identity in the mark, see ipv4_redirect_to_proxy_sk() in Cilium
+// bpf/lib/lxc.h. Returns false if the destination of the connection has been translated instead.
+bool Config::getAssignedMetadata(Network::ConnectionSocket& socket, uint32_t* identity, uint16_t* orig_dport) {
+  uint32_t mark = 0;
+  socklen_t len = sizeof(mark);
+  bool ok = false;
+
+  if (getsockopt(socket.fd(), SOL_SOCKET, SO_MARK, &mark, &len) == 0 &&
+      (mark & 0xF00) == 0x200 && socket.localAddress()->ip()) {
+    *identity = ((mark & 0xFF) << 16) | (mark >> 16);
+    *orig_dport = socket.localAddress()->ip()->port();
+    ok = true;
+  }
+
+  // Replies must carry the mark of the proxy
+  mark = Cilium::SocketMarkOption::markOf(0, is_ingress_);
+  if (setsockopt(socket.fd(), SOL_SOCKET, SO_MARK, &mark, sizeof(mark)) < 0) {
+    ENVOY_LOG(critical, "Socket option failure. Failed to set SO_MARK to {}: {}", mark,
+	      strerror(errno));
+  }
+  return ok;
+}
+
 bool Config::getMetadata(Network::ConnectionSocket& socket) {
   uint32_t source_identity, destination_identity = Cilium::ID::WORLD;
   uint16_t orig_dport, proxy_port;
   bool ok = false;
 
-  if (maps_) {
+  if (sk_assign_ && getAssignedMetadata(socket, &source_identity, &orig_dport)) {
+    proxy_port = 0; // no proxymap entry to remove
+    ok = true;
+  } else if (maps_) {
     ok = maps_->getBpfMetadata(socket, &source_identity, &orig_dport, &proxy_port);
   } else if (hosts_ && socket.remoteAddress()->ip() && socket.localAddress()->ip()) {
     // Resolve the source security ID
@@ -25,8 +25,10 @@ public:
   virtual ~Config() {}
 
   virtual bool getMetadata(Network::ConnectionSocket &socket);
+  bool getAssignedMetadata(Network::ConnectionSocket &socket, uint32_t* identity, uint16_t* orig_dport);
 
   bool is_ingress_;
+  bool sk_assign_;
   Cilium::ProxyMapSharedPtr maps_{};
   std::shared_ptr<const Cilium::PolicyHostMap> hosts_;
 };
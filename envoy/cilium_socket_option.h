@@ -4,6 +4,8 @@
 #include "envoy/network/listen_socket.h"
 #include "common/common/logger.h"
 
+#include <netinet/in.h>
+
 #include "proxymap.h"
 
 namespace Envoy {
@@ -18,9 +20,7 @@ public:
     if (state != envoy::api::v2::core::SocketOption::STATE_PREBIND) {
       return true;
     }
-    uint32_t cluster_id = (identity_ >> 16) & 0xFF;
-    uint32_t identity_id = (identity_ & 0xFFFF) << 16;
-    uint32_t mark = ((ingress_) ? 0xA00 : 0xB00) | cluster_id | identity_id;
+    uint32_t mark = markOf(identity_, ingress_);
     int rc = setsockopt(socket.fd(), SOL_SOCKET, SO_MARK, &mark, sizeof(mark));
     if (rc < 0) {
       if (errno == EPERM) {
@@ -44,10 +44,44 @@ public:
     key.emplace_back(uint8_t(identity_));
   }
 
+  // Must be kept in sync with getMagicMark() in Cilium pkg/proxy/mark.go
+  static uint32_t markOf(uint32_t identity, bool ingress) {
+    uint32_t cluster_id = (identity >> 16) & 0xFF;
+    uint32_t identity_id = (identity & 0xFFFF) << 16;
+    return ((ingress) ? 0xA00 : 0xB00) | cluster_id | identity_id;
+  }
+
   uint32_t identity_;
   bool ingress_;
 };
 
+// Allows the listen socket to accept connections assigned to it by the Cilium
+// datapath without translating their destination.
+class SocketTransparentOption : public Network::Socket::Option, public Logger::Loggable<Logger::Id::filter> {
+public:
+  bool setOption(Network::Socket& socket, envoy::api::v2::core::SocketOption::SocketState state) const override {
+    // Only set the option once per socket
+    if (state != envoy::api::v2::core::SocketOption::STATE_PREBIND) {
+      return true;
+    }
+    int one = 1;
+    int rc;
+    // Both options set the same flag of the socket, also for IPv4 connections to an IPv6 socket.
+    if (socket.localAddress()->ip() &&
+	socket.localAddress()->ip()->version() == Network::Address::IpVersion::v6) {
+      rc = setsockopt(socket.fd(), SOL_IPV6, IPV6_TRANSPARENT, &one, sizeof(one));
+    } else {
+      rc = setsockopt(socket.fd(), SOL_IP, IP_TRANSPARENT, &one, sizeof(one));
+    }
+    if (rc < 0) {
+      ENVOY_LOG(critical, "Socket option failure. Failed to set IP_TRANSPARENT: {}", strerror(errno));
+      return false;
+    }
+    return true;
+  }
+  void hashKey(std::vector<uint8_t>&) const override {}
+};
+
 class SocketOption : public SocketMarkOption {
 public:
   SocketOption(const ProxyMapSharedPtr& maps, uint32_t source_identity, uint32_t destination_identity, bool ingress, uint16_t port, uint16_t proxy_port)
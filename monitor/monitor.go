@@ -68,6 +68,7 @@ type Monitor struct {
 	listeners        map[*monitorListener]struct{}
 	nPages           int
 	monitorEvents    *bpf.PerCpuEvents
+	ringBufEvents    *bpf.RingBufEvents
 }
 
 type monitorListener struct {
@@ -148,7 +149,14 @@ func (m *Monitor) registerNewListener(parentCtx context.Context, conn net.Conn)
 		m.perfReaderCancel() // don't leak any old readers, just in case.
 		perfEventReaderCtx, cancel := context.WithCancel(parentCtx)
 		m.perfReaderCancel = cancel
-		go m.perfEventReader(perfEventReaderCtx, m.nPages)
+		// The datapath only creates the ring buffer if it was
+		// requested and is supported by the kernel, the agent removes
+		// it when switching back to perf buffers.
+		if _, err := os.Stat(bpf.MapPath(bpf.EventsRingBufMapName)); err == nil {
+			go m.ringBufEventReader(perfEventReaderCtx)
+		} else {
+			go m.perfEventReader(perfEventReaderCtx, m.nPages)
+		}
 	}
 
 	newListener := newMonitorListener(conn, m.removeListener)
@@ -199,6 +207,7 @@ func (m *Monitor) perfEventReader(stopCtx context.Context, nPages int) {
 	// also grab the callbacks we need to avoid locking again. These methods never change.
 	m.Lock()
 	m.monitorEvents = monitorEvents
+	m.ringBufEvents = nil
 	receiveEvent := m.receiveEvent
 	lostEvent := m.lostEvent
 	m.Unlock()
@@ -231,16 +240,73 @@ func (m *Monitor) perfEventReader(stopCtx context.Context, nPages int) {
 	}
 }
 
+// ringBufEventReader is a goroutine that reads events from the shared BPF
+// ring buffer. It is the equivalent of perfEventReader for datapaths that
+// were compiled with a ring buffer.
+func (m *Monitor) ringBufEventReader(stopCtx context.Context) {
+	scopedLog := log.WithField(logfields.StartTime, time.Now())
+	scopedLog.Info("Beginning to read BPF ring buffer")
+	defer scopedLog.Info("Stopped reading BPF ring buffer")
+
+	ringBufEvents, err := bpf.NewRingBufEvents(bpf.EventsRingBufMapName)
+	if err != nil {
+		scopedLog.WithError(err).Fatal("Cannot initialise BPF ring buffer")
+	}
+	defer ringBufEvents.CloseAll()
+
+	m.Lock()
+	m.ringBufEvents = ringBufEvents
+	m.monitorEvents = nil
+	m.Unlock()
+
+	receiveEvent := func(data []byte) {
+		pl := payload.Payload{Data: append([]byte(nil), data...), CPU: 0, Lost: 0, Type: payload.EventSample}
+		m.send(&pl)
+	}
+
+	last := time.Now()
+	for !isCtxDone(stopCtx) {
+		todo, err := ringBufEvents.Poll(pollTimeout)
+		switch {
+		case isCtxDone(stopCtx):
+			return
+
+		case err == syscall.EBADF:
+			return
+
+		case err != nil:
+			scopedLog.WithError(err).Error("Error in Poll")
+			continue
+		}
+
+		if todo > 0 {
+			ringBufEvents.ReadAll(receiveEvent)
+		}
+
+		if time.Since(last) > 5*time.Second {
+			last = time.Now()
+			m.dumpStat()
+		}
+	}
+}
+
 // dumpStat prints out the monitor status in JSON.
 func (m *Monitor) dumpStat() {
 	m.Lock()
 	defer m.Unlock()
 
-	c := int64(m.monitorEvents.Cpus)
-	n := int64(m.monitorEvents.Npages)
-	p := int64(m.monitorEvents.Pagesize)
-	l, u := m.monitorEvents.Stats()
-	ms := models.MonitorStatus{Cpus: c, Npages: n, Pagesize: p, Lost: int64(l), Unknown: int64(u)}
+	var ms models.MonitorStatus
+	if rb := m.ringBufEvents; rb != nil {
+		// A single buffer shared by all CPUs. Records that do not fit
+		// are dropped by the datapath and cannot be accounted here.
+		ms = models.MonitorStatus{Cpus: 1, Npages: int64(rb.Size / rb.Pagesize), Pagesize: int64(rb.Pagesize)}
+	} else {
+		c := int64(m.monitorEvents.Cpus)
+		n := int64(m.monitorEvents.Npages)
+		p := int64(m.monitorEvents.Pagesize)
+		l, u := m.monitorEvents.Stats()
+		ms = models.MonitorStatus{Cpus: c, Npages: n, Pagesize: p, Lost: int64(l), Unknown: int64(u)}
+	}
 
 	mp, err := json.Marshal(ms)
 	if err != nil {
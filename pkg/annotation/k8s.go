@@ -37,4 +37,9 @@ const (
 	// CiliumHostIP is the annotation name used to store the IPv4 address
 	// of the cilium host interface in the node's annotations.
 	CiliumHostIP = "io.cilium.network.ipv4-cilium-host"
+
+	// EgressBandwidth is the annotation name used to limit the egress
+	// bandwidth of a pod, in bits per second. The name is shared with the
+	// bandwidth CNI plugin.
+	EgressBandwidth = "kubernetes.io/egress-bandwidth"
 )
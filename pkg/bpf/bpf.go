@@ -36,23 +36,34 @@ var log = logging.DefaultLogger.WithField(logfields.LogSubsys, "bpf")
 
 const (
 	// BPF map type constants. Must match enum bpf_map_type from linux/bpf.h
-	BPF_MAP_TYPE_UNSPEC           = 0
-	BPF_MAP_TYPE_HASH             = 1
-	BPF_MAP_TYPE_ARRAY            = 2
-	BPF_MAP_TYPE_PROG_ARRAY       = 3
-	BPF_MAP_TYPE_PERF_EVENT_ARRAY = 4
-	BPF_MAP_TYPE_PERCPU_HASH      = 5
-	BPF_MAP_TYPE_PERCPU_ARRAY     = 6
-	BPF_MAP_TYPE_STACK_TRACE      = 7
-	BPF_MAP_TYPE_CGROUP_ARRAY     = 8
-	BPF_MAP_TYPE_LRU_HASH         = 9
-	BPF_MAP_TYPE_LRU_PERCPU_HASH  = 10
-	BPF_MAP_TYPE_LPM_TRIE         = 11
-	BPF_MAP_TYPE_ARRAY_OF_MAPS    = 12
-	BPF_MAP_TYPE_HASH_OF_MAPS     = 13
-	BPF_MAP_TYPE_DEVMAP           = 14
-	BPF_MAP_TYPE_SOCKMAP          = 15
-	BPF_MAP_TYPE_CPUMAP           = 16
+	BPF_MAP_TYPE_UNSPEC                = 0
+	BPF_MAP_TYPE_HASH                  = 1
+	BPF_MAP_TYPE_ARRAY                 = 2
+	BPF_MAP_TYPE_PROG_ARRAY            = 3
+	BPF_MAP_TYPE_PERF_EVENT_ARRAY      = 4
+	BPF_MAP_TYPE_PERCPU_HASH           = 5
+	BPF_MAP_TYPE_PERCPU_ARRAY          = 6
+	BPF_MAP_TYPE_STACK_TRACE           = 7
+	BPF_MAP_TYPE_CGROUP_ARRAY          = 8
+	BPF_MAP_TYPE_LRU_HASH              = 9
+	BPF_MAP_TYPE_LRU_PERCPU_HASH       = 10
+	BPF_MAP_TYPE_LPM_TRIE              = 11
+	BPF_MAP_TYPE_ARRAY_OF_MAPS         = 12
+	BPF_MAP_TYPE_HASH_OF_MAPS          = 13
+	BPF_MAP_TYPE_DEVMAP                = 14
+	BPF_MAP_TYPE_SOCKMAP               = 15
+	BPF_MAP_TYPE_CPUMAP                = 16
+	BPF_MAP_TYPE_XSKMAP                = 17
+	BPF_MAP_TYPE_SOCKHASH              = 18
+	BPF_MAP_TYPE_CGROUP_STORAGE        = 19
+	BPF_MAP_TYPE_REUSEPORT_SOCKARRAY   = 20
+	BPF_MAP_TYPE_PERCPU_CGROUP_STORAGE = 21
+	BPF_MAP_TYPE_QUEUE                 = 22
+	BPF_MAP_TYPE_STACK                 = 23
+	BPF_MAP_TYPE_SK_STORAGE            = 24
+	BPF_MAP_TYPE_DEVMAP_HASH           = 25
+	BPF_MAP_TYPE_STRUCT_OPS            = 26
+	BPF_MAP_TYPE_RINGBUF               = 27
 
 	// BPF syscall command constants. Must match enum bpf_cmd from linux/bpf.h
 	BPF_MAP_CREATE          = 0
@@ -95,6 +106,29 @@ const (
 	BPF_F_STACK_BUILD_ID = 1 << 5
 )
 
+// preAllocateMapFlags are the flags of hash tables created with the flags
+// returned by GetPreAllocateMapFlags()
+var preAllocateMapFlags uint32
+
+// DisableMapPreAllocation makes hash tables created with the flags returned
+// by GetPreAllocateMapFlags() allocate their entries on insertion instead of
+// when the map is created.
+func DisableMapPreAllocation() {
+	preAllocateMapFlags = BPF_F_NO_PREALLOC
+}
+
+// GetPreAllocateMapFlags returns the flags for maps of type mapType whose
+// entries are preallocated unless DisableMapPreAllocation() was called. Only
+// hash tables can allocate entries on insertion, LRU hash tables are always
+// preallocated.
+func GetPreAllocateMapFlags(mapType MapType) uint32 {
+	switch mapType {
+	case BPF_MAP_TYPE_HASH, BPF_MAP_TYPE_PERCPU_HASH:
+		return preAllocateMapFlags
+	}
+	return 0
+}
+
 // CreateMap creates a Map of type mapType, with key size keySize, a value size of
 // valueSize and the maximum amount of entries of maxEntries.
 // mapType should be one of the bpf_map_type in "uapi/linux/bpf.h"
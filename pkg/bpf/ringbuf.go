@@ -0,0 +1,196 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bpf
+
+import (
+	"fmt"
+	"os"
+	"path"
+	"sync/atomic"
+	"unsafe"
+
+	"golang.org/x/sys/unix"
+)
+
+const (
+	// EventsRingBufMapName is the name of the shared ring buffer used by
+	// the datapath for events instead of EventsMapName, see
+	// <bpf/lib/events.h>
+	EventsRingBufMapName = "cilium_events_rb"
+
+	// Must match BPF_RINGBUF_* in <linux/bpf.h>
+	ringBufBusyBit    = 1 << 31
+	ringBufDiscardBit = 1 << 30
+	ringBufHdrSize    = 8
+)
+
+// RingBufReceiveFunc is invoked for every record read from a ring buffer.
+// The data is only valid for the duration of the call.
+type RingBufReceiveFunc func(data []byte)
+
+// RingBufEvents is a reader for a BPF_MAP_TYPE_RINGBUF map. Unlike
+// PerCpuEvents a single buffer is shared by all CPUs and records are read
+// in the order in which they were reserved.
+type RingBufEvents struct {
+	// Size is the size of the data area in bytes
+	Size     int
+	Pagesize int
+
+	fd        int
+	consumer  []byte
+	producer  []byte
+	mask      uint64
+	poll      EPoll
+	discarded uint64
+}
+
+// NewRingBufEvents opens the pinned ring buffer 'mapName' and maps it into
+// memory for reading.
+func NewRingBufEvents(mapName string) (*RingBufEvents, error) {
+	var err error
+
+	e := &RingBufEvents{
+		Pagesize: os.Getpagesize(),
+		fd:       -1,
+	}
+
+	defer func() {
+		if err != nil {
+			e.CloseAll()
+		}
+	}()
+
+	mapPath := mapName
+	if !path.IsAbs(mapPath) {
+		mapPath = MapPath(mapPath)
+	}
+
+	e.fd, err = ObjGet(mapPath)
+	if err != nil {
+		return nil, err
+	}
+
+	info, err := GetMapInfo(os.Getpid(), e.fd)
+	if err != nil {
+		return nil, err
+	}
+	if info.MapType != BPF_MAP_TYPE_RINGBUF {
+		err = fmt.Errorf("map %s is of type %d, not a ring buffer", mapPath, info.MapType)
+		return nil, err
+	}
+	e.Size = int(info.MaxEntries)
+	e.mask = uint64(e.Size - 1)
+
+	// The consumer position lives in the first page and is written by
+	// user space. It is followed by the producer position page and the
+	// data area, which the kernel maps twice in a row so that records
+	// wrapping around the end can be read in one piece.
+	e.consumer, err = unix.Mmap(e.fd, 0, e.Pagesize,
+		unix.PROT_READ|unix.PROT_WRITE, unix.MAP_SHARED)
+	if err != nil {
+		err = fmt.Errorf("Unable to mmap ring buffer consumer page: %s", err)
+		return nil, err
+	}
+
+	e.producer, err = unix.Mmap(e.fd, int64(e.Pagesize), e.Pagesize+2*e.Size,
+		unix.PROT_READ, unix.MAP_SHARED)
+	if err != nil {
+		err = fmt.Errorf("Unable to mmap ring buffer data: %s", err)
+		return nil, err
+	}
+
+	e.poll.fd, err = unix.EpollCreate1(0)
+	if err != nil {
+		return nil, err
+	}
+
+	if err = e.poll.AddFD(e.fd, unix.EPOLLIN); err != nil {
+		return nil, err
+	}
+
+	return e, nil
+}
+
+// Poll waits for the kernel to signal new records.
+func (e *RingBufEvents) Poll(timeout int) (int, error) {
+	return e.poll.Poll(timeout)
+}
+
+func (e *RingBufEvents) consumerPos() *uint64 {
+	return (*uint64)(unsafe.Pointer(&e.consumer[0]))
+}
+
+func (e *RingBufEvents) producerPos() *uint64 {
+	return (*uint64)(unsafe.Pointer(&e.producer[0]))
+}
+
+// ReadAll consumes all committed records and returns the number of records
+// passed to 'receive'. It stops at the first record still being written.
+func (e *RingBufEvents) ReadAll(receive RingBufReceiveFunc) int {
+	n := 0
+	cons := atomic.LoadUint64(e.consumerPos())
+	prod := atomic.LoadUint64(e.producerPos())
+
+	for cons < prod {
+		off := e.Pagesize + int(cons&e.mask)
+		hdr := atomic.LoadUint32((*uint32)(unsafe.Pointer(&e.producer[off])))
+		if hdr&ringBufBusyBit != 0 {
+			break
+		}
+
+		size := int(hdr &^ (ringBufBusyBit | ringBufDiscardBit))
+		if hdr&ringBufDiscardBit == 0 {
+			start := off + ringBufHdrSize
+			receive(e.producer[start : start+size : start+size])
+			n++
+		} else {
+			e.discarded++
+		}
+
+		cons += uint64((size + ringBufHdrSize + 7) &^ 7)
+		atomic.StoreUint64(e.consumerPos(), cons)
+	}
+
+	return n
+}
+
+// Stats returns the number of records discarded by the datapath.
+func (e *RingBufEvents) Stats() uint64 {
+	return e.discarded
+}
+
+// CloseAll unmaps the ring buffer and releases all file descriptors.
+func (e *RingBufEvents) CloseAll() error {
+	var retErr error
+
+	e.poll.Close()
+
+	for _, m := range [][]byte{e.producer, e.consumer} {
+		if m == nil {
+			continue
+		}
+		if err := unix.Munmap(m); err != nil {
+			retErr = err
+		}
+	}
+	e.producer, e.consumer = nil, nil
+
+	if e.fd >= 0 {
+		unix.Close(e.fd)
+		e.fd = -1
+	}
+
+	return retErr
+}
@@ -56,6 +56,14 @@ const (
 	// PidFilePath is the path to the pid file for the agent.
 	PidFilePath = RuntimePath + "/cilium.pid"
 
+	// CgroupRoot is the path where the cgroup v2 hierarchy is mounted if
+	// it is not mounted there yet
+	CgroupRoot = RuntimePath + "/cgroupv2"
+
+	// BPFCompileCacheSize is the number of compiled endpoint programs
+	// kept in the compile cache
+	BPFCompileCacheSize = 512
+
 	// DefaultLogLevel is the alternative we provide to Debug
 	// We set this in pkg/logging.
 	DefaultLogLevel = logrus.InfoLevel
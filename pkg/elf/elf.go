@@ -0,0 +1,305 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package elf
+
+import (
+	"bytes"
+	"debug/elf"
+	"encoding/binary"
+	"fmt"
+	"io/ioutil"
+	"sort"
+	"unsafe"
+)
+
+const (
+	// opLdImm64 is the opcode of the 64 bit immediate load
+	// (BPF_LD | BPF_IMM | BPF_DW), which spans two instructions.
+	opLdImm64 = 0x18
+
+	// sizeofInsn is the size of a BPF instruction
+	sizeofInsn = 8
+)
+
+var (
+	sizeofSym = uint64(unsafe.Sizeof(elf.Sym64{}))
+	sizeofRel = uint64(unsafe.Sizeof(elf.Rel64{}))
+)
+
+// Substitutions describes how to specialize a template object.
+type Substitutions struct {
+	// Values maps undefined symbols to the value loaded by the
+	// instructions referring to their address, see
+	// <bpf/lib/static_data.h>.
+	Values map[string]uint64
+
+	// Symbols maps symbols, e.g. of maps, to their new name
+	Symbols map[string]string
+
+	// Sections maps sections to their new name
+	Sections map[string]string
+}
+
+// object is an ELF64 object file being modified in place
+type object struct {
+	data  []byte
+	order binary.ByteOrder
+	file  *elf.File
+	shoff uint64
+
+	// strtabs holds the string tables with added strings by section
+	// index. They are appended to the object once all changes are done.
+	strtabs map[int][]byte
+}
+
+// Substitute writes the object file at src with all substitutions applied
+// to dst. It fails if a relocation of a program refers to an undefined
+// symbol without a value, as the object could not be loaded.
+func Substitute(src, dst string, subst *Substitutions) error {
+	data, err := ioutil.ReadFile(src)
+	if err != nil {
+		return err
+	}
+
+	data, err = substitute(data, subst)
+	if err != nil {
+		return fmt.Errorf("unable to specialize %s: %s", src, err)
+	}
+
+	return ioutil.WriteFile(dst, data, 0644)
+}
+
+func substitute(data []byte, subst *Substitutions) ([]byte, error) {
+	f, err := elf.NewFile(bytes.NewReader(data))
+	if err != nil {
+		return nil, err
+	}
+	if f.Class != elf.ELFCLASS64 {
+		return nil, fmt.Errorf("unsupported class %s", f.Class)
+	}
+
+	o := &object{
+		data:    data,
+		order:   f.ByteOrder,
+		file:    f,
+		strtabs: map[int][]byte{},
+	}
+
+	var hdr elf.Header64
+	if err := o.read(0, &hdr); err != nil {
+		return nil, err
+	}
+	o.shoff = hdr.Shoff
+
+	symtab := -1
+	for i, sec := range f.Sections {
+		if sec.Type == elf.SHT_SYMTAB {
+			symtab = i
+			break
+		}
+	}
+	if symtab < 0 {
+		return nil, fmt.Errorf("no symbol table")
+	}
+
+	syms, names, err := o.symbols(symtab)
+	if err != nil {
+		return nil, err
+	}
+
+	for i, sec := range f.Sections {
+		if sec.Type != elf.SHT_REL || int(sec.Info) >= len(f.Sections) {
+			continue
+		}
+		if f.Sections[sec.Info].Flags&elf.SHF_EXECINSTR == 0 {
+			continue
+		}
+		if err := o.relocate(i, syms, names, subst.Values); err != nil {
+			return nil, err
+		}
+	}
+
+	strtab := int(f.Sections[symtab].Link)
+	for i := range syms {
+		if name, ok := subst.Symbols[names[i]]; ok {
+			syms[i].Name = o.addString(strtab, name)
+			o.write(f.Sections[symtab].Offset+uint64(i)*sizeofSym, &syms[i])
+		}
+	}
+
+	for i, sec := range f.Sections {
+		if name, ok := subst.Sections[sec.Name]; ok {
+			if err := o.renameSection(i, int(hdr.Shstrndx), name); err != nil {
+				return nil, err
+			}
+		}
+	}
+
+	return o.finish()
+}
+
+func (o *object) read(off uint64, v interface{}) error {
+	if off > uint64(len(o.data)) {
+		return fmt.Errorf("offset %#x out of bounds", off)
+	}
+	return binary.Read(bytes.NewReader(o.data[off:]), o.order, v)
+}
+
+func (o *object) write(off uint64, v interface{}) {
+	var buf bytes.Buffer
+	binary.Write(&buf, o.order, v)
+	copy(o.data[off:], buf.Bytes())
+}
+
+func (o *object) sectionHeader(i int) (uint64, *elf.Section64, error) {
+	off := o.shoff + uint64(i)*uint64(unsafe.Sizeof(elf.Section64{}))
+	shdr := &elf.Section64{}
+	return off, shdr, o.read(off, shdr)
+}
+
+// symbols returns the entries of the symbol table in section i together
+// with their names.
+func (o *object) symbols(i int) ([]elf.Sym64, []string, error) {
+	sec := o.file.Sections[i]
+	if int(sec.Link) >= len(o.file.Sections) {
+		return nil, nil, fmt.Errorf("invalid string table of symbol table")
+	}
+	strtab, err := o.file.Sections[sec.Link].Data()
+	if err != nil {
+		return nil, nil, err
+	}
+
+	syms := make([]elf.Sym64, sec.Size/sizeofSym)
+	if err := o.read(sec.Offset, syms); err != nil {
+		return nil, nil, err
+	}
+
+	names := make([]string, len(syms))
+	for j := range syms {
+		start := int(syms[j].Name)
+		if start >= len(strtab) {
+			return nil, nil, fmt.Errorf("invalid name of symbol %d", j)
+		}
+		end := bytes.IndexByte(strtab[start:], 0)
+		if end < 0 {
+			return nil, nil, fmt.Errorf("invalid name of symbol %d", j)
+		}
+		names[j] = string(strtab[start : start+end])
+	}
+
+	return syms, names, nil
+}
+
+// relocate writes the values of all symbols in values into the
+// instructions referred to by the relocation section i and removes the
+// relocations for them.
+func (o *object) relocate(i int, syms []elf.Sym64, names []string, values map[string]uint64) error {
+	sec := o.file.Sections[i]
+	prog := o.file.Sections[sec.Info]
+
+	rels := make([]elf.Rel64, sec.Size/sizeofRel)
+	if err := o.read(sec.Offset, rels); err != nil {
+		return err
+	}
+
+	kept := rels[:0]
+	for _, rel := range rels {
+		sym := int(elf.R_SYM64(rel.Info))
+		if sym >= len(syms) {
+			return fmt.Errorf("invalid symbol in section %s", sec.Name)
+		}
+
+		value, ok := values[names[sym]]
+		if !ok {
+			if elf.SectionIndex(syms[sym].Shndx) == elf.SHN_UNDEF {
+				return fmt.Errorf("unresolved symbol %q in section %s", names[sym], prog.Name)
+			}
+			kept = append(kept, rel)
+			continue
+		}
+
+		if rel.Off+2*sizeofInsn > prog.Size {
+			return fmt.Errorf("relocation of %q out of bounds of section %s", names[sym], prog.Name)
+		}
+		insn := prog.Offset + rel.Off
+		if o.data[insn] != opLdImm64 {
+			return fmt.Errorf("relocation of %q at %s+%#x is not a 64 bit immediate load",
+				names[sym], prog.Name, rel.Off)
+		}
+		o.order.PutUint32(o.data[insn+4:], uint32(value))
+		o.order.PutUint32(o.data[insn+sizeofInsn+4:], uint32(value>>32))
+	}
+
+	if len(kept) == len(rels) {
+		return nil
+	}
+
+	o.write(sec.Offset, kept)
+	off, shdr, err := o.sectionHeader(i)
+	if err != nil {
+		return err
+	}
+	shdr.Size = uint64(len(kept)) * sizeofRel
+	o.write(off, shdr)
+
+	return nil
+}
+
+func (o *object) renameSection(i, shstrtab int, name string) error {
+	off, shdr, err := o.sectionHeader(i)
+	if err != nil {
+		return err
+	}
+	shdr.Name = o.addString(shstrtab, name)
+	o.write(off, shdr)
+	return nil
+}
+
+// addString adds s to the string table in section i and returns its
+// offset. Existing strings are left in place as they may share their
+// suffix with other strings.
+func (o *object) addString(i int, s string) uint32 {
+	tab, ok := o.strtabs[i]
+	if !ok {
+		sec := o.file.Sections[i]
+		tab = append([]byte{}, o.data[sec.Offset:sec.Offset+sec.Size]...)
+	}
+	off := uint32(len(tab))
+	o.strtabs[i] = append(append(tab, s...), 0)
+	return off
+}
+
+// finish appends all modified string tables to the object and points their
+// section headers to them.
+func (o *object) finish() ([]byte, error) {
+	indices := make([]int, 0, len(o.strtabs))
+	for i := range o.strtabs {
+		indices = append(indices, i)
+	}
+	sort.Ints(indices)
+
+	for _, i := range indices {
+		off, shdr, err := o.sectionHeader(i)
+		if err != nil {
+			return nil, err
+		}
+		shdr.Off = uint64(len(o.data))
+		shdr.Size = uint64(len(o.strtabs[i]))
+		o.data = append(o.data, o.strtabs[i]...)
+		o.write(off, shdr)
+	}
+
+	return o.data, nil
+}
@@ -0,0 +1,215 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package elf
+
+import (
+	"bytes"
+	"debug/elf"
+	"encoding/binary"
+	"testing"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+const (
+	// sizeofHeader is the size of the ELF64 file header
+	sizeofHeader = 64
+
+	// rBPF64_64 is the relocation type R_BPF_64_64 of 64 bit immediate loads
+	rBPF64_64 = 1
+)
+
+type ELFSuite struct{}
+
+var _ = Suite(&ELFSuite{})
+
+// strtab builds a string table and records the offset of each string
+type strtab struct {
+	data []byte
+	offs map[string]uint32
+}
+
+func (s *strtab) add(str string) uint32 {
+	if s.offs == nil {
+		s.data = []byte{0}
+		s.offs = map[string]uint32{"": 0}
+	}
+	if off, ok := s.offs[str]; ok {
+		return off
+	}
+	off := uint32(len(s.data))
+	s.data = append(append(s.data, str...), 0)
+	s.offs[str] = off
+	return off
+}
+
+// templateObject returns an object with the program section "1/0xffff"
+// loading the placeholder SECLABEL and the address of the map
+// cilium_calls_tmpl, as emitted by clang for an endpoint program template.
+func templateObject() []byte {
+	le := binary.LittleEndian
+	var strs strtab
+
+	ldImm64 := func(imm uint32) []byte {
+		insn := make([]byte, 2*sizeofInsn)
+		insn[0] = opLdImm64
+		le.PutUint32(insn[4:], imm)
+		return insn
+	}
+	var prog []byte
+	prog = append(prog, ldImm64(0)...)
+	prog = append(prog, ldImm64(0)...)
+	prog = append(prog, 0x95, 0, 0, 0, 0, 0, 0, 0) // exit
+
+	var syms bytes.Buffer
+	binary.Write(&syms, le, []elf.Sym64{
+		{},
+		{
+			Name: strs.add("SECLABEL"),
+			Info: elf.ST_INFO(elf.STB_GLOBAL, elf.STT_NOTYPE),
+		},
+		{
+			Name:  strs.add("cilium_calls_tmpl"),
+			Info:  elf.ST_INFO(elf.STB_GLOBAL, elf.STT_OBJECT),
+			Shndx: 3,
+			Size:  4,
+		},
+	})
+
+	var rels bytes.Buffer
+	binary.Write(&rels, le, []elf.Rel64{
+		{Off: 0, Info: elf.R_INFO(1, rBPF64_64)},
+		{Off: 2 * sizeofInsn, Info: elf.R_INFO(2, rBPF64_64)},
+	})
+
+	sections := []struct {
+		hdr  elf.Section64
+		name string
+		data []byte
+	}{
+		{},
+		{
+			name: "1/0xffff",
+			hdr:  elf.Section64{Type: uint32(elf.SHT_PROGBITS), Flags: uint64(elf.SHF_ALLOC | elf.SHF_EXECINSTR)},
+			data: prog,
+		},
+		{
+			name: ".rel1/0xffff",
+			hdr:  elf.Section64{Type: uint32(elf.SHT_REL), Link: 4, Info: 1, Entsize: sizeofRel},
+			data: rels.Bytes(),
+		},
+		{
+			name: "maps",
+			hdr:  elf.Section64{Type: uint32(elf.SHT_PROGBITS), Flags: uint64(elf.SHF_ALLOC | elf.SHF_WRITE)},
+			data: make([]byte, 4),
+		},
+		{
+			name: ".symtab",
+			hdr:  elf.Section64{Type: uint32(elf.SHT_SYMTAB), Link: 5, Info: 1, Entsize: sizeofSym},
+			data: syms.Bytes(),
+		},
+		{
+			name: ".strtab",
+			hdr:  elf.Section64{Type: uint32(elf.SHT_STRTAB)},
+		},
+	}
+	for i := range sections {
+		sections[i].hdr.Name = strs.add(sections[i].name)
+	}
+	sections[5].data = strs.data
+
+	var body bytes.Buffer
+	off := uint64(sizeofHeader)
+	for i := range sections {
+		if i == 0 {
+			continue
+		}
+		sections[i].hdr.Off = off
+		sections[i].hdr.Size = uint64(len(sections[i].data))
+		body.Write(sections[i].data)
+		off += uint64(len(sections[i].data))
+	}
+
+	hdr := elf.Header64{
+		Type:      uint16(elf.ET_REL),
+		Machine:   uint16(elf.EM_BPF),
+		Version:   uint32(elf.EV_CURRENT),
+		Shoff:     off,
+		Ehsize:    sizeofHeader,
+		Shentsize: 64,
+		Shnum:     uint16(len(sections)),
+		Shstrndx:  5,
+	}
+	copy(hdr.Ident[:], elf.ELFMAG)
+	hdr.Ident[elf.EI_CLASS] = byte(elf.ELFCLASS64)
+	hdr.Ident[elf.EI_DATA] = byte(elf.ELFDATA2LSB)
+	hdr.Ident[elf.EI_VERSION] = byte(elf.EV_CURRENT)
+
+	var obj bytes.Buffer
+	binary.Write(&obj, le, &hdr)
+	obj.Write(body.Bytes())
+	for i := range sections {
+		binary.Write(&obj, le, &sections[i].hdr)
+	}
+	return obj.Bytes()
+}
+
+func (s *ELFSuite) TestSubstitute(c *C) {
+	data, err := substitute(templateObject(), &Substitutions{
+		Values:   map[string]uint64{"SECLABEL": 0x100000002},
+		Symbols:  map[string]string{"cilium_calls_tmpl": "cilium_calls_00042"},
+		Sections: map[string]string{"1/0xffff": "1/0x2a"},
+	})
+	c.Assert(err, IsNil)
+
+	f, err := elf.NewFile(bytes.NewReader(data))
+	c.Assert(err, IsNil)
+
+	c.Assert(f.Section("1/0xffff"), IsNil)
+	prog := f.Section("1/0x2a")
+	c.Assert(prog, Not(IsNil))
+	insns, err := prog.Data()
+	c.Assert(err, IsNil)
+	c.Assert(binary.LittleEndian.Uint32(insns[4:]), Equals, uint32(2))
+	c.Assert(binary.LittleEndian.Uint32(insns[12:]), Equals, uint32(1))
+
+	// Only the relocation of the map is left
+	rels := f.Section(".rel1/0xffff")
+	c.Assert(rels, Not(IsNil))
+	c.Assert(rels.Size, Equals, sizeofRel)
+	relData, err := rels.Data()
+	c.Assert(err, IsNil)
+	var rel elf.Rel64
+	c.Assert(binary.Read(bytes.NewReader(relData), binary.LittleEndian, &rel), IsNil)
+	c.Assert(rel.Off, Equals, uint64(2*sizeofInsn))
+
+	syms, err := f.Symbols()
+	c.Assert(err, IsNil)
+	names := []string{}
+	for _, sym := range syms {
+		names = append(names, sym.Name)
+	}
+	c.Assert(names, DeepEquals, []string{"SECLABEL", "cilium_calls_00042"})
+}
+
+func (s *ELFSuite) TestSubstituteUnresolved(c *C) {
+	_, err := substitute(templateObject(), &Substitutions{})
+	c.Assert(err, ErrorMatches, `unresolved symbol "SECLABEL" in section 1/0xffff`)
+}
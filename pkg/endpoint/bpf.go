@@ -36,12 +36,16 @@ import (
 	"github.com/cilium/cilium/pkg/bpf"
 	"github.com/cilium/cilium/pkg/byteorder"
 	"github.com/cilium/cilium/pkg/completion"
+	"github.com/cilium/cilium/pkg/elf"
 	"github.com/cilium/cilium/pkg/identity"
 	"github.com/cilium/cilium/pkg/logging/logfields"
 	"github.com/cilium/cilium/pkg/maps/ctmap"
 	"github.com/cilium/cilium/pkg/maps/ipcache"
 	"github.com/cilium/cilium/pkg/maps/lxcmap"
+	"github.com/cilium/cilium/pkg/maps/metricsmap"
 	"github.com/cilium/cilium/pkg/maps/policymap"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
+	"github.com/cilium/cilium/pkg/metrics"
 	"github.com/cilium/cilium/pkg/option"
 	"github.com/cilium/cilium/pkg/policy"
 	"github.com/cilium/cilium/pkg/version"
@@ -51,6 +55,17 @@ const (
 	// ExecTimeout is the execution timeout to use in join_ep.sh executions
 	ExecTimeout = 300 * time.Second
 
+	// compileCacheHit and compileCacheMiss are printed by join_ep.sh
+	// with the result of the compile cache lookup
+	compileCacheHit  = "Compile cache: hit"
+	compileCacheMiss = "Compile cache: miss"
+
+	// joinEPAll, joinEPCompile and joinEPLoad are the modes of join_ep.sh
+	// to compile and load, only compile or only load the endpoint program
+	joinEPAll     = "all"
+	joinEPCompile = "compile"
+	joinEPLoad    = "load"
+
 	// EndpointGenerationTimeout specifies timeout for proxy completion context
 	EndpointGenerationTimeout = 55 * time.Second
 )
@@ -149,18 +164,16 @@ func (e *Endpoint) writeHeaderfile(prefix string, owner Owner) error {
 	}
 	fw.WriteString(" */\n\n")
 
-	// If policy has not been derived or calculated yet, all packets must
-	// be dropped until the policy of the endpoint has been determined,
-	// except when it is known that the current policy will not drop anything,
-	// which is true when:
-	// - policy enforcement mode is "never"
-	// - policy enforcement mode is "default" and no policies are loaded
-	if !e.PolicyCalculated &&
-		!(owner.PolicyEnforcement() == option.NeverEnforce) &&
-		!(owner.PolicyEnforcement() == option.DefaultEnforcement && owner.GetPolicyRepository().Empty()) {
-		fw.WriteString("#define DROP_ALL\n")
-	}
+	e.writeStaticData(fw)
+	e.writeMapNames(fw, strconv.Itoa(int(e.ID)))
+	e.writeConfig(fw, owner)
 
+	return fw.Flush()
+}
+
+// writeStaticData writes the constants of the endpoint. They are
+// substituted when loading a program template, see templateSubstitutions().
+func (e *Endpoint) writeStaticData(fw *bufio.Writer) {
 	fw.WriteString(common.FmtDefineAddress("LXC_MAC", e.LXCMAC))
 	fw.WriteString(common.FmtDefineComma("LXC_IP", e.IPv6))
 	if e.IPv4 != nil {
@@ -177,17 +190,38 @@ func (e *Endpoint) writeHeaderfile(prefix string, owner Owner) error {
 		fmt.Fprintf(fw, "#define SECLABEL %s\n", invalid.StringID())
 		fmt.Fprintf(fw, "#define SECLABEL_NB %#x\n", byteorder.HostToNetwork(invalid.Uint32()))
 	}
-	fmt.Fprintf(fw, "#define POLICY_MAP %s\n", path.Base(e.PolicyMapPathLocked()))
-	fmt.Fprintf(fw, "#define CALLS_MAP %s\n", path.Base(e.CallsMapPathLocked()))
+}
+
+// writeMapNames writes the names of the maps of the endpoint, with id in
+// place of the ID of the endpoint in per-endpoint maps.
+func (e *Endpoint) writeMapNames(fw *bufio.Writer, id string) {
+	fmt.Fprintf(fw, "#define POLICY_MAP %s\n", policymap.MapName+id)
+	fmt.Fprintf(fw, "#define CALLS_MAP %s\n", CallsMapName+id)
 	if e.Options.IsEnabled(option.ConntrackLocal) {
 		fmt.Fprintf(fw, "#define CT_MAP_SIZE %s\n", strconv.Itoa(ctmap.MapNumEntriesLocal))
-		fmt.Fprintf(fw, "#define CT_MAP6 %s\n", ctmap.MapName6+strconv.Itoa(int(e.ID)))
-		fmt.Fprintf(fw, "#define CT_MAP4 %s\n", ctmap.MapName4+strconv.Itoa(int(e.ID)))
+		fmt.Fprintf(fw, "#define CT_MAP6 %s\n", ctmap.MapName6+id)
+		fmt.Fprintf(fw, "#define CT_MAP4 %s\n", ctmap.MapName4+id)
 	} else {
 		fmt.Fprintf(fw, "#define CT_MAP_SIZE %s\n", strconv.Itoa(ctmap.MapNumEntriesGlobal))
 		fmt.Fprintf(fw, "#define CT_MAP6 %s\n", ctmap.MapName6Global)
 		fmt.Fprintf(fw, "#define CT_MAP4 %s\n", ctmap.MapName4Global)
 	}
+}
+
+// writeConfig writes the configuration of the endpoint which is shared by
+// all endpoints using the same program template.
+func (e *Endpoint) writeConfig(fw *bufio.Writer, owner Owner) {
+	// If policy has not been derived or calculated yet, all packets must
+	// be dropped until the policy of the endpoint has been determined,
+	// except when it is known that the current policy will not drop anything,
+	// which is true when:
+	// - policy enforcement mode is "never"
+	// - policy enforcement mode is "default" and no policies are loaded
+	if !e.PolicyCalculated &&
+		!(owner.PolicyEnforcement() == option.NeverEnforce) &&
+		!(owner.PolicyEnforcement() == option.DefaultEnforcement && owner.GetPolicyRepository().Empty()) {
+		fw.WriteString("#define DROP_ALL\n")
+	}
 
 	// Always enable L4 and L3 load balancer for now
 	fw.WriteString("#define LB_L3\n")
@@ -205,24 +239,25 @@ func (e *Endpoint) writeHeaderfile(prefix string, owner Owner) error {
 	} else {
 		WriteIPCachePrefixes(fw, e.L3Policy.ToBPFData)
 	}
-
-	return fw.Flush()
 }
 
 // hashEndpointHeaderFiles returns the MD5 hash of any header files that are
 // used in the compilation of an endpoint's BPF program. Currently, this
 // includes the endpoint's headerfile, and the node's headerfile.
 func hashEndpointHeaderfiles(prefix string) (string, error) {
-	endpointHeaderPath := filepath.Join(prefix, common.CHeaderFileName)
-	hashWriter := md5.New()
-	hashWriter, err := hashHeaderfile(hashWriter, endpointHeaderPath)
-	if err != nil {
-		return "", err
-	}
+	return hashHeaderfiles(filepath.Join(prefix, common.CHeaderFileName))
+}
 
-	hashWriter, err = hashHeaderfile(hashWriter, option.Config.GetNodeConfigPath())
-	if err != nil {
-		return "", err
+// hashHeaderfiles returns the MD5 hash of the given header files together
+// with the node's headerfile.
+func hashHeaderfiles(paths ...string) (string, error) {
+	hashWriter := md5.New()
+	var err error
+	for _, headerPath := range append(paths, option.Config.GetNodeConfigPath()) {
+		hashWriter, err = hashHeaderfile(hashWriter, headerPath)
+		if err != nil {
+			return "", err
+		}
 	}
 
 	combinedHeaderHashSum := hashWriter.Sum(nil)
@@ -266,8 +301,27 @@ func hashHeaderfile(hashWriter hash.Hash, filepath string) (hash.Hash, error) {
 	return hashWriter, nil
 }
 
-func (e *Endpoint) runInit(libdir, rundir, epdir, ifName, debug string) error {
-	args := []string{libdir, rundir, epdir, ifName, debug, e.StringID()}
+// compileCacheResult returns the result of the compile cache lookup
+// reported in the output of join_ep.sh.
+func compileCacheResult(out []byte) string {
+	scanner := bufio.NewScanner(bytes.NewReader(out))
+	for scanner.Scan() {
+		switch scanner.Text() {
+		case compileCacheHit:
+			return "hit"
+		case compileCacheMiss:
+			return "miss"
+		}
+	}
+	return "disabled"
+}
+
+// runInit runs join_ep.sh for the endpoint directory epdir. The mode
+// selects whether the program is compiled, loaded or both. Returns the
+// result of the compile cache lookup.
+func (e *Endpoint) runInit(libdir, rundir, epdir, ifName, debug, mode string) (string, error) {
+	args := []string{libdir, rundir, epdir, ifName, debug, e.StringID(),
+		strconv.Itoa(option.Config.BPFCompileCacheSize), mode}
 	prog := filepath.Join(libdir, "join_ep.sh")
 
 	e.Mutex.RLock()
@@ -285,7 +339,7 @@ func (e *Endpoint) runInit(libdir, rundir, epdir, ifName, debug string) error {
 	scopedLog = scopedLog.WithField("cmd", cmd)
 	if ctx.Err() == context.DeadlineExceeded {
 		scopedLog.Error("RunInit: Command execution failed: Timeout")
-		return ctx.Err()
+		return "", ctx.Err()
 	}
 	if err != nil {
 		scopedLog.WithError(err).Warn("RunInit: Command execution failed")
@@ -293,10 +347,13 @@ func (e *Endpoint) runInit(libdir, rundir, epdir, ifName, debug string) error {
 		for scanner.Scan() {
 			log.Warn(scanner.Text())
 		}
-		return fmt.Errorf("error: %q command output: %q", err, out)
+		return "", fmt.Errorf("error: %q command output: %q", err, out)
 	}
 
-	return nil
+	result := compileCacheResult(out)
+	scopedLog.WithField("compileCache", result).Debug("Endpoint program compiled")
+
+	return result, nil
 }
 
 // epInfoCache describes the set of lxcmap entries necessary to describe an Endpoint
@@ -587,6 +644,17 @@ func (e *Endpoint) regenerateBPF(owner Owner, epdir, reason string) (uint64, boo
 		return 0, compilationExecuted, fmt.Errorf("unable to write header file: %s", err)
 	}
 
+	// The program template is shared with all endpoints with the same
+	// configuration and specialized with the constants of this endpoint.
+	var templateSubst *elf.Substitutions
+	if option.Config.EndpointTemplates {
+		if err = e.writeTemplateHeaderfile(epdir, owner); err != nil {
+			e.Mutex.Unlock()
+			return 0, compilationExecuted, fmt.Errorf("unable to write template header file: %s", err)
+		}
+		templateSubst = e.templateSubstitutions()
+	}
+
 	// Avoid BPF program compilation and installation if the headerfile for the endpoint
 	// or the node have not changed.
 	bpfHeaderfilesHash, err := hashEndpointHeaderfiles(epdir)
@@ -625,13 +693,21 @@ func (e *Endpoint) regenerateBPF(owner Owner, epdir, reason string) (uint64, boo
 	if bpfHeaderfilesChanged {
 		start := time.Now()
 		// Compile and install BPF programs for this endpoint
-		err = e.runInit(libdir, rundir, epdir, epInfoCache.ifName, debug)
+		var result string
+		if templateSubst != nil {
+			result, err = e.runTemplateInit(libdir, rundir, epdir, epInfoCache.ifName, debug, templateSubst)
+		} else {
+			result, err = e.runInit(libdir, rundir, epdir, epInfoCache.ifName, debug, joinEPAll)
+		}
+		duration := time.Since(start)
 		logger.WithError(err).
-			WithField(logfields.BPFCompilationTime, time.Since(start).String()).
+			WithField(logfields.BPFCompilationTime, duration.String()).
 			Debugf("BPF compilation completed")
 		if err != nil {
 			return epInfoCache.revision, compilationExecuted, err
 		}
+		metrics.BPFCompilations.WithLabelValues(result).Inc()
+		metrics.BPFCompilationTime.WithLabelValues(result).Add(duration.Seconds())
 		compilationExecuted = true
 		e.bpfHeaderfileHash = bpfHeaderfilesHash
 	} else {
@@ -683,6 +759,17 @@ func (e *Endpoint) regenerateBPF(owner Owner, epdir, reason string) (uint64, boo
 		return 0, compilationExecuted, fmt.Errorf("unable to regenerate policy because PolicyMap synchronization failed: %s", err)
 	}
 
+	if option.Config.EndpointMetricsIdentities > 0 {
+		e.createMetricsEntries()
+	}
+
+	e.syncDebugConfig()
+
+	// The new program may evaluate policy differently than its predecessor
+	if compilationExecuted {
+		e.bumpDatapathPolicyRevision()
+	}
+
 	// The last operation hooks the endpoint into the endpoint table and exposes it
 	err = lxcmap.WriteEndpoint(epInfoCache)
 	if err != nil {
@@ -691,3 +778,29 @@ func (e *Endpoint) regenerateBPF(owner Owner, epdir, reason string) (uint64, boo
 
 	return epInfoCache.revision, compilationExecuted, err
 }
+
+// syncDebugConfig enables or disables the debug messages of the datapath
+// according to the Debug option of the endpoint. Failures are not fatal.
+// Must be called with e.Mutex locked.
+func (e *Endpoint) syncDebugConfig() {
+	err := tracemap.SetDebug(e.ID, e.Options.IsEnabled(option.Debug), uint32(option.Config.DebugRateLimit))
+	if err != nil {
+		e.getLogger().WithError(err).Warn("Unable to update debug configuration")
+	}
+}
+
+// createMetricsEntries creates the per endpoint metrics entries for the
+// identities allowed by the endpoint's policy. Failures are not fatal, the
+// datapath then accounts the traffic to the catch-all identity.
+// Must be called with e.Mutex locked.
+func (e *Endpoint) createMetricsEntries() {
+	identities := make([]uint32, 0, len(e.realizedMapState))
+	for key := range e.realizedMapState {
+		identities = append(identities, key.Identity)
+	}
+
+	err := metricsmap.CreateEndpointEntries(e.ID, identities, option.Config.EndpointMetricsIdentities)
+	if err != nil {
+		e.getLogger().WithError(err).Warn("Unable to create endpoint metrics entries")
+	}
+}
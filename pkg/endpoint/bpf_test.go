@@ -18,9 +18,15 @@ import (
 	"crypto/md5"
 	"encoding/hex"
 	"io/ioutil"
+	"os"
 	"path/filepath"
 
 	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/common/addressing"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/identity"
+	"github.com/cilium/cilium/pkg/mac"
+	"github.com/cilium/cilium/pkg/option"
 
 	. "gopkg.in/check.v1"
 )
@@ -97,3 +103,68 @@ ignored
 
 	c.Assert(hashToString3, Not(Equals), hashToString4)
 }
+
+func (s *EndpointSuite) TestCompileCacheResult(c *C) {
+	c.Assert(compileCacheResult([]byte("Join EP id=1 ifname=lxc0\n"+compileCacheHit+"\n")), Equals, "hit")
+	c.Assert(compileCacheResult([]byte("Join EP id=1 ifname=lxc0\n"+compileCacheMiss+"\n")), Equals, "miss")
+	c.Assert(compileCacheResult([]byte("Join EP id=1 ifname=lxc0\n")), Equals, "disabled")
+}
+
+func (s *EndpointSuite) TestTemplateSubstitutions(c *C) {
+	e := NewEndpointWithState(42, StateReady)
+	e.LXCMAC, _ = mac.ParseMAC("aa:bb:cc:dd:ee:ff")
+	e.NodeMAC, _ = mac.ParseMAC("de:ad:be:ef:c0:de")
+	e.IPv6, _ = addressing.NewCiliumIPv6("beef::1:0:2a")
+	e.IPv4, _ = addressing.NewCiliumIPv4("10.11.0.42")
+
+	subst := e.templateSubstitutions()
+	c.Assert(subst.Values["LXC_ID"], Equals, uint64(42))
+	c.Assert(subst.Values["SECLABEL"], Equals, uint64(identity.InvalidIdentity))
+	c.Assert(subst.Values["LXC_MAC_2"], Equals, uint64(byteorder.Native.Uint16([]byte{0xee, 0xff})))
+	c.Assert(subst.Values["LXC_IP_4"], Equals, uint64(byteorder.Native.Uint32(e.IPv6[12:])))
+	c.Assert(subst.Values["LXC_IPV4"], Equals, uint64(byteorder.Native.Uint32(e.IPv4)))
+	c.Assert(subst.Symbols, DeepEquals, map[string]string{
+		"cilium_policy_template": "cilium_policy_42",
+		"cilium_calls_template":  "cilium_calls_42",
+	})
+	c.Assert(subst.Sections, DeepEquals, map[string]string{"1/0xffff": "1/0x2a"})
+}
+
+func (s *EndpointSuite) TestTemplateRelease(c *C) {
+	oldStateDir := option.Config.StateDir
+	option.Config.StateDir = c.MkDir()
+	defer func() { option.Config.StateDir = oldStateDir }()
+
+	e1 := NewEndpointWithState(1, StateReady)
+	e2 := NewEndpointWithState(2, StateReady)
+
+	tmpl, created := e1.acquireTemplate("a")
+	c.Assert(created, Equals, true)
+	close(tmpl.done)
+	c.Assert(os.MkdirAll(templateDir("a"), 0755), IsNil)
+	e1.setTemplate("a")
+
+	_, created = e2.acquireTemplate("a")
+	c.Assert(created, Equals, false)
+	e2.setTemplate("a")
+
+	// Switching e1 to another template keeps "a" for e2
+	tmpl, _ = e1.acquireTemplate("b")
+	close(tmpl.done)
+	e1.setTemplate("b")
+	c.Assert(templates["a"], Not(IsNil))
+
+	// A failed load of e2 keeps the template of its loaded program
+	e2.acquireTemplate("a")
+	e2.releaseTemplate("a")
+	c.Assert(templates["a"], Not(IsNil))
+
+	// Removing the last user removes the template and its directory
+	e2.setTemplate("")
+	c.Assert(templates["a"], IsNil)
+	_, err := os.Stat(templateDir("a"))
+	c.Assert(os.IsNotExist(err), Equals, true)
+
+	e1.setTemplate("")
+	c.Assert(templates, HasLen, 0)
+}
@@ -392,6 +392,10 @@ type Endpoint struct {
 	// compiled and installed.
 	bpfHeaderfileHash string
 
+	// templateHash is the hash of the program template the loaded program
+	// was specialized from, if any. Protected by templatesMutex.
+	templateHash string
+
 	k8sPodName   string
 	k8sNamespace string
 
@@ -1278,6 +1282,29 @@ func (e *Endpoint) applyOptsLocked(opts map[string]string) bool {
 	return e.Options.ApplyValidated(opts, optionChanged, e) > 0
 }
 
+// applyRuntimeOptsLocked applies the given options to the endpoint's options
+// and the datapath without regeneration if all of them are runtime options.
+// The header file in the state directory is rewritten so that the options
+// persist across restarts. Returns false without applying anything otherwise.
+func (e *Endpoint) applyRuntimeOptsLocked(owner Owner, opts models.ConfigurationMap) bool {
+	if len(opts) == 0 {
+		return false
+	}
+	for k := range opts {
+		if !e.Options.Library.IsRuntime(k) {
+			return false
+		}
+	}
+
+	if e.applyOptsLocked(opts) {
+		e.syncDebugConfig()
+		if err := e.writeHeaderfile(e.directoryPath(), owner); err != nil {
+			e.getLogger().WithError(err).Warn("Unable to persist endpoint options")
+		}
+	}
+	return true
+}
+
 // ForcePolicyCompute marks the endpoint for forced bpf regeneration.
 func (e *Endpoint) ForcePolicyCompute() {
 	e.forcePolicyCompute = true
@@ -1601,6 +1628,11 @@ func (e *Endpoint) Update(owner Owner, cfg *models.EndpointConfigurationSpec) er
 		return UpdateValidationError{err.Error()}
 	}
 
+	if e.applyRuntimeOptsLocked(owner, cfg.Options) {
+		e.Mutex.Unlock()
+		return nil
+	}
+
 	// Option changes may be overridden by the policy configuration.
 	// Currently we return all-OK even in that case.
 	needToRegenerate, err := e.TriggerPolicyUpdatesLocked(owner, cfg.Options)
@@ -1782,6 +1814,7 @@ func (e *Endpoint) LeaveLocked(owner Owner, proxyWaitGroup *completion.WaitGroup
 		e.SecurityIdentity = nil
 	}
 
+	e.setTemplate("")
 	e.removeDirectory()
 	e.removeFailedDirectory()
 	e.controllers.RemoveAll()
@@ -2563,6 +2596,7 @@ func (e *Endpoint) syncPolicyMap() error {
 	}
 
 	errors := []error{}
+	changed := false
 
 	for _, entry := range currentMapContents {
 		// Convert key to host-byte order for lookup in the desiredMapState.
@@ -2579,6 +2613,7 @@ func (e *Endpoint) syncPolicyMap() error {
 			} else {
 				// Operation was successful, remove from realized state.
 				delete(e.realizedMapState, keyHostOrder)
+				changed = true
 			}
 		}
 	}
@@ -2592,10 +2627,15 @@ func (e *Endpoint) syncPolicyMap() error {
 			} else {
 				// Operation was successful, add to realized state.
 				e.realizedMapState[keyToAdd] = entry
+				changed = true
 			}
 		}
 	}
 
+	if changed {
+		e.bumpDatapathPolicyRevision()
+	}
+
 	if len(errors) > 0 {
 		return fmt.Errorf("synchronizing desired PolicyMap state failed: %s", errors)
 	}
@@ -2603,6 +2643,17 @@ func (e *Endpoint) syncPolicyMap() error {
 	return nil
 }
 
+// bumpDatapathPolicyRevision invalidates the policy verdicts of the endpoint
+// cached in conntrack entries. Must be called with e.Mutex locked.
+func (e *Endpoint) bumpDatapathPolicyRevision() {
+	if !option.Config.ConntrackPolicyCache {
+		return
+	}
+	if err := policymap.BumpRevision(e.ID); err != nil {
+		e.getLogger().WithError(err).Warning("Unable to update datapath policy revision")
+	}
+}
+
 func (e *Endpoint) syncPolicyMapController() {
 	ctrlName := fmt.Sprintf("sync-policymap-%d", e.ID)
 	e.controllers.UpdateController(ctrlName,
@@ -0,0 +1,307 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package endpoint
+
+import (
+	"bufio"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"reflect"
+	"strconv"
+
+	"github.com/cilium/cilium/common"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/defaults"
+	"github.com/cilium/cilium/pkg/elf"
+	"github.com/cilium/cilium/pkg/identity"
+	"github.com/cilium/cilium/pkg/lock"
+	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/maps/ctmap"
+	"github.com/cilium/cilium/pkg/maps/policymap"
+	"github.com/cilium/cilium/pkg/option"
+)
+
+const (
+	// templateHeaderFileName is the name of the configuration of the
+	// program template of an endpoint in the endpoint directory
+	templateHeaderFileName = "lxc_template.h"
+
+	// templateMapID replaces the ID of the endpoint in the names of the
+	// per-endpoint maps of program templates
+	templateMapID = "template"
+
+	// templateLXCID must be in sync with TEMPLATE_LXC_ID in
+	// <bpf/lib/static_data.h>
+	templateLXCID = "0xffff"
+
+	// policyTailCallMapID must be in sync with CILIUM_MAP_POLICY in
+	// <bpf/lib/maps.h>
+	policyTailCallMapID = 1
+
+	// endpointObj is the name of the object of the endpoint program
+	endpointObj = "bpf_lxc.o"
+)
+
+// programTemplate is an endpoint program compiled for a template
+// configuration
+type programTemplate struct {
+	// done is closed once the compilation has finished
+	done chan struct{}
+	err  error
+
+	// users holds the IDs of the endpoints using the template, either
+	// for their loaded program or for a regeneration in progress.
+	// Protected by templatesMutex.
+	users map[uint16]struct{}
+}
+
+var (
+	templatesMutex lock.Mutex
+
+	// templates holds the program templates compiled by this agent by the
+	// hash of their configuration. Templates are removed together with
+	// their directory once no endpoint uses them anymore.
+	templates = map[string]*programTemplate{}
+)
+
+// templateDir returns the directory of the program template with the given
+// hash.
+func templateDir(hash string) string {
+	return filepath.Join(option.Config.GetTemplatesDir(), hash)
+}
+
+// policySection returns the name of the section of the policy program of
+// the endpoint with the given ID.
+func policySection(id string) string {
+	return fmt.Sprintf("%d/%s", policyTailCallMapID, id)
+}
+
+// writeTemplateHeaderfile writes the configuration of the program template
+// of the endpoint. It differs from the configuration of the endpoint only
+// in the constants and map names substituted by templateSubstitutions().
+func (e *Endpoint) writeTemplateHeaderfile(prefix string, owner Owner) error {
+	headerPath := filepath.Join(prefix, templateHeaderFileName)
+	f, err := os.Create(headerPath)
+	if err != nil {
+		return fmt.Errorf("failed to open file %s for writing: %s", headerPath, err)
+	}
+	defer f.Close()
+
+	fw := bufio.NewWriter(f)
+
+	fw.WriteString("/* Program template, see <bpf/lib/static_data.h> */\n\n")
+	fw.WriteString("#define ENDPOINT_TEMPLATE\n")
+	if e.IPv4 != nil {
+		fw.WriteString("#define LXC_IPV4\n")
+	}
+	e.writeMapNames(fw, templateMapID)
+	e.writeConfig(fw, owner)
+
+	return fw.Flush()
+}
+
+// templateSubstitutions returns the substitutions to specialize the
+// program template of the endpoint. They must match the constants written
+// by writeStaticData() and the placeholders in <bpf/lib/static_data.h>.
+// Must be called with e.Mutex held.
+func (e *Endpoint) templateSubstitutions() *elf.Substitutions {
+	secLabel := identity.InvalidIdentity
+	if e.SecurityIdentity != nil {
+		secLabel = e.SecurityIdentity.ID
+	}
+
+	values := map[string]uint64{
+		"LXC_ID":      uint64(e.ID),
+		"LXC_ID_NB":   uint64(byteorder.HostToNetwork(e.ID).(uint16)),
+		"SECLABEL":    uint64(secLabel.Uint32()),
+		"SECLABEL_NB": uint64(byteorder.HostToNetwork(secLabel.Uint32()).(uint32)),
+	}
+
+	// Addresses are loaded in the byte order of the host into the words
+	// of union macaddr and union v6addr.
+	var lxcMAC, nodeMAC [6]byte
+	copy(lxcMAC[:], e.LXCMAC)
+	copy(nodeMAC[:], e.NodeMAC)
+	values["LXC_MAC_1"] = uint64(byteorder.Native.Uint32(lxcMAC[0:4]))
+	values["LXC_MAC_2"] = uint64(byteorder.Native.Uint16(lxcMAC[4:6]))
+	values["NODE_MAC_1"] = uint64(byteorder.Native.Uint32(nodeMAC[0:4]))
+	values["NODE_MAC_2"] = uint64(byteorder.Native.Uint16(nodeMAC[4:6]))
+
+	var ip6 [16]byte
+	copy(ip6[:], e.IPv6)
+	for i := 0; i < 4; i++ {
+		values[fmt.Sprintf("LXC_IP_%d", i+1)] = uint64(byteorder.Native.Uint32(ip6[i*4:]))
+	}
+	if e.IPv4 != nil {
+		values["LXC_IPV4"] = uint64(byteorder.HostSliceToNetwork(e.IPv4, reflect.Uint32).(uint32))
+	}
+
+	id := strconv.Itoa(int(e.ID))
+	symbols := map[string]string{
+		policymap.MapName + templateMapID: policymap.MapName + id,
+		CallsMapName + templateMapID:      CallsMapName + id,
+	}
+	if e.Options.IsEnabled(option.ConntrackLocal) {
+		symbols[ctmap.MapName6+templateMapID] = ctmap.MapName6 + id
+		symbols[ctmap.MapName4+templateMapID] = ctmap.MapName4 + id
+	}
+
+	return &elf.Substitutions{
+		Values:  values,
+		Symbols: symbols,
+		Sections: map[string]string{
+			policySection(templateLXCID): policySection(fmt.Sprintf("%#x", e.ID)),
+		},
+	}
+}
+
+// acquireTemplate returns the program template with the given hash and
+// marks it as used by the endpoint. The template is created if it does not
+// exist yet, in which case the caller must compile it.
+func (e *Endpoint) acquireTemplate(hash string) (tmpl *programTemplate, created bool) {
+	templatesMutex.Lock()
+	defer templatesMutex.Unlock()
+
+	tmpl, ok := templates[hash]
+	if !ok {
+		tmpl = &programTemplate{
+			done:  make(chan struct{}),
+			users: map[uint16]struct{}{},
+		}
+		templates[hash] = tmpl
+	}
+	tmpl.users[e.ID] = struct{}{}
+	return tmpl, !ok
+}
+
+// releaseTemplateLocked removes the endpoint from the users of the program
+// template with the given hash and removes the template once it is unused.
+// Must be called with templatesMutex held.
+func (e *Endpoint) releaseTemplateLocked(hash string) {
+	tmpl, ok := templates[hash]
+	if !ok {
+		return
+	}
+	delete(tmpl.users, e.ID)
+	if len(tmpl.users) > 0 {
+		return
+	}
+
+	delete(templates, hash)
+	dir := templateDir(hash)
+	if err := os.RemoveAll(dir); err != nil {
+		log.WithError(err).WithField(logfields.Path, dir).Warn("Unable to remove unused program template")
+	}
+}
+
+// releaseTemplate is called if the program template with the given hash
+// could not be loaded for the endpoint. The template is released unless
+// the loaded program of the endpoint still uses it.
+func (e *Endpoint) releaseTemplate(hash string) {
+	templatesMutex.Lock()
+	defer templatesMutex.Unlock()
+
+	if hash != e.templateHash {
+		e.releaseTemplateLocked(hash)
+	}
+}
+
+// setTemplate records that the loaded program of the endpoint uses the
+// program template with the given hash, releasing the template used before.
+// An empty hash releases the template of an endpoint being removed.
+func (e *Endpoint) setTemplate(hash string) {
+	templatesMutex.Lock()
+	defer templatesMutex.Unlock()
+
+	if e.templateHash != "" && e.templateHash != hash {
+		e.releaseTemplateLocked(e.templateHash)
+	}
+	e.templateHash = hash
+}
+
+// compileTemplate acquires the program template with the given hash for the
+// template configuration at headerPath. The template is compiled unless an
+// endpoint with the same configuration did so already, concurrent callers
+// wait for the same compilation.
+//
+// Returns the result of the compile cache lookup if the endpoint compiled
+// the template, "template" if it was compiled before.
+func (e *Endpoint) compileTemplate(libdir, rundir, headerPath, hash, debug string) (string, error) {
+	tmpl, created := e.acquireTemplate(hash)
+
+	result := "template"
+	if created {
+		result, tmpl.err = e.buildTemplate(libdir, rundir, headerPath, templateDir(hash), debug)
+		if tmpl.err != nil {
+			// Let the next endpoint try again
+			templatesMutex.Lock()
+			if templates[hash] == tmpl {
+				delete(templates, hash)
+			}
+			templatesMutex.Unlock()
+		}
+		close(tmpl.done)
+	}
+
+	<-tmpl.done
+	return result, tmpl.err
+}
+
+// buildTemplate compiles the program template with the configuration at
+// headerPath in dir.
+func (e *Endpoint) buildTemplate(libdir, rundir, headerPath, dir, debug string) (string, error) {
+	if err := os.MkdirAll(dir, defaults.StateDirRights); err != nil {
+		return "", fmt.Errorf("unable to create template directory %s: %s", dir, err)
+	}
+
+	header, err := ioutil.ReadFile(headerPath)
+	if err != nil {
+		return "", err
+	}
+	if err := ioutil.WriteFile(filepath.Join(dir, common.CHeaderFileName), header, 0644); err != nil {
+		return "", err
+	}
+
+	return e.runInit(libdir, rundir, dir, "none", debug, joinEPCompile)
+}
+
+// runTemplateInit specializes the program template of the endpoint with
+// subst and loads it, compiling the template first if needed. Returns the
+// result as for compileTemplate().
+func (e *Endpoint) runTemplateInit(libdir, rundir, epdir, ifName, debug string, subst *elf.Substitutions) (string, error) {
+	headerPath := filepath.Join(epdir, templateHeaderFileName)
+	hash, err := hashHeaderfiles(headerPath)
+	if err != nil {
+		return "", fmt.Errorf("unable to hash template header file: %s", err)
+	}
+
+	result, err := e.compileTemplate(libdir, rundir, headerPath, hash, debug)
+	if err == nil {
+		tmpl := filepath.Join(templateDir(hash), endpointObj)
+		err = elf.Substitute(tmpl, filepath.Join(epdir, endpointObj), subst)
+	}
+	if err == nil {
+		_, err = e.runInit(libdir, rundir, epdir, ifName, debug, joinEPLoad)
+	}
+	if err != nil {
+		e.releaseTemplate(hash)
+		return "", err
+	}
+
+	e.setTemplate(hash)
+	return result, nil
+}
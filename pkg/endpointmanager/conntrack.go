@@ -23,6 +23,7 @@ import (
 	"github.com/cilium/cilium/pkg/endpoint"
 	"github.com/cilium/cilium/pkg/logging/logfields"
 	"github.com/cilium/cilium/pkg/maps/ctmap"
+	"github.com/cilium/cilium/pkg/maps/natmap"
 
 	"github.com/sirupsen/logrus"
 )
@@ -98,6 +99,9 @@ func EnableConntrackGC(ipv4, ipv6 bool, gcinterval int) {
 				}
 				if ipv4 {
 					RunGC(nil, false, ctmap.NewGCFilterBy(ctmap.GCFilterByTime))
+					if deleted := natmap.GC(); deleted > 0 {
+						log.WithField("count", deleted).Debug("Deleted expired entries from SNAT map")
+					}
 				}
 			}
 			for _, e := range eps {
@@ -17,6 +17,10 @@ type BpfMetadata struct {
 	BpfRoot string `protobuf:"bytes,1,opt,name=bpf_root,json=bpfRoot" json:"bpf_root,omitempty"`
 	// 'true' if the filter is on ingress listener, 'false' for egress listener.
 	IsIngress bool `protobuf:"varint,2,opt,name=is_ingress,json=isIngress" json:"is_ingress,omitempty"`
+	// 'true' if the datapath may assign connections to the listener without
+	// translating their destination. The listen socket is made transparent and
+	// the source identity is read from the mark of accepted connections.
+	SkAssign bool `protobuf:"varint,3,opt,name=sk_assign,json=skAssign" json:"sk_assign,omitempty"`
 }
 
 func (m *BpfMetadata) Reset()                    { *m = BpfMetadata{} }
@@ -38,6 +42,13 @@ func (m *BpfMetadata) GetIsIngress() bool {
 	return false
 }
 
+func (m *BpfMetadata) GetSkAssign() bool {
+	if m != nil {
+		return m.SkAssign
+	}
+	return false
+}
+
 func init() {
 	proto.RegisterType((*BpfMetadata)(nil), "cilium.BpfMetadata")
 }
@@ -45,13 +56,15 @@ func init() {
 func init() { proto.RegisterFile("cilium/cilium_bpf_metadata.proto", fileDescriptor1) }
 
 var fileDescriptor1 = []byte{
-	// 124 bytes of a gzipped FileDescriptorProto
+	// 147 bytes of a gzipped FileDescriptorProto
 	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xe2, 0x52, 0x48, 0xce, 0xcc, 0xc9,
 	0x2c, 0xcd, 0xd5, 0x87, 0x50, 0xf1, 0x49, 0x05, 0x69, 0xf1, 0xb9, 0xa9, 0x25, 0x89, 0x29, 0x89,
-	0x25, 0x89, 0x7a, 0x05, 0x45, 0xf9, 0x25, 0xf9, 0x42, 0x6c, 0x10, 0x29, 0x25, 0x77, 0x2e, 0x6e,
+	0x25, 0x89, 0x7a, 0x05, 0x45, 0xf9, 0x25, 0xf9, 0x42, 0x6c, 0x10, 0x29, 0xa5, 0x14, 0x2e, 0x6e,
 	0xa7, 0x82, 0x34, 0x5f, 0xa8, 0xa4, 0x90, 0x24, 0x17, 0x07, 0x48, 0x71, 0x51, 0x7e, 0x7e, 0x89,
 	0x04, 0xa3, 0x02, 0xa3, 0x06, 0x67, 0x10, 0x7b, 0x52, 0x41, 0x5a, 0x50, 0x7e, 0x7e, 0x89, 0x90,
 	0x2c, 0x17, 0x57, 0x66, 0x71, 0x7c, 0x66, 0x5e, 0x7a, 0x51, 0x6a, 0x71, 0xb1, 0x04, 0x93, 0x02,
-	0xa3, 0x06, 0x47, 0x10, 0x67, 0x66, 0xb1, 0x27, 0x44, 0x20, 0x89, 0x0d, 0x6c, 0xae, 0x31, 0x20,
-	0x00, 0x00, 0xff, 0xff, 0xb0, 0xea, 0x7e, 0xbe, 0x7b, 0x00, 0x00, 0x00,
+	0xa3, 0x06, 0x47, 0x10, 0x67, 0x66, 0xb1, 0x27, 0x44, 0x40, 0x48, 0x9a, 0x8b, 0xb3, 0x38, 0x3b,
+	0x3e, 0xb1, 0xb8, 0x38, 0x33, 0x3d, 0x4f, 0x82, 0x19, 0x2c, 0xcb, 0x51, 0x9c, 0xed, 0x08, 0xe6,
+	0x27, 0xb1, 0x81, 0x2d, 0x35, 0x06, 0x04, 0x00, 0x00, 0xff, 0xff, 0xe1, 0xd2, 0xea, 0xbd, 0x98,
+	0x00, 0x00, 0x00,
 }
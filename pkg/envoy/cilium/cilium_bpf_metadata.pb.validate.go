@@ -46,6 +46,8 @@ func (m *BpfMetadata) Validate() error {
 
 	// no validation rules for IsIngress
 
+	// no validation rules for SkAssign
+
 	return nil
 }
 
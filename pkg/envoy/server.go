@@ -35,6 +35,7 @@ import (
 	"github.com/cilium/cilium/pkg/envoy/xds"
 	"github.com/cilium/cilium/pkg/identity"
 	"github.com/cilium/cilium/pkg/lock"
+	"github.com/cilium/cilium/pkg/option"
 	"github.com/cilium/cilium/pkg/policy"
 	"github.com/cilium/cilium/pkg/policy/api"
 	"github.com/cilium/cilium/pkg/proxy/logger"
@@ -197,6 +198,7 @@ func StartXDSServer(stateDir string) *XDSServer {
 			Config: &structpb.Struct{Fields: map[string]*structpb.Value{
 				"is_ingress": {Kind: &structpb.Value_BoolValue{BoolValue: false}},
 				"bpf_root":   {Kind: &structpb.Value_StringValue{StringValue: bpf.GetMapRoot()}},
+				"sk_assign":  {Kind: &structpb.Value_BoolValue{BoolValue: option.Config.ProxySkAssign}},
 			}},
 		}},
 	}
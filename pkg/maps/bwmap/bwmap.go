@@ -0,0 +1,133 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bwmap
+
+import (
+	"fmt"
+	"syscall"
+	"time"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+
+	"k8s.io/apimachinery/pkg/api/resource"
+)
+
+const (
+	// MapName is the name of the map holding the egress bandwidth limit
+	// of each endpoint.
+	MapName = "cilium_throttle"
+
+	// MaxEntries must match THROTTLE_MAP_SIZE in the node configuration.
+	// The map is keyed by endpoint ID.
+	MaxEntries = 65536
+
+	// DropHorizon is the maximum time a packet is held back before the
+	// datapath drops it instead.
+	DropHorizon = 2 * time.Second
+)
+
+// Key is the key of the bandwidth map.
+type Key struct {
+	EndpointID uint32
+}
+
+// String converts the key into a human readable string format
+func (k *Key) String() string { return fmt.Sprintf("%d", k.EndpointID) }
+
+// GetKeyPtr returns the unsafe pointer to the BPF key
+func (k *Key) GetKeyPtr() unsafe.Pointer { return unsafe.Pointer(k) }
+
+// NewValue returns a new empty instance of the structure representing the BPF
+// map value
+func (k *Key) NewValue() bpf.MapValue { return &EdtInfo{} }
+
+// EdtInfo must be in sync with struct edt_info in <bpf/lib/common.h>
+type EdtInfo struct {
+	Bps             uint64 // bytes per second
+	TimeLast        uint64 // written by the datapath
+	TimeHorizonDrop uint64 // nanoseconds
+}
+
+// String converts the value into a human readable string format
+func (v *EdtInfo) String() string { return fmt.Sprintf("%d", v.Bps) }
+
+// GetValuePtr returns the unsafe pointer to the BPF value.
+func (v *EdtInfo) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(v) }
+
+var (
+	// ThrottleMap is the BPF map holding the egress bandwidth limit of
+	// each endpoint.
+	ThrottleMap = bpf.NewMap(MapName,
+		bpf.MapTypeHash,
+		int(unsafe.Sizeof(Key{})),
+		int(unsafe.Sizeof(EdtInfo{})),
+		MaxEntries,
+		0,
+		func(key []byte, value []byte) (bpf.MapKey, bpf.MapValue, error) {
+			k, v := Key{}, EdtInfo{}
+
+			if err := bpf.ConvertKeyValue(key, value, &k, &v); err != nil {
+				return nil, nil, err
+			}
+
+			return &k, &v, nil
+		},
+	)
+)
+
+func init() {
+	bpf.OpenAfterMount(ThrottleMap)
+}
+
+// ParseBandwidth parses a bandwidth in bits per second as used by the
+// kubernetes.io/egress-bandwidth annotation, e.g. "10M", and returns it in
+// bytes per second.
+func ParseBandwidth(s string) (uint64, error) {
+	q, err := resource.ParseQuantity(s)
+	if err != nil {
+		return 0, fmt.Errorf("invalid bandwidth '%s': %s", s, err)
+	}
+	bits := q.Value()
+	if bits < 8 {
+		return 0, fmt.Errorf("invalid bandwidth '%s': must be at least 8 bits per second", s)
+	}
+	return uint64(bits) / 8, nil
+}
+
+// Update limits the egress bandwidth of the endpoint with the given ID to
+// the given number of bytes per second. An unchanged limit is left alone so
+// that the departure time of the last packet is preserved.
+func Update(id uint16, bytesPerSecond uint64) error {
+	key := &Key{EndpointID: uint32(id)}
+	if v, err := ThrottleMap.Lookup(key); err == nil && v.(*EdtInfo).Bps == bytesPerSecond {
+		return nil
+	}
+
+	return ThrottleMap.Update(key, &EdtInfo{
+		Bps:             bytesPerSecond,
+		TimeHorizonDrop: uint64(DropHorizon.Nanoseconds()),
+	})
+}
+
+// Delete removes the egress bandwidth limit of the endpoint with the given
+// ID, if any.
+func Delete(id uint16) error {
+	err, errno := ThrottleMap.DeleteWithErrno(&Key{EndpointID: uint32(id)})
+	if errno == syscall.ENOENT {
+		return nil
+	}
+	return err
+}
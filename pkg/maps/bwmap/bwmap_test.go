@@ -0,0 +1,50 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package bwmap
+
+import (
+	"testing"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+type BWMapTestSuite struct{}
+
+var _ = Suite(&BWMapTestSuite{})
+
+func (s *BWMapTestSuite) TestParseBandwidth(c *C) {
+	valid := map[string]uint64{
+		"8":     1,
+		"10M":   1250000,
+		"1G":    125000000,
+		"100Mi": 13107200,
+	}
+	for in, out := range valid {
+		bps, err := ParseBandwidth(in)
+		c.Assert(err, IsNil, Commentf("%s", in))
+		c.Assert(bps, Equals, out, Commentf("%s", in))
+	}
+
+	invalid := []string{"", "0", "7", "-10M", "10Mbps", "fast"}
+	for _, in := range invalid {
+		_, err := ParseBandwidth(in)
+		c.Assert(err, Not(IsNil), Commentf("%s", in))
+	}
+}
@@ -62,6 +62,16 @@ const (
 	// MaxTime specifies the last possible time for GCFilter.Time
 	MaxTime = math.MaxUint32
 
+	// CloseTimeout is the lifetime of an entry after the connection was
+	// closed, the shortest lifetime. Must be in sync with
+	// CT_DEFAULT_CLOSE_TIMEOUT in <bpf/lib/conntrack.h>
+	CloseTimeout = 10
+
+	// MaxLifetimeSlack is the maximum number of seconds by which the
+	// datapath may defer refreshing the lifetime of an entry. Retransmits
+	// of FIN or RST packets must still extend the close timeout.
+	MaxLifetimeSlack = CloseTimeout / 2
+
 	noAction = iota
 	deleteEntry
 )
@@ -82,21 +92,30 @@ type CtKey interface {
 	Dump(buffer *bytes.Buffer) bool
 }
 
-// CtEntry represents an entry in the connection tracking table.
+// CtEntry represents an entry in the connection tracking table. It must
+// match struct ct_entry in <bpf/lib/common.h>.
 type CtEntry struct {
-	rx_packets uint64
-	rx_bytes   uint64
-	tx_packets uint64
-	tx_bytes   uint64
-	lifetime   uint32
-	flags      uint16
 	// revnat is in network byte order
-	revnat         uint16
-	tx_flags_seen  uint8
-	rx_flags_seen  uint8
-	src_sec_id     uint32
-	last_tx_report uint32
-	last_rx_report uint32
+	revnat uint16
+	slave  uint16
+	flags  uint16
+	// proxy_port and tunnel_endpoint are in network byte order
+	proxy_port uint16
+	src_sec_id uint32
+	// policy_rev is the revision of the cached policy verdict, 0 if unset
+	policy_rev      uint32
+	remote_sec_id   uint32
+	tunnel_endpoint uint32
+	lifetime        uint32
+	tx_flags_seen   uint8
+	rx_flags_seen   uint8
+	pad             uint16
+	last_tx_report  uint32
+	last_rx_report  uint32
+	rx_packets      uint64
+	rx_bytes        uint64
+	tx_packets      uint64
+	tx_bytes        uint64
 }
 
 // GetValuePtr returns the unsafe.Pointer for s.
@@ -104,7 +123,7 @@ func (c *CtEntry) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(c) }
 
 // String returns the readable format
 func (c *CtEntry) String() string {
-	return fmt.Sprintf("expires=%d rx_packets=%d rx_bytes=%d tx_packets=%d tx_bytes=%d flags=%x revnat=%d src_sec_id=%d\n",
+	return fmt.Sprintf("expires=%d rx_packets=%d rx_bytes=%d tx_packets=%d tx_bytes=%d flags=%x revnat=%d src_sec_id=%d policy_rev=%d remote_sec_id=%d proxy_port=%d\n",
 		c.lifetime,
 		c.rx_packets,
 		c.rx_bytes,
@@ -112,7 +131,10 @@ func (c *CtEntry) String() string {
 		c.tx_bytes,
 		c.flags,
 		byteorder.NetworkToHost(c.revnat),
-		c.src_sec_id)
+		c.src_sec_id,
+		c.policy_rev,
+		c.remote_sec_id,
+		byteorder.NetworkToHost(c.proxy_port))
 }
 
 // CtEntryDump represents the key and value contained in the conntrack map.
@@ -160,6 +182,15 @@ func (f *GCFilter) TypeString() string {
 	}
 }
 
+// ValidateLifetimeSlack returns an error if the datapath cannot defer
+// refreshing the lifetime of entries by slack seconds.
+func ValidateLifetimeSlack(slack int) error {
+	if slack < 0 || slack > MaxLifetimeSlack {
+		return fmt.Errorf("lifetime slack must be between 0 and %d seconds", MaxLifetimeSlack)
+	}
+	return nil
+}
+
 // ToString iterates through Map m and writes the values of the ct entries in m
 // to a string.
 func ToString(m *bpf.Map, mapName string) (string, error) {
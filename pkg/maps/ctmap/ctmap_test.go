@@ -0,0 +1,42 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ctmap
+
+import (
+	"testing"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+type CTMapTestSuite struct{}
+
+var _ = Suite(&CTMapTestSuite{})
+
+func (s *CTMapTestSuite) TestValidateLifetimeSlack(c *C) {
+	for _, slack := range []int{0, 1, CloseTimeout / 2} {
+		c.Assert(ValidateLifetimeSlack(slack), IsNil, Commentf("%d", slack))
+	}
+
+	// A larger slack would keep retransmits during the close timeout
+	// from extending the lifetime of the entry.
+	for _, slack := range []int{-1, CloseTimeout/2 + 1, CloseTimeout, 30} {
+		c.Assert(ValidateLifetimeSlack(slack), Not(IsNil), Commentf("%d", slack))
+	}
+}
@@ -0,0 +1,77 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package ipcache
+
+import (
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/lock"
+)
+
+const (
+	// CacheMapName is the name of the per-CPU cache of exact addresses in
+	// front of the ipcache, see <bpf/lib/eps.h>. It is created by the
+	// datapath if enabled.
+	CacheMapName = "cilium_ipcache_cache"
+
+	// CacheGenerationMapName is the name of the map holding the ipcache
+	// generation. Cache entries of older generations are ignored by the
+	// datapath.
+	CacheGenerationMapName = "cilium_ipcache_gen"
+)
+
+var (
+	// CacheGeneration holds the generation of the ipcache at index 0
+	CacheGeneration = bpf.NewMap(
+		CacheGenerationMapName,
+		bpf.BPF_MAP_TYPE_ARRAY,
+		int(unsafe.Sizeof(uint32(0))),
+		int(unsafe.Sizeof(uint32(0))),
+		1,
+		0,
+		nil,
+	)
+
+	generationMutex lock.Mutex
+)
+
+// BumpCacheGeneration invalidates all entries of the datapath cache. It
+// must be called after every change of the ipcache.
+func BumpCacheGeneration() error {
+	var key, generation uint32
+
+	generationMutex.Lock()
+	defer generationMutex.Unlock()
+
+	fd := CacheGeneration.GetFd()
+	if err := bpf.LookupElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&generation)); err != nil {
+		return err
+	}
+
+	// Generation 0 is never current so that entries of CPUs which
+	// did not add them read as invalid.
+	generation++
+	if generation == 0 {
+		generation = 1
+	}
+	return bpf.UpdateElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&generation), 0)
+}
+
+func init() {
+	if err := bpf.OpenAfterMount(CacheGeneration); err != nil {
+		log.WithError(err).Error("unable to open map")
+	}
+}
@@ -0,0 +1,186 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package l4filtermap
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/logging"
+	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/u8proto"
+)
+
+var log = logging.DefaultLogger.WithField(logfields.LogSubsys, "map-l4filter")
+
+const (
+	// MapName is the name of the L4 prefilter rule map.
+	MapName = "cilium_l4filter"
+
+	// BucketMapName is the name of the per-CPU token bucket map. It is
+	// created and owned by the datapath, the agent never writes to it.
+	BucketMapName = "cilium_l4filter_rl"
+
+	// MaxEntries is the maximum number of L4 prefilter rules.
+	MaxEntries = 1024
+
+	// MaxBuckets is the maximum number of source prefixes tracked for
+	// rate limiting at any given time.
+	MaxBuckets = 1024 * 256
+)
+
+// Action is the verdict of an L4 prefilter rule. It must be in sync with
+// the L4_RULE_* enum in <bpf/lib/xdp.h>.
+type Action uint8
+
+const (
+	// ActionPass lets matching packets continue to the endpoint check.
+	ActionPass Action = iota
+	// ActionDrop drops matching packets.
+	ActionDrop
+	// ActionRateLimit admits matching packets through a per source
+	// prefix token bucket.
+	ActionRateLimit
+	// ActionSynCookie answers TCP SYNs of unvalidated sources with SYN
+	// cookies once a destination exceeds the SYN rate of the rule.
+	ActionSynCookie
+)
+
+func (a Action) String() string {
+	switch a {
+	case ActionPass:
+		return "pass"
+	case ActionDrop:
+		return "drop"
+	case ActionRateLimit:
+		return "ratelimit"
+	case ActionSynCookie:
+		return "syncookie"
+	}
+	return fmt.Sprintf("unknown(%d)", uint8(a))
+}
+
+// Key must be in sync with struct l4_rule_key in <bpf/lib/xdp.h>
+type Key struct {
+	DPort  uint16 // network byte order, 0 matches any port
+	Proto  uint8
+	Family uint8
+}
+
+// NewKey returns a Key for the given family, protocol and host byte order
+// destination port.
+func NewKey(family uint8, proto u8proto.U8proto, dport uint16) Key {
+	return Key{
+		DPort:  byteorder.HostToNetwork(dport).(uint16),
+		Proto:  uint8(proto),
+		Family: family,
+	}
+}
+
+// Port returns the destination port in host byte order.
+func (k *Key) Port() uint16 {
+	return byteorder.NetworkToHost(k.DPort).(uint16)
+}
+
+// String converts the key into a human readable string format
+func (k *Key) String() string {
+	family := "v4"
+	if k.Family == bpf.EndpointKeyIPv6 {
+		family = "v6"
+	}
+	port := "*"
+	if k.DPort != 0 {
+		port = fmt.Sprintf("%d", k.Port())
+	}
+	return fmt.Sprintf("%s %s/%s", family, u8proto.U8proto(k.Proto), port)
+}
+
+// GetKeyPtr returns the unsafe pointer to the BPF key
+func (k *Key) GetKeyPtr() unsafe.Pointer { return unsafe.Pointer(k) }
+
+// NewValue returns a new empty instance of the structure representing the BPF
+// map value
+func (k *Key) NewValue() bpf.MapValue { return &Value{} }
+
+// Value must be in sync with struct l4_rule_val in <bpf/lib/xdp.h>
+type Value struct {
+	Action Action
+	Pad1   uint8
+	Pad2   uint16
+	Rate   uint32 // packets per second, per CPU
+	Burst  uint32 // bucket depth in packets, per CPU
+	Pad3   uint32
+}
+
+// String converts the value into a human readable string format
+func (v *Value) String() string {
+	if v.Action == ActionRateLimit || v.Action == ActionSynCookie {
+		return fmt.Sprintf("%s rate:%d burst:%d", v.Action, v.Rate, v.Burst)
+	}
+	return v.Action.String()
+}
+
+// GetValuePtr returns the unsafe pointer to the BPF value.
+func (v *Value) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(v) }
+
+// Map represents the L4 prefilter rule map.
+type Map struct {
+	bpf.Map
+}
+
+// NewMap instantiates the L4 prefilter rule Map.
+func NewMap() *Map {
+	return &Map{
+		Map: *bpf.NewMap(
+			MapName,
+			bpf.BPF_MAP_TYPE_HASH,
+			int(unsafe.Sizeof(Key{})),
+			int(unsafe.Sizeof(Value{})),
+			MaxEntries,
+			bpf.BPF_F_NO_PREALLOC,
+			func(key []byte, value []byte) (bpf.MapKey, bpf.MapValue, error) {
+				k, v := Key{}, Value{}
+
+				if err := bpf.ConvertKeyValue(key, value, &k, &v); err != nil {
+					return nil, nil, err
+				}
+				return &k, &v, nil
+			},
+		),
+	}
+}
+
+// InsertRule adds or replaces the rule for 'key'.
+func (m *Map) InsertRule(key Key, value Value) error {
+	log.WithField(logfields.BPFMapName, MapName).Debugf("Inserting L4 filter %s: %s", key.String(), value.String())
+	return m.Update(&key, &value)
+}
+
+// DeleteRule removes the rule for 'key'.
+func (m *Map) DeleteRule(key Key) error {
+	log.WithField(logfields.BPFMapName, MapName).Debugf("Removing L4 filter %s", key.String())
+	return m.Delete(&key)
+}
+
+// Keys returns the keys of all rules in the map.
+func (m *Map) Keys() ([]Key, error) {
+	var keys []Key
+	err := m.DumpWithCallback(func(k bpf.MapKey, v bpf.MapValue) {
+		keys = append(keys, *k.(*Key))
+	})
+	return keys, err
+}
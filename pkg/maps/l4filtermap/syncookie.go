@@ -0,0 +1,131 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package l4filtermap
+
+import (
+	"crypto/rand"
+	"fmt"
+	"net"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/lock"
+	"github.com/cilium/cilium/pkg/u8proto"
+)
+
+const (
+	// SynCookieStatsMapName is the name of the per-CPU map counting SYN
+	// cookies sent and validated per destination. It is created and
+	// owned by the datapath.
+	SynCookieStatsMapName = "cilium_l4filter_sc"
+
+	// SynCookieSourceMapName is the name of the map of sources which
+	// returned a valid SYN cookie. It is created and owned by the
+	// datapath.
+	SynCookieSourceMapName = "cilium_l4filter_sc_src"
+
+	// SynCookieSecretMapName is the name of the map holding the secret
+	// of the SYN cookie hash.
+	SynCookieSecretMapName = "cilium_l4filter_sc_key"
+
+	// MaxSynCookieEntries is the maximum number of validated sources and
+	// of destinations with SYN cookie stats.
+	MaxSynCookieEntries = 1024 * 64
+)
+
+// BucketKey must be in sync with struct l4_bucket_key in <bpf/lib/xdp.h>.
+// SYN cookie stats are keyed by destination address.
+type BucketKey struct {
+	Addr   [16]byte
+	DPort  uint16 // network byte order
+	Proto  uint8
+	Family uint8
+}
+
+// String converts the key into a human readable string format
+func (k *BucketKey) String() string {
+	var ip net.IP
+	if k.Family == bpf.EndpointKeyIPv6 {
+		ip = net.IP(k.Addr[:])
+	} else {
+		ip = net.IP(k.Addr[:net.IPv4len])
+	}
+	port := "*"
+	if k.DPort != 0 {
+		port = fmt.Sprintf("%d", byteorder.NetworkToHost(k.DPort).(uint16))
+	}
+	return fmt.Sprintf("%s/%s", net.JoinHostPort(ip.String(), port), u8proto.U8proto(k.Proto))
+}
+
+// SynCookieStats must be in sync with struct syncookie_stats in
+// <bpf/lib/xdp.h>
+type SynCookieStats struct {
+	Sent      uint64
+	Validated uint64
+}
+
+// synCookieSecret must be in sync with struct syncookie_secret in
+// <bpf/lib/xdp.h>
+type synCookieSecret struct {
+	Key [4]uint32
+}
+
+var (
+	synCookieSecretMutex lock.Mutex
+
+	// synCookieSecretDone is set once the secret of this agent run has
+	// been written
+	synCookieSecretDone bool
+)
+
+// InitSynCookieSecret creates the SYN cookie secret map and fills it with
+// a new random secret once per agent run. Later calls, e.g. when the
+// datapath is recompiled, leave the secret untouched so that cookies in
+// flight remain valid. After a restart of the agent, clients which are in
+// the middle of a validation simply retry.
+func InitSynCookieSecret() error {
+	synCookieSecretMutex.Lock()
+	defer synCookieSecretMutex.Unlock()
+	if synCookieSecretDone {
+		return nil
+	}
+
+	m := bpf.NewMap(SynCookieSecretMapName,
+		bpf.BPF_MAP_TYPE_ARRAY,
+		int(unsafe.Sizeof(uint32(0))),
+		int(unsafe.Sizeof(synCookieSecret{})),
+		1,
+		0,
+		nil,
+	)
+	if _, err := m.OpenOrCreate(); err != nil {
+		return err
+	}
+	defer m.Close()
+
+	var key uint32
+	var secret synCookieSecret
+	buf := (*[unsafe.Sizeof(secret)]byte)(unsafe.Pointer(&secret))
+	if _, err := rand.Read(buf[:]); err != nil {
+		return fmt.Errorf("unable to generate SYN cookie secret: %s", err)
+	}
+	if err := bpf.UpdateElement(m.GetFd(), unsafe.Pointer(&key), unsafe.Pointer(&secret), 0); err != nil {
+		return err
+	}
+
+	synCookieSecretDone = true
+	return nil
+}
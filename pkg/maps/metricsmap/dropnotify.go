@@ -0,0 +1,58 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metricsmap
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/maps/tracemap"
+	"github.com/cilium/cilium/pkg/metrics"
+	"github.com/cilium/cilium/pkg/monitor"
+)
+
+// SyncDropNotifyMetrics is called periodically to sync the number of drop
+// notifications suppressed by rate limiting, summed over all CPUs, with
+// the prometheus server.
+func SyncDropNotifyMetrics() error {
+	bucketmap, err := bpf.OpenMap(bpf.MapPath(tracemap.DropBucketMapName))
+	if err != nil {
+		return fmt.Errorf("unable to open drop notification bucket map: %s", err)
+	}
+	defer bucketmap.Close()
+
+	entry := make([]tracemap.DropBucket, possibleCpus)
+	for key := uint32(1); key < tracemap.DropLimitMaxEntries; key++ {
+		err := bpf.LookupElement(bucketmap.GetFd(), unsafe.Pointer(&key), unsafe.Pointer(&entry[0]))
+		if err != nil {
+			return fmt.Errorf("unable to lookup drop notification bucket map: %s", err)
+		}
+
+		var suppressed uint64
+		for i := 0; i < possibleCpus; i++ {
+			suppressed += entry[i].Suppressed
+		}
+		if suppressed == 0 {
+			continue
+		}
+
+		reason := monitor.DropReason(uint8(key))
+		if err := addCounterDelta(metrics.DropNotifySuppressed, float64(suppressed), reason); err != nil {
+			log.WithError(err).Warn("Failed to update prometheus metrics")
+		}
+	}
+	return nil
+}
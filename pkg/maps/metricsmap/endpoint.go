@@ -0,0 +1,220 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metricsmap
+
+import (
+	"fmt"
+	"sort"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+)
+
+const (
+	// EndpointMapName is the name of the per endpoint metrics map.
+	EndpointMapName = "cilium_ep_metrics"
+
+	// EndpointMaxEntries is the maximum number of entries in the per
+	// endpoint metrics map, least recently used entries are evicted
+	// once it is full.
+	EndpointMaxEntries = 65536
+
+	// OtherIdentity is the remote identity to which traffic is accounted
+	// if the identity is not tracked for the endpoint.
+	OtherIdentity = 0
+
+	// reasonDropPolicy is -DROP_POLICY in <bpf/lib/common.h>
+	reasonDropPolicy = 133
+)
+
+// EndpointKey must be in sync with struct ep_metrics_key in
+// <bpf/lib/common.h>
+type EndpointKey struct {
+	Identity   uint32
+	EndpointID uint16
+	Reason     uint8
+	Dir        uint8
+}
+
+// String converts the key into a human readable string format
+func (k *EndpointKey) String() string {
+	identity := fmt.Sprintf("%d", k.Identity)
+	if k.Identity == OtherIdentity {
+		identity = "other"
+	}
+	reason := "FORWARDED"
+	if k.Reason != 0 {
+		reason = DropReasonString(k.Reason)
+	}
+	return fmt.Sprintf("endpoint:%d identity:%s reason:%s dir:%s",
+		k.EndpointID, identity, reason, direction[k.Dir])
+}
+
+// DropReasonString returns the drop reason in human readable form.
+func DropReasonString(reason uint8) string {
+	k := Key{Reason: reason}
+	return k.DropForwardReason()
+}
+
+// endpointKeys returns the keys pre-created for an endpoint and a remote
+// identity: forwarded and policy denied traffic in both directions.
+func endpointKeys(id uint16, identity uint32) []EndpointKey {
+	keys := make([]EndpointKey, 0, 4)
+	for _, reason := range []uint8{0, reasonDropPolicy} {
+		for _, dir := range []uint8{dirIngress, dirEgress} {
+			keys = append(keys, EndpointKey{
+				Identity:   identity,
+				EndpointID: id,
+				Reason:     reason,
+				Dir:        dir,
+			})
+		}
+	}
+	return keys
+}
+
+// EndpointIdentities returns at most 'budget' remote identities out of
+// 'identities', ordered and without duplicates, followed by
+// OtherIdentity.
+//
+// The identities with the lowest numeric IDs are kept. Policy does not
+// tell which peers carry the most traffic, but this selection has two
+// useful properties: the reserved identities such as host, world and
+// health, which most endpoints talk to, come first, and the selection
+// only depends on the set of identities. Regenerations with an unchanged
+// policy therefore track the same identities, so that their counters are
+// not split between an identity and OtherIdentity.
+func EndpointIdentities(identities []uint32, budget int) []uint32 {
+	sorted := make([]uint32, 0, len(identities))
+	seen := make(map[uint32]struct{}, len(identities))
+	for _, identity := range identities {
+		if identity == OtherIdentity {
+			continue
+		}
+		if _, ok := seen[identity]; ok {
+			continue
+		}
+		seen[identity] = struct{}{}
+		sorted = append(sorted, identity)
+	}
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i] < sorted[j] })
+
+	if len(sorted) > budget {
+		sorted = sorted[:budget]
+	}
+	return append(sorted, OtherIdentity)
+}
+
+func openEndpointMap() (*bpf.Map, error) {
+	m, err := bpf.OpenMap(bpf.MapPath(EndpointMapName))
+	if err != nil {
+		return nil, fmt.Errorf("unable to open endpoint metrics map: %s", err)
+	}
+	return m, nil
+}
+
+// CreateEndpointEntries creates the metrics entries of endpoint 'id' for
+// the remote identities returned by EndpointIdentities(). Existing
+// entries are left untouched so that counters survive regenerations. The
+// datapath then only has to increment counters for the common cases.
+func CreateEndpointEntries(id uint16, identities []uint32, budget int) error {
+	m, err := openEndpointMap()
+	if err != nil {
+		return err
+	}
+	defer m.Close()
+
+	// Values of per-CPU maps are passed for all possible CPUs at once
+	entry := make([]Value, possibleCpus)
+	for _, identity := range EndpointIdentities(identities, budget) {
+		for _, key := range endpointKeys(id, identity) {
+			keyPtr, valuePtr := unsafe.Pointer(&key), unsafe.Pointer(&entry[0])
+			if bpf.LookupElement(m.GetFd(), keyPtr, valuePtr) == nil {
+				continue
+			}
+
+			for i := range entry {
+				entry[i] = Value{}
+			}
+			err := bpf.UpdateElement(m.GetFd(), keyPtr, valuePtr, bpf.BPF_NOEXIST)
+			// The datapath may have created the entry in the meantime
+			if err != nil && bpf.LookupElement(m.GetFd(), keyPtr, valuePtr) != nil {
+				return fmt.Errorf("unable to create endpoint metrics entry %s: %s", key.String(), err)
+			}
+		}
+	}
+	return nil
+}
+
+// EndpointCallback is invoked by DumpEndpointMetrics for every entry with
+// the counters summed over all CPUs.
+type EndpointCallback func(key *EndpointKey, value *Value)
+
+// DumpEndpointMetrics calls 'cb' for all per endpoint metrics entries.
+func DumpEndpointMetrics(cb EndpointCallback) error {
+	m, err := openEndpointMap()
+	if err != nil {
+		return err
+	}
+	defer m.Close()
+
+	entry := make([]Value, possibleCpus)
+	var key, nextKey EndpointKey
+	for {
+		err := bpf.GetNextKey(m.GetFd(), unsafe.Pointer(&key), unsafe.Pointer(&nextKey))
+		if err != nil {
+			break
+		}
+		err = bpf.LookupElement(m.GetFd(), unsafe.Pointer(&nextKey), unsafe.Pointer(&entry[0]))
+		if err == nil {
+			var sum Value
+			for i := 0; i < possibleCpus; i++ {
+				sum.Count += entry[i].Count
+				sum.Bytes += entry[i].Bytes
+			}
+			cb(&nextKey, &sum)
+		}
+		key = nextKey
+	}
+	return nil
+}
+
+// DeleteEndpointEntries removes all metrics entries of endpoint 'id'.
+func DeleteEndpointEntries(id uint16) error {
+	m, err := openEndpointMap()
+	if err != nil {
+		return err
+	}
+	defer m.Close()
+
+	var keys []EndpointKey
+	var key, nextKey EndpointKey
+	for {
+		err := bpf.GetNextKey(m.GetFd(), unsafe.Pointer(&key), unsafe.Pointer(&nextKey))
+		if err != nil {
+			break
+		}
+		if nextKey.EndpointID == id {
+			keys = append(keys, nextKey)
+		}
+		key = nextKey
+	}
+
+	for i := range keys {
+		// Entries may have been evicted in the meantime
+		bpf.DeleteElement(m.GetFd(), unsafe.Pointer(&keys[i]))
+	}
+	return nil
+}
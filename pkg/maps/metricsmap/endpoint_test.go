@@ -0,0 +1,57 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metricsmap
+
+import (
+	"testing"
+
+	"github.com/cilium/cilium/pkg/identity"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+type MetricsMapTestSuite struct{}
+
+var _ = Suite(&MetricsMapTestSuite{})
+
+func (s *MetricsMapTestSuite) TestEndpointIdentities(c *C) {
+	host := identity.ReservedIdentityHost.Uint32()
+	world := identity.ReservedIdentityWorld.Uint32()
+
+	c.Assert(EndpointIdentities(nil, 4), DeepEquals, []uint32{OtherIdentity})
+	c.Assert(EndpointIdentities([]uint32{1000, 300}, 0), DeepEquals, []uint32{OtherIdentity})
+
+	// Duplicates and the catch-all identity are dropped
+	c.Assert(EndpointIdentities([]uint32{300, OtherIdentity, 300, 256}, 4),
+		DeepEquals, []uint32{256, 300, OtherIdentity})
+
+	// The lowest identities are kept, reserved identities first
+	identities := []uint32{1000, 300, world, 256, host}
+	c.Assert(EndpointIdentities(identities, 3), DeepEquals,
+		[]uint32{host, world, 256, OtherIdentity})
+
+	// The selection does not depend on the order of the identities
+	reversed := []uint32{host, 256, world, 300, 1000}
+	c.Assert(EndpointIdentities(reversed, 3), DeepEquals,
+		EndpointIdentities(identities, 3))
+
+	// The input is left untouched
+	c.Assert(identities, DeepEquals, []uint32{1000, 300, world, 256, host})
+}
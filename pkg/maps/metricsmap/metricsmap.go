@@ -49,6 +49,10 @@ const (
 	dirEgress  = 2
 	dirUnknown = 0
 
+	// dirInternal must match METRIC_INTERNAL in bpf/lib/common.h, the
+	// reason of such keys is one of internalReasons.
+	dirInternal = 3
+
 	// possibleCPUsFileLength matches the buffer size for CPUs.
 	// Reference bpf_num_possible_cpus from
 	// https://git.kernel.org/pub/scm/linux/kernel/git/bpf/bpf.git/tree/tools/testing/selftests/bpf/bpf_util.h
@@ -62,6 +66,19 @@ var direction = map[uint8]string{
 	0: "UNKNOWN",
 	1: "INGRESS",
 	2: "EGRESS",
+	3: "INTERNAL",
+}
+
+// internalReasons must be in sync with METRIC_REASON_* in
+// <bpf/lib/common.h>
+var internalReasons = map[uint8]struct {
+	counter *prometheus.CounterVec
+	label   string
+}{
+	1: {metrics.IPCacheCacheLookups, "hit"},
+	2: {metrics.IPCacheCacheLookups, "miss"},
+	3: {metrics.BandwidthPackets, "delayed"},
+	4: {metrics.BandwidthPackets, "dropped"},
 }
 
 // Key must be in sync with struct metrics_key in <bpf/lib/common.h>
@@ -90,6 +107,8 @@ func (k *Key) Direction() string {
 		return direction[k.Dir]
 	case dirEgress:
 		return direction[k.Dir]
+	case dirInternal:
+		return direction[k.Dir]
 	}
 	return direction[dirUnknown]
 }
@@ -164,6 +183,24 @@ func updatePrometheusMetrics(key *Key, val *Value) {
 	}
 }
 
+// updateInternalMetrics updates the prometheus counter of a datapath
+// internal metric with the value summed over all CPUs.
+func updateInternalMetrics(key *Key, val *Value) {
+	reason, ok := internalReasons[key.Reason]
+	if !ok {
+		return
+	}
+
+	counter, err := reason.counter.GetMetricWithLabelValues(reason.label)
+	if err != nil {
+		log.WithError(err).Warn("Failed to update prometheus metrics")
+		return
+	}
+	if old := metrics.GetCounterValue(counter); val.CountFloat() > old {
+		counter.Add(val.CountFloat() - old)
+	}
+}
+
 // SyncMetricsMap is called periodically to sync off the metrics map by
 // aggregating it into drops (by drop reason and direction) and
 // forwards (by direction) with the prometheus server.
@@ -188,6 +225,16 @@ func SyncMetricsMap() error {
 			return fmt.Errorf("unable to lookup metrics map: %s", err)
 		}
 
+		if nextKey.Dir == dirInternal {
+			var sum Value
+			for i := 0; i < possibleCpus; i++ {
+				sum.Count += entry[i].Count
+			}
+			updateInternalMetrics(&nextKey, &sum)
+			key = nextKey
+			continue
+		}
+
 		// cannot use `range entry` since, if the first value for a particular
 		// CPU is zero, it never iterates over the next non-zero value.
 		for i := 0; i < possibleCpus; i++ {
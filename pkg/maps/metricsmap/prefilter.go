@@ -0,0 +1,113 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metricsmap
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/metrics"
+	"github.com/cilium/cilium/pkg/monitor"
+
+	"github.com/prometheus/client_golang/prometheus"
+)
+
+const (
+	// PrefilterMapName is the name of the XDP prefilter drop counter map.
+	PrefilterMapName = "cilium_prefilter_metrics"
+
+	// prefilterMaxEntries must match PREFILTER_METRICS_SIZE in
+	// <bpf/lib/xdp.h>
+	prefilterMaxEntries = 32
+
+	// prefilterFirstReason is -DROP_PREFILTER_DENY in <bpf/lib/common.h>,
+	// the drop reason encoded as index 0 in the prefilter map.
+	prefilterFirstReason = 163
+
+	// prefilterFamilyBits is the number of key bits used for the family,
+	// see PREFILTER_METRICS_KEY() in <bpf/lib/xdp.h>
+	prefilterFamilyBits = 2
+)
+
+// prefilterFamily must be in sync with the PREFILTER_FAMILY_* enum in
+// <bpf/lib/xdp.h>
+var prefilterFamily = map[uint32]string{
+	0: "other",
+	1: "ipv4",
+	2: "ipv6",
+}
+
+// prefilterKeyLabels decodes a prefilter map index into its drop reason
+// and family labels.
+func prefilterKeyLabels(key uint32) (string, string, bool) {
+	family, ok := prefilterFamily[key&(1<<prefilterFamilyBits-1)]
+	if !ok {
+		return "", "", false
+	}
+	reason := prefilterFirstReason + key>>prefilterFamilyBits
+	return monitor.DropReason(uint8(reason)), family, true
+}
+
+func addCounterDelta(vec *prometheus.CounterVec, value float64, labels ...string) error {
+	counter, err := vec.GetMetricWithLabelValues(labels...)
+	if err != nil {
+		return err
+	}
+	if old := metrics.GetCounterValue(counter); value > old {
+		counter.Add(value - old)
+	}
+	return nil
+}
+
+// SyncPrefilterMetrics is called periodically to sync the XDP prefilter
+// drop counters, summed over all CPUs, with the prometheus server.
+func SyncPrefilterMetrics() error {
+	prefiltermap, err := bpf.OpenMap(bpf.MapPath(PrefilterMapName))
+	if err != nil {
+		return fmt.Errorf("unable to open prefilter metrics map: %s", err)
+	}
+	defer prefiltermap.Close()
+
+	entry := make([]Value, possibleCpus)
+	for key := uint32(0); key < prefilterMaxEntries; key++ {
+		reason, family, ok := prefilterKeyLabels(key)
+		if !ok {
+			continue
+		}
+		err := bpf.LookupElement(prefiltermap.GetFd(), unsafe.Pointer(&key), unsafe.Pointer(&entry[0]))
+		if err != nil {
+			return fmt.Errorf("unable to lookup prefilter metrics map: %s", err)
+		}
+
+		var sum Value
+		for i := 0; i < possibleCpus; i++ {
+			sum.Count += entry[i].Count
+			sum.Bytes += entry[i].Bytes
+		}
+		if sum.Count == 0 {
+			continue
+		}
+
+		if err := addCounterDelta(metrics.PrefilterDropCount, float64(sum.Count), reason, family); err != nil {
+			log.WithError(err).Warn("Failed to update prometheus metrics")
+			continue
+		}
+		if err := addCounterDelta(metrics.PrefilterDropBytes, float64(sum.Bytes), reason, family); err != nil {
+			log.WithError(err).Warn("Failed to update prometheus metrics")
+		}
+	}
+	return nil
+}
@@ -0,0 +1,86 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package metricsmap
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/maps/l4filtermap"
+	"github.com/cilium/cilium/pkg/metrics"
+)
+
+// SynCookieCallback is called for each destination in the SYN cookie stats
+// map with the stats summed over all CPUs.
+type SynCookieCallback func(key *l4filtermap.BucketKey, stats *l4filtermap.SynCookieStats)
+
+// DumpSynCookieStats iterates over the SYN cookie stats of all destinations
+// of the XDP prefilter.
+func DumpSynCookieStats(cb SynCookieCallback) error {
+	m, err := bpf.OpenMap(bpf.MapPath(l4filtermap.SynCookieStatsMapName))
+	if err != nil {
+		return fmt.Errorf("unable to open SYN cookie stats map: %s", err)
+	}
+	defer m.Close()
+
+	entry := make([]l4filtermap.SynCookieStats, possibleCpus)
+	var key, nextKey l4filtermap.BucketKey
+	for {
+		err := bpf.GetNextKey(m.GetFd(), unsafe.Pointer(&key), unsafe.Pointer(&nextKey))
+		if err != nil {
+			break
+		}
+		err = bpf.LookupElement(m.GetFd(), unsafe.Pointer(&nextKey), unsafe.Pointer(&entry[0]))
+		if err == nil {
+			var sum l4filtermap.SynCookieStats
+			for i := 0; i < possibleCpus; i++ {
+				sum.Sent += entry[i].Sent
+				sum.Validated += entry[i].Validated
+			}
+			cb(&nextKey, &sum)
+		}
+		key = nextKey
+	}
+	return nil
+}
+
+// SyncSynCookieMetrics is called periodically to sync the SYN cookies sent
+// and validated by the XDP prefilter, summed over all destinations, with
+// the prometheus server. Destinations evicted from the LRU stats map are
+// no longer accounted, the counters never decrease.
+func SyncSynCookieMetrics() error {
+	var sent, validated [bpf.EndpointKeyIPv6 + 1]uint64
+
+	err := DumpSynCookieStats(func(key *l4filtermap.BucketKey, stats *l4filtermap.SynCookieStats) {
+		if key.Family <= bpf.EndpointKeyIPv6 {
+			sent[key.Family] += stats.Sent
+			validated[key.Family] += stats.Validated
+		}
+	})
+	if err != nil {
+		return err
+	}
+
+	for family, label := range map[uint8]string{bpf.EndpointKeyIPv4: "ipv4", bpf.EndpointKeyIPv6: "ipv6"} {
+		if err := addCounterDelta(metrics.PrefilterSynCookies, float64(sent[family]), "sent", label); err != nil {
+			log.WithError(err).Warn("Failed to update prometheus metrics")
+		}
+		if err := addCounterDelta(metrics.PrefilterSynCookies, float64(validated[family]), "validated", label); err != nil {
+			log.WithError(err).Warn("Failed to update prometheus metrics")
+		}
+	}
+	return nil
+}
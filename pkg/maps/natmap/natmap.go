@@ -0,0 +1,156 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package natmap
+
+import (
+	"fmt"
+	"net"
+	"strconv"
+	"unsafe"
+
+	"github.com/cilium/cilium/common/types"
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/logging"
+	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/u8proto"
+)
+
+var log = logging.DefaultLogger.WithField(logfields.LogSubsys, "map-nat")
+
+const (
+	// MapName is the name of the map holding the SNAT mappings of
+	// masqueraded IPv4 flows. It is created and owned by the datapath.
+	MapName = "cilium_snat_v4_external"
+
+	// MaxEntries must match SNAT_MAPPING_MAP_SIZE in the node
+	// configuration. Each masqueraded flow takes up two entries.
+	MaxEntries = 512 * 1024
+
+	// FragMaxEntries must match SNAT_FRAG_MAP_SIZE in the node
+	// configuration. Each fragmented datagram in flight takes up one
+	// entry.
+	FragMaxEntries = 8192
+
+	// DirEgress marks the entry of the original direction of a flow
+	DirEgress = 0
+
+	// DirIngress marks the entry of the reply direction of a flow
+	DirIngress = 1
+)
+
+// Key must be in sync with struct ipv4_ct_tuple in <bpf/lib/common.h>.
+// Unlike conntrack entries, SNAT entries are keyed by the addresses and
+// ports as found in the packet.
+type Key struct {
+	DestAddr   types.IPv4
+	SourceAddr types.IPv4
+	DestPort   uint16 // network byte order
+	SourcePort uint16 // network byte order
+	NextHeader u8proto.U8proto
+	Flags      uint8
+}
+
+// GetKeyPtr returns the unsafe pointer to the BPF key
+func (k *Key) GetKeyPtr() unsafe.Pointer { return unsafe.Pointer(k) }
+
+// NewValue returns a new empty instance of the structure representing the BPF
+// map value
+func (k *Key) NewValue() bpf.MapValue { return &Entry{} }
+
+// String converts the key into a human readable string format
+func (k *Key) String() string {
+	dir := "OUT"
+	if k.Flags == DirIngress {
+		dir = "IN"
+	}
+	return fmt.Sprintf("%s %s %s -> %s", dir, k.NextHeader,
+		hostPort(k.SourceAddr.IP(), k.SourcePort),
+		hostPort(k.DestAddr.IP(), k.DestPort))
+}
+
+// Entry must be in sync with struct ipv4_nat_entry in <bpf/lib/nat.h>
+type Entry struct {
+	ToAddr   types.IPv4
+	ToPort   uint16 // network byte order
+	Pad1     uint16
+	Lifetime uint32
+	Pad2     uint32
+}
+
+// GetValuePtr returns the unsafe pointer to the BPF value.
+func (e *Entry) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(e) }
+
+// String converts the entry into a human readable string format
+func (e *Entry) String() string {
+	return fmt.Sprintf("%s expires=%d", hostPort(e.ToAddr.IP(), e.ToPort), e.Lifetime)
+}
+
+func hostPort(ip net.IP, port uint16) string {
+	return net.JoinHostPort(ip.String(), strconv.Itoa(int(byteorder.NetworkToHost(port).(uint16))))
+}
+
+// Map is the BPF map holding the SNAT mappings of masqueraded IPv4 flows.
+// It is only present if masquerading in BPF is enabled.
+var Map = bpf.NewMap(MapName,
+	bpf.MapTypeLRUHash,
+	int(unsafe.Sizeof(Key{})),
+	int(unsafe.Sizeof(Entry{})),
+	MaxEntries,
+	0,
+	func(key []byte, value []byte) (bpf.MapKey, bpf.MapValue, error) {
+		k, v := Key{}, Entry{}
+
+		if err := bpf.ConvertKeyValue(key, value, &k, &v); err != nil {
+			return nil, nil, err
+		}
+
+		return &k, &v, nil
+	},
+)
+
+// GC removes all SNAT entries which expired before the current time of the
+// datapath and returns the number of removed entries. The datapath refreshes
+// both entries of a flow together, so both directions expire together and
+// their ports become available for new flows again.
+//
+// Nothing is done if the map does not exist.
+func GC() int {
+	if err := Map.Open(); err != nil {
+		return 0
+	}
+
+	t, _ := bpf.GetMtime()
+	now := uint32(t / 1000000000)
+
+	var expired []Key
+	err := Map.DumpWithCallback(func(key bpf.MapKey, value bpf.MapValue) {
+		if value.(*Entry).Lifetime < now {
+			expired = append(expired, *key.(*Key))
+		}
+	})
+	if err != nil {
+		log.WithError(err).Warning("Unable to dump SNAT map")
+	}
+
+	deleted := 0
+	for i := range expired {
+		if err := Map.Delete(&expired[i]); err == nil {
+			deleted++
+		}
+	}
+
+	return deleted
+}
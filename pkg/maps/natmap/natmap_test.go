@@ -0,0 +1,60 @@
+// Copyright 2017 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package natmap
+
+import (
+	"testing"
+	"unsafe"
+
+	"github.com/cilium/cilium/common/types"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/u8proto"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+type NATMapTestSuite struct{}
+
+var _ = Suite(&NATMapTestSuite{})
+
+func (s *NATMapTestSuite) TestLayout(c *C) {
+	// Must match struct ipv4_ct_tuple and struct ipv4_nat_entry
+	c.Assert(unsafe.Sizeof(Key{}), Equals, uintptr(14))
+	c.Assert(unsafe.Sizeof(Entry{}), Equals, uintptr(16))
+}
+
+func (s *NATMapTestSuite) TestString(c *C) {
+	k := Key{
+		DestAddr:   types.IPv4{1, 1, 1, 1},
+		SourceAddr: types.IPv4{10, 0, 0, 1},
+		DestPort:   byteorder.HostToNetwork(uint16(443)).(uint16),
+		SourcePort: byteorder.HostToNetwork(uint16(32000)).(uint16),
+		NextHeader: u8proto.TCP,
+		Flags:      DirEgress,
+	}
+	c.Assert(k.String(), Equals, "OUT TCP 10.0.0.1:32000 -> 1.1.1.1:443")
+
+	e := Entry{
+		ToAddr:   types.IPv4{192, 168, 0, 1},
+		ToPort:   byteorder.HostToNetwork(uint16(61000)).(uint16),
+		Lifetime: 100,
+	}
+	c.Assert(e.String(), Equals, "192.168.0.1:61000 expires=100")
+}
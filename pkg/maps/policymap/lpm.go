@@ -0,0 +1,274 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package policymap
+
+import (
+	"sync"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+)
+
+// Policy maps backed by an LPM trie allow the datapath to resolve L4 and
+// L3 rules of an identity with a single lookup, see __policy_can_access()
+// in <bpf/lib/policy.h>. L3 rules are stored with a prefix covering the
+// identity and traffic direction. Rules for any identity (identity 0) are
+// announced by a catch-all entry with a zero length prefix so that the
+// datapath only performs a second lookup if such rules exist.
+
+const (
+	// Must be synchronized with POLICY_PREFIX_* in <bpf/lib/common.h>
+	policyPrefixL3   = 40
+	policyPrefixFull = 64
+
+	// policyPrefixInvalid is larger than any prefix in the map and makes
+	// GetNextKey return the first key of the trie.
+	policyPrefixInvalid = policyPrefixFull + 1
+)
+
+// Must be synchronized with POLICY_F_* in <bpf/lib/common.h>
+const (
+	policyFlagL3              = 1 << 0
+	policyFlagDefault         = 1 << 1
+	policyFlagWildcardIngress = 1 << 2
+	policyFlagWildcardEgress  = 1 << 3
+)
+
+// policyLPMKey is the key of a policy map backed by an LPM trie. It must
+// match the layout of policy_key in bpf/lib/common.h if POLICY_LPM is
+// defined.
+type policyLPMKey struct {
+	Prefixlen        uint32
+	Identity         uint32
+	TrafficDirection uint8
+	Nexthdr          uint8
+	DestPort         uint16 // In network byte-order
+}
+
+var (
+	lpmOnce      sync.Once
+	lpmSupported bool
+	lpmEnabled   bool
+)
+
+// LPMSupported returns true if the kernel supports all operations on LPM
+// tries required by the policy map. The result is cached after the first
+// call.
+func LPMSupported() bool {
+	lpmOnce.Do(func() {
+		lpmSupported = probeLPM()
+		log.Debugf("Policy maps backed by LPM trie: %t", lpmSupported)
+	})
+	return lpmSupported
+}
+
+// EnableLPM makes newly created policy maps use an LPM trie if supported
+// by the kernel. Returns true if LPM tries are used.
+//
+// A single trie lookup is cheaper than the lookups of the hash table
+// cascade for maps with up to a few hundred entries but becomes more
+// expensive as the trie grows, see test/bpf/policy-bench.go.
+func EnableLPM() bool {
+	lpmEnabled = LPMSupported()
+	return lpmEnabled
+}
+
+// LPMEnabled returns true if newly created policy maps use an LPM trie
+func LPMEnabled() bool {
+	return lpmEnabled
+}
+
+// probeLPM creates a temporary LPM trie and checks that entries can be
+// inserted, iterated over and deleted. Older kernels support the map type
+// without the latter two.
+func probeLPM() bool {
+	fd, err := bpf.CreateMap(bpf.BPF_MAP_TYPE_LPM_TRIE,
+		uint32(unsafe.Sizeof(policyLPMKey{})),
+		uint32(unsafe.Sizeof(PolicyEntry{})), 1, bpf.BPF_F_NO_PREALLOC)
+	if err != nil {
+		return false
+	}
+	defer bpf.ObjClose(fd)
+
+	var entry PolicyEntry
+	key := policyLPMKey{Prefixlen: policyPrefixFull}
+	start := policyLPMKey{Prefixlen: policyPrefixInvalid}
+	next := policyLPMKey{}
+
+	if bpf.UpdateElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&entry), 0) != nil {
+		return false
+	}
+	if bpf.GetNextKey(fd, unsafe.Pointer(&start), unsafe.Pointer(&next)) != nil || next != key {
+		return false
+	}
+	return bpf.DeleteElement(fd, unsafe.Pointer(&key)) == nil
+}
+
+// mapAttributes returns the type, key size and flags of newly created
+// policy maps.
+func mapAttributes() (bpf.MapType, uint32, uint32) {
+	if lpmEnabled {
+		return typeAttributes(bpf.BPF_MAP_TYPE_LPM_TRIE)
+	}
+	return typeAttributes(bpf.BPF_MAP_TYPE_HASH)
+}
+
+// typeAttributes returns the key size and flags of policy maps of the
+// given type.
+func typeAttributes(mapType bpf.MapType) (bpf.MapType, uint32, uint32) {
+	if mapType == bpf.BPF_MAP_TYPE_LPM_TRIE {
+		return mapType, uint32(unsafe.Sizeof(policyLPMKey{})), bpf.BPF_F_NO_PREALLOC
+	}
+	return bpf.BPF_MAP_TYPE_HASH, uint32(unsafe.Sizeof(PolicyKey{})),
+		bpf.GetPreAllocateMapFlags(bpf.BPF_MAP_TYPE_HASH)
+}
+
+// isL3 returns true if key applies to all ports and protocols
+func (key *PolicyKey) isL3() bool {
+	return key.DestPort == 0 && key.Nexthdr == 0
+}
+
+// isWildcardL4 returns true if key is an L4 rule for any identity
+func (key *PolicyKey) isWildcardL4() bool {
+	return key.Identity == 0 && !key.isL3()
+}
+
+func (key *PolicyKey) toLPM() policyLPMKey {
+	k := policyLPMKey{
+		Prefixlen:        policyPrefixFull,
+		Identity:         key.Identity,
+		TrafficDirection: key.TrafficDirection,
+		Nexthdr:          key.Nexthdr,
+		DestPort:         key.DestPort,
+	}
+	if key.isL3() {
+		k.Prefixlen = policyPrefixL3
+	}
+	return k
+}
+
+func (k *policyLPMKey) toPolicyKey() PolicyKey {
+	return PolicyKey{
+		Identity:         k.Identity,
+		DestPort:         k.DestPort,
+		Nexthdr:          k.Nexthdr,
+		TrafficDirection: k.TrafficDirection,
+	}
+}
+
+// keyPtr returns a pointer to key in the format of the map
+func (pm *PolicyMap) keyPtr(key *PolicyKey) unsafe.Pointer {
+	if pm.lpm {
+		k := key.toLPM()
+		return unsafe.Pointer(&k)
+	}
+	return unsafe.Pointer(key)
+}
+
+func wildcardFlag(trafficDirection TrafficDirection) uint8 {
+	if trafficDirection == Egress {
+		return policyFlagWildcardEgress
+	}
+	return policyFlagWildcardIngress
+}
+
+// setWildcard sets or clears the flag of the catch-all entry announcing L4
+// rules for any identity in the given direction. The catch-all entry is
+// removed if no flags remain.
+func (pm *PolicyMap) setWildcard(trafficDirection TrafficDirection, enable bool) error {
+	var entry PolicyEntry
+	key := policyLPMKey{}
+
+	if bpf.LookupElement(pm.Fd, unsafe.Pointer(&key), unsafe.Pointer(&entry)) != nil {
+		entry = PolicyEntry{}
+	}
+
+	flags := entry.Flags &^ policyFlagDefault
+	if enable {
+		flags |= wildcardFlag(trafficDirection)
+	} else {
+		flags &^= wildcardFlag(trafficDirection)
+	}
+
+	if flags == 0 {
+		if entry.Flags == 0 {
+			return nil
+		}
+		return bpf.DeleteElement(pm.Fd, unsafe.Pointer(&key))
+	}
+
+	entry.Flags = flags | policyFlagDefault
+	return bpf.UpdateElement(pm.Fd, unsafe.Pointer(&key), unsafe.Pointer(&entry), 0)
+}
+
+// updateWildcard recomputes the flag of the catch-all entry for the given
+// direction after an L4 rule for any identity has been removed.
+func (pm *PolicyMap) updateWildcard(trafficDirection TrafficDirection) error {
+	entries, err := pm.dumpLPM()
+	if err != nil {
+		return err
+	}
+
+	for _, e := range entries {
+		if e.Key.TrafficDirection == trafficDirection.Uint8() && e.Key.isWildcardL4() {
+			return pm.setWildcard(trafficDirection, true)
+		}
+	}
+	return pm.setWildcard(trafficDirection, false)
+}
+
+// lpmKeys returns all keys of the trie including the catch-all entry
+func (pm *PolicyMap) lpmKeys() []policyLPMKey {
+	var keys []policyLPMKey
+	key := policyLPMKey{Prefixlen: policyPrefixInvalid}
+	for {
+		var nextKey policyLPMKey
+		if bpf.GetNextKey(pm.Fd, unsafe.Pointer(&key), unsafe.Pointer(&nextKey)) != nil {
+			break
+		}
+		keys = append(keys, nextKey)
+		key = nextKey
+	}
+	return keys
+}
+
+func (pm *PolicyMap) dumpLPM() ([]PolicyEntryDump, error) {
+	entries := []PolicyEntryDump{}
+	for _, key := range pm.lpmKeys() {
+		var entry PolicyEntry
+		if key.Prefixlen == 0 {
+			continue
+		}
+
+		// A lookup never matches prefixes longer than the one of the
+		// key, so this returns the entry of the exact key.
+		err := bpf.LookupElement(pm.Fd, unsafe.Pointer(&key), unsafe.Pointer(&entry))
+		if err != nil {
+			return nil, err
+		}
+		entries = append(entries, PolicyEntryDump{Key: key.toPolicyKey(), PolicyEntry: entry})
+	}
+	return entries, nil
+}
+
+func (pm *PolicyMap) flushLPM() error {
+	// Keys are collected first as deleting nodes while iterating
+	// restarts the iteration of the trie.
+	for _, key := range pm.lpmKeys() {
+		// FIXME: Ignore delete errors?
+		bpf.DeleteElement(pm.Fd, unsafe.Pointer(&key))
+	}
+	return nil
+}
@@ -17,6 +17,7 @@ package policymap
 import (
 	"bytes"
 	"fmt"
+	"os"
 	"unsafe"
 
 	"github.com/cilium/cilium/pkg/bpf"
@@ -53,6 +54,9 @@ type PolicyMap struct {
 	path  string
 	Fd    int
 	mutex lock.Mutex
+
+	// lpm is true if the map is backed by an LPM trie, see lpm.go
+	lpm bool
 }
 
 func (pe *PolicyEntry) String() string {
@@ -72,7 +76,8 @@ type PolicyKey struct {
 // match the layout of policy_entry in bpf/lib/common.h.
 type PolicyEntry struct {
 	ProxyPort uint16 // In network byte-order
-	Pad0      uint16
+	Flags     uint8
+	Pad0      uint8
 	Pad1      uint16
 	Pad2      uint16
 	Packets   uint64
@@ -155,7 +160,21 @@ func (pm *PolicyMap) AllowKey(k PolicyKey, proxyPort uint16) error {
 func (pm *PolicyMap) Allow(id uint32, dport uint16, proto u8proto.U8proto, trafficDirection TrafficDirection, proxyPort uint16) error {
 	key := PolicyKey{Identity: id, DestPort: byteorder.HostToNetwork(dport).(uint16), Nexthdr: uint8(proto), TrafficDirection: trafficDirection.Uint8()}
 	entry := PolicyEntry{ProxyPort: byteorder.HostToNetwork(proxyPort).(uint16)}
-	return bpf.UpdateElement(pm.Fd, unsafe.Pointer(&key), unsafe.Pointer(&entry), 0)
+	if key.isL3() {
+		// The datapath ignores the proxy port of L3 entries
+		entry.Flags = policyFlagL3
+		if pm.lpm {
+			entry.ProxyPort = 0
+		}
+	}
+
+	if err := bpf.UpdateElement(pm.Fd, pm.keyPtr(&key), unsafe.Pointer(&entry), 0); err != nil {
+		return err
+	}
+	if pm.lpm && key.isWildcardL4() {
+		return pm.setWildcard(trafficDirection, true)
+	}
+	return nil
 }
 
 // Exists determines whether PolicyMap currently contains an entry that
@@ -164,7 +183,16 @@ func (pm *PolicyMap) Allow(id uint32, dport uint16, proto u8proto.U8proto, traff
 func (pm *PolicyMap) Exists(id uint32, dport uint16, proto u8proto.U8proto, trafficDirection TrafficDirection) bool {
 	key := PolicyKey{Identity: id, DestPort: byteorder.HostToNetwork(dport).(uint16), Nexthdr: uint8(proto), TrafficDirection: trafficDirection.Uint8()}
 	var entry PolicyEntry
-	return bpf.LookupElement(pm.Fd, unsafe.Pointer(&key), unsafe.Pointer(&entry)) == nil
+	if bpf.LookupElement(pm.Fd, pm.keyPtr(&key), unsafe.Pointer(&entry)) != nil {
+		return false
+	}
+	if pm.lpm {
+		// The lookup returns the longest matching prefix, which may
+		// be an L3 rule or the catch-all entry.
+		return entry.Flags&policyFlagDefault == 0 &&
+			(entry.Flags&policyFlagL3 != 0) == key.isL3()
+	}
+	return true
 }
 
 // DeleteKey deletes the key-value pair from the given PolicyMap with PolicyKey
@@ -179,13 +207,20 @@ func (pm *PolicyMap) DeleteKey(k PolicyKey) error {
 // Returns an error if the deletion did not succeed.
 func (pm *PolicyMap) Delete(id uint32, dport uint16, proto u8proto.U8proto, trafficDirection TrafficDirection) error {
 	key := PolicyKey{Identity: id, DestPort: byteorder.HostToNetwork(dport).(uint16), Nexthdr: uint8(proto), TrafficDirection: trafficDirection.Uint8()}
-	return bpf.DeleteElement(pm.Fd, unsafe.Pointer(&key))
+	if err := bpf.DeleteElement(pm.Fd, pm.keyPtr(&key)); err != nil {
+		return err
+	}
+	if pm.lpm && key.isWildcardL4() {
+		return pm.updateWildcard(trafficDirection)
+	}
+	return nil
 }
 
 // DeleteEntry removes an entry from the PolicyMap. It can be used in
 // conjunction with DumpToSlice() to inspect and delete map entries.
 func (pm *PolicyMap) DeleteEntry(entry *PolicyEntryDump) error {
-	return bpf.DeleteElement(pm.Fd, unsafe.Pointer(&entry.Key))
+	key := entry.Key.ToHost()
+	return pm.DeleteKey(key)
 }
 
 func (pm *PolicyMap) String() string {
@@ -206,6 +241,10 @@ func (pm *PolicyMap) Dump() (string, error) {
 }
 
 func (pm *PolicyMap) DumpToSlice() ([]PolicyEntryDump, error) {
+	if pm.lpm {
+		return pm.dumpLPM()
+	}
+
 	var key, nextKey PolicyKey
 	entries := []PolicyEntryDump{}
 	for {
@@ -240,6 +279,10 @@ func (pm *PolicyMap) DumpToSlice() ([]PolicyEntryDump, error) {
 
 // Flush deletes all entries from the given policy map
 func (pm *PolicyMap) Flush() error {
+	if pm.lpm {
+		return pm.flushLPM()
+	}
+
 	var key, nextKey PolicyKey
 	for {
 		err := bpf.GetNextKey(
@@ -295,9 +338,9 @@ func (pm *PolicyMap) Close() error {
 // attributes such as type, key length, value length are the same as for the
 // current version of Cilium.
 func Validate(path string) (bool, error) {
-	dummy := bpf.NewMap(path, bpf.BPF_MAP_TYPE_HASH,
-		int(unsafe.Sizeof(PolicyKey{})),
-		int(unsafe.Sizeof(PolicyEntry{})), MaxEntries, 0, nil)
+	mapType, keySize, flags := mapAttributes()
+	dummy := bpf.NewMap(path, mapType, int(keySize),
+		int(unsafe.Sizeof(PolicyEntry{})), MaxEntries, flags, nil)
 
 	existing, err := bpf.OpenMap(path)
 	if err != nil {
@@ -312,20 +355,33 @@ func Validate(path string) (bool, error) {
 }
 
 func OpenMap(path string) (*PolicyMap, bool, error) {
+	mapType, keySize, flags := mapAttributes()
+
+	// An existing map determines the key format and whether entries are
+	// preallocated, it may have been created with different settings.
+	if existing, err := bpf.ObjGet(path); err == nil {
+		info, err := bpf.GetMapInfo(os.Getpid(), existing)
+		bpf.ObjClose(existing)
+		if err == nil {
+			mapType, keySize, _ = typeAttributes(info.MapType)
+			flags = info.Flags
+		}
+	}
+
 	fd, isNewMap, err := bpf.OpenOrCreateMap(
 		path,
-		bpf.BPF_MAP_TYPE_HASH,
-		uint32(unsafe.Sizeof(PolicyKey{})),
+		int(mapType),
+		keySize,
 		uint32(unsafe.Sizeof(PolicyEntry{})),
 		MaxEntries,
-		0,
+		flags,
 	)
 
 	if err != nil {
 		return nil, false, err
 	}
 
-	m := &PolicyMap{path: path, Fd: fd}
+	m := &PolicyMap{path: path, Fd: fd, lpm: mapType == bpf.BPF_MAP_TYPE_LPM_TRIE}
 
 	return m, isNewMap, nil
 }
@@ -0,0 +1,121 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package policymap
+
+import (
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/lock"
+)
+
+const (
+	// RevisionMapName is the name of the map holding the datapath policy
+	// revision of each endpoint, see policy_revision() in
+	// <bpf/lib/policy.h>. It must not carry the per endpoint policy map
+	// prefix.
+	RevisionMapName = "cilium_ep_policy_rev"
+
+	// RevisionMaxEntries is the number of entries of the revision map,
+	// which is indexed by endpoint ID.
+	RevisionMaxEntries = 65536
+)
+
+var (
+	// Revisions holds the datapath policy revision of each endpoint.
+	// Policy verdicts cached in conntrack entries are only used by the
+	// datapath while the revision of the endpoint is unchanged.
+	Revisions = bpf.NewMap(
+		RevisionMapName,
+		bpf.MapTypeArray,
+		int(unsafe.Sizeof(uint32(0))),
+		int(unsafe.Sizeof(uint32(0))),
+		RevisionMaxEntries,
+		0,
+		nil,
+	)
+
+	revisionMutex lock.Mutex
+
+	// lastRevision is the revision last handed out by BumpRevision.
+	// Revisions are unique across all endpoints so that the revision of
+	// an endpoint never returns to a previous value.
+	lastRevision uint32
+
+	// lookupRevision and updateRevision access the entry of an endpoint
+	// in the revision map. They are replaced by the unit tests.
+	lookupRevision = func(id uint32) (uint32, error) {
+		var rev uint32
+		err := bpf.LookupElement(Revisions.GetFd(), unsafe.Pointer(&id), unsafe.Pointer(&rev))
+		return rev, err
+	}
+	updateRevision = func(id, rev uint32) error {
+		return bpf.UpdateElement(Revisions.GetFd(), unsafe.Pointer(&id), unsafe.Pointer(&rev), 0)
+	}
+)
+
+func init() {
+	if err := bpf.OpenAfterMount(Revisions); err != nil {
+		log.WithError(err).Error("unable to open map")
+	}
+}
+
+// InitRevisions continues revisions above the highest revision left behind
+// in the revision map by a previous instance of the agent. It reads every
+// entry of the map and is only needed if policy verdicts are cached.
+func InitRevisions() error {
+	var max uint32
+
+	revisionMutex.Lock()
+	defer revisionMutex.Unlock()
+
+	for id := uint32(0); id < RevisionMaxEntries; id++ {
+		rev, err := lookupRevision(id)
+		if err != nil {
+			return err
+		}
+		if rev > max {
+			max = rev
+		}
+	}
+
+	lastRevision = max
+	return nil
+}
+
+// BumpRevision assigns a new datapath policy revision to the endpoint with
+// the given ID, invalidating all policy verdicts cached for it. It must be
+// called after every change of the policy map or program of the endpoint.
+func BumpRevision(id uint16) error {
+	revisionMutex.Lock()
+	defer revisionMutex.Unlock()
+
+	// Revision 0 disables the cache.
+	lastRevision++
+	if lastRevision == 0 {
+		lastRevision = 1
+	}
+	return setRevision(id, lastRevision)
+}
+
+// DeleteRevision disables the use of cached policy verdicts for the endpoint
+// with the given ID.
+func DeleteRevision(id uint16) error {
+	return setRevision(id, 0)
+}
+
+func setRevision(id uint16, rev uint32) error {
+	return updateRevision(uint32(id), rev)
+}
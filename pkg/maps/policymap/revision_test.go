@@ -0,0 +1,97 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package policymap
+
+import (
+	"fmt"
+	"testing"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+type RevisionTestSuite struct {
+	revisions   [RevisionMaxEntries]uint32
+	savedLookup func(uint32) (uint32, error)
+	savedUpdate func(uint32, uint32) error
+}
+
+var _ = Suite(&RevisionTestSuite{})
+
+func (s *RevisionTestSuite) SetUpTest(c *C) {
+	s.revisions = [RevisionMaxEntries]uint32{}
+	s.savedLookup, s.savedUpdate = lookupRevision, updateRevision
+	lookupRevision = func(id uint32) (uint32, error) {
+		if id >= RevisionMaxEntries {
+			return 0, fmt.Errorf("invalid id %d", id)
+		}
+		return s.revisions[id], nil
+	}
+	updateRevision = func(id, rev uint32) error {
+		if id >= RevisionMaxEntries {
+			return fmt.Errorf("invalid id %d", id)
+		}
+		s.revisions[id] = rev
+		return nil
+	}
+	lastRevision = 0
+}
+
+func (s *RevisionTestSuite) TearDownTest(c *C) {
+	lookupRevision, updateRevision = s.savedLookup, s.savedUpdate
+	lastRevision = 0
+}
+
+func (s *RevisionTestSuite) TestBumpRevision(c *C) {
+	c.Assert(BumpRevision(1), IsNil)
+	c.Assert(BumpRevision(2), IsNil)
+	c.Assert(s.revisions[1], Equals, uint32(1))
+	c.Assert(s.revisions[2], Equals, uint32(2))
+
+	// Revisions are unique across endpoints
+	c.Assert(BumpRevision(1), IsNil)
+	c.Assert(s.revisions[1], Equals, uint32(3))
+	c.Assert(s.revisions[2], Equals, uint32(2))
+
+	c.Assert(DeleteRevision(1), IsNil)
+	c.Assert(s.revisions[1], Equals, uint32(0))
+
+	// Revision 0 disables the cache and is skipped on wrap around
+	lastRevision = ^uint32(0)
+	c.Assert(BumpRevision(3), IsNil)
+	c.Assert(s.revisions[3], Equals, uint32(1))
+}
+
+func (s *RevisionTestSuite) TestInitRevisions(c *C) {
+	c.Assert(InitRevisions(), IsNil)
+	c.Assert(BumpRevision(1), IsNil)
+	c.Assert(s.revisions[1], Equals, uint32(1))
+
+	// Revisions left behind by a previous instance are never reused
+	s.revisions[7] = 100
+	s.revisions[RevisionMaxEntries-1] = 42
+	c.Assert(InitRevisions(), IsNil)
+	c.Assert(BumpRevision(7), IsNil)
+	c.Assert(s.revisions[7], Equals, uint32(101))
+
+	lookupRevision = func(id uint32) (uint32, error) {
+		return 0, fmt.Errorf("lookup failed")
+	}
+	c.Assert(InitRevisions(), Not(IsNil))
+}
@@ -0,0 +1,108 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tracemap
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/logging/logfields"
+)
+
+const (
+	// DebugMapName is the name of the per endpoint debug configuration
+	// map.
+	DebugMapName = "cilium_dbg_config"
+
+	// DebugMaxEntries must match DBG_CONFIG_MAP_SIZE in <bpf/lib/dbg.h>.
+	// The map is indexed by endpoint ID, index 0 applies to programs not
+	// attached to an endpoint.
+	DebugMaxEntries = 65536
+)
+
+// Must be in sync with the DBG_CONFIG_* enum in <bpf/lib/dbg.h>
+const (
+	// DebugFlagEnabled enables debug messages of an endpoint.
+	DebugFlagEnabled = 1 << iota
+)
+
+// DebugConfig must be in sync with struct dbg_config in <bpf/lib/dbg.h>
+type DebugConfig struct {
+	Flags uint32
+	Rate  uint32 // messages per second and CPU, 0 disables the limit
+}
+
+// String converts the value into a human readable string format
+func (v *DebugConfig) String() string {
+	if v.Flags&DebugFlagEnabled == 0 {
+		return "disabled"
+	}
+	if v.Rate == 0 {
+		return "enabled"
+	}
+	return fmt.Sprintf("enabled rate:%d", v.Rate)
+}
+
+// GetValuePtr returns the unsafe pointer to the BPF value.
+func (v *DebugConfig) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(v) }
+
+// debugKey is the index into the debug configuration map. It only differs
+// from Key in the value type returned by NewValue().
+type debugKey struct {
+	Key
+}
+
+// NewValue returns a new empty instance of the structure representing the BPF
+// map value
+func (k *debugKey) NewValue() bpf.MapValue { return &DebugConfig{} }
+
+var (
+	// Debug is the BPF map holding the debug configuration of all
+	// endpoints.
+	Debug = bpf.NewMap(DebugMapName,
+		bpf.MapTypeArray,
+		int(unsafe.Sizeof(debugKey{})),
+		int(unsafe.Sizeof(DebugConfig{})),
+		DebugMaxEntries,
+		0,
+		func(key []byte, value []byte) (bpf.MapKey, bpf.MapValue, error) {
+			k, v := debugKey{}, DebugConfig{}
+
+			if err := bpf.ConvertKeyValue(key, value, &k, &v); err != nil {
+				return nil, nil, err
+			}
+
+			return &k, &v, nil
+		},
+	)
+)
+
+func init() {
+	bpf.OpenAfterMount(Debug)
+}
+
+// SetDebug enables or disables the debug messages of endpoint 'id' without
+// regenerating its program. Messages are limited to 'rate' per second and
+// CPU, 0 disables the limit.
+func SetDebug(id uint16, enabled bool, rate uint32) error {
+	cfg := DebugConfig{}
+	if enabled {
+		cfg.Flags |= DebugFlagEnabled
+		cfg.Rate = rate
+	}
+	log.WithField(logfields.EndpointID, id).Debugf("Setting debug configuration %s", cfg.String())
+	return Debug.Update(&debugKey{Key{EndpointID: uint32(id)}}, &cfg)
+}
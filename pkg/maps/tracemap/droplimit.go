@@ -0,0 +1,169 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tracemap
+
+import (
+	"fmt"
+	"strconv"
+	"strings"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/monitor"
+)
+
+const (
+	// DropLimitMapName is the name of the map holding the rate limits of
+	// drop notifications per drop reason.
+	DropLimitMapName = "cilium_drop_notify_limits"
+
+	// DropBucketMapName is the name of the per-CPU map holding the token
+	// buckets of drop notifications per drop reason.
+	DropBucketMapName = "cilium_drop_notify_buckets"
+
+	// DropLimitMaxEntries must match DROP_NOTIFY_LIMITS_SIZE in
+	// <bpf/lib/drop.h>. Both maps are indexed by drop reason.
+	DropLimitMaxEntries = 256
+)
+
+// ReasonKey is the index into the drop notification rate limit maps.
+type ReasonKey struct {
+	Reason uint32
+}
+
+// String converts the key into a human readable string format
+func (k *ReasonKey) String() string { return monitor.DropReason(uint8(k.Reason)) }
+
+// GetKeyPtr returns the unsafe pointer to the BPF key
+func (k *ReasonKey) GetKeyPtr() unsafe.Pointer { return unsafe.Pointer(k) }
+
+// NewValue returns a new empty instance of the structure representing the BPF
+// map value
+func (k *ReasonKey) NewValue() bpf.MapValue { return &DropLimit{} }
+
+// DropLimit must be in sync with struct drop_notify_limit in
+// <bpf/lib/drop.h>
+type DropLimit struct {
+	Rate  uint32 // notifications per second and CPU
+	Burst uint32 // maximum bucket depth, 0 disables the limit
+}
+
+// String converts the value into a human readable string format
+func (v *DropLimit) String() string {
+	if v.Burst == 0 {
+		return "unlimited"
+	}
+	return fmt.Sprintf("%d:%d", v.Rate, v.Burst)
+}
+
+// GetValuePtr returns the unsafe pointer to the BPF value.
+func (v *DropLimit) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(v) }
+
+// DropBucket must be in sync with struct ratelimit_bucket in
+// <bpf/lib/ratelimit.h>
+type DropBucket struct {
+	Last       uint64
+	Tokens     uint64
+	Suppressed uint64
+}
+
+var (
+	// DropLimits is the BPF map holding the rate limits of drop
+	// notifications.
+	DropLimits = bpf.NewMap(DropLimitMapName,
+		bpf.MapTypeArray,
+		int(unsafe.Sizeof(ReasonKey{})),
+		int(unsafe.Sizeof(DropLimit{})),
+		DropLimitMaxEntries,
+		0,
+		func(key []byte, value []byte) (bpf.MapKey, bpf.MapValue, error) {
+			k, v := ReasonKey{}, DropLimit{}
+
+			if err := bpf.ConvertKeyValue(key, value, &k, &v); err != nil {
+				return nil, nil, err
+			}
+
+			return &k, &v, nil
+		},
+	)
+)
+
+func init() {
+	bpf.OpenAfterMount(DropLimits)
+}
+
+// ParseDropLimits parses rules of the form <reason>=<rate>[:<burst>] into
+// the rate limits of all drop reasons. The reason is the numeric drop
+// reason as shown by cilium monitor or "all", which applies to all reasons
+// without a rule of their own. If burst is omitted, it defaults to rate.
+func ParseDropLimits(rules []string) ([DropLimitMaxEntries]DropLimit, error) {
+	var limits, explicit [DropLimitMaxEntries]DropLimit
+	var all DropLimit
+
+	for _, s := range rules {
+		match := strings.SplitN(s, "=", 2)
+		if len(match) != 2 {
+			return limits, fmt.Errorf("missing rate in drop notification limit '%s'", s)
+		}
+
+		var limit DropLimit
+		rateBurst := strings.Split(match[1], ":")
+		if len(rateBurst) > 2 {
+			return limits, fmt.Errorf("drop notification limit '%s' needs <rate>[:<burst>]", s)
+		}
+		rate, err := strconv.ParseUint(rateBurst[0], 10, 32)
+		if err != nil || rate == 0 {
+			return limits, fmt.Errorf("invalid rate in drop notification limit '%s'", s)
+		}
+		limit.Rate = uint32(rate)
+		limit.Burst = limit.Rate
+		if len(rateBurst) == 2 {
+			burst, err := strconv.ParseUint(rateBurst[1], 10, 32)
+			if err != nil || burst == 0 {
+				return limits, fmt.Errorf("invalid burst in drop notification limit '%s'", s)
+			}
+			limit.Burst = uint32(burst)
+		}
+
+		if match[0] == "all" {
+			all = limit
+			continue
+		}
+		reason, err := strconv.ParseUint(match[0], 10, 8)
+		if err != nil || reason == 0 {
+			return limits, fmt.Errorf("invalid drop reason in drop notification limit '%s'", s)
+		}
+		explicit[reason] = limit
+	}
+
+	for i := range limits {
+		limits[i] = all
+		if explicit[i].Burst != 0 {
+			limits[i] = explicit[i]
+		}
+	}
+	return limits, nil
+}
+
+// SetDropLimits installs the rate limits of drop notifications of all drop
+// reasons.
+func SetDropLimits(limits [DropLimitMaxEntries]DropLimit) error {
+	for i := range limits {
+		if err := DropLimits.Update(&ReasonKey{Reason: uint32(i)}, &limits[i]); err != nil {
+			return err
+		}
+	}
+	return nil
+}
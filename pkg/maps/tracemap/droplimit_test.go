@@ -0,0 +1,61 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tracemap
+
+import (
+	"testing"
+
+	. "gopkg.in/check.v1"
+)
+
+// Hook up gocheck into the "go test" runner.
+func Test(t *testing.T) {
+	TestingT(t)
+}
+
+type TraceMapTestSuite struct{}
+
+var _ = Suite(&TraceMapTestSuite{})
+
+func (s *TraceMapTestSuite) TestParseDropLimits(c *C) {
+	limits, err := ParseDropLimits(nil)
+	c.Assert(err, IsNil)
+	for i := range limits {
+		c.Assert(limits[i], Equals, DropLimit{})
+	}
+
+	limits, err = ParseDropLimits([]string{"133=10", "all=100:200", "181=5:50"})
+	c.Assert(err, IsNil)
+	c.Assert(limits[133], Equals, DropLimit{Rate: 10, Burst: 10})
+	c.Assert(limits[181], Equals, DropLimit{Rate: 5, Burst: 50})
+	c.Assert(limits[130], Equals, DropLimit{Rate: 100, Burst: 200})
+	c.Assert(limits[0], Equals, DropLimit{Rate: 100, Burst: 200})
+
+	invalid := []string{
+		"",
+		"133",
+		"0=10",
+		"256=10",
+		"policy=10",
+		"133=0",
+		"133=10:0",
+		"133=10:20:30",
+		"all=",
+	}
+	for _, in := range invalid {
+		_, err := ParseDropLimits([]string{in})
+		c.Assert(err, Not(IsNil), Commentf("%s", in))
+	}
+}
@@ -0,0 +1,179 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package tracemap
+
+import (
+	"fmt"
+	"strings"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/logging"
+	"github.com/cilium/cilium/pkg/logging/logfields"
+	"github.com/cilium/cilium/pkg/monitor"
+)
+
+var log = logging.DefaultLogger.WithField(logfields.LogSubsys, "map-trace")
+
+const (
+	// MapName is the name of the per endpoint trace configuration map.
+	MapName = "cilium_trace_config"
+
+	// MaxEntries must match TRACE_CONFIG_MAP_SIZE in
+	// <bpf/lib/trace_config.h>. The map is indexed by endpoint ID, index
+	// 0 applies to programs not attached to an endpoint.
+	MaxEntries = 65536
+
+	// AllObsPoints enables notifications at all observation points.
+	AllObsPoints = 0xffff
+)
+
+// Must be in sync with the TRACE_CONFIG_* enum in <bpf/lib/trace_config.h>
+const (
+	// FlagEnabled marks an entry as overriding the compile time defaults.
+	FlagEnabled = 1 << iota
+	// FlagNoAggregation bypasses the monitor aggregation level.
+	FlagNoAggregation
+)
+
+// Key is the index into the trace configuration map.
+type Key struct {
+	EndpointID uint32
+}
+
+// String converts the key into a human readable string format
+func (k *Key) String() string { return fmt.Sprintf("%d", k.EndpointID) }
+
+// GetKeyPtr returns the unsafe pointer to the BPF key
+func (k *Key) GetKeyPtr() unsafe.Pointer { return unsafe.Pointer(k) }
+
+// NewValue returns a new empty instance of the structure representing the BPF
+// map value
+func (k *Key) NewValue() bpf.MapValue { return &Config{} }
+
+// Config must be in sync with struct trace_config in
+// <bpf/lib/trace_config.h>
+type Config struct {
+	CapLen     uint16 // 0 uses TRACE_PAYLOAD_LEN
+	ObsPoints  uint16 // bitmask of observation points
+	SampleRate uint32 // 1 in N, 0 or 1 notifies every packet
+	Flags      uint8
+	Pad1       uint8
+	Pad2       uint16
+	Pad3       uint32
+}
+
+// Enabled returns true if the entry overrides the compile time defaults.
+func (v *Config) Enabled() bool { return v.Flags&FlagEnabled != 0 }
+
+// String converts the value into a human readable string format
+func (v *Config) String() string {
+	if !v.Enabled() {
+		return "disabled"
+	}
+
+	capLen := "default"
+	if v.CapLen != 0 {
+		capLen = fmt.Sprintf("%d", v.CapLen)
+	}
+	sample := uint32(1)
+	if v.SampleRate > 1 {
+		sample = v.SampleRate
+	}
+
+	var points []string
+	if v.ObsPoints == AllObsPoints {
+		points = []string{"all"}
+	} else {
+		for i, name := range monitor.ObsPointNames() {
+			if v.ObsPoints&(1<<uint(i)) != 0 {
+				points = append(points, name)
+			}
+		}
+	}
+	if len(points) == 0 {
+		points = []string{"none"}
+	}
+
+	str := fmt.Sprintf("cap-len:%s sample:1/%d obs-points:%s",
+		capLen, sample, strings.Join(points, ","))
+	if v.Flags&FlagNoAggregation != 0 {
+		str += " no-aggregation"
+	}
+	return str
+}
+
+// GetValuePtr returns the unsafe pointer to the BPF value.
+func (v *Config) GetValuePtr() unsafe.Pointer { return unsafe.Pointer(v) }
+
+var (
+	// TraceConfig is the BPF map holding the trace configuration of
+	// all endpoints.
+	TraceConfig = bpf.NewMap(MapName,
+		bpf.MapTypeArray,
+		int(unsafe.Sizeof(Key{})),
+		int(unsafe.Sizeof(Config{})),
+		MaxEntries,
+		0,
+		func(key []byte, value []byte) (bpf.MapKey, bpf.MapValue, error) {
+			k, v := Key{}, Config{}
+
+			if err := bpf.ConvertKeyValue(key, value, &k, &v); err != nil {
+				return nil, nil, err
+			}
+
+			return &k, &v, nil
+		},
+	)
+)
+
+func init() {
+	bpf.OpenAfterMount(TraceConfig)
+}
+
+// Set installs the trace configuration 'cfg' for endpoint 'id'. The entry
+// is marked as enabled.
+func Set(id uint16, cfg Config) error {
+	cfg.Flags |= FlagEnabled
+	log.WithField(logfields.EndpointID, id).Debugf("Setting trace configuration %s", cfg.String())
+	return TraceConfig.Update(&Key{EndpointID: uint32(id)}, &cfg)
+}
+
+// Reset restores the compile time defaults for endpoint 'id'. Entries of
+// an array map cannot be deleted, they are cleared instead.
+func Reset(id uint16) error {
+	return TraceConfig.Update(&Key{EndpointID: uint32(id)}, &Config{})
+}
+
+// Dump calls 'cb' for all enabled entries. The map is walked by index as
+// a dump starting from an empty key would skip index 0.
+func Dump(cb func(id uint16, cfg *Config)) error {
+	if err := TraceConfig.Open(); err != nil {
+		return err
+	}
+
+	for id := uint32(0); id < MaxEntries; id++ {
+		key := Key{EndpointID: id}
+		cfg := Config{}
+		err := bpf.LookupElement(TraceConfig.GetFd(), key.GetKeyPtr(), cfg.GetValuePtr())
+		if err != nil {
+			return err
+		}
+		if cfg.Enabled() {
+			cb(uint16(id), &cfg)
+		}
+	}
+	return nil
+}
@@ -107,6 +107,25 @@ var (
 		Help:      "Total sum of squares of successful endpoint regeneration times",
 	})
 
+	// BPFCompilations is the number of compilations of endpoint programs,
+	// tagged by the result of the compile cache lookup or "template" for
+	// endpoints loaded from a program template compiled before
+	BPFCompilations = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Name:      "bpf_compilations_total",
+		Help:      "Number of endpoint program compilations, tagged by compile cache result (hit, miss or disabled) or template",
+	},
+		[]string{"result"})
+
+	// BPFCompilationTime is the total time taken to compile and load
+	// endpoint programs, tagged like BPFCompilations
+	BPFCompilationTime = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Name:      "bpf_compilation_seconds_total",
+		Help:      "Total time of endpoint program compilations including loading, tagged by compile cache result (hit, miss or disabled) or template",
+	},
+		[]string{"result"})
+
 	// EndpointStateCount is the total count of the endpoints in various states.
 	EndpointStateCount = prometheus.NewGaugeVec(
 		prometheus.GaugeOpts{
@@ -243,6 +262,42 @@ var (
 	},
 		[]string{"direction"})
 
+	// DropNotifySuppressed is the total number of drop notifications
+	// not sent by the datapath due to rate limiting, tagged by drop reason
+	DropNotifySuppressed = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Name:      "drop_notifications_suppressed_total",
+		Help:      "Total drop notifications suppressed by rate limiting, tagged by drop reason",
+	},
+		[]string{"reason"})
+
+	// PrefilterDropCount is the total number of packets dropped by the
+	// XDP prefilter, tagged by drop reason and address family
+	PrefilterDropCount = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Name:      "prefilter_drop_count_total",
+		Help:      "Total packets dropped by the XDP prefilter, tagged by drop reason and address family",
+	},
+		[]string{"reason", "family"})
+
+	// PrefilterDropBytes is the total number of bytes dropped by the
+	// XDP prefilter, tagged by drop reason and address family
+	PrefilterDropBytes = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Name:      "prefilter_drop_bytes_total",
+		Help:      "Total bytes dropped by the XDP prefilter, tagged by drop reason and address family",
+	},
+		[]string{"reason", "family"})
+
+	// PrefilterSynCookies is the total number of SYN cookies sent and
+	// validated by the XDP prefilter, tagged by action and address family
+	PrefilterSynCookies = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Name:      "prefilter_syncookies_total",
+		Help:      "Total SYN cookies sent and validated by the XDP prefilter, tagged by action and address family",
+	},
+		[]string{"action", "family"})
+
 	// Datapath statistics
 
 	// DatapathErrors is the number of errors managing datapath components
@@ -254,6 +309,26 @@ var (
 		Help:      "Number of errors that occurred in the datapath or datapath management",
 	},
 		[]string{LabelDatapathArea, LabelDatapathName, LabelDatapathFamily})
+
+	// IPCacheCacheLookups is the number of lookups in the datapath cache
+	// in front of the ipcache, tagged by result (hit or miss)
+	IPCacheCacheLookups = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Subsystem: Datapath,
+		Name:      "ipcache_cache_lookups_total",
+		Help:      "Number of lookups in the datapath cache in front of the ipcache, tagged by result (hit or miss)",
+	},
+		[]string{"result"})
+
+	// BandwidthPackets is the number of packets delayed or dropped by the
+	// egress bandwidth limits of endpoints, tagged by action
+	BandwidthPackets = prometheus.NewCounterVec(prometheus.CounterOpts{
+		Namespace: Namespace,
+		Subsystem: Datapath,
+		Name:      "bandwidth_packets_total",
+		Help:      "Number of packets delayed or dropped by the egress bandwidth limits of endpoints, tagged by action (delayed or dropped)",
+	},
+		[]string{"action"})
 )
 
 func init() {
@@ -265,6 +340,8 @@ func init() {
 	MustRegister(EndpointRegenerationCount)
 	MustRegister(EndpointRegenerationTime)
 	MustRegister(EndpointRegenerationTimeSquare)
+	MustRegister(BPFCompilations)
+	MustRegister(BPFCompilationTime)
 	MustRegister(EndpointStateCount)
 
 	MustRegister(PolicyCount)
@@ -285,10 +362,16 @@ func init() {
 
 	MustRegister(DropCount)
 	MustRegister(ForwardCount)
+	MustRegister(DropNotifySuppressed)
+	MustRegister(PrefilterDropCount)
+	MustRegister(PrefilterDropBytes)
+	MustRegister(PrefilterSynCookies)
 
 	MustRegister(newStatusCollector())
 
 	MustRegister(DatapathErrors)
+	MustRegister(IPCacheCacheLookups)
+	MustRegister(BandwidthPackets)
 }
 
 // MustRegister adds the collector to the registry, exposing this metric to
@@ -75,6 +75,15 @@ var errors = map[uint8]string{
 	160: "No tunnel/encapsulation endpoint (datapath BUG!)",
 	161: "Failed to insert into proxymap",
 	162: "Policy denied (CIDR)",
+	163: "Prefilter: Source prefix denied",
+	164: "Prefilter: No matching local endpoint",
+	165: "Prefilter: Truncated or invalid header",
+	166: "Prefilter: L4 rule denied",
+	167: "Prefilter: Rate limit exceeded",
+	168: "No proxy socket",
+	169: "Bandwidth limit: Departure time beyond drop horizon",
+	170: "No port available for masquerading",
+	171: "First fragment of datagram not seen",
 }
 
 // DropReason prints the drop reason in a human readable string
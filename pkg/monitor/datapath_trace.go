@@ -75,6 +75,27 @@ func obsPoint(obsPoint uint8) string {
 	return fmt.Sprintf("%d", obsPoint)
 }
 
+// ParseObsPoint returns the observation point for a name as printed by
+// the monitor, e.g. "to-endpoint".
+func ParseObsPoint(name string) (uint8, error) {
+	for point, str := range traceObsPoints {
+		if str == name {
+			return point, nil
+		}
+	}
+	return 0, fmt.Errorf("unknown observation point %q", name)
+}
+
+// ObsPointNames returns the names of all observation points ordered by
+// their value.
+func ObsPointNames() []string {
+	names := make([]string, 0, len(traceObsPoints))
+	for point := uint8(TraceToLxc); point <= TraceFromOverlay; point++ {
+		names = append(names, traceObsPoints[point])
+	}
+	return names
+}
+
 // Reasons for forwarding a packet.
 const (
 	TraceReasonPolicy = iota
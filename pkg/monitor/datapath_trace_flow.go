@@ -0,0 +1,234 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monitor
+
+import (
+	"bytes"
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"net"
+	"strings"
+	"time"
+
+	"github.com/cilium/cilium/pkg/byteorder"
+)
+
+// Must be synchronized with ENDPOINT_KEY_* in <bpf/lib/common.h>
+const (
+	flowFamilyIPv4 = 1
+	flowFamilyIPv6 = 2
+)
+
+// Reasons for emitting a flow summary, must be synchronized with the
+// TRACE_FLOW_REPORT_* enum in <bpf/lib/trace.h>
+const (
+	TraceFlowReportInterval = iota
+	TraceFlowReportBytes
+	TraceFlowReportClose
+)
+
+var traceFlowReports = map[uint8]string{
+	TraceFlowReportInterval: "interval",
+	TraceFlowReportBytes:    "bytes",
+	TraceFlowReportClose:    "close",
+}
+
+func flowReport(report uint8) string {
+	if str, ok := traceFlowReports[report]; ok {
+		return str
+	}
+	return fmt.Sprintf("%d", report)
+}
+
+// TraceFlowKey is the flow tuple of a flow summary, it must be
+// synchronized with struct trace_flow_key in <bpf/lib/trace.h>
+type TraceFlowKey struct {
+	SrcAddr  [16]byte
+	DstAddr  [16]byte
+	SrcPort  uint16 // network byte order
+	DstPort  uint16 // network byte order
+	Nexthdr  uint8
+	Family   uint8
+	ObsPoint uint8
+	Pad      uint8
+}
+
+func (k *TraceFlowKey) addrs() (net.IP, net.IP) {
+	if k.Family == flowFamilyIPv4 {
+		return net.IP(k.SrcAddr[:4]), net.IP(k.DstAddr[:4])
+	}
+	return net.IP(k.SrcAddr[:]), net.IP(k.DstAddr[:])
+}
+
+// String returns the flow tuple in human readable form
+func (k *TraceFlowKey) String() string {
+	src, dst := k.addrs()
+	sport := byteorder.NetworkToHost(k.SrcPort).(uint16)
+	dport := byteorder.NetworkToHost(k.DstPort).(uint16)
+
+	var proto string
+	switch k.Nexthdr {
+	case 6:
+		proto = "tcp"
+	case 17:
+		proto = "udp"
+	default:
+		return fmt.Sprintf("%s -> %s proto %d", src, dst, k.Nexthdr)
+	}
+	return fmt.Sprintf("%s -> %s %s",
+		net.JoinHostPort(src.String(), fmt.Sprintf("%d", sport)),
+		net.JoinHostPort(dst.String(), fmt.Sprintf("%d", dport)), proto)
+}
+
+// TraceFlowNotify is the message format of a flow summary in the BPF ring
+// buffer, it must be synchronized with struct trace_flow_notify in
+// <bpf/lib/trace.h>
+type TraceFlowNotify struct {
+	Type     uint8
+	ObsPoint uint8
+	Source   uint16
+	Hash     uint32
+	SrcLabel uint32
+	DstLabel uint32
+	DstID    uint16
+	Report   uint8
+	TCPFlags uint8
+	Ifindex  uint32
+	Reason   uint8
+	Pad      [7]uint8
+	Packets  uint64
+	Bytes    uint64
+	Duration uint64
+	Key      TraceFlowKey
+}
+
+// DecodeTraceFlowNotify decodes the flow summary in data into tf
+func DecodeTraceFlowNotify(data []byte, tf *TraceFlowNotify) error {
+	if len(data) < binary.Size(tf) {
+		return fmt.Errorf("flow notification of %d bytes is too short", len(data))
+	}
+	return binary.Read(bytes.NewReader(data), byteorder.Native, tf)
+}
+
+// Must be synchronized with union tcp_flags in <bpf/lib/conntrack.h>
+var tcpFlagNames = []struct {
+	bit  uint8
+	name string
+}{
+	{0x01, "FIN"},
+	{0x02, "SYN"},
+	{0x04, "RST"},
+	{0x08, "PSH"},
+	{0x10, "ACK"},
+}
+
+func tcpFlags(flags uint8) string {
+	var names []string
+	for _, f := range tcpFlagNames {
+		if flags&f.bit != 0 {
+			names = append(names, f.name)
+		}
+	}
+	return strings.Join(names, ",")
+}
+
+// DumpInfo prints a one line summary of the flow
+func (n *TraceFlowNotify) DumpInfo() {
+	fmt.Printf("%s flow %s %s identity %d->%d: %s, %d packets, %d bytes in %s\n",
+		obsPoint(n.ObsPoint), flowReport(n.Report), connState(n.Reason), n.SrcLabel,
+		n.DstLabel, n.Key.String(), n.Packets, n.Bytes, time.Duration(n.Duration))
+}
+
+// DumpVerbose prints the flow summary in human readable form
+func (n *TraceFlowNotify) DumpVerbose(prefix string) {
+	fmt.Printf("%s MARK %#x FROM %d %s: flow %s, state %s, %d packets, %d bytes, age %s",
+		prefix, n.Hash, n.Source, obsPoint(n.ObsPoint), flowReport(n.Report),
+		connState(n.Reason), n.Packets, n.Bytes, time.Duration(n.Duration))
+
+	if n.Ifindex != 0 {
+		fmt.Printf(", interface %s", ifname(int(n.Ifindex)))
+	}
+
+	if n.SrcLabel != 0 || n.DstLabel != 0 {
+		fmt.Printf(", identity %d->%d", n.SrcLabel, n.DstLabel)
+	}
+
+	if n.TCPFlags != 0 {
+		fmt.Printf(", tcp flags %s", tcpFlags(n.TCPFlags))
+	}
+
+	if n.DstID != 0 {
+		fmt.Printf(", to endpoint %d\n", n.DstID)
+	} else {
+		fmt.Printf("\n")
+	}
+
+	fmt.Printf("%s\n", n.Key.String())
+}
+
+// DumpJSON prints the flow summary in json format
+func (n *TraceFlowNotify) DumpJSON(cpuPrefix string) {
+	v := TraceFlowNotifyToVerbose(n)
+	v.CPUPrefix = cpuPrefix
+
+	resp, err := json.Marshal(v)
+	if err == nil {
+		fmt.Println(string(resp))
+	}
+}
+
+// TraceFlowNotifyVerbose represents a json flow summary printed by monitor
+type TraceFlowNotifyVerbose struct {
+	CPUPrefix        string `json:"cpu,omitempty"`
+	Type             string `json:"type,omitempty"`
+	Mark             string `json:"mark,omitempty"`
+	Ifindex          string `json:"ifindex,omitempty"`
+	Report           string `json:"report"`
+	State            string `json:"state,omitempty"`
+	ObservationPoint string `json:"observationPoint"`
+	TCPFlags         string `json:"tcpFlags,omitempty"`
+
+	Source   uint16 `json:"source"`
+	SrcLabel uint32 `json:"srcLabel"`
+	DstLabel uint32 `json:"dstLabel"`
+	DstID    uint16 `json:"dstID"`
+	Packets  uint64 `json:"packets"`
+	Bytes    uint64 `json:"bytes"`
+	Duration uint64 `json:"durationNs"`
+	Flow     string `json:"flow"`
+}
+
+// TraceFlowNotifyToVerbose creates a verbose notification from a
+// TraceFlowNotify
+func TraceFlowNotifyToVerbose(n *TraceFlowNotify) TraceFlowNotifyVerbose {
+	return TraceFlowNotifyVerbose{
+		Type:             "flow",
+		Mark:             fmt.Sprintf("%#x", n.Hash),
+		Ifindex:          ifname(int(n.Ifindex)),
+		Report:           flowReport(n.Report),
+		State:            connState(n.Reason),
+		ObservationPoint: obsPoint(n.ObsPoint),
+		TCPFlags:         tcpFlags(n.TCPFlags),
+		Source:           n.Source,
+		SrcLabel:         n.SrcLabel,
+		DstLabel:         n.DstLabel,
+		DstID:            n.DstID,
+		Packets:          n.Packets,
+		Bytes:            n.Bytes,
+		Duration:         n.Duration,
+		Flow:             n.Key.String(),
+	}
+}
@@ -0,0 +1,67 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monitor
+
+import (
+	"github.com/cilium/cilium/pkg/byteorder"
+
+	. "gopkg.in/check.v1"
+)
+
+func (s *MonitorSuite) TestDecodeTraceFlowNotify(c *C) {
+	// Layout of struct trace_flow_notify in <bpf/lib/trace.h>
+	data := make([]byte, 96)
+	data[0] = MessageTypeTraceFlow
+	data[1] = TraceToLxc
+	byteorder.Native.PutUint16(data[2:], 42)
+	byteorder.Native.PutUint32(data[8:], 1000)
+	byteorder.Native.PutUint32(data[12:], 2000)
+	byteorder.Native.PutUint16(data[16:], 43)
+	data[18] = TraceFlowReportClose
+	data[19] = 0x11
+	byteorder.Native.PutUint32(data[20:], 7)
+	data[24] = TraceReasonCtReply
+	byteorder.Native.PutUint64(data[32:], 10)
+	byteorder.Native.PutUint64(data[40:], 1500)
+	byteorder.Native.PutUint64(data[48:], 3000000000)
+	copy(data[56:], []byte{10, 0, 0, 1})
+	copy(data[72:], []byte{10, 0, 0, 2})
+	copy(data[88:], []byte{0, 80, 0x1f, 0x90})
+	data[92] = 6
+	data[93] = flowFamilyIPv4
+	data[94] = TraceToLxc
+
+	tf := TraceFlowNotify{}
+	c.Assert(DecodeTraceFlowNotify(data, &tf), IsNil)
+	c.Assert(tf.Source, Equals, uint16(42))
+	c.Assert(tf.SrcLabel, Equals, uint32(1000))
+	c.Assert(tf.DstLabel, Equals, uint32(2000))
+	c.Assert(tf.DstID, Equals, uint16(43))
+	c.Assert(tf.Report, Equals, uint8(TraceFlowReportClose))
+	c.Assert(tcpFlags(tf.TCPFlags), Equals, "FIN,ACK")
+	c.Assert(tf.Ifindex, Equals, uint32(7))
+	c.Assert(connState(tf.Reason), Equals, "reply")
+	c.Assert(tf.Packets, Equals, uint64(10))
+	c.Assert(tf.Bytes, Equals, uint64(1500))
+	c.Assert(tf.Duration, Equals, uint64(3000000000))
+	c.Assert(tf.Key.String(), Equals, "10.0.0.1:80 -> 10.0.0.2:8080 tcp")
+	c.Assert(tf.Key.ObsPoint, Equals, uint8(TraceToLxc))
+
+	v := TraceFlowNotifyToVerbose(&tf)
+	c.Assert(v.State, Equals, "reply")
+	c.Assert(v.Report, Equals, "close")
+
+	c.Assert(DecodeTraceFlowNotify(data[:95], &tf), NotNil)
+}
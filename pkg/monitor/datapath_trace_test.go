@@ -0,0 +1,34 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package monitor
+
+import (
+	. "gopkg.in/check.v1"
+)
+
+func (s *MonitorSuite) TestParseObsPoint(c *C) {
+	names := ObsPointNames()
+	c.Assert(len(names), Equals, TraceFromOverlay+1)
+
+	for i, name := range names {
+		point, err := ParseObsPoint(name)
+		c.Assert(err, IsNil)
+		c.Assert(point, Equals, uint8(i))
+		c.Assert(obsPoint(point), Equals, name)
+	}
+
+	_, err := ParseObsPoint("to-nowhere")
+	c.Assert(err, Not(IsNil))
+}
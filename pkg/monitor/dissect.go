@@ -131,6 +131,16 @@ func GetConnectionSummary(data []byte) string {
 	return "[unknown]"
 }
 
+// TrimCapture cuts a notification carrying a packet capture of capLen bytes
+// after a header of hdrLen bytes to its actual length. Records read from
+// the BPF ring buffer are padded to the maximum capture length.
+func TrimCapture(data []byte, hdrLen int, capLen uint32) []byte {
+	if end := hdrLen + int(capLen); end < len(data) {
+		return data[:end]
+	}
+	return data
+}
+
 // Dissect parses and prints the provided data if dissect is set to true,
 // otherwise the data is printed as HEX output
 func Dissect(dissect bool, data []byte) {
@@ -48,3 +48,13 @@ func (s *MonitorSuite) TestDissectSummary(c *C) {
 	c.Assert(summary.L4.Src, Equals, sport)
 	c.Assert(summary.L4.Dst, Equals, dport)
 }
+
+func (s *MonitorSuite) TestTrimCapture(c *C) {
+	data := make([]byte, TraceNotifyLen+128)
+
+	c.Assert(TrimCapture(data, TraceNotifyLen, 64), HasLen, TraceNotifyLen+64)
+	c.Assert(TrimCapture(data, TraceNotifyLen, 0), HasLen, TraceNotifyLen)
+	c.Assert(TrimCapture(data, TraceNotifyLen, 128), HasLen, TraceNotifyLen+128)
+	// Perf records are never longer than the capture, keep short data as is
+	c.Assert(TrimCapture(data[:TraceNotifyLen+16], TraceNotifyLen, 64), HasLen, TraceNotifyLen+16)
+}
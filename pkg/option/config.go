@@ -112,6 +112,94 @@ const (
 	// ClusterMeshConfigNameEnv is the name of the environment variable of
 	// the ClusterMeshConfig option
 	ClusterMeshConfigNameEnv = "CILIUM_CLUSTERMESH_CONFIG"
+
+	// PreFilterL4RuleName is the name of the option to add L4 prefilter rules
+	PreFilterL4RuleName = "prefilter-l4-rule"
+
+	// PreFilterRateLimitPrefixV4Name is the name of the option for the
+	// IPv4 source prefix length of prefilter rate limiting
+	PreFilterRateLimitPrefixV4Name = "prefilter-ratelimit-prefix-v4"
+
+	// PreFilterRateLimitPrefixV6Name is the name of the option for the
+	// IPv6 source prefix length of prefilter rate limiting
+	PreFilterRateLimitPrefixV6Name = "prefilter-ratelimit-prefix-v6"
+
+	// PreFilterSampleRateName is the name of the option for the rate of
+	// sampled prefilter drop notifications
+	PreFilterSampleRateName = "prefilter-sample-rate"
+
+	// MonitorRingBufPagesName is the name of the option for the size of
+	// the shared BPF ring buffer for datapath events
+	MonitorRingBufPagesName = "monitor-ringbuf-pages"
+
+	// EndpointMetricsIdentitiesName is the name of the option for the
+	// number of remote identities tracked per endpoint in endpoint metrics
+	EndpointMetricsIdentitiesName = "endpoint-metrics-identities"
+
+	// PolicyMapLPMName is the name of the option to back endpoint policy
+	// maps by LPM tries
+	PolicyMapLPMName = "policy-map-lpm"
+
+	// ProxySkAssignName is the name of the option to redirect connections
+	// to proxies by assigning them to the proxy socket
+	ProxySkAssignName = "proxy-sk-assign"
+
+	// IPCacheCacheSizeName is the name of the option for the size of the
+	// datapath cache in front of the ipcache
+	IPCacheCacheSizeName = "ipcache-cache-size"
+
+	// PreAllocateMapsName is the name of the option to preallocate the
+	// entries of endpoint policy and connection tracking hash tables
+	PreAllocateMapsName = "preallocate-bpf-maps"
+
+	// DropNotifyRateLimitName is the name of the option to rate limit
+	// drop notifications per drop reason
+	DropNotifyRateLimitName = "drop-notify-ratelimit"
+
+	// ConntrackPolicyCacheName is the name of the option to cache policy
+	// verdicts in connection tracking entries
+	ConntrackPolicyCacheName = "conntrack-policy-cache"
+
+	// ConntrackLifetimeSlackName is the name of the option for the number
+	// of seconds the lifetime of connection tracking entries may fall
+	// behind before the datapath refreshes it
+	ConntrackLifetimeSlackName = "conntrack-lifetime-slack"
+
+	// EnableBandwidthManagerName is the name of the option to enforce
+	// egress bandwidth limits of endpoints in the datapath
+	EnableBandwidthManagerName = "enable-bandwidth-manager"
+
+	// EnableBPFMasqueradeName is the name of the option to masquerade
+	// endpoint traffic leaving the node in the datapath
+	EnableBPFMasqueradeName = "enable-bpf-masquerade"
+
+	// EnableSocketLBName is the name of the option to translate services
+	// at the socket layer
+	EnableSocketLBName = "enable-socket-lb"
+
+	// SocketLBSendmsgName is the name of the option to translate services
+	// on sendmsg() of unconnected UDP sockets
+	SocketLBSendmsgName = "socket-lb-sendmsg"
+
+	// CgroupRootName is the name of the option to specify the cgroup v2
+	// root the socket programs are attached to
+	CgroupRootName = "cgroup-root"
+
+	// DebugRateLimitName is the name of the option to limit the rate of
+	// datapath debug messages
+	DebugRateLimitName = "debug-event-rate-limit"
+
+	// EnableXDPDecapName is the name of the option to decapsulate overlay
+	// traffic in the XDP program of the prefilter device
+	EnableXDPDecapName = "enable-xdp-decap"
+
+	// BPFCompileCacheSizeName is the name of the option for the number of
+	// compiled endpoint programs kept in the compile cache
+	BPFCompileCacheSizeName = "bpf-compile-cache-size"
+
+	// EndpointTemplatesName is the name of the option to compile endpoint
+	// programs once per configuration and specialize them at load time
+	EndpointTemplatesName = "bpf-endpoint-templates"
 )
 
 // Available option for daemonConfig.Tunnel
@@ -222,6 +310,109 @@ type daemonConfig struct {
 
 	// ClusterMeshConfig is the path to the clustermesh configuration directory
 	ClusterMeshConfig string
+
+	// PreFilterL4Rules is the list of L4 rules installed into the XDP
+	// prefilter at startup. L4 filtering is compiled in only if set.
+	PreFilterL4Rules []string
+
+	// PreFilterRateLimitPrefixV4 and PreFilterRateLimitPrefixV6 are the
+	// source prefix lengths on which the prefilter token buckets aggregate.
+	PreFilterRateLimitPrefixV4 int
+	PreFilterRateLimitPrefixV6 int
+
+	// PreFilterSampleRate is N for sampling 1 in N prefilter drops into
+	// a drop notification, 0 disables sampling.
+	PreFilterSampleRate int
+
+	// MonitorRingBufPages is the size in pages of the BPF ring buffer
+	// shared by all CPUs for datapath events. If 0, or if the kernel lacks
+	// support, per-CPU perf buffers are used.
+	MonitorRingBufPages int
+
+	// EndpointMetricsIdentities is the number of remote identities per
+	// endpoint for which the datapath keeps separate traffic counters.
+	// Traffic with all other identities is accounted together. If 0,
+	// per endpoint metrics are disabled.
+	EndpointMetricsIdentities int
+
+	// PolicyMapLPM enables endpoint policy maps backed by LPM tries which
+	// resolve L3 and L4 rules with a single lookup, if supported by the
+	// kernel.
+	PolicyMapLPM bool
+
+	// ProxySkAssign makes the datapath redirect connections to proxies by
+	// assigning them to the listen socket of the proxy instead of
+	// translating their destination, if supported by the kernel. The
+	// source identity is carried in the packet mark.
+	ProxySkAssign bool
+
+	// IPCacheCacheSize is the number of addresses cached per CPU by the
+	// datapath in front of the ipcache. If 0, the cache is disabled.
+	IPCacheCacheSize int
+
+	// PreAllocateMaps preallocates all entries of endpoint policy maps
+	// and of connection tracking maps which are not LRU hash tables when
+	// the maps are created. If false, entries are allocated on insertion.
+	PreAllocateMaps bool
+
+	// DropNotifyRateLimits is the list of rate limits of drop
+	// notifications per drop reason, enforced per CPU by the datapath.
+	DropNotifyRateLimits []string
+
+	// ConntrackPolicyCache enables caching of the policy verdict,
+	// destination identity and proxy port in connection tracking entries
+	// so that established connections skip policy and ipcache lookups
+	// until the policy of the endpoint or the ipcache changes.
+	ConntrackPolicyCache bool
+
+	// ConntrackLifetimeSlack is the number of seconds by which the
+	// lifetime stored in a connection tracking entry may fall behind
+	// before the datapath refreshes it. Entries of active connections are
+	// then written at most once per slack period rather than per packet.
+	ConntrackLifetimeSlack int
+
+	// EnableBandwidthManager enforces the egress bandwidth limits of
+	// endpoints given by the kubernetes.io/egress-bandwidth annotation of
+	// their pod. The datapath sets the departure time of packets and fq
+	// on the physical device paces them, if supported by the kernel.
+	EnableBandwidthManager bool
+
+	// EnableBPFMasquerade masquerades TCP and UDP traffic of endpoints
+	// leaving the node in the datapath instead of iptables, which keeps
+	// these flows out of netfilter connection tracking.
+	EnableBPFMasquerade bool
+
+	// EnableSocketLB translates the destination of connect() from a
+	// service to one of its backends, so that the datapath does not
+	// translate every packet of the connection.
+	EnableSocketLB bool
+
+	// SocketLBSendmsg additionally translates the destination of
+	// datagrams sent on unconnected UDP sockets. Replies are received
+	// from the backend address.
+	SocketLBSendmsg bool
+
+	// CgroupRoot is the path of the cgroup v2 hierarchy
+	CgroupRoot string
+
+	// DebugRateLimit is the maximum number of datapath debug messages
+	// per second and CPU of each endpoint, 0 for no limit
+	DebugRateLimit int
+
+	// EnableXDPDecap decapsulates overlay traffic to local endpoints in
+	// the XDP program of the prefilter device, bypassing the UDP receive
+	// path and the tunnel device.
+	EnableXDPDecap bool
+
+	// BPFCompileCacheSize is the number of compiled endpoint programs
+	// kept in the compile cache, 0 disables the cache
+	BPFCompileCacheSize int
+
+	// EndpointTemplates compiles the program of all endpoints with the
+	// same configuration once and writes the constants of each endpoint,
+	// e.g. its addresses and identity, into a copy of the object before
+	// it is loaded.
+	EndpointTemplates bool
 }
 
 var (
@@ -248,6 +439,12 @@ func (c *daemonConfig) GetGlobalsDir() string {
 	return filepath.Join(c.StateDir, "globals")
 }
 
+// GetTemplatesDir returns the path for the directory of the compiled
+// endpoint program templates.
+func (c *daemonConfig) GetTemplatesDir() string {
+	return filepath.Join(c.StateDir, "templates")
+}
+
 // AlwaysAllowLocalhost returns true if the daemon has the option set that
 // localhost can always reach local endpoints
 func (c *daemonConfig) AlwaysAllowLocalhost() bool {
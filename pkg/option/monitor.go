@@ -52,9 +52,21 @@ const (
 	// unless there is new information (eg, a TCP connection is closed).
 	MonitorAggregationLevelMedium = 3
 
-	// MonitorAggregationLevelMax is the maximum level of aggregation
-	// currently supported.
+	// MonitorAggregationLevelFlow represents aggregation of monitor
+	// events per flow in the datapath. Trace events are only emitted for
+	// the first and last packet of a flow, in between the datapath emits
+	// periodic flow summaries carrying packet and byte counts. Falls back
+	// to MonitorAggregationLevelMedium if the kernel lacks LRU maps. It
+	// must be selected explicitly.
+	MonitorAggregationLevelFlow = 4
+
+	// MonitorAggregationLevelMax is the level selected by "max". It
+	// remains at MonitorAggregationLevelMedium so that existing
+	// configurations keep receiving trace events for every connection.
 	MonitorAggregationLevelMax = MonitorAggregationLevelMedium
+
+	// monitorAggregationLevelLast is the highest level accepted
+	monitorAggregationLevelLast = MonitorAggregationLevelFlow
 )
 
 // monitorAggregationOption maps a user-specified string to a monitor
@@ -66,12 +78,13 @@ var monitorAggregationOption = map[string]int{
 	"lowest":   MonitorAggregationLevelLowest,
 	"low":      MonitorAggregationLevelLow,
 	"medium":   MonitorAggregationLevelMedium,
+	"flow":     MonitorAggregationLevelFlow,
 	"max":      MonitorAggregationLevelMax,
 	"maximum":  MonitorAggregationLevelMax,
 }
 
 func init() {
-	for i := MonitorAggregationLevelNone; i <= MonitorAggregationLevelMax; i++ {
+	for i := MonitorAggregationLevelNone; i <= monitorAggregationLevelLast; i++ {
 		number := strconv.Itoa(i)
 		monitorAggregationOption[number] = i
 	}
@@ -83,6 +96,7 @@ var monitorAggregationFormat = map[int]string{
 	MonitorAggregationLevelLowest: color.Green("Lowest"),
 	MonitorAggregationLevelLow:    color.Green("Low"),
 	MonitorAggregationLevelMedium: color.Green("Medium"),
+	MonitorAggregationLevelFlow:   color.Green("Flow"),
 }
 
 // VerifyMonitorAggregationLevel validates the specified key/value for a
@@ -107,9 +121,9 @@ func ParseMonitorAggregationLevel(value string) (int, error) {
 		err = fmt.Errorf("Invalid monitor aggregation level %q", value)
 		return MonitorAggregationLevelNone, err
 	}
-	if parsed < MonitorAggregationLevelNone || parsed > MonitorAggregationLevelMax {
+	if parsed < MonitorAggregationLevelNone || parsed > monitorAggregationLevelLast {
 		err = fmt.Errorf("Monitor aggregation level must be between %d and %d",
-			MonitorAggregationLevelNone, MonitorAggregationLevelMax)
+			MonitorAggregationLevelNone, monitorAggregationLevelLast)
 		return MonitorAggregationLevelNone, err
 	}
 	return parsed, nil
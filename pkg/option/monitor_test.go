@@ -27,6 +27,7 @@ func (s *OptionSuite) TestVerifyMonitorAggregationLevel(c *C) {
 	c.Assert(VerifyMonitorAggregationLevel("", "lowest"), IsNil)
 	c.Assert(VerifyMonitorAggregationLevel("", "low"), IsNil)
 	c.Assert(VerifyMonitorAggregationLevel("", "medium"), IsNil)
+	c.Assert(VerifyMonitorAggregationLevel("", "flow"), IsNil)
 	c.Assert(VerifyMonitorAggregationLevel("", "max"), IsNil)
 	c.Assert(VerifyMonitorAggregationLevel("", "maximum"), IsNil)
 	c.Assert(VerifyMonitorAggregationLevel("", "LoW"), IsNil)
@@ -38,7 +39,11 @@ func (s *OptionSuite) TestParseMonitorAggregationLevel(c *C) {
 	c.Assert(err, IsNil)
 	c.Assert(level, Equals, MonitorAggregationLevelLow)
 
-	level, err = ParseMonitorAggregationLevel(strconv.Itoa(MonitorAggregationLevelMax + 1))
+	level, err = ParseMonitorAggregationLevel(strconv.Itoa(MonitorAggregationLevelFlow))
+	c.Assert(err, IsNil)
+	c.Assert(level, Equals, MonitorAggregationLevelFlow)
+
+	level, err = ParseMonitorAggregationLevel(strconv.Itoa(MonitorAggregationLevelFlow + 1))
 	c.Assert(err, NotNil)
 
 	level, err = ParseMonitorAggregationLevel("-1")
@@ -71,9 +76,13 @@ func (s *OptionSuite) TestParseMonitorAggregationLevel(c *C) {
 	c.Assert(err, IsNil)
 	c.Assert(level, Equals, MonitorAggregationLevelMedium)
 
+	level, err = ParseMonitorAggregationLevel("flow")
+	c.Assert(err, IsNil)
+	c.Assert(level, Equals, MonitorAggregationLevelFlow)
+
 	level, err = ParseMonitorAggregationLevel("max")
 	c.Assert(err, IsNil)
-	c.Assert(level, Equals, MonitorAggregationLevelMax)
+	c.Assert(level, Equals, MonitorAggregationLevelMedium)
 
 	level, err = ParseMonitorAggregationLevel("maximum")
 	c.Assert(err, IsNil)
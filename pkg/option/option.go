@@ -57,6 +57,10 @@ type Option struct {
 	Format FormatFunc
 	// Verify is called prior to applying the option
 	Verify VerifyFunc
+	// Runtime marks an option which is applied to the datapath through a
+	// map instead of a #define. Changing it does not require the BPF
+	// program to be regenerated.
+	Runtime bool
 }
 
 const (
@@ -89,6 +93,13 @@ func (l OptionLibrary) Lookup(name string) (string, *Option) {
 	return "", nil
 }
 
+// IsRuntime returns true if the option `name` is applied to the datapath at
+// runtime, see Option.Runtime.
+func (l OptionLibrary) IsRuntime(name string) bool {
+	_, o := l.Lookup(name)
+	return o != nil && o.Runtime
+}
+
 func (l OptionLibrary) Define(name string) string {
 	if _, ok := l[name]; ok {
 		return l[name].Define
@@ -291,7 +302,7 @@ func ParseKeyValue(lib *OptionLibrary, arg, value string, defaultValue int) (str
 // map or #undef name if option does not exist or exists but is set to false
 func (o *IntOptions) getFmtOpt(name string) string {
 	define := o.Library.Define(name)
-	if define == "" {
+	if define == "" || o.Library.IsRuntime(name) {
 		return ""
 	}
 
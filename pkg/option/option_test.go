@@ -284,6 +284,28 @@ func (s *OptionSuite) TestGetFmtOpt(c *C) {
 	o.optsMU.Unlock()
 }
 
+func (s *OptionSuite) TestGetFmtOptRuntime(c *C) {
+	OptionTest := Option{
+		Define:      "TEST_DEFINE",
+		Description: "This is a test",
+		Runtime:     true,
+	}
+
+	o := IntOptions{
+		Opts: OptionMap{
+			"test": OptionEnabled,
+		},
+		Library: &OptionLibrary{
+			"test": &OptionTest,
+		},
+	}
+	c.Assert(o.Library.IsRuntime("test"), Equals, true)
+	c.Assert(o.Library.IsRuntime("BAR"), Equals, false)
+	o.optsMU.Lock()
+	c.Assert(o.getFmtOpt("test"), Equals, "")
+	o.optsMU.Unlock()
+}
+
 func (s *OptionSuite) TestGetImmutableModel(c *C) {
 	k := "foo"
 
@@ -62,6 +62,7 @@ var (
 	specDebug = Option{
 		Define:      "DEBUG",
 		Description: "Enable debugging trace statements",
+		Runtime:     true,
 	}
 
 	specDebugLB = Option{
@@ -20,11 +20,15 @@ import (
 	"net"
 	"os/exec"
 	"path"
+	"strconv"
+	"strings"
 	"syscall"
 
 	"github.com/cilium/cilium/pkg/bpf"
 	"github.com/cilium/cilium/pkg/lock"
 	"github.com/cilium/cilium/pkg/maps/cidrmap"
+	"github.com/cilium/cilium/pkg/maps/l4filtermap"
+	"github.com/cilium/cilium/pkg/u8proto"
 )
 
 type preFilterMapType int
@@ -51,11 +55,18 @@ type preFilterConfig struct {
 	dyn6Enabled bool
 	fix4Enabled bool
 	fix6Enabled bool
+
+	l4Enabled bool
+	// rlPrefix{4,6} is the source prefix length the L4 rate limiting
+	// token buckets are aggregated on.
+	rlPrefix4 int
+	rlPrefix6 int
 }
 
 // PreFilter holds global info on related CIDR maps participating in prefilter
 type PreFilter struct {
 	maps     preFilterMaps
+	l4       *l4filtermap.Map
 	config   preFilterConfig
 	revision int64
 	mutex    lock.RWMutex
@@ -86,6 +97,20 @@ func (p *PreFilter) WriteConfig(fw io.Writer) {
 			fmt.Fprintf(fw, "#define CIDR6_LPM_PREFILTER\n")
 		}
 	}
+
+	if p.config.l4Enabled {
+		fmt.Fprintf(fw, "#define L4_RULE_ELEMS %d\n", l4filtermap.MaxEntries)
+		fmt.Fprintf(fw, "#define L4_BUCKET_ELEMS %d\n", l4filtermap.MaxBuckets)
+		fmt.Fprintf(fw, "#define L4_RULE_MAP_NAME %s\n", l4filtermap.MapName)
+		fmt.Fprintf(fw, "#define L4_BUCKET_MAP_NAME %s\n", l4filtermap.BucketMapName)
+		fmt.Fprintf(fw, "#define L4_SYNCOOKIE_ELEMS %d\n", l4filtermap.MaxSynCookieEntries)
+		fmt.Fprintf(fw, "#define L4_SYNCOOKIE_STATS_MAP_NAME %s\n", l4filtermap.SynCookieStatsMapName)
+		fmt.Fprintf(fw, "#define L4_SYNCOOKIE_SRC_MAP_NAME %s\n", l4filtermap.SynCookieSourceMapName)
+		fmt.Fprintf(fw, "#define L4_SYNCOOKIE_SECRET_MAP_NAME %s\n", l4filtermap.SynCookieSecretMapName)
+		fmt.Fprintf(fw, "#define L4_RL_PREFIX4 %d\n", p.config.rlPrefix4)
+		fmt.Fprintf(fw, "#define L4_RL_PREFIX6 %d\n", p.config.rlPrefix6)
+		fmt.Fprintf(fw, "#define L4_FILTER\n")
+	}
 }
 
 func (p *PreFilter) dumpOneMap(which preFilterMapType, to []string) []string {
@@ -254,6 +279,183 @@ func (p *PreFilter) init() (*PreFilter, error) {
 	return p, nil
 }
 
+// L4FilterRule is an L4 prefilter rule matching on protocol and
+// destination port, applied to both IPv4 and IPv6.
+type L4FilterRule struct {
+	Proto  u8proto.U8proto
+	Port   uint16 // 0 matches any port
+	Action l4filtermap.Action
+	// Rate and Burst parametrize the per source prefix token bucket
+	// for ActionRateLimit and the per destination SYN bucket for
+	// ActionSynCookie. Both are enforced per CPU.
+	Rate  uint32
+	Burst uint32
+}
+
+func (r *L4FilterRule) String() string {
+	port := "*"
+	if r.Port != 0 {
+		port = strconv.Itoa(int(r.Port))
+	}
+	s := fmt.Sprintf("%s/%s=%s", strings.ToLower(r.Proto.String()), port, r.Action)
+	if r.Action == l4filtermap.ActionRateLimit || r.Action == l4filtermap.ActionSynCookie {
+		s += fmt.Sprintf(":%d:%d", r.Rate, r.Burst)
+	}
+	return s
+}
+
+// ParseL4FilterRule parses a rule of the form
+// <proto>[/<port>]={pass|drop|ratelimit:<rate>[:<burst>]|syncookie:<rate>[:<burst>]},
+// e.g. "udp/53=ratelimit:1000:2000", "tcp/80=syncookie:10000" or
+// "tcp=drop". If burst is omitted, it defaults to rate. syncookie is only
+// valid for TCP, its rate is the number of SYNs per second a destination
+// accepts before SYNs of unvalidated sources are answered with cookies.
+func ParseL4FilterRule(s string) (L4FilterRule, error) {
+	var rule L4FilterRule
+
+	match := strings.SplitN(s, "=", 2)
+	if len(match) != 2 {
+		return rule, fmt.Errorf("missing action in L4 filter rule '%s'", s)
+	}
+
+	protoPort := strings.SplitN(match[0], "/", 2)
+	proto, err := u8proto.ParseProtocol(protoPort[0])
+	if err != nil || proto == u8proto.All {
+		return rule, fmt.Errorf("invalid protocol in L4 filter rule '%s'", s)
+	}
+	rule.Proto = proto
+	if len(protoPort) == 2 && protoPort[1] != "*" {
+		if proto != u8proto.TCP && proto != u8proto.UDP {
+			return rule, fmt.Errorf("port given for portless protocol in L4 filter rule '%s'", s)
+		}
+		port, err := strconv.ParseUint(protoPort[1], 10, 16)
+		if err != nil || port == 0 {
+			return rule, fmt.Errorf("invalid port in L4 filter rule '%s'", s)
+		}
+		rule.Port = uint16(port)
+	}
+
+	action := strings.Split(match[1], ":")
+	switch action[0] {
+	case "pass":
+		rule.Action = l4filtermap.ActionPass
+	case "drop":
+		rule.Action = l4filtermap.ActionDrop
+	case "ratelimit", "syncookie":
+		rule.Action = l4filtermap.ActionRateLimit
+		if action[0] == "syncookie" {
+			if proto != u8proto.TCP {
+				return rule, fmt.Errorf("syncookie is only valid for tcp in L4 filter rule '%s'", s)
+			}
+			rule.Action = l4filtermap.ActionSynCookie
+		}
+		if len(action) < 2 || len(action) > 3 {
+			return rule, fmt.Errorf("%s needs <rate>[:<burst>] in L4 filter rule '%s'", action[0], s)
+		}
+		rate, err := strconv.ParseUint(action[1], 10, 32)
+		if err != nil || rate == 0 {
+			return rule, fmt.Errorf("invalid rate in L4 filter rule '%s'", s)
+		}
+		rule.Rate = uint32(rate)
+		rule.Burst = rule.Rate
+		if len(action) == 3 {
+			burst, err := strconv.ParseUint(action[2], 10, 32)
+			if err != nil || burst == 0 {
+				return rule, fmt.Errorf("invalid burst in L4 filter rule '%s'", s)
+			}
+			rule.Burst = uint32(burst)
+		}
+		return rule, nil
+	default:
+		return rule, fmt.Errorf("unknown action '%s' in L4 filter rule '%s'", action[0], s)
+	}
+	if len(action) != 1 {
+		return rule, fmt.Errorf("unexpected action arguments in L4 filter rule '%s'", s)
+	}
+	return rule, nil
+}
+
+func (r *L4FilterRule) keys() []l4filtermap.Key {
+	return []l4filtermap.Key{
+		l4filtermap.NewKey(bpf.EndpointKeyIPv4, r.Proto, r.Port),
+		l4filtermap.NewKey(bpf.EndpointKeyIPv6, r.Proto, r.Port),
+	}
+}
+
+// EnableL4Filter creates the L4 rule map and the SYN cookie secret and
+// turns on L4 filtering for the next header write. Token buckets aggregate
+// sources on the given prefix lengths.
+func (p *PreFilter) EnableL4Filter(prefix4, prefix6 int) error {
+	if prefix4 < 0 || prefix4 > net.IPv4len*8 {
+		return fmt.Errorf("Invalid IPv4 rate limit prefix length %d", prefix4)
+	}
+	if prefix6 < 0 || prefix6 > net.IPv6len*8 {
+		return fmt.Errorf("Invalid IPv6 rate limit prefix length %d", prefix6)
+	}
+
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	if p.l4 == nil {
+		m := l4filtermap.NewMap()
+		if _, err := m.OpenOrCreate(); err != nil {
+			return err
+		}
+		if err := l4filtermap.InitSynCookieSecret(); err != nil {
+			m.Close()
+			return err
+		}
+		p.l4 = m
+	}
+	p.config.l4Enabled = true
+	p.config.rlPrefix4 = prefix4
+	p.config.rlPrefix6 = prefix6
+	return nil
+}
+
+// ReplaceL4Rules installs the given L4 rules and removes all other rules,
+// e.g. rules left in the pinned map by a previous run of the agent with a
+// different configuration. Takes effect immediately, no reload of the XDP
+// program is needed.
+func (p *PreFilter) ReplaceL4Rules(rules []L4FilterRule) error {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	if p.l4 == nil {
+		return fmt.Errorf("L4 prefilter not enabled")
+	}
+
+	// Install the new rules first so that no configured rule is
+	// missing while stale rules are removed.
+	configured := make(map[l4filtermap.Key]struct{}, 2*len(rules))
+	for _, rule := range rules {
+		value := l4filtermap.Value{
+			Action: rule.Action,
+			Rate:   rule.Rate,
+			Burst:  rule.Burst,
+		}
+		for _, key := range rule.keys() {
+			if err := p.l4.InsertRule(key, value); err != nil {
+				return fmt.Errorf("Error inserting L4 filter rule %s: %s", rule.String(), err)
+			}
+			configured[key] = struct{}{}
+		}
+	}
+
+	keys, err := p.l4.Keys()
+	if err != nil {
+		return fmt.Errorf("Error dumping L4 filter rules: %s", err)
+	}
+	for _, key := range keys {
+		if _, ok := configured[key]; ok {
+			continue
+		}
+		if err := p.l4.DeleteRule(key); err != nil {
+			return fmt.Errorf("Error deleting L4 filter rule %s: %s", key.String(), err)
+		}
+	}
+	p.revision++
+	return nil
+}
+
 // ProbePreFilter checks whether XDP mode is supported on given device
 func ProbePreFilter(device, mode string) error {
 	cmd := exec.Command("ip", "-force", "link", "set", "dev", device, mode, "off")
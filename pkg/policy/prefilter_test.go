@@ -0,0 +1,69 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package policy
+
+import (
+	"github.com/cilium/cilium/pkg/maps/l4filtermap"
+	"github.com/cilium/cilium/pkg/u8proto"
+
+	. "gopkg.in/check.v1"
+)
+
+func (ds *PolicyTestSuite) TestParseL4FilterRule(c *C) {
+	valid := map[string]L4FilterRule{
+		"tcp=drop":   {Proto: u8proto.TCP, Action: l4filtermap.ActionDrop},
+		"TCP/*=pass": {Proto: u8proto.TCP, Action: l4filtermap.ActionPass},
+		"udp/53=ratelimit:1000": {Proto: u8proto.UDP, Port: 53,
+			Action: l4filtermap.ActionRateLimit, Rate: 1000, Burst: 1000},
+		"tcp/80=ratelimit:100:500": {Proto: u8proto.TCP, Port: 80,
+			Action: l4filtermap.ActionRateLimit, Rate: 100, Burst: 500},
+		"icmp=ratelimit:10": {Proto: u8proto.ICMP,
+			Action: l4filtermap.ActionRateLimit, Rate: 10, Burst: 10},
+		"tcp/443=syncookie:10000:20000": {Proto: u8proto.TCP, Port: 443,
+			Action: l4filtermap.ActionSynCookie, Rate: 10000, Burst: 20000},
+	}
+	for in, expected := range valid {
+		rule, err := ParseL4FilterRule(in)
+		c.Assert(err, IsNil, Commentf("%s", in))
+		c.Assert(rule, Equals, expected, Commentf("%s", in))
+
+		// String() must round-trip through the parser.
+		again, err := ParseL4FilterRule(rule.String())
+		c.Assert(err, IsNil, Commentf("%s", rule.String()))
+		c.Assert(again, Equals, rule)
+	}
+
+	invalid := []string{
+		"",
+		"tcp",
+		"all=drop",
+		"sctp/80=drop",
+		"icmp/8=drop",
+		"tcp/0=drop",
+		"tcp/70000=drop",
+		"tcp/80=reject",
+		"tcp/80=drop:1",
+		"udp/53=ratelimit",
+		"udp/53=ratelimit:0",
+		"udp/53=ratelimit:10:0",
+		"udp/53=ratelimit:10:20:30",
+		"udp/53=syncookie:10",
+		"tcp/80=syncookie",
+	}
+	for _, in := range invalid {
+		_, err := ParseL4FilterRule(in)
+		c.Assert(err, Not(IsNil), Commentf("%s", in))
+	}
+}
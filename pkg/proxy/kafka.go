@@ -323,11 +323,15 @@ func (k *kafkaRedirect) handleRequests(done <-chan struct{}, pair *connectionPai
 
 	// retrieve identity of source together with original destination IP
 	// and destination port
-	srcIdentity, dstIPPort, err := k.conf.lookupNewDest(remoteAddr.String(), k.redirect.ProxyPort)
-	if err != nil {
-		scopedLog.WithField("source",
-			remoteAddr.String()).WithError(err).Error("Unable to lookup original destination")
-		return
+	srcIdentity, dstIPPort := c.identity, c.origDst
+	if dstIPPort == "" {
+		var err error
+		srcIdentity, dstIPPort, err = k.conf.lookupNewDest(remoteAddr.String(), k.redirect.ProxyPort)
+		if err != nil {
+			scopedLog.WithField("source",
+				remoteAddr.String()).WithError(err).Error("Unable to lookup original destination")
+			return
+		}
 	}
 
 	// create a correlation cache
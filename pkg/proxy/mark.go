@@ -37,6 +37,7 @@ package proxy
 //
 // Cilium Mark (4 bits):
 // M M M M
+// 0 0 1 0 To proxy, packet assigned to the proxy socket by the datapath
 // 1 0 1 0 Ingress proxy
 // 1 0 1 1 Egress proxy
 // 1 1 0 0 From host
@@ -53,6 +54,11 @@ const (
 	// with a proxy.
 	MagicMarkIsProxy int = 0x0A00
 
+	// MagicMarkToProxy determines that the datapath assigned the traffic
+	// to the socket of a proxy without translating its destination, see
+	// ipv4_redirect_to_proxy_sk() in <bpf/lib/lxc.h>
+	MagicMarkToProxy int = 0x0200
+
 	// MagicMarkIngress determines that the traffic is sourced from the
 	// proxy which is applying Ingress policy
 	MagicMarkIngress int = 0x0A00
@@ -89,3 +95,9 @@ func getMagicMark(isIngress bool, identity int) int {
 
 	return mark
 }
+
+// getMarkIdentity returns the identity encoded in mark by getMagicMark() or
+// by the datapath
+func getMarkIdentity(mark int) uint32 {
+	return uint32((mark&0xFF)<<16 | (mark>>16)&0xFFFF)
+}
@@ -0,0 +1,31 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package proxy
+
+import (
+	. "gopkg.in/check.v1"
+)
+
+func (s *proxyTestSuite) TestMarkIdentity(c *C) {
+	for _, identity := range []int{0, 1, 0xFFFF, 0x10000, 0x51234, 0xFFFFFF} {
+		mark := getMagicMark(true, identity)
+		c.Assert(mark&MagicMarkHostMask, Equals, MagicMarkIngress)
+		c.Assert(getMarkIdentity(mark), Equals, uint32(identity))
+	}
+
+	// Mark set by set_identity_to_proxy() in <bpf/lib/common.h>
+	mark := MagicMarkToProxy | 0x1234<<16 | 0x05
+	c.Assert(getMarkIdentity(mark), Equals, uint32(0x51234))
+}
@@ -27,11 +27,15 @@ import (
 	"github.com/cilium/cilium/pkg/lock"
 	"github.com/cilium/cilium/pkg/logging/logfields"
 	"github.com/cilium/cilium/pkg/maps/proxymap"
+	"github.com/cilium/cilium/pkg/option"
 
 	"github.com/sirupsen/logrus"
 )
 
 const (
+	// ipv6Transparent is IPV6_TRANSPARENT in <linux/in6.h>
+	ipv6Transparent = 75
+
 	fieldConn     = "conn"
 	fieldSize     = "size"
 	fieldConnPair = "connPair"
@@ -48,11 +52,22 @@ type proxySocket struct {
 
 	// pairs is the set of active connection pairs.
 	pairs []*connectionPair
+
+	// transparent is true if the datapath may assign connections to the
+	// listen socket without translating their destination. mark is then
+	// set on accepted connections instead of the listen socket, as the
+	// mark of an accepted connection carries its source identity.
+	transparent bool
+	mark        int
 }
 
+// listenSocket opens a listen socket for a proxy. All traffic of accepted
+// connections is marked with mark if it is not 0.
 func listenSocket(address string, mark int) (*proxySocket, error) {
 	socket := &proxySocket{
-		closing: make(chan struct{}),
+		closing:     make(chan struct{}),
+		transparent: option.Config.ProxySkAssign,
+		mark:        mark,
 	}
 
 	addr, err := net.ResolveTCPAddr("tcp", address)
@@ -74,7 +89,12 @@ func listenSocket(address string, mark int) (*proxySocket, error) {
 		return nil, fmt.Errorf("unable to set SO_REUSEADDR socket option: %s", err)
 	}
 
-	if mark != 0 {
+	if socket.transparent {
+		if err = setFdTransparent(fd, family); err != nil {
+			syscall.Close(fd)
+			return nil, err
+		}
+	} else if mark != 0 {
 		setFdMark(fd, mark)
 	}
 
@@ -149,6 +169,10 @@ func (s *proxySocket) Accept(cascadeClose bool) (*connectionPair, error) {
 	}
 	pair := newConnectionPair(afterClose)
 
+	if s.transparent {
+		s.lookupAssignedDest(c, pair.Rx)
+	}
+
 	s.locker.Lock()
 	if cascadeClose {
 		s.pairs = append(s.pairs, pair)
@@ -227,6 +251,13 @@ type proxyConnection struct {
 	// afterClose is a function that is called after the connection's queue is
 	// closed.
 	afterClose func()
+
+	// origDst is the original destination of a connection assigned to
+	// the proxy by the datapath and identity is its source identity. It
+	// is empty if the destination of the connection has been translated,
+	// the proxy map must be consulted then.
+	origDst  string
+	identity uint32
 }
 
 func newProxyConnection(rx bool, afterClose func()) *proxyConnection {
@@ -462,6 +493,48 @@ func setFdMark(fd, mark int) {
 	}
 }
 
+// setFdTransparent allows a listen socket to accept connections to
+// addresses which are not local.
+func setFdTransparent(fd, family int) error {
+	var err error
+	if family == syscall.AF_INET {
+		err = syscall.SetsockoptInt(fd, syscall.SOL_IP, syscall.IP_TRANSPARENT, 1)
+	} else {
+		err = syscall.SetsockoptInt(fd, syscall.SOL_IPV6, ipv6Transparent, 1)
+	}
+	if err != nil {
+		return fmt.Errorf("unable to set IP_TRANSPARENT socket option: %s", err)
+	}
+	return nil
+}
+
+// lookupAssignedDest records the original destination and source identity
+// of the accepted connection c in pc if the datapath assigned it to the
+// listen socket, see ipv4_redirect_to_proxy_sk() in <bpf/lib/lxc.h>. The
+// connection then inherits the mark of its first packet, which is
+// replaced with the mark of the proxy.
+func (s *proxySocket) lookupAssignedDest(c net.Conn, pc *proxyConnection) {
+	tc, ok := c.(*net.TCPConn)
+	if !ok {
+		return
+	}
+
+	f, err := tc.File()
+	if err != nil {
+		return
+	}
+	defer f.Close()
+
+	fd := int(f.Fd())
+	mark, err := syscall.GetsockoptInt(fd, syscall.SOL_SOCKET, syscall.SO_MARK)
+	if err == nil && mark&MagicMarkHostMask == MagicMarkToProxy && c.LocalAddr() != nil {
+		pc.origDst = c.LocalAddr().String()
+		pc.identity = getMarkIdentity(mark)
+	}
+
+	setFdMark(fd, s.mark)
+}
+
 func setSocketMark(c net.Conn, mark int) {
 	if tc, ok := c.(*net.TCPConn); ok {
 		if f, err := tc.File(); err == nil {
@@ -4,6 +4,13 @@
 #define __NR_CPUS__ 1
 #endif
 
+#ifdef TEST_RINGBUF
+struct bpf_elf_map __section_maps ringbuf_test_events = {
+	.type           = BPF_MAP_TYPE_RINGBUF,
+	.pinning        = PIN_GLOBAL_NS,
+	.max_elem       = 1 << 22,
+};
+#else
 struct bpf_elf_map __section_maps perf_test_events = {
 	.type           = BPF_MAP_TYPE_PERF_EVENT_ARRAY,
 	.size_key       = sizeof(int),
@@ -11,10 +18,23 @@ struct bpf_elf_map __section_maps perf_test_events = {
 	.pinning        = PIN_GLOBAL_NS,
 	.max_elem       = __NR_CPUS__,
 };
+#endif
 
 __section_cls_entry
 int cls_entry(struct __sk_buff *skb)
 {
+#ifdef TEST_RINGBUF
+	struct event_msg *msg;
+
+	msg = ringbuf_reserve(&ringbuf_test_events, sizeof(*msg), 0);
+	if (!msg)
+		return TC_ACT_OK;
+
+	msg->type = EVENT_TYPE_SAMPLE;
+	if (skb_load_bytes(skb, 0, &msg->data, sizeof(msg->data)) < 0)
+		memset(&msg->data, 0, sizeof(msg->data));
+	ringbuf_submit(msg, 0);
+#else
 	struct event_msg msg = {0};
 
 	msg.type = EVENT_TYPE_SAMPLE;
@@ -22,6 +42,7 @@ int cls_entry(struct __sk_buff *skb)
 	skb_load_bytes(skb, 0, &msg.data, sizeof(msg.data));
 	skb_event_output(skb, &perf_test_events, BPF_F_CURRENT_CPU,
 		     &msg, sizeof(msg));
+#endif
 
 	return TC_ACT_OK;
 }
@@ -0,0 +1,1049 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// datapath-bench replays packets through the datapath programs with
+// BPF_PROG_TEST_RUN and reports the cost per packet of each code path
+// together with the instruction counts of all program sections as JSON.
+// The programs are compiled with the dummy configs in bpf/ and attached by
+// datapath-bench.sh, which passes the ids of the entry programs.
+//
+// The maps are populated to match the dummy configs: the endpoint LXC_ID
+// with address LXC_IPV4 may talk to identity 1000 on port 80 directly and
+// on port 8080 through a proxy, and accepts anything from that identity.
+//
+// Packets run by the kernel lack the metadata set by a real device, so
+// some paths end earlier than in production. Most notably bpf_overlay
+// drops all packets due to the missing tunnel key.
+package main
+
+import (
+	"encoding/binary"
+	"encoding/json"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"net"
+	"os"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/byteorder"
+	"github.com/cilium/cilium/pkg/maps/cidrmap"
+	"github.com/cilium/cilium/pkg/maps/ipcache"
+	"github.com/cilium/cilium/pkg/maps/lbmap"
+	"github.com/cilium/cilium/pkg/maps/lxcmap"
+	"github.com/cilium/cilium/pkg/maps/policymap"
+	"github.com/cilium/cilium/pkg/u8proto"
+
+	"github.com/google/gopacket"
+	"github.com/google/gopacket/layers"
+	"github.com/spf13/cobra"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	progTypeSchedCls = 3
+	progTypeXDP      = 6
+
+	// Must be synchronized with bpf/lxc_config.h, bpf/node_config.h and
+	// bpf/filter_config.h
+	lxcID       = 0x1010
+	lxcIPv4     = 0x10203040
+	policyMap   = "cilium_policy_foo"
+	ctMap4      = "cilium_ct4_111"
+	cidr4DynMap = "v4_dyn"
+
+	// Must be synchronized with <bpf/lib/common.h>
+	policyProgMap = "cilium_policy"
+	callsMapName  = "cilium_calls_bench_"
+	callsSize     = 13
+	cbSrcLabel    = 0
+
+	remoteIdentity = 1000
+	deniedIdentity = 1001
+	proxyPort      = 4242
+	httpPort       = 80
+	proxiedPort    = 8080
+	revNATID       = 1
+)
+
+// Must be synchronized with CILIUM_CALL_* in <bpf/lib/common.h>
+var callNames = map[uint32]string{
+	1:  "drop-notify",
+	2:  "error-notify",
+	3:  "send-icmp6-echo-reply",
+	4:  "handle-icmp6-ns",
+	5:  "send-icmp6-time-exceeded",
+	6:  "arp",
+	7:  "ipv4-from-lxc",
+	8:  "nat64",
+	9:  "nat46",
+	10: "ipv6-from-lxc",
+	11: "ipv4-to-lxc",
+	12: "ipv6-to-lxc",
+}
+
+var (
+	repeat         uint32
+	parallel       int
+	newFlows       int
+	ctEntries      int
+	ipcacheEntries int
+	policyEntries  int
+	services       int
+	threshold      float64
+	baseline       string
+	progArgs       []string
+	pcapArgs       []string
+
+	lxcMAC     = net.HardwareAddr{0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff}
+	nodeMAC    = net.HardwareAddr{0xde, 0xad, 0xbe, 0xef, 0xc0, 0xde}
+	remoteMAC  = net.HardwareAddr{0x02, 0x00, 0x00, 0x00, 0x00, 0x01}
+	remoteIP   = net.IPv4(10, 1, 0, 1).To4()
+	deniedIP   = net.IPv4(10, 2, 0, 1).To4()
+	clientIP   = net.IPv4(192, 0, 2, 1).To4()
+	serviceIP  = net.IPv4(10, 96, 0, 10).To4()
+	filteredIP = net.IPv4(203, 0, 113, 1).To4()
+	filtered   = net.IPNet{IP: net.IPv4(203, 0, 113, 0).To4(), Mask: net.CIDRMask(24, 32)}
+)
+
+// lxcIP returns LXC_IPV4 which is stored in network byte order, so the
+// address depends on the byte order of the host.
+func lxcIP() net.IP {
+	ip := make(net.IP, net.IPv4len)
+	byteorder.Native.PutUint32(ip, lxcIPv4)
+	return ip
+}
+
+// ctKey4 must match struct ipv4_ct_tuple in <bpf/lib/common.h>
+type ctKey4 struct {
+	Daddr   [4]byte
+	Saddr   [4]byte
+	Dport   uint16
+	Sport   uint16
+	Nexthdr uint8
+	Flags   uint8
+}
+
+// ctEntryLifetime is the offset of lifetime in struct ct_entry in
+// <bpf/lib/common.h>
+const ctEntryLifetime = 24
+
+// progInfo must match struct bpf_prog_info in <linux/bpf.h> up to
+// verified_insns. Kernels which do not know a field leave it zero.
+type progInfo struct {
+	Type          uint32
+	ID            uint32
+	Tag           [8]byte
+	JitedProgLen  uint32
+	XlatedProgLen uint32
+	Unused        [192]byte
+	VerifiedInsns uint32
+	Pad           uint32
+}
+
+type sectionReport struct {
+	Section       string `json:"section"`
+	XlatedInsns   uint32 `json:"xlatedInsns"`
+	VerifiedInsns uint32 `json:"verifiedInsns,omitempty"`
+	JitedBytes    uint32 `json:"jitedBytes"`
+}
+
+type pathReport struct {
+	Path        string            `json:"path"`
+	Packets     uint64            `json:"packets"`
+	NsPerPacket float64           `json:"nsPerPacket"`
+	Verdicts    map[string]uint64 `json:"verdicts"`
+}
+
+type programReport struct {
+	Program  string          `json:"program"`
+	Sections []sectionReport `json:"sections"`
+	Paths    []pathReport    `json:"paths"`
+}
+
+type report struct {
+	Kernel   string          `json:"kernel"`
+	Repeat   uint32          `json:"repeat"`
+	Parallel int             `json:"parallel"`
+	Programs []programReport `json:"programs"`
+}
+
+type flow struct {
+	src, dst     net.IP
+	sport, dport uint16
+	syn          bool
+}
+
+func (f flow) reverse() flow {
+	return flow{src: f.dst, dst: f.src, sport: f.dport, dport: f.sport}
+}
+
+// packet returns an Ethernet frame carrying a TCP SYN or ACK of the flow
+func (f flow) packet(srcMAC, dstMAC net.HardwareAddr) []byte {
+	eth := &layers.Ethernet{
+		SrcMAC:       srcMAC,
+		DstMAC:       dstMAC,
+		EthernetType: layers.EthernetTypeIPv4,
+	}
+	ip := &layers.IPv4{
+		Version:  4,
+		TTL:      64,
+		Protocol: layers.IPProtocolTCP,
+		SrcIP:    f.src,
+		DstIP:    f.dst,
+	}
+	tcp := &layers.TCP{
+		SrcPort: layers.TCPPort(f.sport),
+		DstPort: layers.TCPPort(f.dport),
+		Seq:     1,
+		SYN:     f.syn,
+		ACK:     !f.syn,
+		Window:  65535,
+	}
+	tcp.SetNetworkLayerForChecksum(ip)
+
+	buf := gopacket.NewSerializeBuffer()
+	opts := gopacket.SerializeOptions{FixLengths: true, ComputeChecksums: true}
+	if err := gopacket.SerializeLayers(buf, opts, eth, ip, tcp); err != nil {
+		panic(err)
+	}
+	return buf.Bytes()
+}
+
+// step is a packet injected into a program. identity is passed in
+// skb->cb[CB_SRC_LABEL] to programs invoked by tail call.
+type step struct {
+	prog     string
+	identity uint32
+	flow     flow
+	srcMAC   net.HardwareAddr
+	dstMAC   net.HardwareAddr
+}
+
+// path is a code path of a program. The setup packets are run once before
+// the measurement, e.g. to create conntrack entries. If newFlow is set, the
+// measured packet is run once for each of --flows different source ports
+// so that every run creates a new connection.
+type path struct {
+	name    string
+	setup   []step
+	measure step
+	newFlow bool
+}
+
+func fromLXC(f flow) step {
+	return step{prog: "lxc", flow: f, srcMAC: lxcMAC, dstMAC: nodeMAC}
+}
+
+func toLXC(identity uint32, f flow) step {
+	return step{prog: "lxc-policy", identity: identity, flow: f, srcMAC: nodeMAC, dstMAC: lxcMAC}
+}
+
+func fromWire(prog string, f flow) step {
+	return step{prog: prog, flow: f, srcMAC: remoteMAC, dstMAC: nodeMAC}
+}
+
+func syn(src net.IP, sport uint16, dst net.IP, dport uint16) flow {
+	return flow{src: src, dst: dst, sport: sport, dport: dport, syn: true}
+}
+
+func ack(f flow) flow {
+	f.syn = false
+	return f
+}
+
+// paths returns the code paths measured for each program. Source ports
+// are unique across paths so that their conntrack entries do not collide.
+func paths() map[string][]path {
+	lxc := lxcIP()
+	egress := syn(lxc, 1000, remoteIP, httpPort)
+	service := syn(lxc, 1001, serviceIP, httpPort)
+	proxy := syn(lxc, 1002, remoteIP, proxiedPort)
+	ingress := syn(remoteIP, 2000, lxc, httpPort)
+	netdev := syn(remoteIP, 3000, lxc, httpPort)
+
+	return map[string][]path{
+		"lxc": {
+			{name: "new", measure: fromLXC(syn(lxc, 0, remoteIP, httpPort)), newFlow: true},
+			{name: "established", setup: []step{fromLXC(egress)}, measure: fromLXC(ack(egress))},
+			{name: "service", setup: []step{fromLXC(service)}, measure: fromLXC(ack(service))},
+			{name: "proxy", setup: []step{fromLXC(proxy)}, measure: fromLXC(ack(proxy))},
+			{name: "denied", measure: fromLXC(syn(lxc, 1003, deniedIP, httpPort))},
+		},
+		"lxc-policy": {
+			{name: "new", measure: toLXC(remoteIdentity, syn(remoteIP, 0, lxc, httpPort)), newFlow: true},
+			{name: "established", setup: []step{toLXC(remoteIdentity, ingress)}, measure: toLXC(remoteIdentity, ack(ingress))},
+			{name: "reply", setup: []step{fromLXC(egress)}, measure: toLXC(remoteIdentity, egress.reverse())},
+			{name: "denied", measure: toLXC(deniedIdentity, syn(deniedIP, 2001, lxc, httpPort))},
+		},
+		"netdev": {
+			{name: "new", measure: fromWire("netdev", syn(remoteIP, 0, lxc, httpPort)), newFlow: true},
+			{name: "established", setup: []step{fromWire("netdev", netdev)}, measure: fromWire("netdev", ack(netdev))},
+		},
+		"lb": {
+			{name: "service", measure: fromWire("lb", syn(clientIP, 4000, serviceIP, httpPort))},
+			{name: "passthrough", measure: fromWire("lb", syn(clientIP, 4001, lxc, httpPort))},
+		},
+		"overlay": {
+			{name: "to-endpoint", measure: fromWire("overlay", ack(netdev))},
+		},
+		"xdp": {
+			{name: "pass", measure: fromWire("xdp", syn(clientIP, 5000, lxc, httpPort))},
+			{name: "prefilter-drop", measure: fromWire("xdp", syn(filteredIP, 5000, lxc, httpPort))},
+		},
+	}
+}
+
+type program struct {
+	name     string
+	id       uint32
+	fd       int
+	progType uint32
+}
+
+func testRun(p *program, identity uint32, pkt []byte, count uint32) (uint32, uint32, error) {
+	// struct __sk_buff up to and including cb[]
+	var ctx [17]uint32
+	attr := struct {
+		progFd      uint32
+		retval      uint32
+		dataSizeIn  uint32
+		dataSizeOut uint32
+		dataIn      uint64
+		dataOut     uint64
+		repeat      uint32
+		duration    uint32
+		ctxSizeIn   uint32
+		ctxSizeOut  uint32
+		ctxIn       uint64
+		ctxOut      uint64
+	}{
+		progFd:     uint32(p.fd),
+		dataSizeIn: uint32(len(pkt)),
+		dataIn:     uint64(uintptr(unsafe.Pointer(&pkt[0]))),
+		repeat:     count,
+	}
+
+	if identity != 0 {
+		ctx[12+cbSrcLabel] = identity
+		attr.ctxSizeIn = uint32(unsafe.Sizeof(ctx))
+		attr.ctxIn = uint64(uintptr(unsafe.Pointer(&ctx[0])))
+	}
+
+	_, _, errno := unix.Syscall(unix.SYS_BPF, bpf.BPF_PROG_TEST_RUN,
+		uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+	if errno != 0 {
+		return 0, 0, fmt.Errorf("unable to run %s: %s", p.name, errno)
+	}
+	return attr.retval, attr.duration, nil
+}
+
+func getProgInfo(fd int) (*progInfo, error) {
+	info := &progInfo{}
+	attr := struct {
+		bpfFd   uint32
+		infoLen uint32
+		info    uint64
+	}{
+		bpfFd:   uint32(fd),
+		infoLen: uint32(unsafe.Sizeof(*info)),
+		info:    uint64(uintptr(unsafe.Pointer(info))),
+	}
+
+	_, _, errno := unix.Syscall(unix.SYS_BPF, bpf.BPF_OBJ_GET_INFO_BY_FD,
+		uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+	if errno != 0 {
+		return nil, fmt.Errorf("unable to get program info: %s", errno)
+	}
+	return info, nil
+}
+
+func openProg(name string, id uint32) (*program, error) {
+	fd, err := bpf.GetProgFDByID(id)
+	if err != nil {
+		return nil, err
+	}
+	info, err := getProgInfo(fd)
+	if err != nil {
+		unix.Close(fd)
+		return nil, err
+	}
+	return &program{name: name, id: id, fd: fd, progType: info.Type}, nil
+}
+
+func sectionInfo(section string, id uint32) (sectionReport, error) {
+	fd, err := bpf.GetProgFDByID(id)
+	if err != nil {
+		return sectionReport{}, err
+	}
+	defer unix.Close(fd)
+
+	info, err := getProgInfo(fd)
+	if err != nil {
+		return sectionReport{}, err
+	}
+	return sectionReport{
+		Section:       section,
+		XlatedInsns:   info.XlatedProgLen / 8,
+		VerifiedInsns: info.VerifiedInsns,
+		JitedBytes:    info.JitedProgLen,
+	}, nil
+}
+
+// progArrayID returns the id of the program at 'index' of a prog array
+func progArrayID(mapName string, index uint32) (uint32, bool) {
+	fd, err := bpf.ObjGet(bpf.MapPath(mapName))
+	if err != nil {
+		return 0, false
+	}
+	defer bpf.ObjClose(fd)
+
+	var id uint32
+	if bpf.LookupElement(fd, unsafe.Pointer(&index), unsafe.Pointer(&id)) != nil {
+		return 0, false
+	}
+	return id, true
+}
+
+// sections returns the instruction counts of the entry program and all
+// programs in its tail call map
+func sections(p *program) ([]sectionReport, error) {
+	entry, err := sectionInfo("entry", p.id)
+	if err != nil {
+		return nil, err
+	}
+	result := []sectionReport{entry}
+
+	for i := uint32(1); i < callsSize; i++ {
+		id, ok := progArrayID(callsMapName+p.name, i)
+		if !ok {
+			continue
+		}
+		s, err := sectionInfo(fmt.Sprintf("2/%d (%s)", i, callNames[i]), id)
+		if err != nil {
+			return nil, err
+		}
+		result = append(result, s)
+	}
+
+	if p.name == "lxc" {
+		if id, ok := progArrayID(policyProgMap, lxcID); ok {
+			s, err := sectionInfo(fmt.Sprintf("1/%#x (policy)", lxcID), id)
+			if err != nil {
+				return nil, err
+			}
+			result = append(result, s)
+		}
+	}
+	return result, nil
+}
+
+func verdict(progType, retval uint32) string {
+	if progType == progTypeXDP {
+		switch retval {
+		case 0:
+			return "aborted"
+		case 1:
+			return "drop"
+		case 2:
+			return "pass"
+		case 3:
+			return "tx"
+		case 4:
+			return "redirect"
+		}
+	} else {
+		switch int32(retval) {
+		case -1:
+			return "unspec"
+		case 0:
+			return "ok"
+		case 2:
+			return "shot"
+		case 7:
+			return "redirect"
+		}
+	}
+	return strconv.Itoa(int(int32(retval)))
+}
+
+// measurement accumulates the runs of a path
+type measurement struct {
+	packets  uint64
+	totalNs  float64
+	verdicts map[string]uint64
+}
+
+func (m *measurement) run(p *program, identity uint32, pkt []byte, count uint32) error {
+	ret, duration, err := testRun(p, identity, pkt, count)
+	if err != nil {
+		return err
+	}
+	m.add(p, ret, duration, count)
+	return nil
+}
+
+func (m *measurement) add(p *program, ret, duration, count uint32) {
+	if m.verdicts == nil {
+		m.verdicts = map[string]uint64{}
+	}
+	m.packets += uint64(count)
+	m.totalNs += float64(duration) * float64(count)
+	m.verdicts[verdict(p.progType, ret)] += uint64(count)
+}
+
+// setAffinity pins the calling thread to the given CPU
+func setAffinity(cpu int) error {
+	var mask [16]uint64
+
+	if cpu >= len(mask)*64 {
+		return fmt.Errorf("CPU %d out of range", cpu)
+	}
+	mask[cpu/64] = 1 << uint(cpu%64)
+	_, _, errno := unix.RawSyscall(unix.SYS_SCHED_SETAFFINITY, 0,
+		unsafe.Sizeof(mask), uintptr(unsafe.Pointer(&mask[0])))
+	if errno != 0 {
+		return fmt.Errorf("unable to pin thread to CPU %d: %s", cpu, errno)
+	}
+	return nil
+}
+
+// runParallel runs the packet count times on each of the first n CPUs at
+// the same time. All CPUs work on the same flow, so the cost per packet
+// includes the contention on state shared between CPUs, most notably the
+// conntrack entry.
+func (m *measurement) runParallel(p *program, identity uint32, pkt []byte, count uint32, n int) error {
+	var (
+		wg    sync.WaitGroup
+		mutex sync.Mutex
+		ready sync.WaitGroup
+		start = make(chan struct{})
+		errs  = make([]error, n)
+	)
+
+	for cpu := 0; cpu < n; cpu++ {
+		wg.Add(1)
+		ready.Add(1)
+		go func(cpu int) {
+			defer wg.Done()
+			runtime.LockOSThread()
+			defer runtime.UnlockOSThread()
+
+			errs[cpu] = setAffinity(cpu)
+			ready.Done()
+			<-start
+			if errs[cpu] != nil {
+				return
+			}
+
+			ret, duration, err := testRun(p, identity, pkt, count)
+			if err != nil {
+				errs[cpu] = err
+				return
+			}
+			mutex.Lock()
+			m.add(p, ret, duration, count)
+			mutex.Unlock()
+		}(cpu)
+	}
+	ready.Wait()
+	close(start)
+	wg.Wait()
+
+	for _, err := range errs {
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func (m *measurement) report(name string) pathReport {
+	r := pathReport{Path: name, Packets: m.packets, Verdicts: m.verdicts}
+	if m.packets > 0 {
+		r.NsPerPacket = m.totalNs / float64(m.packets)
+	}
+	return r
+}
+
+func runPath(progs map[string]*program, pt path) (*pathReport, error) {
+	for _, s := range pt.setup {
+		p, ok := progs[s.prog]
+		if !ok {
+			return nil, nil
+		}
+		if _, _, err := testRun(p, s.identity, s.flow.packet(s.srcMAC, s.dstMAC), 1); err != nil {
+			return nil, err
+		}
+	}
+
+	s := pt.measure
+	p := progs[s.prog]
+	m := measurement{}
+	if pt.newFlow {
+		for i := 0; i < newFlows; i++ {
+			f := s.flow
+			f.sport = uint16(10000 + i%50000)
+			if err := m.run(p, s.identity, f.packet(s.srcMAC, s.dstMAC), 1); err != nil {
+				return nil, err
+			}
+		}
+	} else if parallel > 1 {
+		if err := m.runParallel(p, s.identity, s.flow.packet(s.srcMAC, s.dstMAC), repeat, parallel); err != nil {
+			return nil, err
+		}
+	} else if err := m.run(p, s.identity, s.flow.packet(s.srcMAC, s.dstMAC), repeat); err != nil {
+		return nil, err
+	}
+
+	r := m.report(pt.name)
+	return &r, nil
+}
+
+// readPcap returns the packets of a pcap file with Ethernet link type
+func readPcap(file string) ([][]byte, error) {
+	data, err := ioutil.ReadFile(file)
+	if err != nil {
+		return nil, err
+	}
+	if len(data) < 24 {
+		return nil, fmt.Errorf("%s: truncated pcap header", file)
+	}
+
+	var order binary.ByteOrder
+	switch binary.LittleEndian.Uint32(data) {
+	case 0xa1b2c3d4, 0xa1b23c4d:
+		order = binary.LittleEndian
+	case 0xd4c3b2a1, 0x4d3cb2a1:
+		order = binary.BigEndian
+	default:
+		return nil, fmt.Errorf("%s: not a pcap file", file)
+	}
+	if linkType := order.Uint32(data[20:]); linkType != 1 {
+		return nil, fmt.Errorf("%s: unsupported link type %d", file, linkType)
+	}
+
+	var pkts [][]byte
+	for off := 24; off < len(data); {
+		if off+16 > len(data) {
+			return nil, io.ErrUnexpectedEOF
+		}
+		caplen := int(order.Uint32(data[off+8:]))
+		off += 16
+		if off+caplen > len(data) {
+			return nil, io.ErrUnexpectedEOF
+		}
+		if caplen >= 14 {
+			pkts = append(pkts, data[off:off+caplen])
+		}
+		off += caplen
+	}
+	return pkts, nil
+}
+
+func runPcap(p *program, file string) (*pathReport, error) {
+	pkts, err := readPcap(file)
+	if err != nil {
+		return nil, err
+	}
+
+	m := measurement{}
+	for _, pkt := range pkts {
+		if err := m.run(p, 0, pkt, repeat); err != nil {
+			return nil, err
+		}
+	}
+	r := m.report("pcap:" + file)
+	return &r, nil
+}
+
+func warn(format string, args ...interface{}) {
+	fmt.Fprintf(os.Stderr, "WARNING: "+format+"\n", args...)
+}
+
+func populateEndpoint() error {
+	mac, _ := lxcmap.ParseMAC(lxcMAC.String())
+	nmac, _ := lxcmap.ParseMAC(nodeMAC.String())
+	info := &lxcmap.EndpointInfo{IfIndex: 1, LxcID: lxcID, MAC: mac, NodeMAC: nmac}
+	return lxcmap.LXCMap.Update(lxcmap.NewEndpointKey(lxcIP()), info)
+}
+
+func populateIPCache() error {
+	entries := map[string]uint32{
+		remoteIP.String(): remoteIdentity,
+		deniedIP.String(): deniedIdentity,
+	}
+	for i := 0; i < services; i++ {
+		entries[backendIP(i).String()] = remoteIdentity
+	}
+	for i := 0; i < ipcacheEntries; i++ {
+		ip := net.IPv4(10, 3, byte(i>>8), byte(i)).To4()
+		entries[ip.String()] = uint32(10000 + i%50000)
+	}
+
+	for ip, identity := range entries {
+		key := ipcache.NewKey(net.ParseIP(ip), nil)
+		if err := ipcache.IPCache.Update(&key, &ipcache.RemoteEndpointInfo{SecurityIdentity: identity}); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func populatePolicy() error {
+	pm, _, err := policymap.OpenMap(bpf.MapPath(policyMap))
+	if err != nil {
+		return err
+	}
+	defer pm.Close()
+
+	if err := pm.Allow(remoteIdentity, httpPort, u8proto.TCP, policymap.Egress, 0); err != nil {
+		return err
+	}
+	if err := pm.Allow(remoteIdentity, proxiedPort, u8proto.TCP, policymap.Egress, proxyPort); err != nil {
+		return err
+	}
+	if err := pm.Allow(remoteIdentity, 0, 0, policymap.Ingress, 0); err != nil {
+		return err
+	}
+	for i := 0; i < policyEntries; i++ {
+		identity := uint32(20000 + i)
+		if err := pm.Allow(identity, 443, u8proto.TCP, policymap.Ingress, 0); err != nil {
+			return err
+		}
+		if err := pm.Allow(identity, 0, 0, policymap.Egress, 0); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func backendIP(i int) net.IP {
+	return net.IPv4(10, 1, byte(1+i/250), byte(1+i%250)).To4()
+}
+
+// populateServices adds serviceIP and --services-1 additional services,
+// each with a single backend
+func populateServices() error {
+	for i := 0; i < services; i++ {
+		vip := serviceIP
+		if i > 0 {
+			vip = net.IPv4(10, 96, byte(1+i/250), byte(1+i%250)).To4()
+		}
+		fe := lbmap.NewService4Key(vip, httpPort, 0)
+		be := lbmap.NewService4Value(0, backendIP(i), httpPort, uint16(revNATID+i), 0)
+		if err := lbmap.AddSVC2BPFMap(fe, []lbmap.ServiceValue{be}, true, revNATID+i); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// populateCT fills the IPv4 conntrack map with unrelated connections of
+// the endpoint which expire in an hour
+func populateCT() error {
+	fd, err := bpf.ObjGet(bpf.MapPath(ctMap4))
+	if err != nil {
+		return err
+	}
+	defer bpf.ObjClose(fd)
+
+	info, err := bpf.GetMapInfo(os.Getpid(), fd)
+	if err != nil {
+		return err
+	}
+	now, err := bpf.GetMtime()
+	if err != nil {
+		return err
+	}
+
+	value := make([]byte, info.ValueSize)
+	byteorder.Native.PutUint32(value[ctEntryLifetime:], uint32(now/1000000000+3600))
+
+	lxc := lxcIP()
+	for i := 0; i < ctEntries; i++ {
+		key := ctKey4{
+			Dport:   byteorder.HostToNetwork(uint16(httpPort)).(uint16),
+			Sport:   byteorder.HostToNetwork(uint16(10000 + i%50000)).(uint16),
+			Nexthdr: uint8(u8proto.TCP),
+		}
+		copy(key.Daddr[:], net.IPv4(10, 4, byte(i>>8), byte(i)).To4())
+		copy(key.Saddr[:], lxc)
+		if err := bpf.UpdateElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&value[0]), 0); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func populatePrefilter() error {
+	m, _, err := cidrmap.OpenMapElems(bpf.MapPath(cidr4DynMap), 32, true, 1024)
+	if err != nil {
+		return err
+	}
+	defer m.Close()
+	return m.InsertCIDR(filtered)
+}
+
+// populate fills the maps of all loaded programs. Maps of programs which
+// were not loaded may be missing, so failures are not fatal.
+func populate(progs map[string]*program) {
+	steps := []struct {
+		name string
+		fn   func() error
+	}{
+		{"endpoint", populateEndpoint},
+		{"ipcache", populateIPCache},
+		{"policy", populatePolicy},
+		{"services", populateServices},
+		{"conntrack", populateCT},
+	}
+	if _, ok := progs["xdp"]; ok {
+		steps = append(steps, struct {
+			name string
+			fn   func() error
+		}{"prefilter", populatePrefilter})
+	}
+
+	for _, s := range steps {
+		if err := s.fn(); err != nil {
+			warn("unable to populate %s: %s", s.name, err)
+		}
+	}
+}
+
+func parseProgs() (map[string]*program, []string, error) {
+	progs := map[string]*program{}
+	var order []string
+
+	for _, arg := range progArgs {
+		s := strings.SplitN(arg, "=", 2)
+		if len(s) != 2 {
+			return nil, nil, fmt.Errorf("invalid --prog %q, expected name=id", arg)
+		}
+		id, err := strconv.ParseUint(s[1], 10, 32)
+		if err != nil {
+			return nil, nil, fmt.Errorf("invalid --prog %q: %s", arg, err)
+		}
+		p, err := openProg(s[0], uint32(id))
+		if err != nil {
+			return nil, nil, err
+		}
+		progs[s[0]] = p
+		order = append(order, s[0])
+	}
+
+	// The policy program of the endpoint is only reachable by tail call
+	if _, ok := progs["lxc"]; ok {
+		if id, ok := progArrayID(policyProgMap, lxcID); ok {
+			p, err := openProg("lxc-policy", id)
+			if err != nil {
+				return nil, nil, err
+			}
+			progs[p.name] = p
+			order = append(order, p.name)
+		}
+	}
+	return progs, order, nil
+}
+
+func pcapFiles() (map[string][]string, error) {
+	files := map[string][]string{}
+	for _, arg := range pcapArgs {
+		s := strings.SplitN(arg, "=", 2)
+		if len(s) != 2 {
+			return nil, fmt.Errorf("invalid --pcap %q, expected name=file", arg)
+		}
+		files[s[0]] = append(files[s[0]], s[1])
+	}
+	return files, nil
+}
+
+func run() (*report, error) {
+	if parallel < 1 || parallel > runtime.NumCPU() {
+		return nil, fmt.Errorf("invalid --parallel %d, expected 1..%d", parallel, runtime.NumCPU())
+	}
+
+	progs, order, err := parseProgs()
+	if err != nil {
+		return nil, err
+	}
+	files, err := pcapFiles()
+	if err != nil {
+		return nil, err
+	}
+
+	populate(progs)
+
+	r := &report{Kernel: kernelRelease(), Repeat: repeat, Parallel: parallel}
+
+	allPaths := paths()
+	for _, name := range order {
+		p := progs[name]
+		pr := programReport{Program: name}
+
+		if name != "lxc-policy" {
+			if pr.Sections, err = sections(p); err != nil {
+				return nil, err
+			}
+		}
+
+		for _, pt := range allPaths[name] {
+			res, err := runPath(progs, pt)
+			if err != nil {
+				return nil, err
+			}
+			if res != nil {
+				pr.Paths = append(pr.Paths, *res)
+			}
+		}
+
+		for _, file := range files[name] {
+			res, err := runPcap(p, file)
+			if err != nil {
+				return nil, err
+			}
+			pr.Paths = append(pr.Paths, *res)
+		}
+
+		r.Programs = append(r.Programs, pr)
+	}
+	return r, nil
+}
+
+func kernelRelease() string {
+	var uname unix.Utsname
+	if unix.Uname(&uname) != nil {
+		return ""
+	}
+	release := make([]byte, 0, len(uname.Release))
+	for _, c := range uname.Release {
+		if c == 0 {
+			break
+		}
+		release = append(release, byte(c))
+	}
+	return string(release)
+}
+
+func change(old, new float64) float64 {
+	if old == 0 {
+		return 0
+	}
+	return (new - old) / old * 100
+}
+
+// compare prints the differences to the baseline report and returns the
+// number of paths and sections which regressed by more than --threshold
+// percent
+func compare(base, cur *report) int {
+	regressions := 0
+	check := func(what string, old, new float64) {
+		c := change(old, new)
+		mark := ""
+		if c > threshold {
+			mark = " REGRESSION"
+			regressions++
+		}
+		fmt.Fprintf(os.Stderr, "%-40s %12.1f %12.1f %+8.1f%%%s\n", what, old, new, c, mark)
+	}
+
+	fmt.Fprintf(os.Stderr, "%-40s %12s %12s %9s\n", "PATH / SECTION", "BASELINE", "CURRENT", "CHANGE")
+	for _, bp := range base.Programs {
+		for _, cp := range cur.Programs {
+			if bp.Program != cp.Program {
+				continue
+			}
+			for _, bpath := range bp.Paths {
+				for _, cpath := range cp.Paths {
+					if bpath.Path == cpath.Path {
+						check(cp.Program+"/"+cpath.Path+" ns", bpath.NsPerPacket, cpath.NsPerPacket)
+					}
+				}
+			}
+			for _, bs := range bp.Sections {
+				for _, cs := range cp.Sections {
+					if bs.Section == cs.Section {
+						check(cp.Program+"/"+cs.Section+" insns", float64(bs.XlatedInsns), float64(cs.XlatedInsns))
+					}
+				}
+			}
+		}
+	}
+	return regressions
+}
+
+var RootCmd = &cobra.Command{
+	Use:   "datapath-bench",
+	Short: "Measure datapath programs with BPF_PROG_TEST_RUN",
+	Run: func(cmd *cobra.Command, args []string) {
+		r, err := run()
+		if err != nil {
+			fmt.Fprintf(os.Stderr, "%s\n", err)
+			os.Exit(1)
+		}
+
+		out, err := json.MarshalIndent(r, "", "  ")
+		if err != nil {
+			fmt.Fprintf(os.Stderr, "%s\n", err)
+			os.Exit(1)
+		}
+		fmt.Println(string(out))
+
+		if baseline == "" {
+			return
+		}
+		data, err := ioutil.ReadFile(baseline)
+		if err != nil {
+			fmt.Fprintf(os.Stderr, "%s\n", err)
+			os.Exit(1)
+		}
+		base := &report{}
+		if err := json.Unmarshal(data, base); err != nil {
+			fmt.Fprintf(os.Stderr, "%s: %s\n", baseline, err)
+			os.Exit(1)
+		}
+		if n := compare(base, r); n > 0 {
+			fmt.Fprintf(os.Stderr, "%d regressions above %.1f%%\n", n, threshold)
+			os.Exit(2)
+		}
+	},
+}
+
+func main() {
+	if err := RootCmd.Execute(); err != nil {
+		fmt.Fprintf(os.Stderr, "%s", err)
+		os.Exit(-1)
+	}
+}
+
+func init() {
+	flags := RootCmd.PersistentFlags()
+	flags.StringSliceVarP(&progArgs, "prog", "p", nil, "Program to measure as name=id, name is one of lxc, netdev, lb, overlay, xdp")
+	flags.StringSliceVar(&pcapArgs, "pcap", nil, "Additionally replay the packets of a pcap file as name=file")
+	flags.Uint32VarP(&repeat, "repeat", "r", 100000, "Number of runs per packet")
+	flags.IntVar(&parallel, "parallel", 1, "Number of CPUs running each packet of established flows at the same time, to measure contention on shared state")
+	flags.IntVar(&newFlows, "flows", 10000, "Number of connections created to measure new flows")
+	flags.IntVar(&ctEntries, "ct-entries", 2000, "Number of additional conntrack entries")
+	flags.IntVar(&ipcacheEntries, "ipcache-entries", 10000, "Number of additional ipcache entries")
+	flags.IntVar(&policyEntries, "policy-entries", 1000, "Number of additional identities in the policy")
+	flags.IntVar(&services, "services", 100, "Number of services")
+	flags.StringVar(&baseline, "baseline", "", "Report to compare against, exits with 2 on regressions")
+	flags.Float64Var(&threshold, "threshold", 10, "Regression threshold in percent")
+}
@@ -0,0 +1,142 @@
+#!/bin/bash
+#
+# Copyright 2018 Authors of Cilium
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Compiles the datapath programs with the dummy configs in bpf/, attaches
+# them to dummy devices and runs datapath-bench against them. All arguments
+# are passed to datapath-bench, e.g.:
+#
+#    $ make -C test/bpf datapath-bench
+#    $ sudo test/bpf/datapath-bench.sh --repeat 100000 > report.json
+#    $ sudo test/bpf/datapath-bench.sh --baseline report.json
+
+set -e
+
+DIR=$(dirname $0)
+BPFDIR=$(cd ${DIR}/../../bpf && pwd)
+BENCH=${DIR}/datapath-bench
+BUILDDIR=$(mktemp -d)
+DEV_PREFIX="bench_"
+CLANG=${CLANG:-clang}
+LLC=${LLC:-llc}
+
+# name:source:section:extra clang flags. bpf_lxc must be loaded before
+# bpf_netdev as local delivery tail calls into the policy program of the
+# endpoint.
+PROGS="lxc:bpf_lxc:from-container:
+netdev:bpf_netdev:from-netdev:
+lb:bpf_lb:from-netdev:-DLB_L3 -DLB_L4
+overlay:bpf_overlay:from-overlay:
+xdp:bpf_xdp:from-netdev:"
+
+function clean_maps {
+	rm -rf /sys/fs/bpf/tc/globals/*
+}
+
+function cleanup {
+	for dev in $(ip -o link show | grep -o "${DEV_PREFIX}[a-z]*"); do
+		ip link del ${dev} 2>/dev/null || true
+	done
+	rm -rf ${BUILDDIR}
+	clean_maps
+}
+
+# All programs are loaded at the same time, so each gets a private tail
+# call map instead of the cilium_calls_111 of the dummy configs.
+function prepare_config {
+	name=$1
+	cfg=${BUILDDIR}/${name}
+
+	mkdir -p ${cfg}
+	for h in node_config.h lxc_config.h netdev_config.h filter_config.h; do
+		grep -v "define CALLS_MAP" ${BPFDIR}/${h} > ${cfg}/${h}
+	done
+}
+
+function compile {
+	name=$1
+	src=$2
+	shift 2
+
+	${CLANG} -O2 -target bpf -emit-llvm -D__NR_CPUS__=$(nproc) \
+		-DCALLS_MAP=cilium_calls_bench_${name} "$@" \
+		-Wno-address-of-packed-member -Wno-unknown-warning-option \
+		-I${BUILDDIR}/${name} -I${BUILDDIR}/globals -I${BPFDIR} \
+		-I${BPFDIR}/include -c ${BPFDIR}/${src}.c -o - | \
+		${LLC} -march=bpf -mcpu=probe -filetype=obj \
+		-o ${BUILDDIR}/${name}.o
+}
+
+function tc_prog_id {
+	tc filter show dev $1 ingress | grep -o " id [0-9]*" | head -n1 | awk '{print $2}'
+}
+
+function xdp_prog_id {
+	ip -d link show dev $1 | grep -o "prog/xdp id [0-9]*" | awk '{print $3}'
+}
+
+if [ $(id -u) -ne 0 ]; then
+	echo "Must be run as root" 1>&2
+	exit 1
+fi
+
+if ps cax | grep cilium-agent; then
+	echo "WARNING: This test will conflict with running cilium instances." 1>&2
+	echo "Shut down cilium before continuing." 1>&2
+	exit 1
+fi
+
+if [ ! -x ${BENCH} ]; then
+	echo "${BENCH} not found, run 'make -C ${DIR} datapath-bench'" 1>&2
+	exit 1
+fi
+
+trap cleanup EXIT
+clean_maps
+
+# Compile against the features of the running kernel rather than the dummy
+# bpf_features.h so that the numbers match what the agent would load.
+mkdir -p ${BUILDDIR}/globals
+${BPFDIR}/run_probes.sh ${BPFDIR} ${BUILDDIR} 1>&2
+
+ARGS=""
+while IFS=: read name src section flags; do
+	dev=${DEV_PREFIX}${name}
+
+	echo "=> Compiling ${src}.c for ${name}..." 1>&2
+	prepare_config ${name}
+	compile ${name} ${src} ${flags}
+
+	echo "=> Loading ${name}.o:${section} on ${dev}..." 1>&2
+	ip link add ${dev} type dummy
+	ip link set dev ${dev} up
+	if [ "${name}" == "xdp" ]; then
+		ip link set dev ${dev} xdpgeneric obj ${BUILDDIR}/${name}.o sec ${section}
+		id=$(xdp_prog_id ${dev})
+	else
+		tc qdisc replace dev ${dev} clsact
+		tc filter replace dev ${dev} ingress prio 1 handle 1 bpf da \
+			obj ${BUILDDIR}/${name}.o sec ${section}
+		id=$(tc_prog_id ${dev})
+	fi
+
+	if [ -z "${id}" ]; then
+		echo "Unable to determine program id of ${name}" 1>&2
+		exit 1
+	fi
+	ARGS="${ARGS} --prog ${name}=${id}"
+done <<< "${PROGS}"
+
+${BENCH} ${ARGS} "$@"
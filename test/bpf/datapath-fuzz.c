@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (c) 2018 Authors of Cilium
+//
+// libFuzzer target for the datapath library. The first byte of the input
+// selects the function under test, the remainder is an ethernet frame or,
+// for the policy lookup, the identity, port and protocol to look up. Maps
+// persist across inputs so that connections created by one input can be
+// found by the next.
+//
+//    $ make -C test/bpf datapath-fuzz
+//    $ test/bpf/datapath-fuzz -max_len=512 corpus/
+//
+// Built with -DFUZZ_MAIN, the target runs the inputs given on the command
+// line instead, e.g. to reproduce a crash without libFuzzer.
+#include "datapath-harness.h"
+
+enum {
+	FUZZ_CT4,
+	FUZZ_CT6,
+	FUZZ_LB4,
+	FUZZ_POLICY,
+	FUZZ_NAT46,
+	__FUZZ_MAX,
+};
+
+static struct mock_skb skb;
+
+static void fuzz_policy(const uint8_t *data, size_t size)
+{
+	__u32 identity;
+	__u16 dport;
+	int ret;
+
+	if (size < 8)
+		return;
+
+	memcpy(&identity, data, sizeof(identity));
+	memcpy(&dport, data + 4, sizeof(dport));
+	ret = harness_policy(&skb.skb, identity, dport, data[6], data[7] & 1);
+	if (ret != DROP_POLICY && (ret < 0 || ret > 0xffff))
+		abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static bool initialized;
+	uint8_t target;
+	int ret = 0;
+
+	if (!initialized) {
+		harness_setup();
+		initialized = true;
+	}
+
+	if (size < 1)
+		return 0;
+	target = data[0] % __FUZZ_MAX;
+	data++;
+	size--;
+
+	if (mock_skb_init(&skb, data, size) < 0)
+		return 0;
+	mock_state.now_ns += 1000000000ULL;
+
+	switch (target) {
+	case FUZZ_CT4:
+		if (skb.skb.protocol == bpf_htons(ETH_P_IP))
+			ret = harness_ct4(&skb.skb, data[0] % 3);
+		break;
+	case FUZZ_CT6:
+		if (skb.skb.protocol == bpf_htons(ETH_P_IPV6))
+			ret = harness_ct6(&skb.skb, data[0] % 3);
+		break;
+	case FUZZ_LB4:
+		if (skb.skb.protocol == bpf_htons(ETH_P_IP))
+			ret = harness_lb4(&skb.skb);
+		break;
+	case FUZZ_POLICY:
+		fuzz_policy(data, size);
+		break;
+	case FUZZ_NAT46:
+		ret = harness_nat46(&skb.skb);
+		break;
+	}
+
+	/* Packets never grow beyond the buffer and errors must fit into the
+	 * reason of a drop notification.
+	 */
+	if (skb.skb.len > skb.size || ret < -UINT8_MAX)
+		abort();
+
+	return 0;
+}
+
+#ifdef FUZZ_MAIN
+int main(int argc, char *argv[])
+{
+	static uint8_t buf[MOCK_SKB_SIZE + 1];
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		FILE *f = fopen(argv[i], "r");
+		size_t len;
+
+		if (!f) {
+			perror(argv[i]);
+			return 1;
+		}
+		len = fread(buf, 1, sizeof(buf), f);
+		fclose(f);
+		LLVMFuzzerTestOneInput(buf, len);
+	}
+
+	return 0;
+}
+#endif
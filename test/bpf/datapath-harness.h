@@ -0,0 +1,302 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Entry points into bpf/lib for datapath-fuzz and datapath-microbench
+ *
+ * The library is compiled with the dummy configs of bpf/ against the
+ * helpers of mock.h. Each harness_*() function runs one piece of the
+ * datapath the way bpf_lxc.c does and returns its result.
+ *
+ * API:
+ * void harness_setup()
+ * int harness_ct4(skb, dir)
+ * int harness_ct6(skb, dir)
+ * int harness_lb4(skb)
+ * int harness_policy(skb, identity, dport, proto, dir)
+ * int harness_nat46(skb)
+ */
+
+#ifndef __DATAPATH_HARNESS_H_
+#define __DATAPATH_HARNESS_H_
+
+#include <node_config.h>
+#include <lxc_config.h>
+
+#include "mock.h"
+
+#include "lib/common.h"
+#include "lib/maps.h"
+#include "lib/ipv4.h"
+#include "lib/ipv6.h"
+#include "lib/conntrack.h"
+#include "lib/lb.h"
+#include "lib/policy.h"
+#include "lib/nat46.h"
+
+/* Must be synchronized with CT_MAP4/CT_MAP6 in bpf_lxc.c */
+struct bpf_elf_map __section_maps CT_MAP6 = {
+	.type		= BPF_MAP_TYPE_HASH,
+	.flags		= CONDITIONAL_PREALLOC,
+	.size_key	= sizeof(struct ipv6_ct_tuple),
+	.size_value	= sizeof(struct ct_entry),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= CT_MAP_SIZE,
+};
+
+struct bpf_elf_map __section_maps CT_MAP4 = {
+	.type		= BPF_MAP_TYPE_HASH,
+	.flags		= CONDITIONAL_PREALLOC,
+	.size_key	= sizeof(struct ipv4_ct_tuple),
+	.size_value	= sizeof(struct ct_entry),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= CT_MAP_SIZE,
+};
+
+/* Addresses in network byte order */
+#define HARNESS_REMOTE_IP	0x0100010a	/* 10.1.0.1 */
+#define HARNESS_SERVICE_IP	0x0a00600a	/* 10.96.0.10 */
+#define HARNESS_BACKEND_IP	0x0201010a	/* 10.1.1.2 */
+#define HARNESS_SERVICE_PORT	80
+#define HARNESS_BACKENDS	4
+#define HARNESS_IDENTITY	1000
+#define HARNESS_PROXY_PORT	4242
+
+static inline void harness_policy_allow(__u32 identity, __u16 dport, __u8 proto,
+					int dir, __u16 proxy_port)
+{
+	struct policy_entry entry = {
+		.proxy_port = bpf_htons(proxy_port),
+	};
+	struct policy_key key = {
+		.sec_label = identity,
+		.dport = bpf_htons(dport),
+		.protocol = proto,
+		.egress = !dir,
+	};
+
+#ifdef POLICY_LPM
+	key.prefixlen = POLICY_PREFIX_FULL;
+	if (!dport && !proto) {
+		key.prefixlen = POLICY_PREFIX_L3;
+		entry.flags = POLICY_F_L3;
+	}
+#endif
+	map_update_elem(&POLICY_MAP, &key, &entry, BPF_ANY);
+}
+
+/**
+ * harness_setup
+ *
+ * Adds a service with HARNESS_BACKENDS backends and a policy allowing
+ * HARNESS_IDENTITY in both directions, on port 80 directly and on port
+ * 8080 through a proxy.
+ */
+static inline void harness_setup(void)
+{
+	struct lb4_key key = {
+		.address = HARNESS_SERVICE_IP,
+		.dport = bpf_htons(HARNESS_SERVICE_PORT),
+	};
+	struct lb4_service svc = {
+		.count = HARNESS_BACKENDS,
+		.rev_nat_index = 1,
+	};
+	struct lb4_reverse_nat revnat = {
+		.address = HARNESS_SERVICE_IP,
+		.port = bpf_htons(HARNESS_SERVICE_PORT),
+	};
+	__u16 index = 1;
+	int i;
+
+	map_update_elem(&cilium_lb4_services, &key, &svc, BPF_ANY);
+	for (i = 1; i <= HARNESS_BACKENDS; i++) {
+		key.slave = i;
+		svc.target = HARNESS_BACKEND_IP + ((i - 1) << 24);
+		svc.port = bpf_htons(HARNESS_SERVICE_PORT);
+		svc.count = 0;
+		map_update_elem(&cilium_lb4_services, &key, &svc, BPF_ANY);
+	}
+	map_update_elem(&cilium_lb4_reverse_nat, &index, &revnat, BPF_ANY);
+
+	harness_policy_allow(HARNESS_IDENTITY, 80, IPPROTO_TCP, CT_EGRESS, 0);
+	harness_policy_allow(HARNESS_IDENTITY, 8080, IPPROTO_TCP, CT_EGRESS,
+			     HARNESS_PROXY_PORT);
+	harness_policy_allow(HARNESS_IDENTITY, 0, 0, CT_INGRESS, 0);
+}
+
+/**
+ * harness_ct4
+ * @skb:	IPv4 packet
+ * @dir:	CT_EGRESS, CT_INGRESS or CT_SERVICE
+ *
+ * Looks up the connection of the packet and creates it if new. Returns the
+ * CT_* result or a negative drop reason.
+ */
+static inline int harness_ct4(struct __sk_buff *skb, int dir)
+{
+	struct ipv4_ct_tuple tuple = {};
+	struct ct_state ct_state = {};
+	void *data, *data_end;
+	bool monitor = false;
+	struct iphdr *ip4;
+	int ret, l4_off;
+
+	if (!revalidate_data(skb, &data, &data_end, &ip4))
+		return DROP_INVALID;
+
+	tuple.nexthdr = ip4->protocol;
+	tuple.daddr = ip4->daddr;
+	tuple.saddr = ip4->saddr;
+	l4_off = ETH_HLEN + ipv4_hdrlen(ip4);
+
+	ret = ct_lookup4(&CT_MAP4, &tuple, skb, l4_off, dir, &ct_state, &monitor);
+	if (ret == CT_NEW) {
+		struct ct_state ct_state_new = {
+			.src_sec_id = SECLABEL,
+		};
+		int err;
+
+		err = ct_create4(&CT_MAP4, &tuple, skb, dir, &ct_state_new);
+		if (IS_ERR(err))
+			return err;
+	}
+	return ret;
+}
+
+/**
+ * harness_ct6
+ * @skb:	IPv6 packet
+ * @dir:	CT_EGRESS, CT_INGRESS or CT_SERVICE
+ *
+ * Same as harness_ct4() for IPv6.
+ */
+static inline int harness_ct6(struct __sk_buff *skb, int dir)
+{
+	struct ipv6_ct_tuple tuple = {};
+	struct ct_state ct_state = {};
+	void *data, *data_end;
+	bool monitor = false;
+	struct ipv6hdr *ip6;
+	int ret, l4_off, hdrlen;
+
+	if (!revalidate_data(skb, &data, &data_end, &ip6))
+		return DROP_INVALID;
+
+	tuple.nexthdr = ip6->nexthdr;
+	ipv6_addr_copy(&tuple.daddr, (union v6addr *) &ip6->daddr);
+	ipv6_addr_copy(&tuple.saddr, (union v6addr *) &ip6->saddr);
+
+	hdrlen = ipv6_hdrlen(skb, ETH_HLEN, &tuple.nexthdr);
+	if (hdrlen < 0)
+		return hdrlen;
+	l4_off = ETH_HLEN + hdrlen;
+
+	ret = ct_lookup6(&CT_MAP6, &tuple, skb, l4_off, dir, &ct_state, &monitor);
+	if (ret == CT_NEW) {
+		struct ct_state ct_state_new = {
+			.src_sec_id = SECLABEL,
+		};
+		int err;
+
+		err = ct_create6(&CT_MAP6, &tuple, skb, dir, &ct_state_new);
+		if (IS_ERR(err))
+			return err;
+	}
+	return ret;
+}
+
+/**
+ * harness_lb4
+ * @skb:	IPv4 packet
+ *
+ * Translates a packet to a service to one of its backends as done by
+ * handle_ipv4_from_lxc(). Returns the result of lb4_local(), 0 if the
+ * packet is not for a service or a negative drop reason.
+ */
+static inline int harness_lb4(struct __sk_buff *skb)
+{
+	struct ipv4_ct_tuple tuple = {};
+	struct ct_state ct_state_new = {};
+	struct csum_offset csum_off = {};
+	struct lb4_key key = {};
+	struct lb4_service *svc;
+	void *data, *data_end;
+	struct iphdr *ip4;
+	int ret, l4_off;
+
+	if (!revalidate_data(skb, &data, &data_end, &ip4))
+		return DROP_INVALID;
+
+	tuple.nexthdr = ip4->protocol;
+	tuple.daddr = ip4->daddr;
+	tuple.saddr = ip4->saddr;
+	l4_off = ETH_HLEN + ipv4_hdrlen(ip4);
+
+	ret = lb4_extract_key(skb, &tuple, l4_off, &key, &csum_off, CT_EGRESS);
+	if (IS_ERR(ret))
+		return ret == DROP_UNKNOWN_L4 ? 0 : ret;
+
+	ct_state_new.orig_dport = key.dport;
+	svc = lb4_lookup_service(skb, &key);
+	if (!svc)
+		return 0;
+	return lb4_local(&CT_MAP4, skb, ETH_HLEN, l4_off, &csum_off, &key,
+			 &tuple, svc, &ct_state_new, ip4->saddr);
+}
+
+/**
+ * harness_policy
+ * @skb:	packet, only used for accounting
+ * @identity:	identity of the remote endpoint
+ * @dport:	destination port in host byte order
+ * @proto:	L4 protocol
+ * @dir:	CT_EGRESS or CT_INGRESS
+ *
+ * Returns the proxy port, 0 if the packet is allowed or DROP_POLICY.
+ */
+static inline int harness_policy(struct __sk_buff *skb, __u32 identity,
+				 __u16 dport, __u8 proto, int dir)
+{
+	return __policy_can_access(&POLICY_MAP, skb, identity, bpf_htons(dport),
+				   proto, 0, NULL, dir);
+}
+
+/**
+ * harness_nat46
+ * @skb:	IPv4 or IPv6 packet
+ *
+ * Translates IPv4 packets to IPv6 as done for LXC_NAT46 endpoints and
+ * IPv6 packets back to IPv4. Returns 0 or a negative drop reason.
+ */
+static inline int harness_nat46(struct __sk_buff *skb)
+{
+	void *data, *data_end;
+	struct iphdr *ip4;
+	union v6addr dp = {};
+
+	if (skb->protocol == bpf_htons(ETH_P_IPV6))
+		return ipv6_to_ipv4(skb, ETH_HLEN, LXC_IPV4);
+
+	if (!revalidate_data(skb, &data, &data_end, &ip4))
+		return DROP_INVALID;
+
+	BPF_V6(dp, LXC_IP);
+	return ipv4_to_ipv6(skb, ip4, ETH_HLEN, &dp);
+}
+
+#endif /* __DATAPATH_HARNESS_H_ */
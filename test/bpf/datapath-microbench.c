@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (c) 2018 Authors of Cilium
+//
+// Runs pieces of the datapath library in a tight loop against the mock
+// helpers and reports the average time per call. Intended to be profiled
+// with perf, e.g.:
+//
+//    $ make -C test/bpf datapath-microbench
+//    $ perf record -g test/bpf/datapath-microbench -n 10000000 ct4-established
+//
+// The cost of the mock maps differs from the kernel maps, so the numbers
+// are only meaningful relative to each other and across changes of bpf/lib.
+#include <time.h>
+#include <unistd.h>
+
+#include "datapath-harness.h"
+
+static struct mock_skb skb;
+static __u8 pkt[128];
+static __u32 pkt_len;
+
+/* Builds an ethernet frame with an IPv4 TCP header into pkt */
+static void build_tcp4(__be32 saddr, __be32 daddr, __u16 sport, __u16 dport,
+		       bool syn)
+{
+	struct ethhdr *eth = (struct ethhdr *) pkt;
+	struct iphdr *ip4 = (struct iphdr *) (eth + 1);
+	struct tcphdr *tcp = (struct tcphdr *) (ip4 + 1);
+	__u32 csum;
+
+	memset(pkt, 0, sizeof(pkt));
+	eth->h_proto = bpf_htons(ETH_P_IP);
+
+	ip4->version = 4;
+	ip4->ihl = 5;
+	ip4->ttl = 64;
+	ip4->protocol = IPPROTO_TCP;
+	ip4->tot_len = bpf_htons(sizeof(*ip4) + sizeof(*tcp));
+	ip4->saddr = saddr;
+	ip4->daddr = daddr;
+	ip4->check = mock_csum_fold(csum_diff(NULL, 0, ip4, sizeof(*ip4), 0));
+
+	tcp->source = bpf_htons(sport);
+	tcp->dest = bpf_htons(dport);
+	tcp->doff = 5;
+	tcp->syn = syn;
+	tcp->ack = !syn;
+	tcp->window = bpf_htons(65535);
+
+	/* Pseudo header followed by the TCP header */
+	csum = csum_diff(NULL, 0, &ip4->saddr, 8, 0);
+	csum = mock_csum_add(csum, bpf_htonl(IPPROTO_TCP + sizeof(*tcp)));
+	tcp->check = mock_csum_fold(csum_diff(NULL, 0, tcp, sizeof(*tcp), csum));
+
+	pkt_len = ETH_HLEN + sizeof(*ip4) + sizeof(*tcp);
+}
+
+/* Builds an ethernet frame with an IPv6 TCP header into pkt */
+static void build_tcp6(__u16 sport, __u16 dport, bool syn)
+{
+	union v6addr lxc = { .addr = { LXC_IP } };
+	struct ethhdr *eth = (struct ethhdr *) pkt;
+	struct ipv6hdr *ip6 = (struct ipv6hdr *) (eth + 1);
+	struct tcphdr *tcp = (struct tcphdr *) (ip6 + 1);
+
+	memset(pkt, 0, sizeof(pkt));
+	eth->h_proto = bpf_htons(ETH_P_IPV6);
+
+	ip6->version = 6;
+	ip6->nexthdr = IPPROTO_TCP;
+	ip6->hop_limit = 64;
+	ip6->payload_len = bpf_htons(sizeof(*tcp));
+	memcpy(&ip6->saddr, &lxc, sizeof(lxc));
+	memcpy(&ip6->daddr, &lxc, sizeof(lxc));
+	ip6->daddr.s6_addr[15] ^= 1;
+
+	tcp->source = bpf_htons(sport);
+	tcp->dest = bpf_htons(dport);
+	tcp->doff = 5;
+	tcp->syn = syn;
+	tcp->ack = !syn;
+
+	pkt_len = ETH_HLEN + sizeof(*ip6) + sizeof(*tcp);
+}
+
+static void reset(void)
+{
+	if (mock_skb_init(&skb, pkt, pkt_len) < 0) {
+		fprintf(stderr, "Unable to allocate packet buffer\n");
+		exit(1);
+	}
+}
+
+struct bench {
+	const char *name;
+	const char *desc;
+	void (*prepare)(void);
+	int (*run)(__u64 i);
+	int expect;
+};
+
+static void prepare_ct4_new(void)
+{
+	mock_map_clear(&CT_MAP4);
+	build_tcp4(LXC_IPV4, HARNESS_REMOTE_IP, 0, 80, true);
+}
+
+/* Every iteration uses a new source port and thus creates a connection,
+ * the map is cleared before it fills up.
+ */
+static int run_ct4_new(__u64 i)
+{
+	struct tcphdr *tcp = (struct tcphdr *) (pkt + ETH_HLEN + sizeof(struct iphdr));
+
+	if (i % CT_MAP_SIZE == 0)
+		mock_map_clear(&CT_MAP4);
+	tcp->source = bpf_htons(1024 + i % CT_MAP_SIZE);
+	reset();
+	return harness_ct4(&skb.skb, CT_EGRESS);
+}
+
+static void prepare_ct4_established(void)
+{
+	build_tcp4(LXC_IPV4, HARNESS_REMOTE_IP, 1000, 80, true);
+	reset();
+	harness_ct4(&skb.skb, CT_EGRESS);
+	build_tcp4(LXC_IPV4, HARNESS_REMOTE_IP, 1000, 80, false);
+}
+
+static int run_ct4(__u64 i)
+{
+	reset();
+	return harness_ct4(&skb.skb, CT_EGRESS);
+}
+
+static void prepare_ct4_reply(void)
+{
+	prepare_ct4_established();
+	build_tcp4(HARNESS_REMOTE_IP, LXC_IPV4, 80, 1000, false);
+}
+
+static int run_ct4_reply(__u64 i)
+{
+	reset();
+	return harness_ct4(&skb.skb, CT_INGRESS);
+}
+
+static void prepare_ct6_established(void)
+{
+	build_tcp6(1000, 80, true);
+	reset();
+	harness_ct6(&skb.skb, CT_EGRESS);
+	build_tcp6(1000, 80, false);
+}
+
+static int run_ct6(__u64 i)
+{
+	reset();
+	return harness_ct6(&skb.skb, CT_EGRESS);
+}
+
+static void prepare_lb4(void)
+{
+	build_tcp4(LXC_IPV4, HARNESS_SERVICE_IP, 1001, HARNESS_SERVICE_PORT, true);
+}
+
+static int run_lb4(__u64 i)
+{
+	reset();
+	return harness_lb4(&skb.skb);
+}
+
+static void prepare_policy(void)
+{
+	build_tcp4(LXC_IPV4, HARNESS_REMOTE_IP, 1000, 80, false);
+	reset();
+}
+
+static int run_policy_l4(__u64 i)
+{
+	return harness_policy(&skb.skb, HARNESS_IDENTITY, 80, IPPROTO_TCP, CT_EGRESS);
+}
+
+static int run_policy_proxy(__u64 i)
+{
+	return harness_policy(&skb.skb, HARNESS_IDENTITY, 8080, IPPROTO_TCP, CT_EGRESS);
+}
+
+static int run_policy_l3(__u64 i)
+{
+	return harness_policy(&skb.skb, HARNESS_IDENTITY, 443, IPPROTO_TCP, CT_INGRESS);
+}
+
+static int run_policy_denied(__u64 i)
+{
+	return harness_policy(&skb.skb, HARNESS_IDENTITY + 1, 80, IPPROTO_TCP, CT_EGRESS);
+}
+
+static void prepare_nat46(void)
+{
+	build_tcp4(HARNESS_REMOTE_IP, LXC_IPV4, 80, 1000, false);
+}
+
+static int run_nat46(__u64 i)
+{
+	reset();
+	return harness_nat46(&skb.skb);
+}
+
+static struct bench benches[] = {
+	{ "ct4-new", "ct_lookup4() and ct_create4() of new connections",
+	  prepare_ct4_new, run_ct4_new, CT_NEW },
+	{ "ct4-established", "ct_lookup4() of an established connection",
+	  prepare_ct4_established, run_ct4, CT_ESTABLISHED },
+	{ "ct4-reply", "ct_lookup4() of a reply",
+	  prepare_ct4_reply, run_ct4_reply, CT_REPLY },
+	{ "ct6-established", "ct_lookup6() of an established connection",
+	  prepare_ct6_established, run_ct6, CT_ESTABLISHED },
+	{ "lb4-service", "lb4_local() of a new connection to a service",
+	  prepare_lb4, run_lb4, 0 },
+	{ "policy-l4", "__policy_can_access() matching an L4 rule",
+	  prepare_policy, run_policy_l4, 0 },
+	{ "policy-proxy", "__policy_can_access() matching a proxy redirect",
+	  prepare_policy, run_policy_proxy, bpf_htons(HARNESS_PROXY_PORT) },
+	{ "policy-l3", "__policy_can_access() matching an L3 rule",
+	  prepare_policy, run_policy_l3, 0 },
+	{ "policy-denied", "__policy_can_access() without matching rule",
+	  prepare_policy, run_policy_denied, DROP_POLICY },
+	{ "nat46", "ipv4_to_ipv6() of a TCP packet",
+	  prepare_nat46, run_nat46, 0 },
+};
+
+#define NBENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static __u64 now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int run(struct bench *b, __u64 iterations)
+{
+	__u64 i, start, duration;
+	int ret;
+
+	b->prepare();
+	ret = b->run(0);
+	if (ret != b->expect) {
+		fprintf(stderr, "%s: unexpected result %d, expected %d\n",
+			b->name, ret, b->expect);
+		return 1;
+	}
+
+	start = now();
+	for (i = 1; i <= iterations; i++)
+		b->run(i);
+	duration = now() - start;
+
+	printf("%-20s %10.1f ns/op  %s\n", b->name,
+	       (double) duration / iterations, b->desc);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	unsigned int i;
+
+	fprintf(stderr, "Usage: %s [-n iterations] [benchmark...]\n\n", prog);
+	for (i = 0; i < NBENCHES; i++)
+		fprintf(stderr, "  %-20s %s\n", benches[i].name, benches[i].desc);
+}
+
+int main(int argc, char *argv[])
+{
+	__u64 iterations = 1000000;
+	unsigned int i;
+	int opt, j, ret = 0;
+
+	while ((opt = getopt(argc, argv, "n:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			iterations = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	harness_setup();
+
+	for (i = 0; i < NBENCHES; i++) {
+		bool selected = optind == argc;
+
+		for (j = optind; j < argc; j++)
+			if (!strcmp(argv[j], benches[i].name))
+				selected = true;
+		if (selected)
+			ret |= run(&benches[i], iterations);
+	}
+
+	return ret;
+}
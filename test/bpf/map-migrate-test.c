@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (c) 2018 Authors of Cilium
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/utils.h"
+#include "node_config.h"
+
+#include "lib/common.h"
+
+#include "cilium-map-migrate.h"
+
+struct value_v1 {
+	__u32 a;
+	__u16 b;
+	__u16 c;
+};
+
+struct value_v2 {
+	struct value_v1 old;
+	__u32 d;
+	__u32 e;
+};
+
+static void migration_setup(struct bpf_map_migration *m, __u32 old_size,
+			    __u32 new_size, __u32 ncpus, bool percpu,
+			    __u32 count)
+{
+	memset(m, 0, sizeof(*m));
+	m->old_size = old_size;
+	m->new_size = new_size;
+	m->old_stride = percpu ? (old_size + 7) & ~7U : old_size;
+	m->new_stride = percpu ? (new_size + 7) & ~7U : new_size;
+	m->ncpus = ncpus;
+	m->old_values = calloc(count, (size_t)m->old_stride * ncpus);
+	m->new_values = calloc(count, (size_t)m->new_stride * ncpus);
+	assert(m->old_values && m->new_values);
+
+	/* Leftovers of a previous batch must not leak into new members */
+	memset(m->new_values, 0xff, (size_t)count * m->new_stride * ncpus);
+}
+
+static void migration_free(struct bpf_map_migration *m)
+{
+	free(m->old_values);
+	free(m->new_values);
+}
+
+static void test_convert_zero_extend()
+{
+	struct bpf_map_migration m;
+	struct value_v1 *from;
+	struct value_v2 *to;
+	__u32 i;
+
+	migration_setup(&m, sizeof(*from), sizeof(*to), 1, false, 3);
+	for (i = 0; i < 3; i++) {
+		from = (struct value_v1 *)bpf_migration_old(&m, i);
+		from->a = 0x11111111 * (i + 1);
+		from->b = 0x2222;
+		from->c = 0x3333;
+	}
+
+	bpf_migration_convert(&m, 3);
+
+	for (i = 0; i < 3; i++) {
+		to = (struct value_v2 *)bpf_migration_new(&m, i);
+		assert(to->old.a == 0x11111111 * (i + 1));
+		assert(to->old.b == 0x2222);
+		assert(to->old.c == 0x3333);
+		assert(to->d == 0);
+		assert(to->e == 0);
+	}
+	migration_free(&m);
+}
+
+static void test_convert_zero_extend_percpu()
+{
+	struct bpf_map_migration m;
+	__u32 ncpus = 3, i, cpu;
+	char *src, *dst;
+
+	/* Per-CPU values are 8 byte aligned: 12 -> 16 and 20 -> 24 */
+	migration_setup(&m, 12, 20, ncpus, true, 2);
+	for (i = 0; i < 2; i++) {
+		src = bpf_migration_old(&m, i);
+		for (cpu = 0; cpu < ncpus; cpu++)
+			memset(src + cpu * m.old_stride, i * ncpus + cpu + 1,
+			       m.old_size);
+	}
+
+	bpf_migration_convert(&m, 2);
+
+	for (i = 0; i < 2; i++) {
+		dst = bpf_migration_new(&m, i);
+		for (cpu = 0; cpu < ncpus; cpu++) {
+			char *v = dst + cpu * m.new_stride;
+			__u32 j;
+
+			for (j = 0; j < m.old_size; j++)
+				assert(v[j] == (char)(i * ncpus + cpu + 1));
+			for (; j < m.new_stride; j++)
+				assert(v[j] == 0);
+		}
+	}
+	migration_free(&m);
+}
+
+static void test_convert_ct_entry_v1()
+{
+	const struct bpf_value_layout *l;
+	struct bpf_map_migration m;
+	struct ct_entry_v1 *from;
+	struct ct_entry_v2 *to;
+
+	/* The new layout is the one of the datapath */
+	assert(sizeof(struct ct_entry_v2) == sizeof(struct ct_entry));
+
+	l = bpf_value_layout_find("/sys/fs/bpf/tc/globals/cilium_ct4_global",
+				  sizeof(*from), sizeof(*to));
+	assert(l && l->convert == bpf_ct_entry_convert_v1);
+	assert(!bpf_value_layout_find("/sys/fs/bpf/tc/globals/cilium_lb4_services",
+				      sizeof(*from), sizeof(*to)));
+	assert(!bpf_value_layout_find("cilium_ct4_global", sizeof(*from),
+				      sizeof(*to) + 8));
+
+	migration_setup(&m, sizeof(*from), sizeof(*to), 1, false, 1);
+	m.convert = l->convert;
+	from = (struct ct_entry_v1 *)bpf_migration_old(&m, 0);
+	from->rx_packets = 1;
+	from->rx_bytes = 2;
+	from->tx_packets = 3;
+	from->tx_bytes = 4;
+	from->lifetime = 5;
+	from->flags = 6;
+	from->rev_nat_index = 7;
+	from->slave = 8;
+	from->tx_flags_seen = 9;
+	from->rx_flags_seen = 10;
+	from->src_sec_id = 11;
+	from->last_tx_report = 12;
+	from->last_rx_report = 13;
+
+	bpf_migration_convert(&m, 1);
+
+	to = (struct ct_entry_v2 *)bpf_migration_new(&m, 0);
+	assert(to->rx_packets == 1);
+	assert(to->rx_bytes == 2);
+	assert(to->tx_packets == 3);
+	assert(to->tx_bytes == 4);
+	assert(to->lifetime == 5);
+	assert(to->flags == 6);
+	assert(to->rev_nat_index == 7);
+	assert(to->slave == 8);
+	assert(to->tx_flags_seen == 9);
+	assert(to->rx_flags_seen == 10);
+	assert(to->src_sec_id == 11);
+	assert(to->last_tx_report == 12);
+	assert(to->last_rx_report == 13);
+	assert(to->proxy_port == 0);
+	assert(to->policy_rev == 0);
+	assert(to->remote_sec_id == 0);
+	assert(to->tunnel_endpoint == 0);
+	assert(to->pad == 0);
+	migration_free(&m);
+}
+
+int main(int argc, char *argv[])
+{
+	test_convert_zero_extend();
+	test_convert_zero_extend_percpu();
+	test_convert_ct_entry_v1();
+
+	return 0;
+}
@@ -0,0 +1,823 @@
+/*
+ *  Copyright (C) 2018 Authors of Cilium
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*
+ * Userspace implementation of the BPF helpers used by bpf/lib
+ *
+ * Including this header instead of <bpf/api.h> turns the helper
+ * declarations into static functions implemented below, so that the
+ * datapath library can be compiled into ordinary programs such as fuzzers
+ * and microbenchmarks. It must be included after the config headers and
+ * before any header of bpf/lib.
+ *
+ * Maps are kept in memory and created on first use from their struct
+ * bpf_elf_map definition. Hash tables and LPM tries are chained hash
+ * tables, LPM lookups probe each prefix length present in the trie. Per-CPU
+ * maps behave like a single CPU system.
+ *
+ * Packets live in a struct mock_skb. Its buffer is mapped below 4GB so
+ * that the 32 bit skb->data and skb->data_end can hold real pointers for
+ * direct packet access. Like in the kernel, the network header following
+ * the ethernet header is 4 byte aligned (NET_IP_ALIGN).
+ *
+ * Helpers which end the program in the kernel, tail_call() and redirect(),
+ * only record their arguments in mock_state and return. tail_call() thus
+ * looks like a missing program to the caller.
+ */
+
+#ifndef __MOCK_H_
+#define __MOCK_H_
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Declare helpers as static functions rather than pointers to the helper
+ * ids of the kernel.
+ */
+#define BPF_FUNC(NAME, ...)						\
+	NAME(__VA_ARGS__) __maybe_unused
+#define BPF_FUNC2(NAME, ...)						\
+	NAME(__VA_ARGS__) __maybe_unused;				\
+	static __maybe_unused const void *mock_alias_##NAME
+
+#include <bpf/api.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+
+#include "lib/utils.h"
+
+#ifndef ENOTSUPP
+#define ENOTSUPP 524
+#endif
+
+#define MOCK_SKB_SIZE		4096
+#define MOCK_NET_IP_ALIGN	2
+#define MOCK_MAPS		64
+#define MOCK_MAP_BUCKETS	4096
+#define MOCK_RINGBUF_SIZE	512
+
+struct mock_skb {
+	struct __sk_buff skb;	/* Must be first */
+	__u8 *buf;
+	__u32 size;
+};
+
+struct mock_entry {
+	struct mock_entry *next;
+	__u8 data[];		/* key followed by value */
+};
+
+struct mock_map {
+	const struct bpf_elf_map *def;
+	__u32 count;
+	__u8 *array;
+	struct mock_entry **buckets;
+	__u32 *prefixes;	/* LPM tries: number of entries per prefix */
+};
+
+struct mock_state {
+	/* Returned by ktime_get_ns(), advanced by the caller */
+	__u64 now_ns;
+	__u32 prandom;
+
+	/* Arguments of the last call to tail_call() and redirect() */
+	__u32 tail_call_index;
+	__u32 tail_calls;
+	__u32 redirect_ifindex;
+	__u32 redirect_flags;
+
+	/* Number of events sent to user space */
+	__u64 events;
+	bool trace;
+
+	struct mock_map maps[MOCK_MAPS];
+	__u8 ringbuf_record[MOCK_RINGBUF_SIZE];
+};
+
+static struct mock_state mock_state = {
+	.now_ns = 1000000000ULL,
+	.prandom = 0x12345678,
+};
+
+/** Packets */
+
+/**
+ * mock_skb_init
+ * @m:		packet to initialize
+ * @data:	packet data starting with the ethernet header
+ * @len:	length of data
+ *
+ * Returns 0 on success or a negative error code.
+ */
+static inline int mock_skb_init(struct mock_skb *m, const void *data, __u32 len)
+{
+	if (!m->buf) {
+		void *addr = (void *) 0x10000000UL;
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_32BIT
+		flags |= MAP_32BIT;
+#endif
+		m->buf = mmap(addr, MOCK_SKB_SIZE, PROT_READ | PROT_WRITE,
+			      flags, -1, 0);
+		if (m->buf == MAP_FAILED) {
+			m->buf = NULL;
+			return -ENOMEM;
+		}
+		if ((unsigned long) m->buf + MOCK_SKB_SIZE > 0xffffffffUL) {
+			munmap(m->buf, MOCK_SKB_SIZE);
+			m->buf = NULL;
+			return -ENOMEM;
+		}
+		m->buf += MOCK_NET_IP_ALIGN;
+		m->size = MOCK_SKB_SIZE - MOCK_NET_IP_ALIGN;
+	}
+
+	if (len > m->size)
+		return -E2BIG;
+
+	memset(&m->skb, 0, sizeof(m->skb));
+	memcpy(m->buf, data, len);
+	m->skb.len = len;
+	m->skb.data = (__u32) (unsigned long) m->buf;
+	m->skb.data_end = m->skb.data + len;
+	if (len >= ETH_HLEN)
+		m->skb.protocol = (m->buf[12] << 8 | m->buf[13]);
+	m->skb.protocol = bpf_htons(m->skb.protocol);
+	return 0;
+}
+
+static inline struct mock_skb *mock_skb(struct __sk_buff *skb)
+{
+	return (struct mock_skb *) skb;
+}
+
+static inline void mock_skb_set_len(struct mock_skb *m, __u32 len)
+{
+	m->skb.len = len;
+	m->skb.data_end = m->skb.data + len;
+}
+
+/* Inserts (diff > 0) or removes (diff < 0) bytes at offset 'off' */
+static inline int mock_skb_resize(struct mock_skb *m, __u32 off, int diff)
+{
+	__u32 len = m->skb.len;
+
+	if (off > len || (diff < 0 && off - diff > len) ||
+	    len + diff > m->size)
+		return -EINVAL;
+
+	if (diff > 0) {
+		memmove(m->buf + off + diff, m->buf + off, len - off);
+		memset(m->buf + off, 0, diff);
+	} else {
+		memmove(m->buf + off, m->buf + off - diff, len - off + diff);
+	}
+	mock_skb_set_len(m, len + diff);
+	return 0;
+}
+
+/** Maps */
+
+static inline __u64 mock_hash(const __u8 *data, __u32 len)
+{
+	__u64 hash = 14695981039346656037ULL;
+	__u32 i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static inline bool mock_map_is_array(const struct bpf_elf_map *def)
+{
+	switch (def->type) {
+	case BPF_MAP_TYPE_ARRAY:
+	case BPF_MAP_TYPE_PERCPU_ARRAY:
+	case BPF_MAP_TYPE_PROG_ARRAY:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* LPM trie keys start with a __u32 prefix length followed by the data */
+static inline __u32 mock_lpm_max_prefixlen(const struct mock_map *m)
+{
+	return (m->def->size_key - sizeof(__u32)) * 8;
+}
+
+static inline struct mock_map *mock_map(const void *map)
+{
+	const struct bpf_elf_map *def = map;
+	struct mock_map *m;
+	int i;
+
+	for (i = 0; i < MOCK_MAPS; i++) {
+		m = &mock_state.maps[i];
+		if (m->def == def)
+			return m;
+		if (m->def)
+			continue;
+
+		m->def = def;
+		if (mock_map_is_array(def))
+			m->array = calloc(def->max_elem, def->size_value);
+		else
+			m->buckets = calloc(MOCK_MAP_BUCKETS, sizeof(*m->buckets));
+		if (def->type == BPF_MAP_TYPE_LPM_TRIE)
+			m->prefixes = calloc(mock_lpm_max_prefixlen(m) + 1,
+					     sizeof(*m->prefixes));
+		if ((!m->array && !m->buckets) ||
+		    (def->type == BPF_MAP_TYPE_LPM_TRIE && !m->prefixes)) {
+			fprintf(stderr, "mock: out of memory\n");
+			abort();
+		}
+		return m;
+	}
+
+	fprintf(stderr, "mock: more than %d maps\n", MOCK_MAPS);
+	abort();
+}
+
+static inline struct mock_entry **mock_map_find(struct mock_map *m, const void *key)
+{
+	__u32 size = m->def->size_key;
+	struct mock_entry **e;
+
+	e = &m->buckets[mock_hash(key, size) % MOCK_MAP_BUCKETS];
+	for (; *e; e = &(*e)->next)
+		if (!memcmp((*e)->data, key, size))
+			break;
+	return e;
+}
+
+/* Copies key to out with the given prefix length and all bits beyond it
+ * cleared, so that keys of the same prefix can be compared as a whole.
+ */
+static inline void mock_lpm_key(const struct mock_map *m, const void *key,
+				__u32 prefixlen, __u8 *out)
+{
+	__u32 bytes = prefixlen / 8, bits = prefixlen % 8;
+	__u8 *data = out + sizeof(__u32);
+
+	memcpy(out, key, m->def->size_key);
+	memcpy(out, &prefixlen, sizeof(prefixlen));
+	if (bits)
+		data[bytes++] &= 0xff << (8 - bits);
+	memset(data + bytes, 0, mock_lpm_max_prefixlen(m) / 8 - bytes);
+}
+
+/* Probes all prefix lengths present in the trie, longest first */
+static inline void *mock_lpm_lookup(struct mock_map *m, const void *key)
+{
+	__u32 prefixlen = *(const __u32 *) key;
+	__u8 lpm_key[m->def->size_key];
+	struct mock_entry *e;
+	int len;
+
+	if (prefixlen > mock_lpm_max_prefixlen(m))
+		prefixlen = mock_lpm_max_prefixlen(m);
+
+	for (len = prefixlen; len >= 0; len--) {
+		if (!m->prefixes[len])
+			continue;
+		mock_lpm_key(m, key, len, lpm_key);
+		e = *mock_map_find(m, lpm_key);
+		if (e)
+			return e->data + m->def->size_key;
+	}
+	return NULL;
+}
+
+/* Removes an arbitrary entry to make room in a full LRU map */
+static inline void mock_lru_evict(struct mock_map *m)
+{
+	struct mock_entry *e;
+	int i;
+
+	for (i = 0; i < MOCK_MAP_BUCKETS; i++) {
+		e = m->buckets[i];
+		if (e) {
+			m->buckets[i] = e->next;
+			free(e);
+			m->count--;
+			return;
+		}
+	}
+}
+
+static void *map_lookup_elem(void *map, const void *key)
+{
+	struct mock_map *m = mock_map(map);
+	struct mock_entry *e;
+
+	if (m->array) {
+		__u32 index = *(const __u32 *) key;
+
+		if (index >= m->def->max_elem)
+			return NULL;
+		return m->array + index * m->def->size_value;
+	}
+
+	if (m->def->type == BPF_MAP_TYPE_LPM_TRIE)
+		return mock_lpm_lookup(m, key);
+
+	e = *mock_map_find(m, key);
+	return e ? e->data + m->def->size_key : NULL;
+}
+
+static int map_update_elem(void *map, const void *key, const void *value,
+			   uint32_t flags)
+{
+	struct mock_map *m = mock_map(map);
+	__u8 lpm_key[m->def->size_key];
+	struct mock_entry **e;
+
+	if (m->array) {
+		__u32 index = *(const __u32 *) key;
+
+		if (index >= m->def->max_elem)
+			return -E2BIG;
+		if (flags == BPF_NOEXIST)
+			return -EEXIST;
+		memcpy(m->array + index * m->def->size_value, value,
+		       m->def->size_value);
+		return 0;
+	}
+
+	if (m->prefixes) {
+		if (*(const __u32 *) key > mock_lpm_max_prefixlen(m))
+			return -EINVAL;
+		mock_lpm_key(m, key, *(const __u32 *) key, lpm_key);
+		key = lpm_key;
+	}
+
+	e = mock_map_find(m, key);
+	if (*e) {
+		if (flags == BPF_NOEXIST)
+			return -EEXIST;
+		memcpy((*e)->data + m->def->size_key, value, m->def->size_value);
+		return 0;
+	}
+	if (flags == BPF_EXIST)
+		return -ENOENT;
+
+	if (m->count >= m->def->max_elem) {
+		if (m->def->type != BPF_MAP_TYPE_LRU_HASH &&
+		    m->def->type != BPF_MAP_TYPE_LRU_PERCPU_HASH)
+			return -E2BIG;
+		mock_lru_evict(m);
+		e = mock_map_find(m, key);
+	}
+
+	*e = malloc(sizeof(**e) + m->def->size_key + m->def->size_value);
+	if (!*e)
+		return -ENOMEM;
+	(*e)->next = NULL;
+	memcpy((*e)->data, key, m->def->size_key);
+	memcpy((*e)->data + m->def->size_key, value, m->def->size_value);
+	m->count++;
+	if (m->prefixes)
+		m->prefixes[*(const __u32 *) key]++;
+	return 0;
+}
+
+static int map_delete_elem(void *map, const void *key)
+{
+	struct mock_map *m = mock_map(map);
+	__u8 lpm_key[m->def->size_key];
+	struct mock_entry **e, *next;
+
+	if (m->array)
+		return -EINVAL;
+
+	if (m->prefixes) {
+		if (*(const __u32 *) key > mock_lpm_max_prefixlen(m))
+			return -EINVAL;
+		mock_lpm_key(m, key, *(const __u32 *) key, lpm_key);
+		key = lpm_key;
+	}
+
+	e = mock_map_find(m, key);
+	if (!*e)
+		return -ENOENT;
+	if (m->prefixes)
+		m->prefixes[*(const __u32 *) key]--;
+	next = (*e)->next;
+	free(*e);
+	*e = next;
+	m->count--;
+	return 0;
+}
+
+/**
+ * mock_map_count
+ * @map:	map definition
+ *
+ * Returns the number of entries in a hash table or LPM trie.
+ */
+static inline __u32 mock_map_count(void *map)
+{
+	return mock_map(map)->count;
+}
+
+/**
+ * mock_map_clear
+ * @map:	map definition
+ *
+ * Removes all entries of a map.
+ */
+static inline void mock_map_clear(void *map)
+{
+	struct mock_map *m = mock_map(map);
+	struct mock_entry *e, *next;
+	int i;
+
+	if (m->array) {
+		memset(m->array, 0, (size_t) m->def->max_elem * m->def->size_value);
+		return;
+	}
+
+	for (i = 0; i < MOCK_MAP_BUCKETS; i++) {
+		for (e = m->buckets[i]; e; e = next) {
+			next = e->next;
+			free(e);
+		}
+		m->buckets[i] = NULL;
+	}
+	m->count = 0;
+	if (m->prefixes)
+		memset(m->prefixes, 0, (mock_lpm_max_prefixlen(m) + 1) *
+		       sizeof(*m->prefixes));
+}
+
+/** Checksums, see csum_replace*() and csum_partial() of the kernel */
+
+static inline __u16 mock_csum_fold(__u32 csum)
+{
+	csum = (csum & 0xffff) + (csum >> 16);
+	csum = (csum & 0xffff) + (csum >> 16);
+	return (__u16) ~csum;
+}
+
+static inline __u32 mock_csum_add(__u32 csum, __u32 addend)
+{
+	csum += addend;
+	return csum + (csum < addend);
+}
+
+static inline __u32 mock_csum_unfold(__u16 sum)
+{
+	return sum;
+}
+
+static int csum_diff(void *from, uint32_t from_size, void *to,
+		     uint32_t to_size, uint32_t seed)
+{
+	__u32 *f = from, *t = to;
+	__u32 csum = seed, i;
+
+	if (from_size % 4 || to_size % 4)
+		return -EINVAL;
+
+	for (i = 0; i < from_size / 4; i++)
+		csum = mock_csum_add(csum, ~f[i]);
+	for (i = 0; i < to_size / 4; i++)
+		csum = mock_csum_add(csum, t[i]);
+	return csum;
+}
+
+/* Replaces 'from' with 'to' or applies the difference 'to' if size is 0 */
+static inline int mock_csum_replace(struct __sk_buff *skb, uint32_t off,
+				    uint32_t from, uint32_t to, uint32_t size,
+				    bool mangled_0)
+{
+	struct mock_skb *m = mock_skb(skb);
+	__u16 sum;
+	__u32 csum;
+
+	if (off + sizeof(sum) > skb->len)
+		return -EFAULT;
+	memcpy(&sum, m->buf + off, sizeof(sum));
+	if (mangled_0 && !sum)
+		return 0;
+
+	csum = mock_csum_unfold((__u16) ~sum);
+	switch (size) {
+	case 0:
+		csum = mock_csum_add(csum, to);
+		break;
+	case 2:
+		csum = mock_csum_add(csum, (__u16) ~from);
+		csum = mock_csum_add(csum, (__u16) to);
+		break;
+	case 4:
+		csum = mock_csum_add(csum, ~from);
+		csum = mock_csum_add(csum, to);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	sum = mock_csum_fold(csum);
+	if (mangled_0 && !sum)
+		sum = 0xffff;
+	memcpy(m->buf + off, &sum, sizeof(sum));
+	return 0;
+}
+
+static int l3_csum_replace(struct __sk_buff *skb, uint32_t off, uint32_t from,
+			   uint32_t to, uint32_t flags)
+{
+	return mock_csum_replace(skb, off, from, to,
+				 flags & BPF_F_HDR_FIELD_MASK, false);
+}
+
+static int l4_csum_replace(struct __sk_buff *skb, uint32_t off, uint32_t from,
+			   uint32_t to, uint32_t flags)
+{
+	return mock_csum_replace(skb, off, from, to,
+				 flags & BPF_F_HDR_FIELD_MASK,
+				 flags & BPF_F_MARK_MANGLED_0);
+}
+
+/** Packet access */
+
+static int skb_load_bytes(struct __sk_buff *skb, uint32_t off, void *to,
+			  uint32_t len)
+{
+	if ((__u64) off + len > skb->len) {
+		memset(to, 0, len);
+		return -EFAULT;
+	}
+	memcpy(to, mock_skb(skb)->buf + off, len);
+	return 0;
+}
+
+static int skb_store_bytes(struct __sk_buff *skb, uint32_t off,
+			   const void *from, uint32_t len, uint32_t flags)
+{
+	if ((__u64) off + len > skb->len)
+		return -EFAULT;
+	memcpy(mock_skb(skb)->buf + off, from, len);
+	return 0;
+}
+
+/* The protocol change of nat46 moves the network header, which is assumed
+ * to follow an ethernet header.
+ */
+static int skb_change_proto(struct __sk_buff *skb, uint32_t proto,
+			    uint32_t flags)
+{
+	int diff = sizeof(struct ipv6hdr) - sizeof(struct iphdr);
+	int ret;
+
+	if (flags)
+		return -EINVAL;
+
+	if (proto == bpf_htons(ETH_P_IPV6) && skb->protocol == bpf_htons(ETH_P_IP))
+		ret = mock_skb_resize(mock_skb(skb), ETH_HLEN, diff);
+	else if (proto == bpf_htons(ETH_P_IP) && skb->protocol == bpf_htons(ETH_P_IPV6))
+		ret = mock_skb_resize(mock_skb(skb), ETH_HLEN, -diff);
+	else
+		return -ENOTSUPP;
+
+	if (!ret)
+		skb->protocol = proto;
+	return ret;
+}
+
+static int skb_change_type(struct __sk_buff *skb, uint32_t type)
+{
+	skb->pkt_type = type;
+	return 0;
+}
+
+static int skb_change_tail(struct __sk_buff *skb, uint32_t nlen, uint32_t flags)
+{
+	struct mock_skb *m = mock_skb(skb);
+
+	if (flags || nlen > m->size)
+		return -EINVAL;
+	if (nlen > skb->len)
+		memset(m->buf + skb->len, 0, nlen - skb->len);
+	mock_skb_set_len(m, nlen);
+	return 0;
+}
+
+static int skb_vlan_push(struct __sk_buff *skb, uint16_t proto,
+			 uint16_t vlan_tci)
+{
+	return -ENOTSUPP;
+}
+
+static int skb_vlan_pop(struct __sk_buff *skb)
+{
+	return -ENOTSUPP;
+}
+
+/** Program flow */
+
+static void tail_call(struct __sk_buff *skb, void *map, uint32_t index)
+{
+	mock_state.tail_call_index = index;
+	mock_state.tail_calls++;
+}
+
+static int redirect(int ifindex, uint32_t flags)
+{
+	mock_state.redirect_ifindex = ifindex;
+	mock_state.redirect_flags = flags;
+	return TC_ACT_REDIRECT;
+}
+
+static int clone_redirect(struct __sk_buff *skb, int ifindex, uint32_t flags)
+{
+	return 0;
+}
+
+/** Misc */
+
+static uint64_t ktime_get_ns(void)
+{
+	return mock_state.now_ns;
+}
+
+/* xorshift32 with a fixed seed to keep runs reproducible */
+static uint32_t get_prandom_u32(void)
+{
+	__u32 x = mock_state.prandom;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	mock_state.prandom = x;
+	return x;
+}
+
+static uint32_t get_smp_processor_id(void)
+{
+	return 0;
+}
+
+static void trace_printk(const char *fmt, int fmt_size, ...)
+{
+	va_list args;
+
+	if (!mock_state.trace)
+		return;
+	va_start(args, fmt_size);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+static uint32_t get_cgroup_classid(struct __sk_buff *skb)
+{
+	return 0;
+}
+
+static uint32_t get_route_realm(struct __sk_buff *skb)
+{
+	return 0;
+}
+
+static uint32_t get_hash_recalc(struct __sk_buff *skb)
+{
+	return skb->hash;
+}
+
+static uint32_t set_hash_invalid(struct __sk_buff *skb)
+{
+	skb->hash = 0;
+	return 0;
+}
+
+static int skb_under_cgroup(void *map, uint32_t index)
+{
+	return 0;
+}
+
+/** Tunnel metadata is never present */
+
+static int skb_get_tunnel_key(struct __sk_buff *skb, struct bpf_tunnel_key *to,
+			      uint32_t size, uint32_t flags)
+{
+	memset(to, 0, size);
+	return -ENOENT;
+}
+
+static int skb_set_tunnel_key(struct __sk_buff *skb,
+			      const struct bpf_tunnel_key *from, uint32_t size,
+			      uint32_t flags)
+{
+	return 0;
+}
+
+static int skb_get_tunnel_opt(struct __sk_buff *skb, void *to, uint32_t size)
+{
+	return -ENOENT;
+}
+
+static int skb_set_tunnel_opt(struct __sk_buff *skb, const void *from,
+			      uint32_t size)
+{
+	return 0;
+}
+
+/** Events are counted and dropped */
+
+static int skb_event_output(struct __sk_buff *skb, void *map, uint64_t index,
+			    const void *data, uint32_t size)
+{
+	mock_state.events++;
+	return 0;
+}
+
+static int xdp_event_output(struct xdp_md *xdp, void *map, uint64_t index,
+			    const void *data, uint32_t size)
+{
+	mock_state.events++;
+	return 0;
+}
+
+static int ringbuf_output(void *ringbuf, const void *data, uint64_t size,
+			  uint64_t flags)
+{
+	mock_state.events++;
+	return 0;
+}
+
+static void *ringbuf_reserve(void *ringbuf, uint64_t size, uint64_t flags)
+{
+	if (size > sizeof(mock_state.ringbuf_record))
+		return NULL;
+	return mock_state.ringbuf_record;
+}
+
+static void ringbuf_submit(void *data, uint64_t flags)
+{
+	mock_state.events++;
+}
+
+static void ringbuf_discard(void *data, uint64_t flags)
+{
+}
+
+static uint64_t ringbuf_query(void *ringbuf, uint64_t flags)
+{
+	return 0;
+}
+
+/** There are no sockets */
+
+static struct bpf_sock *sk_lookup_tcp(struct __sk_buff *skb,
+				      struct bpf_sock_tuple *tuple,
+				      uint32_t tuple_size, uint64_t netns,
+				      uint64_t flags)
+{
+	return NULL;
+}
+
+static struct bpf_sock *sk_lookup_udp(struct __sk_buff *skb,
+				      struct bpf_sock_tuple *tuple,
+				      uint32_t tuple_size, uint64_t netns,
+				      uint64_t flags)
+{
+	return NULL;
+}
+
+static int sk_release(struct bpf_sock *sk)
+{
+	return 0;
+}
+
+static int sk_assign(struct __sk_buff *skb, struct bpf_sock *sk, uint64_t flags)
+{
+	return -ENOENT;
+}
+
+#endif /* __MOCK_H_ */
@@ -17,6 +17,7 @@ package main
 import (
 	"fmt"
 	"os"
+	"time"
 
 	"github.com/cilium/cilium/pkg/bpf"
 
@@ -31,35 +32,100 @@ var (
 		SampleType:   bpf.PERF_SAMPLE_RAW,
 		WakeupEvents: 1,
 	}
+
+	// ringBuf is the name of the ring buffer map to read from instead
+	// of the perf event array
+	ringBuf string
+
+	// quiet suppresses printing of individual events
+	quiet bool
+
+	received, lost, wakeups uint64
+	last                    = time.Now()
 )
 
 func receiveEvent(msg *bpf.PerfEventSample, cpu int) {
-	fmt.Printf("%+v\n", msg)
+	received++
+	if !quiet {
+		fmt.Printf("%+v\n", msg)
+	}
 }
 
-func lostEvent(lost *bpf.PerfEventLost, cpu int) {
-	fmt.Printf("Lost %d\n", lost.Lost)
+func lostEvent(msg *bpf.PerfEventLost, cpu int) {
+	lost += msg.Lost
+	if !quiet {
+		fmt.Printf("Lost %d\n", msg.Lost)
+	}
 }
 
-var RootCmd = &cobra.Command{
-	Use:   "perf-event-test",
-	Short: "Test utility for perf events",
-	Run: func(cmd *cobra.Command, args []string) {
-		events, err := bpf.NewPerCpuEvents(&config)
+func receiveRecord(data []byte) {
+	received++
+	if !quiet {
+		fmt.Printf("% x\n", data)
+	}
+}
+
+// reportRate prints the number of events per second once a second.
+func reportRate() {
+	elapsed := time.Since(last)
+	if elapsed < time.Second {
+		return
+	}
+
+	secs := elapsed.Seconds()
+	fmt.Printf("%.0f events/s, %.0f lost/s, %.0f wakeups/s\n",
+		float64(received)/secs, float64(lost)/secs, float64(wakeups)/secs)
+	received, lost, wakeups = 0, 0, 0
+	last = time.Now()
+}
+
+func readPerf() {
+	events, err := bpf.NewPerCpuEvents(&config)
+	if err != nil {
+		panic(err)
+	}
+
+	for {
+		todo, err := events.Poll(1000)
 		if err != nil {
 			panic(err)
 		}
+		if todo > 0 {
+			wakeups++
+			events.ReadAll(receiveEvent, lostEvent)
+		}
+		reportRate()
+	}
+}
 
-		for {
-			todo, err := events.Poll(-1)
-			if err != nil {
-				panic(err)
-			}
-			if todo > 0 {
-				events.ReadAll(receiveEvent, lostEvent)
-			}
+func readRingBuf() {
+	events, err := bpf.NewRingBufEvents(ringBuf)
+	if err != nil {
+		panic(err)
+	}
+
+	for {
+		todo, err := events.Poll(1000)
+		if err != nil {
+			panic(err)
 		}
+		if todo > 0 {
+			wakeups++
+			events.ReadAll(receiveRecord)
+		}
+		reportRate()
+	}
+}
 
+var RootCmd = &cobra.Command{
+	Use:   "perf-event-test",
+	Short: "Test utility for perf events",
+	Run: func(cmd *cobra.Command, args []string) {
+		if ringBuf != "" {
+			readRingBuf()
+		} else {
+			readPerf()
+		}
 	},
 }
 
@@ -74,4 +140,6 @@ func init() {
 	flags := RootCmd.PersistentFlags()
 	flags.IntVarP(&config.NumCpus, "num-cpus", "c", 1, "Number of CPUs")
 	flags.IntVarP(&config.NumPages, "num-pagse", "n", 8, "Number of pages for ring buffer")
+	flags.StringVarP(&ringBuf, "ringbuf", "r", "", "Read from this BPF ring buffer map instead of the perf event array")
+	flags.BoolVarP(&quiet, "quiet", "q", false, "Only print the event rate")
 }
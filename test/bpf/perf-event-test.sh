@@ -33,15 +33,50 @@ function setup
 	tc filter add dev $TESTDEV1 ingress bpf da obj $1
 }
 
+# Flood the test device from all CPUs and report the event rate seen by
+# the reader for the perf event array and the ring buffer transport.
+function throughput
+{
+	local duration=${1:-10}
+	local transport
+
+	for transport in perf ringbuf; do
+		cleanup
+		if [ "$transport" == "perf" ]; then
+			setup bpf-event-test.o
+			READER_ARGS="--quiet --num-cpus $(nproc)"
+		else
+			setup bpf-ringbuf-test.o
+			READER_ARGS="--quiet --ringbuf ringbuf_test_events"
+		fi
+
+		for i in $(seq $(nproc)); do
+			ping -f -q -w $duration $ADDR2 > /dev/null &
+		done
+
+		echo "== $transport"
+		timeout $duration ./perf-event-test $READER_ARGS || true
+		wait
+	done
+}
+
 function main
 {
 	if [ $# -lt 1 ]; then
 		echo "usage: $0 <bpf-object-file>"
+		echo "       $0 --throughput [seconds]"
 		exit 1
 	fi
 
 	cleanup
 	trap cleanup EXIT
+
+	if [ "$1" == "--throughput" ]; then
+		shift
+		throughput "$@"
+		return
+	fi
+
 	setup "$@"
 
 	ping -c 10 $ADDR2&
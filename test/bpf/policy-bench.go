@@ -0,0 +1,419 @@
+// Copyright 2018 Authors of Cilium
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// policy-bench compares the cost of the policy lookup cascade of
+// __policy_can_access() against the single LPM lookup used with
+// POLICY_LPM. Both lookups are hand assembled into minimal SCHED_CLS
+// programs which mirror <bpf/lib/policy.h> and run with BPF_PROG_TEST_RUN,
+// so no compiler is required.
+package main
+
+import (
+	"fmt"
+	"os"
+	"unsafe"
+
+	"github.com/cilium/cilium/pkg/bpf"
+	"github.com/cilium/cilium/pkg/byteorder"
+
+	"github.com/spf13/cobra"
+	"golang.org/x/sys/unix"
+)
+
+const (
+	progTypeSchedCls = 3
+	dropPolicy       = 2
+
+	// Must be synchronized with POLICY_* in <bpf/lib/common.h>
+	prefixL3        = 40
+	prefixFull      = 64
+	flagL3          = 1 << 0
+	flagDefault     = 1 << 1
+	flagWildcardIng = 1 << 2
+
+	identityL4       = 1000
+	identityL3       = 2000
+	identityWildcard = 3000
+	identityDenied   = 4000
+	proxyPort        = 4242
+)
+
+var (
+	repeat     uint32
+	identities uint32
+)
+
+// hashKey must match struct policy_key in <bpf/lib/common.h>
+type hashKey struct {
+	Identity uint32
+	DPort    uint16
+	Proto    uint8
+	Egress   uint8
+}
+
+// lpmKey must match struct policy_key in <bpf/lib/common.h> with
+// POLICY_LPM defined
+type lpmKey struct {
+	Prefixlen uint32
+	Identity  uint32
+	Egress    uint8
+	Proto     uint8
+	DPort     uint16
+}
+
+// entry must match struct policy_entry in <bpf/lib/common.h>
+type entry struct {
+	ProxyPort uint16
+	Flags     uint8
+	Pad0      uint8
+	Pad       [2]uint16
+	Packets   uint64
+	Bytes     uint64
+}
+
+type scenario struct {
+	name     string
+	identity uint32
+	dport    uint16
+	proto    uint8
+}
+
+var scenarios = []scenario{
+	{"l4", identityL4, 80, 6},
+	{"l3", identityL3, 80, 6},
+	{"wildcard", identityWildcard, 8080, 6},
+	{"denied", identityDenied, 80, 6},
+}
+
+type insn struct {
+	Code uint8
+	Regs uint8
+	Off  int16
+	Imm  int32
+}
+
+func ins(code, dst, src uint8, off int16, imm int32) insn {
+	return insn{Code: code, Regs: src<<4 | dst, Off: off, Imm: imm}
+}
+
+const (
+	r0  = 0
+	r1  = 1
+	r2  = 2
+	r6  = 6
+	r10 = 10
+)
+
+func ldMapFd(dst uint8, fd int) []insn {
+	return []insn{ins(0x18, dst, 1, 0, int32(fd)), ins(0, 0, 0, 0, 0)}
+}
+
+func stW(off int16, imm int32) insn  { return ins(0x62, r10, 0, off, imm) }
+func stH(off int16, imm int32) insn  { return ins(0x6a, r10, 0, off, imm) }
+func stB(off int16, imm int32) insn  { return ins(0x72, r10, 0, off, imm) }
+func movK(dst uint8, imm int32) insn { return ins(0xb7, dst, 0, 0, imm) }
+func movX(dst, src uint8) insn       { return ins(0xbf, dst, src, 0, 0) }
+func exit() insn                     { return ins(0x95, 0, 0, 0, 0) }
+
+// lookup calls map_lookup_elem(map, fp+off)
+func lookup(fd int, off int32) []insn {
+	return append(ldMapFd(r1, fd),
+		movX(r2, r10),
+		ins(0x07, r2, 0, 0, off),
+		ins(0x85, 0, 0, 0, 1))
+}
+
+// account updates the counters of the entry in r0 and returns its proxy
+// port. The skb pointer is kept in r6.
+func account() []insn {
+	return []insn{
+		movK(r1, 1),
+		ins(0xdb, r0, r1, 8, 0),
+		ins(0x61, r1, r6, 0, 0),
+		ins(0xdb, r0, r1, 16, 0),
+		ins(0x69, r0, r0, 0, 0),
+		exit(),
+	}
+}
+
+// cascadeProg mirrors __policy_can_access() without POLICY_LPM
+func cascadeProg(fd int, s scenario) []insn {
+	dport := int32(byteorder.HostToNetwork(s.dport).(uint16))
+	var p []insn
+
+	p = append(p, movX(r6, r1),
+		stW(-8, int32(s.identity)), stH(-4, dport), stB(-2, int32(s.proto)), stB(-1, 0))
+	p = append(p, lookup(fd, -8)...)
+	// if r0 goto account_l4
+	jl4a := len(p)
+	p = append(p, insn{})
+
+	p = append(p, stH(-4, 0), stB(-2, 0))
+	p = append(p, lookup(fd, -8)...)
+	jl3 := len(p)
+	p = append(p, insn{})
+
+	p = append(p, stW(-8, 0), stH(-4, dport), stB(-2, int32(s.proto)))
+	p = append(p, lookup(fd, -8)...)
+	jl4b := len(p)
+	p = append(p, insn{})
+
+	p = append(p, movK(r0, dropPolicy), exit())
+
+	l3 := len(p)
+	p = append(p, account()[:4]...)
+	p = append(p, movK(r0, 0), exit())
+
+	l4 := len(p)
+	p = append(p, account()...)
+
+	p[jl4a] = ins(0x55, r0, 0, int16(l4-jl4a-1), 0)
+	p[jl3] = ins(0x55, r0, 0, int16(l3-jl3-1), 0)
+	p[jl4b] = ins(0x55, r0, 0, int16(l4-jl4b-1), 0)
+	return p
+}
+
+// lpmProg mirrors __policy_can_access() with POLICY_LPM
+func lpmProg(fd int, s scenario) []insn {
+	dport := int32(byteorder.HostToNetwork(s.dport).(uint16))
+	var p []insn
+
+	p = append(p, movX(r6, r1),
+		stW(-16, prefixFull), stW(-12, int32(s.identity)),
+		stB(-8, 0), stB(-7, int32(s.proto)), stH(-6, dport))
+	p = append(p, lookup(fd, -16)...)
+	var miss []int
+
+	// if !r0 goto miss
+	miss = append(miss, len(p))
+	p = append(p, insn{})
+	// if !(flags & DEFAULT) goto hit
+	p = append(p, ins(0x71, r1, r0, 2, 0), movX(r2, r1), ins(0x57, r2, 0, 0, flagDefault))
+	jhit := len(p)
+	p = append(p, insn{})
+	// if !(flags & wildcard) goto miss
+	p = append(p, ins(0x57, r1, 0, 0, flagWildcardIng))
+	miss = append(miss, len(p))
+	p = append(p, insn{})
+
+	p = append(p, stW(-12, 0))
+	p = append(p, lookup(fd, -16)...)
+	miss = append(miss, len(p))
+	p = append(p, insn{})
+	p = append(p, ins(0x71, r1, r0, 2, 0), ins(0x57, r1, 0, 0, flagDefault|flagL3))
+	jmissFlags := len(p)
+	p = append(p, insn{})
+
+	hit := len(p)
+	p = append(p, account()...)
+
+	m := len(p)
+	p = append(p, movK(r0, dropPolicy), exit())
+
+	p[miss[0]] = ins(0x15, r0, 0, int16(m-miss[0]-1), 0)
+	p[jhit] = ins(0x15, r2, 0, int16(hit-jhit-1), 0)
+	p[miss[1]] = ins(0x15, r1, 0, int16(m-miss[1]-1), 0)
+	p[miss[2]] = ins(0x15, r0, 0, int16(m-miss[2]-1), 0)
+	p[jmissFlags] = ins(0x55, r1, 0, int16(m-jmissFlags-1), 0)
+	return p
+}
+
+func loadProg(p []insn) (int, error) {
+	license := []byte("GPL\x00")
+	logBuf := make([]byte, 65536)
+	attr := struct {
+		progType    uint32
+		insnCnt     uint32
+		insns       uint64
+		license     uint64
+		logLevel    uint32
+		logSize     uint32
+		logBuf      uint64
+		kernVersion uint32
+	}{
+		progType: progTypeSchedCls,
+		insnCnt:  uint32(len(p)),
+		insns:    uint64(uintptr(unsafe.Pointer(&p[0]))),
+		license:  uint64(uintptr(unsafe.Pointer(&license[0]))),
+		logLevel: 1,
+		logSize:  uint32(len(logBuf)),
+		logBuf:   uint64(uintptr(unsafe.Pointer(&logBuf[0]))),
+	}
+
+	fd, _, errno := unix.Syscall(unix.SYS_BPF, bpf.BPF_PROG_LOAD,
+		uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+	if errno != 0 {
+		return 0, fmt.Errorf("unable to load program: %s\n%s", errno, logBuf)
+	}
+	return int(fd), nil
+}
+
+// testRun runs the program 'repeat' times and returns its verdict and the
+// average duration in nanoseconds
+func testRun(fd int) (uint32, uint32, error) {
+	pkt := make([]byte, 64)
+	attr := struct {
+		progFd      uint32
+		retval      uint32
+		dataSizeIn  uint32
+		dataSizeOut uint32
+		dataIn      uint64
+		dataOut     uint64
+		repeat      uint32
+		duration    uint32
+	}{
+		progFd:     uint32(fd),
+		dataSizeIn: uint32(len(pkt)),
+		dataIn:     uint64(uintptr(unsafe.Pointer(&pkt[0]))),
+		repeat:     repeat,
+	}
+
+	_, _, errno := unix.Syscall(unix.SYS_BPF, bpf.BPF_PROG_TEST_RUN,
+		uintptr(unsafe.Pointer(&attr)), unsafe.Sizeof(attr))
+	if errno != 0 {
+		return 0, 0, fmt.Errorf("unable to run program: %s", errno)
+	}
+	return attr.retval, attr.duration, nil
+}
+
+type rule struct {
+	identity uint32
+	dport    uint16
+	proto    uint8
+	proxy    uint16
+}
+
+// rules returns the policy used by all scenarios, padded with additional
+// L3 and L4 rules to populate the maps.
+func rules() []rule {
+	r := []rule{
+		{identityL4, 80, 6, proxyPort},
+		{identityL3, 0, 0, 0},
+		{0, 8080, 6, proxyPort},
+	}
+	for i := uint32(0); i < identities; i++ {
+		r = append(r, rule{10000 + i, 0, 0, 0}, rule{20000 + i, 443, 6, 0})
+	}
+	return r
+}
+
+func populateHash(fd int) error {
+	for _, r := range rules() {
+		key := hashKey{Identity: r.identity, DPort: byteorder.HostToNetwork(r.dport).(uint16), Proto: r.proto}
+		val := entry{ProxyPort: byteorder.HostToNetwork(r.proxy).(uint16)}
+		if err := bpf.UpdateElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&val), 0); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// populateLPM encodes the rules as policymap.PolicyMap does
+func populateLPM(fd int) error {
+	wildcard := uint8(0)
+	for _, r := range rules() {
+		key := lpmKey{Prefixlen: prefixFull, Identity: r.identity, DPort: byteorder.HostToNetwork(r.dport).(uint16), Proto: r.proto}
+		val := entry{ProxyPort: byteorder.HostToNetwork(r.proxy).(uint16)}
+		if r.dport == 0 && r.proto == 0 {
+			key.Prefixlen = prefixL3
+			val = entry{Flags: flagL3}
+		} else if r.identity == 0 {
+			wildcard |= flagWildcardIng
+		}
+		if err := bpf.UpdateElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&val), 0); err != nil {
+			return err
+		}
+	}
+	if wildcard != 0 {
+		key := lpmKey{}
+		val := entry{Flags: flagDefault | wildcard}
+		return bpf.UpdateElement(fd, unsafe.Pointer(&key), unsafe.Pointer(&val), 0)
+	}
+	return nil
+}
+
+func run() error {
+	hashFd, err := bpf.CreateMap(bpf.BPF_MAP_TYPE_HASH, uint32(unsafe.Sizeof(hashKey{})),
+		uint32(unsafe.Sizeof(entry{})), 16384, 0)
+	if err != nil {
+		return err
+	}
+	defer bpf.ObjClose(hashFd)
+
+	lpmFd, err := bpf.CreateMap(bpf.BPF_MAP_TYPE_LPM_TRIE, uint32(unsafe.Sizeof(lpmKey{})),
+		uint32(unsafe.Sizeof(entry{})), 16384, bpf.BPF_F_NO_PREALLOC)
+	if err != nil {
+		return err
+	}
+	defer bpf.ObjClose(lpmFd)
+
+	if err := populateHash(hashFd); err != nil {
+		return err
+	}
+	if err := populateLPM(lpmFd); err != nil {
+		return err
+	}
+
+	fmt.Printf("%-10s %12s %12s %8s\n", "SCENARIO", "CASCADE ns", "LPM ns", "VERDICT")
+	for _, s := range scenarios {
+		var verdicts, durations [2]uint32
+		for i, p := range [][]insn{cascadeProg(hashFd, s), lpmProg(lpmFd, s)} {
+			fd, err := loadProg(p)
+			if err != nil {
+				return err
+			}
+			verdicts[i], durations[i], err = testRun(fd)
+			unix.Close(fd)
+			if err != nil {
+				return err
+			}
+		}
+		if verdicts[0] != verdicts[1] {
+			return fmt.Errorf("%s: verdict mismatch, cascade %d, lpm %d", s.name, verdicts[0], verdicts[1])
+		}
+
+		verdict := "allow"
+		if verdicts[0] == dropPolicy {
+			verdict = "drop"
+		} else if verdicts[0] != 0 {
+			verdict = fmt.Sprintf("proxy %d", byteorder.NetworkToHost(uint16(verdicts[0])))
+		}
+		fmt.Printf("%-10s %12d %12d %8s\n", s.name, durations[0], durations[1], verdict)
+	}
+	return nil
+}
+
+var RootCmd = &cobra.Command{
+	Use:   "policy-bench",
+	Short: "Compare policy map lookup strategies with BPF_PROG_TEST_RUN",
+	Run: func(cmd *cobra.Command, args []string) {
+		if err := run(); err != nil {
+			fmt.Fprintf(os.Stderr, "%s\n", err)
+			os.Exit(1)
+		}
+	},
+}
+
+func main() {
+	if err := RootCmd.Execute(); err != nil {
+		fmt.Fprintf(os.Stderr, "%s", err)
+		os.Exit(-1)
+	}
+}
+
+func init() {
+	flags := RootCmd.PersistentFlags()
+	flags.Uint32VarP(&repeat, "repeat", "r", 1000000, "Number of runs per scenario")
+	flags.Uint32VarP(&identities, "identities", "i", 4096, "Number of additional L3 and L4 rules")
+}